@@ -9,13 +9,39 @@
  *   - loCredit: Minimum credit (bytes, negative)
  *
  * Estimation Method:
- *   1. Capture traffic and measure actual throughput per TC
- *   2. Detect burst patterns and inter-burst gaps
- *   3. Estimate idleSlope = measured_bandwidth when saturated
- *   4. Detect shaped vs unshaped traffic via burst analysis
+ *   1. Capture traffic, keeping each TC's frame times and lengths for the
+ *      current chunk of the run (FIT_CHUNK_FRAMES)
+ *   2. Replay them through the 802.1Qav credit (tsn-cbs.h): idleSlope is the
+ *      lowest slope at which the shaper would have let every frame start,
+ *      sendSlope = idleSlope - link, hiCredit / loCredit from the largest
+ *      interfering (other TCs, or --max-interference) and own frame
+ *   3. Shaped = the fit is pinned by frames the credit held back and is
+ *      below the link rate; otherwise idleSlope is only a lower bound
+ * A burst above the slope pins it, so the link need not be saturated. A full
+ * chunk is swapped out for a spare set of traces and fitted in the
+ * background, one thread per TC, while capture goes on; each fit is folded
+ * into the run's (tsn_cbs_fit_merge()), so a soak test is fitted end to end
+ * in bounded memory. Burst and gap figures are descriptive.
  *
- * Compile: gcc -O2 -o cbs-estimator cbs-estimator.c -lpcap -lpthread -lm
- * Run: sudo ./cbs-estimator <interface> <duration> <vlan_id> [link_speed_mbps]
+ * Bursts and throughput are accounted per packet, so with --interval-ms N
+ * the current estimate is also printed every N ms as one JSON line
+ * ("type": "cbs_update") while capturing. --shm NAME publishes the same
+ * estimate to /dev/shm/NAME (tsn-shm), every --interval-ms or 100 ms.
+ *
+ * With --read FILE a pcap / pcapng capture (tcpdump, hardware tap) is analyzed
+ * instead, split by PCP over --rx-workers threads (default: all CPUs, max 8).
+ * Which frame waited behind another TC's needs every TC's frames of a chunk,
+ * so the chunks end at group epochs (tsn_capture_group_set_epoch): the
+ * workers are idle while the traces are swapped.
+ *
+ * Results and live lines carry an "instrumentation" object (tsn-instr.h):
+ * kernel ring drops, frames the fit had no memory for, per-frame capture
+ * cost and the fit cost. A "shaped" verdict from a capture that dropped frames
+ * may be the capture, not the shaper.
+ *
+ * Compile: make cbs-estimator (links libtsntest.a)
+ * Run: sudo ./cbs-estimator [--interval-ms N] [--shm NAME] [--max-interference BYTES] <interface> <duration> <vlan_id> [link_speed_mbps]
+ *      ./cbs-estimator --read FILE [--rx-workers N] [vlan_id] [link_speed_mbps]
  */
 
 #define _GNU_SOURCE
@@ -28,50 +54,32 @@
 #include <signal.h>
 #include <time.h>
 #include <math.h>
-#include <sys/mman.h>
-#include <sched.h>
 #include <pthread.h>
-#include <pcap/pcap.h>
 
-#define MAX_TC 8
-#define MAX_PACKETS 100000
-#define MAX_BURSTS 10000
+#include "tsn-common.h"
+#include "tsn-capture.h"
+#include "tsn-analysis.h"
+#include "tsn-shm.h"
+#include "tsn-cbs.h"
 
-// Packet record
-typedef struct {
-    uint64_t ts_ns;
-    uint16_t len;
-    uint8_t tc;
-} packet_t;
-
-// Burst detection
-typedef struct {
-    uint64_t start_ns;
-    uint64_t end_ns;
-    uint32_t bytes;
-    uint32_t packets;
-} burst_t;
+#define MAX_TC TSN_MAX_TC
 
 // Per-TC analysis
 typedef struct {
-    // Raw data
-    packet_t packets[MAX_PACKETS];
-    int packet_count;
-
-    // Bursts
-    burst_t bursts[MAX_BURSTS];
-    int burst_count;
-
-    // Statistics
-    uint64_t total_bytes;
-    uint64_t first_ts;
-    uint64_t last_ts;
+    // Packet stream, bursts split as packets arrive
+    tsn_stream_t stream;
+    tsn_cbs_trace_t trace;        // frame times and lengths of the current chunk
+    uint64_t trace_dropped;       // frames the trace had no memory for
+    tsn_cbs_fit_t run_fit;        // fitted chunks so far (tsn_cbs_fit_merge)
+    uint16_t max_len;
 
     // CBS estimation
     double measured_bps;          // Actual throughput
-    double estimated_idle_slope;  // Estimated idle slope
+    double estimated_idle_slope;  // Fitted idle slope (measured_bps without a fit)
     double burst_ratio;           // Burst vs total time
-    bool is_shaped;               // Detected as CBS shaped
+    bool is_shaped;               // Fit pinned by the credit, below the link rate
+    tsn_cbs_fit_t fit;
+    bool fitted;
 
     // Burst timing
     double avg_burst_duration_us;
@@ -84,179 +92,351 @@ static volatile int running = 1;
 static tc_analysis_t tc_data[MAX_TC];
 static int target_vlan = 100;
 static double link_speed_bps = 100000000.0;  // Default 100 Mbps
-static pcap_t *handle = NULL;
-static pthread_mutex_t data_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tsn_capture_t *cap = NULL;
+static uint32_t ts_resolution_ns = 1000;
+static const char *ts_source = "software";
+static uint64_t update_interval_ms = 0;  // 0 = final result only
+static const char *read_file = NULL;     // offline analysis
+static int rx_workers = 0;               // file workers, 0 = one per CPU
+static tsn_capture_group_t *file_group = NULL;
+static const char *shm_name = NULL;
+static tsn_shm_stats_t *shm = NULL;
+
+// Shared-memory updates when no --interval-ms is given
+#define SHM_INTERVAL_MS 100
 
 // Burst detection threshold (microseconds gap = new burst)
 #define BURST_GAP_THRESHOLD_US 500
 
-static uint64_t get_time_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
-}
+// Frames of all TCs per fitted chunk (10 bytes each); live updates fit the
+// last LIVE_FIT_FRAMES of the current chunk so a tick stays short
+#define FIT_CHUNK_FRAMES (1U << 20)
+#define LIVE_FIT_FRAMES 65536
+
+// Shaped: fitted idle slope below this share of the link
+#define SHAPED_MAX_SHARE 0.95
+
+// Software timestamps: scheduling jitter forgiven per frame on top of the
+// resolution
+#define SW_TS_JITTER_NS 5000
+
+static long max_interference = -1;  // bytes, -1 = largest frame of the other TCs
+
+// Kernel filter on the VLAN (tsn_capture_set_match), else the pcap expression
+// and the generic parser
+static tsn_capture_match_t vlan_match;
+static tsn_capture_handler_t handler;
+
+// Capture counters, refreshed while the capture is open, and the cost of
+// the credit fits (tsn-instr.h)
+static tsn_instr_t capture_instr;
+static tsn_stage_t analysis_stage;
+
+// Frames in the current chunk (unless the file group ends chunks at its
+// epochs), chunks fitted, their cost
+static uint32_t chunk_frames;
+static bool chunk_epochs;
+static uint32_t chunks_fitted;
+static uint64_t fit_frames, fit_ns;
+
+// The chunk on the fit thread: every TC's full trace, swapped out of tc_data
+// so capture goes on into the spare ones. Results are folded in by
+// fit_collect() on the capture thread
+static struct {
+    tsn_cbs_trace_t trace[MAX_TC];
+    tsn_cbs_model_t model[MAX_TC];
+    tsn_cbs_fit_t fit[MAX_TC];
+    int rc[MAX_TC];
+    uint32_t tolerance_ns;
+    uint64_t frames, t0, t1, ns;
+    pthread_t tid;
+    bool busy;       // chunk handed over, not collected yet
+    bool threaded;   // else fitted inline (no thread)
+    int done;        // set by the fit thread
+} fitter;
+
+static void fit_chunk(void);
 
 static void signal_handler(int sig) {
     (void)sig;
     running = 0;
-    if (handle) pcap_breakloop(handle);
+    if (cap) tsn_capture_breakloop(cap);
+    if (file_group) tsn_capture_group_breakloop(file_group);
+}
+
+// Packet handlers - collect raw data
+// Capture and analysis run on the same thread, so the hot path takes no lock;
+// a file is split by PCP, so each TC still has a single writer. A full chunk
+// only costs a swap of the trace buffers here
+static inline void account(int pcp, const tsn_packet_t *hdr) {
+    tc_analysis_t *tc = &tc_data[pcp];
+    tsn_stream_add(&tc->stream, hdr->ts_ns, hdr->len);
+    uint16_t len = hdr->len > UINT16_MAX ? UINT16_MAX : (uint16_t)hdr->len;
+    if (tsn_cbs_trace_add(&tc->trace, hdr->ts_ns, len) < 0) tc->trace_dropped++;
+    if (len > tc->max_len) tc->max_len = len;
+    if (!chunk_epochs && ++chunk_frames >= FIT_CHUNK_FRAMES) fit_chunk();
 }
 
-// Packet handler - collect raw data
-static void packet_handler(u_char *user, const struct pcap_pkthdr *hdr, const u_char *pkt) {
+static void packet_handler(void *user, const tsn_packet_t *hdr) {
     (void)user;
 
-    if (hdr->caplen < 18) return;
+    tsn_vlan_t vlan;
+    if (tsn_parse_vlan(hdr->data, hdr->caplen, &vlan) < 0) return;
+    if (target_vlan > 0 && vlan.vid != target_vlan) return;
+    account(vlan.pcp, hdr);
+}
 
-    // Check VLAN
-    uint16_t ethertype = (pkt[12] << 8) | pkt[13];
-    if (ethertype != 0x8100) return;
+// Behind the generated kernel filter every frame carries the VLAN in-band
+static void packet_handler_matched(void *user, const tsn_packet_t *hdr) {
+    (void)user;
+    account(hdr->data[14] >> 5, hdr);
+}
 
-    uint16_t tci = (pkt[14] << 8) | pkt[15];
-    int pcp = (tci >> 13) & 0x07;
-    int vid = tci & 0x0FFF;
+static void instr_refresh(void) {
+    if (!cap && !file_group) return;
+    memset(&capture_instr, 0, sizeof(capture_instr));
+    if (cap) tsn_capture_instr(cap, &capture_instr);
+    else tsn_capture_group_instr(file_group, &capture_instr);
+}
 
-    if (target_vlan > 0 && vid != target_vlan) return;
+// Frames the fit had no room for count as truncated
+static void instr_get(tsn_instr_t *in) {
+    *in = capture_instr;
+    tsn_stage_merge(&in->stage[TSN_STAGE_ANALYSIS], &analysis_stage);
+    for (int i = 0; i < MAX_TC; i++) in->truncated += tc_data[i].trace_dropped;
+}
 
-    // Timestamp in nanoseconds
-    uint64_t ts_ns = (uint64_t)hdr->ts.tv_sec * 1000000000ULL +
-                     (uint64_t)hdr->ts.tv_usec * 1000ULL;
+// Credit model of TC i: the link, what can hold it back, the timestamp jitter
+static void cbs_model(int i, tsn_cbs_model_t *m) {
+    uint16_t intf = 0;
+    for (int t = 0; t < MAX_TC; t++) {
+        if (t != i && tc_data[t].max_len > intf) intf = tc_data[t].max_len;
+    }
+    m->link_bps = link_speed_bps;
+    m->interference_bytes = max_interference >= 0 ? (uint32_t)max_interference
+                                                  : intf ? (uint32_t)intf + TSN_CBS_WIRE_OVERHEAD : 0;
+    m->tolerance_ns = 2 * ts_resolution_ns + (strcmp(ts_source, "hardware") == 0 ? 0 : SW_TS_JITTER_NS);
+    m->burst_gap_ns = BURST_GAP_THRESHOLD_US * 1000ULL;
+}
 
-    pthread_mutex_lock(&data_mutex);
+// Fit thread: which frames waited behind another TC's, then one thread per TC
+static void *fit_thread(void *arg) {
+    (void)arg;
+    const tsn_cbs_trace_t *traces[MAX_TC];
+    tsn_cbs_model_t models[MAX_TC];
+    tsn_cbs_fit_t fits[MAX_TC];
+    int idx[MAX_TC], rc[MAX_TC], n = 0;
+    uint64_t start = tsn_time_ns();
+    fitter.t0 = tsn_instr_ticks();
+    fitter.frames = 0;
+
+    tsn_cbs_trace_t *all[MAX_TC];
+    for (int i = 0; i < MAX_TC; i++) all[i] = &fitter.trace[i];
+    tsn_cbs_mark_blocked(all, MAX_TC, link_speed_bps, fitter.tolerance_ns);
 
-    tc_analysis_t *tc = &tc_data[pcp];
-    if (tc->packet_count < MAX_PACKETS) {
-        packet_t *p = &tc->packets[tc->packet_count];
-        p->ts_ns = ts_ns;
-        p->len = hdr->len;
-        p->tc = pcp;
-        tc->packet_count++;
-        tc->total_bytes += hdr->len;
-
-        if (tc->first_ts == 0) tc->first_ts = ts_ns;
-        tc->last_ts = ts_ns;
+    for (int i = 0; i < MAX_TC; i++) {
+        fitter.rc[i] = -1;
+        if (fitter.trace[i].n == 0) continue;
+        models[n] = fitter.model[i];
+        traces[n] = &fitter.trace[i];
+        idx[n++] = i;
+        fitter.frames += fitter.trace[i].n;
+    }
+    tsn_cbs_fit_parallel(traces, models, fits, rc, n);
+    for (int j = 0; j < n; j++) {
+        fitter.fit[idx[j]] = fits[j];
+        fitter.rc[idx[j]] = rc[j];
     }
+    for (int i = 0; i < MAX_TC; i++) tsn_cbs_trace_reset(&fitter.trace[i]);
 
-    pthread_mutex_unlock(&data_mutex);
+    fitter.t1 = tsn_instr_ticks();
+    fitter.ns = tsn_time_ns() - start;
+    __atomic_store_n(&fitter.done, 1, __ATOMIC_RELEASE);
+    return NULL;
 }
 
-// Detect bursts in packet stream
-static void detect_bursts(tc_analysis_t *tc) {
-    if (tc->packet_count < 2) return;
-
-    uint64_t gap_threshold = BURST_GAP_THRESHOLD_US * 1000;  // to ns
-
-    // Start first burst
-    burst_t *b = &tc->bursts[0];
-    b->start_ns = tc->packets[0].ts_ns;
-    b->bytes = tc->packets[0].len;
-    b->packets = 1;
-    tc->burst_count = 1;
-
-    for (int i = 1; i < tc->packet_count; i++) {
-        uint64_t gap = tc->packets[i].ts_ns - tc->packets[i-1].ts_ns;
-
-        if (gap > gap_threshold && tc->burst_count < MAX_BURSTS) {
-            // End current burst
-            b->end_ns = tc->packets[i-1].ts_ns;
-
-            // Start new burst
-            tc->burst_count++;
-            b = &tc->bursts[tc->burst_count - 1];
-            b->start_ns = tc->packets[i].ts_ns;
-            b->bytes = tc->packets[i].len;
-            b->packets = 1;
-        } else {
-            // Continue burst
-            b->bytes += tc->packets[i].len;
-            b->packets++;
-        }
+// Fold the chunk on the fit thread into the run's fits, waiting for it
+static void fit_collect(void) {
+    if (!fitter.busy) return;
+    if (fitter.threaded) pthread_join(fitter.tid, NULL);
+    for (int i = 0; i < MAX_TC; i++) {
+        if (fitter.rc[i] == 0) tsn_cbs_fit_merge(&tc_data[i].run_fit, &fitter.fit[i]);
     }
+    tsn_stage_add(&analysis_stage, fitter.t0, fitter.t1, fitter.frames);
+    chunks_fitted++;
+    fit_frames += fitter.frames;
+    fit_ns += fitter.ns;
+    fitter.busy = false;
+}
 
-    // End last burst
-    b->end_ns = tc->packets[tc->packet_count - 1].ts_ns;
+// Hand the current chunk of every TC to the fit thread and start the next
+// one in the spare traces. The previous chunk has had a whole chunk of
+// capture time to finish; if it has not, this waits for it. Frames right
+// after a chunk boundary are not checked against the other TCs' frames of
+// the previous chunk
+static void fit_chunk(void) {
+    fit_collect();
+    tsn_cbs_model_t any;
+    cbs_model(-1, &any);
+    fitter.tolerance_ns = any.tolerance_ns;
+    for (int i = 0; i < MAX_TC; i++) {
+        tsn_cbs_trace_t t = fitter.trace[i];
+        fitter.trace[i] = tc_data[i].trace;
+        tc_data[i].trace = t;
+        cbs_model(i, &fitter.model[i]);
+    }
+    chunk_frames = 0;
+
+    fitter.busy = true;
+    fitter.done = 0;
+    fitter.threaded = pthread_create(&fitter.tid, NULL, fit_thread, NULL) == 0;
+    if (!fitter.threaded) fit_thread(NULL);
+}
+
+// File group epoch: every worker is idle
+static void fit_epoch(void *user) {
+    (void)user;
+    fit_chunk();
+}
+
+// Fit every TC: while capturing the fitted chunks plus the last
+// LIVE_FIT_FRAMES of the current one (no blocked marks: a pass over every
+// trace, too long for a tick, so a slightly higher slope; a chunk still on
+// the fit thread joins the estimate once done); at the end the rest of the
+// run
+static void fit_all(bool live) {
+    if (live && __atomic_load_n(&fitter.done, __ATOMIC_ACQUIRE)) fit_collect();
+    if (!live) {
+        fit_chunk();
+        fit_collect();
+        fprintf(stderr, "Credit fit: %lu frames in %u chunks, %.1f ms\n",
+                fit_frames, chunks_fitted, fit_ns / 1e6);
+    }
+
+    uint64_t t0 = tsn_instr_ticks(), frames = 0;
+    for (int i = 0; i < MAX_TC; i++) {
+        tc_analysis_t *tc = &tc_data[i];
+        tc->fitted = false;
+        if (tc->stream.count < 10) continue;
+        tc->fit = tc->run_fit;
+        if (live) {
+            tsn_cbs_model_t m;
+            tsn_cbs_fit_t tail;
+            cbs_model(i, &m);
+            uint32_t from = tc->trace.n > LIVE_FIT_FRAMES ? tc->trace.n - LIVE_FIT_FRAMES : 0;
+            if (tsn_cbs_fit(&tc->trace, from, &m, &tail) == 0) {
+                tsn_cbs_fit_merge(&tc->fit, &tail);
+                frames += tc->trace.n - from;
+            }
+        }
+        tc->fitted = tc->fit.frames > 0;
+    }
+    if (frames) tsn_stage_add(&analysis_stage, t0, tsn_instr_ticks(), frames);
 }
 
 // Analyze bursts and estimate CBS parameters
 static void analyze_cbs(tc_analysis_t *tc) {
-    if (tc->packet_count < 10 || tc->burst_count < 1) return;
+    if (tc->stream.count < 10) return;
+    if (tc->stream.burst_count < 1) return;
+
+    // Throughput and burst timing
+    tsn_burst_stats_t bs;
+    tsn_burst_stats(&tc->stream, &bs);
+    if (bs.measured_bps <= 0) return;
+
+    tc->measured_bps = bs.measured_bps;
+    tc->max_burst_bytes = bs.max_burst_bytes;
+    tc->avg_burst_duration_us = bs.avg_burst_us;
+    tc->avg_gap_duration_us = bs.avg_gap_us;
+    tc->burst_ratio = bs.burst_ratio;
+
+    // Idle slope from the credit fit (fit_all() first). Frames the credit
+    // held back pin it; unshaped or light traffic only bounds it from below
+    if (!tc->fitted) {
+        tc->estimated_idle_slope = tc->measured_bps;
+        tc->is_shaped = false;
+        return;
+    }
+    tc->estimated_idle_slope = tc->fit.idle_slope_bps;
+    tc->is_shaped = tc->fit.tight && tc->fit.idle_slope_bps < link_speed_bps * SHAPED_MAX_SHARE;
+}
 
-    // Calculate total duration
-    double total_duration_s = (tc->last_ts - tc->first_ts) / 1e9;
-    if (total_duration_s <= 0) return;
+// Recommended send slope and credits: the fit's, 802.1Qav defaults without one
+static void cbs_params(const tc_analysis_t *tc, double *send_slope, double *hi_credit, double *lo_credit) {
+    if (tc->fitted) {
+        *send_slope = tc->fit.send_slope_bps;
+        *hi_credit = tc->fit.hi_credit_bytes;
+        *lo_credit = tc->fit.lo_credit_bytes;
+        return;
+    }
+    *send_slope = -(link_speed_bps - tc->estimated_idle_slope);
+    *hi_credit = tc->max_burst_bytes * 1.5;  // Add margin
+    *lo_credit = -*hi_credit;
+}
 
-    // Measured throughput
-    tc->measured_bps = (tc->total_bytes * 8.0) / total_duration_s;
+// One-line JSON with the estimate so far
+static void print_update_json(uint64_t elapsed_ns) {
+    uint64_t total = 0;
+    for (int i = 0; i < MAX_TC; i++) total += tc_data[i].stream.count;
 
-    // Analyze burst patterns
-    double total_burst_time = 0;
-    double total_gap_time = 0;
-    double max_burst = 0;
+    printf("{\"type\":\"cbs_update\",\"elapsed_ms\":%.1f,\"total\":%lu,\"tc\":{",
+           elapsed_ns / 1e6, total);
 
-    for (int i = 0; i < tc->burst_count; i++) {
-        burst_t *b = &tc->bursts[i];
-        double burst_dur = (b->end_ns - b->start_ns) / 1e3;  // microseconds
-        total_burst_time += burst_dur;
+    int first = 1;
+    fit_all(true);
+    for (int i = 0; i < MAX_TC; i++) {
+        tc_analysis_t *tc = &tc_data[i];
+        if (tc->stream.count < 10) continue;
+        analyze_cbs(tc);
 
-        if (b->bytes > max_burst) max_burst = b->bytes;
+        if (!first) printf(",");
+        first = 0;
 
-        // Gap to next burst
-        if (i < tc->burst_count - 1) {
-            double gap = (tc->bursts[i+1].start_ns - b->end_ns) / 1e3;
-            total_gap_time += gap;
-        }
+        double send_slope, hi_credit, lo_credit;
+        cbs_params(tc, &send_slope, &hi_credit, &lo_credit);
+        printf("\"%d\":{\"packets\":%lu,\"bursts\":%lu,\"measured_kbps\":%.1f,"
+               "\"burst_ratio\":%.3f,\"is_shaped\":%s,\"estimated_idle_slope_kbps\":%.1f,"
+               "\"bandwidth_percent\":%.2f,\"hi_credit_bytes\":%.0f,\"lo_credit_bytes\":%.0f,"
+               "\"fit_tight\":%s}",
+               i, tc->stream.count, tc->stream.burst_count, tc->measured_bps / 1000.0,
+               tc->burst_ratio, tc->is_shaped ? "true" : "false",
+               tc->estimated_idle_slope / 1000.0,
+               (tc->estimated_idle_slope / link_speed_bps) * 100.0, hi_credit, lo_credit,
+               tc->fitted && tc->fit.tight ? "true" : "false");
     }
 
-    tc->max_burst_bytes = max_burst;
-    tc->avg_burst_duration_us = tc->burst_count > 0 ?
-        total_burst_time / tc->burst_count : 0;
-    tc->avg_gap_duration_us = tc->burst_count > 1 ?
-        total_gap_time / (tc->burst_count - 1) : 0;
-
-    // Calculate burst ratio
-    double total_time_us = total_duration_s * 1e6;
-    tc->burst_ratio = total_burst_time / total_time_us;
-
-    /*
-     * CBS Detection Heuristics:
-     *
-     * Shaped traffic characteristics:
-     * - Regular burst patterns with gaps
-     * - burst_ratio < 0.9 (not continuous)
-     * - Consistent inter-burst gaps
-     * - Limited max burst size (hiCredit effect)
-     *
-     * Unshaped traffic:
-     * - Near-continuous transmission
-     * - burst_ratio close to 1.0
-     * - No regular gaps
-     */
-
-    // Check for shaping indicators
-    bool has_gaps = tc->avg_gap_duration_us > 100;  // > 100us gaps
-    bool regular_bursts = tc->burst_count > 3;
-    bool limited_burst = tc->max_burst_bytes < 10000;  // bytes
-
-    tc->is_shaped = has_gaps && regular_bursts && (tc->burst_ratio < 0.85);
-
-    /*
-     * Idle Slope Estimation:
-     *
-     * For CBS: idleSlope determines the allocated bandwidth
-     * When traffic is saturated, measured throughput ≈ idleSlope / link_speed
-     *
-     * If shaped: idleSlope ≈ measured_bps (allocated bandwidth)
-     * If unshaped: idleSlope estimation not reliable
-     */
-
-    if (tc->is_shaped) {
-        // For shaped traffic, measured throughput reflects idle slope
-        tc->estimated_idle_slope = tc->measured_bps;
-    } else {
-        // Unshaped - estimate based on ratio of link speed
-        // This is less accurate
-        tc->estimated_idle_slope = tc->measured_bps;
+    tsn_instr_t in;
+    instr_get(&in);
+    printf("},");
+    tsn_instr_print_json(stdout, &in);
+    printf("}\n");
+    fflush(stdout);
+}
+
+// Estimate so far into the shared-memory block
+static void publish_shm(uint64_t elapsed_ns, bool live) {
+    if (live && update_interval_ms == 0) fit_all(true);  // else print_update_json's
+    tsn_shm_begin(shm);
+    uint64_t total = 0;
+    for (int i = 0; i < MAX_TC; i++) {
+        tc_analysis_t *tc = &tc_data[i];
+        total += tc->stream.count;
+        if (tc->stream.count == 0) continue;
+        analyze_cbs(tc);
+
+        tsn_shm_tc_t *t = &shm->tc[i];
+        tsn_shm_put_stream(t, &tc->stream);
+        t->idle_slope_kbps = tc->estimated_idle_slope / 1000.0;
+        double send_slope, lo_credit;
+        cbs_params(tc, &send_slope, &t->hi_credit_bytes, &lo_credit);
+        t->shaped = tc->is_shaped;
     }
+    shm->elapsed_ms = elapsed_ns / 1e6;
+    shm->total = total;
+    tsn_instr_t in;
+    instr_get(&in);
+    tsn_shm_put_instr(shm, &in);
+    tsn_shm_end(shm);
 }
 
 // Print JSON results
@@ -265,31 +445,45 @@ static void print_results_json(void) {
     printf("  \"type\": \"cbs_estimation\",\n");
     printf("  \"link_speed_mbps\": %.0f,\n", link_speed_bps / 1e6);
     printf("  \"vlan\": %d,\n", target_vlan);
+    printf("  \"timestamp_source\": \"%s\",\n", ts_source);
+    printf("  \"timestamp_resolution_ns\": %u,\n", ts_resolution_ns);
     printf("  \"tc\": {\n");
 
     int first = 1;
     for (int i = 0; i < MAX_TC; i++) {
         tc_analysis_t *tc = &tc_data[i];
-        if (tc->packet_count < 10) continue;
+        if (tc->stream.count < 10) continue;
 
         if (!first) printf(",\n");
         first = 0;
 
         printf("    \"%d\": {\n", i);
-        printf("      \"packets\": %d,\n", tc->packet_count);
-        printf("      \"bytes\": %lu,\n", tc->total_bytes);
-        printf("      \"duration_ms\": %.1f,\n", (tc->last_ts - tc->first_ts) / 1e6);
+        printf("      \"packets\": %lu,\n", tc->stream.count);
+        printf("      \"bytes\": %lu,\n", tc->stream.total_bytes);
+        printf("      \"duration_ms\": %.1f,\n", (tc->stream.last_ts - tc->stream.first_ts) / 1e6);
         printf("      \"measured_kbps\": %.1f,\n", tc->measured_bps / 1000.0);
         printf("      \"measured_mbps\": %.3f,\n", tc->measured_bps / 1e6);
-        printf("      \"bursts\": %d,\n", tc->burst_count);
+        printf("      \"bursts\": %lu,\n", tc->stream.burst_count);
         printf("      \"avg_burst_us\": %.1f,\n", tc->avg_burst_duration_us);
         printf("      \"avg_gap_us\": %.1f,\n", tc->avg_gap_duration_us);
         printf("      \"max_burst_bytes\": %.0f,\n", tc->max_burst_bytes);
+        tsn_pctl_t ia;
+        tsn_hist_pctl(&tc->stream.interval_hist, &ia);
+        printf("      \"interval_p50_us\": %.1f,\n", ia.p50);
+        printf("      \"interval_p90_us\": %.1f,\n", ia.p90);
+        printf("      \"interval_p99_us\": %.1f,\n", ia.p99);
+        printf("      \"interval_p999_us\": %.1f,\n", ia.p999);
+        printf("      \"interval_max_us\": %.1f,\n", ia.max);
         printf("      \"burst_ratio\": %.3f,\n", tc->burst_ratio);
         printf("      \"is_shaped\": %s,\n", tc->is_shaped ? "true" : "false");
         printf("      \"estimated_idle_slope_bps\": %.0f,\n", tc->estimated_idle_slope);
         printf("      \"estimated_idle_slope_kbps\": %.1f,\n", tc->estimated_idle_slope / 1000.0);
-        printf("      \"bandwidth_percent\": %.2f\n", (tc->estimated_idle_slope / link_speed_bps) * 100.0);
+        printf("      \"bandwidth_percent\": %.2f,\n", (tc->estimated_idle_slope / link_speed_bps) * 100.0);
+        printf("      \"fit\": {\"frames\": %lu, \"binding\": %lu, \"violations\": %lu, "
+               "\"tight\": %s, \"send_slope_bps\": %.0f, \"hi_credit_bytes\": %.0f, \"lo_credit_bytes\": %.0f}\n",
+               tc->fit.frames, tc->fit.binding, tc->fit.violations,
+               tc->fitted && tc->fit.tight ? "true" : "false",
+               tc->fit.send_slope_bps, tc->fit.hi_credit_bytes, tc->fit.lo_credit_bytes);
         printf("    }");
     }
 
@@ -300,16 +494,15 @@ static void print_results_json(void) {
     first = 1;
     for (int i = 0; i < MAX_TC; i++) {
         tc_analysis_t *tc = &tc_data[i];
-        if (tc->packet_count < 10) continue;
+        if (tc->stream.count < 10) continue;
 
         if (!first) printf(",\n");
         first = 0;
 
-        // Calculate recommended CBS parameters
+        // Recommended CBS parameters
         double idle_slope = tc->estimated_idle_slope;
-        double send_slope = -(link_speed_bps - idle_slope);
-        double hi_credit = tc->max_burst_bytes * 1.5;  // Add margin
-        double lo_credit = -hi_credit;  // Symmetric
+        double send_slope, hi_credit, lo_credit;
+        cbs_params(tc, &send_slope, &hi_credit, &lo_credit);
 
         printf("    {\n");
         printf("      \"tc\": %d,\n", i);
@@ -317,11 +510,15 @@ static void print_results_json(void) {
         printf("      \"send_slope_bps\": %.0f,\n", send_slope);
         printf("      \"hi_credit_bytes\": %.0f,\n", hi_credit);
         printf("      \"lo_credit_bytes\": %.0f,\n", lo_credit);
-        printf("      \"confidence\": \"%s\"\n", tc->is_shaped ? "high" : "low");
+        printf("      \"confidence\": \"%s\"\n", tc->is_shaped ? "high" : "low");  // low: lower bound
         printf("    }");
     }
-    printf("\n  ]\n");
-    printf("}\n");
+    printf("\n  ],\n");
+    tsn_instr_t in;
+    instr_get(&in);
+    printf("  ");
+    tsn_instr_print_json(stdout, &in);
+    printf("\n}\n");
 }
 
 static void print_results_human(void) {
@@ -338,11 +535,11 @@ static void print_results_human(void) {
 
     for (int i = 0; i < MAX_TC; i++) {
         tc_analysis_t *tc = &tc_data[i];
-        if (tc->packet_count < 10) continue;
+        if (tc->stream.count < 10) continue;
 
-        printf("│ %2d │ %8d │ %8.1f │ %6d │   %s   │ %8.0f │ %6.2f%% │\n",
-               i, tc->packet_count, tc->measured_bps / 1000.0,
-               tc->burst_count, tc->is_shaped ? "YES" : " NO",
+        printf("│ %2d │ %8lu │ %8.1f │ %6lu │   %s   │ %8.0f │ %6.2f%% │\n",
+               i, tc->stream.count, tc->measured_bps / 1000.0,
+               tc->stream.burst_count, tc->is_shaped ? "YES" : " NO",
                tc->estimated_idle_slope / 1000.0,
                (tc->estimated_idle_slope / link_speed_bps) * 100.0);
     }
@@ -355,77 +552,182 @@ static void print_results_human(void) {
 
     for (int i = 0; i < MAX_TC; i++) {
         tc_analysis_t *tc = &tc_data[i];
-        if (tc->packet_count < 10) continue;
+        if (tc->stream.count < 10) continue;
 
         double idle_slope = tc->estimated_idle_slope;
-        double send_slope = -(link_speed_bps - idle_slope);
-        double hi_credit = tc->max_burst_bytes * 1.5;
+        double send_slope, hi_credit, lo_credit;
+        cbs_params(tc, &send_slope, &hi_credit, &lo_credit);
 
-        printf("TC%d: idleSlope=%8.0f bps, sendSlope=%9.0f bps, hiCredit=%6.0f bytes",
-               i, idle_slope, send_slope, hi_credit);
-        printf("  [%s]\n", tc->is_shaped ? "SHAPED" : "UNSHAPED");
+        printf("TC%d: idleSlope=%8.0f bps, sendSlope=%9.0f bps, hiCredit=%6.0f bytes, loCredit=%6.0f bytes",
+               i, idle_slope, send_slope, hi_credit, lo_credit);
+        printf("  [%s]\n", tc->is_shaped ? "SHAPED" : tc->fitted ? "UNSHAPED, idleSlope >= fit" : "UNSHAPED");
     }
     printf("\n");
+    tsn_instr_t in;
+    instr_get(&in);
+    tsn_instr_print_human(stdout, &in);
+}
+
+// Live capture for duration seconds, with optional JSON updates
+static int capture_live(const char *ifname, int duration, const char *filter) {
+    char errbuf[256];
+    tsn_capture_opts_t opts;
+    tsn_capture_opts_init(&opts);
+    cap = tsn_capture_open(ifname, &opts, errbuf);
+    if (!cap) {
+        fprintf(stderr, "Error: %s\n", errbuf);
+        return -1;
+    }
+    handler = packet_handler_matched;
+    if (tsn_capture_set_match(cap, &vlan_match) < 0) {
+        handler = packet_handler;
+        tsn_capture_set_filter(cap, filter);
+    }
+
+    fprintf(stderr, "Capturing on %s for %d seconds (VLAN %d)...\n",
+            ifname, duration, target_vlan);
+
+    uint64_t start = tsn_time_ns();
+    uint64_t end = start + (uint64_t)duration * 1000000000ULL;
+    uint64_t interval_ns = (update_interval_ms ? update_interval_ms : shm ? SHM_INTERVAL_MS : 0) * 1000000ULL;
+    uint64_t next_update = start + interval_ns;
+
+    while (running && tsn_time_ns() < end) {
+        tsn_capture_dispatch(cap, handler, NULL);
+
+        uint64_t now = tsn_time_ns();
+        if (interval_ns > 0 && now >= next_update) {
+            instr_refresh();
+            if (update_interval_ms > 0) print_update_json(now - start);
+            if (shm) publish_shm(now - start, true);
+            next_update += interval_ns;
+            if (next_update < now) next_update = now + interval_ns;
+        }
+    }
+
+    ts_resolution_ns = tsn_capture_ts_resolution_ns(cap);
+    ts_source = tsn_capture_ts_source(cap);
+    instr_refresh();
+    tsn_capture_close(cap);
+    cap = NULL;
+    return 0;
+}
+
+// Whole capture file, one worker per PCP slice
+static int read_capture_file(const char *filter) {
+    char errbuf[256];
+    if (rx_workers <= 0) rx_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (rx_workers > TSN_CAPTURE_MAX_WORKERS) rx_workers = TSN_CAPTURE_MAX_WORKERS;
+
+    file_group = tsn_capture_group_open_file(read_file, rx_workers, errbuf);
+    if (!file_group) {
+        fprintf(stderr, "Error: %s\n", errbuf);
+        return -1;
+    }
+    handler = packet_handler_matched;
+    if (tsn_capture_group_set_match(file_group, &vlan_match) < 0) {
+        handler = packet_handler;
+        tsn_capture_group_set_filter(file_group, filter);
+    }
+    // One worker counts its own chunks. Epochs count records before the
+    // filter, so a chunk never holds more than FIT_CHUNK_FRAMES frames
+    chunk_epochs = tsn_capture_group_set_epoch(file_group, FIT_CHUNK_FRAMES, fit_epoch, NULL) == 0;
+
+    tsn_capture_t *f = tsn_capture_group_member(file_group, 0);
+    ts_resolution_ns = tsn_capture_ts_resolution_ns(f);
+    ts_source = tsn_capture_ts_source(f);
+    fprintf(stderr, "Reading %s (%s, %d workers, VLAN %d)...\n",
+            read_file, tsn_capture_backend_name(f), rx_workers, target_vlan);
+
+    tsn_capture_group_run(file_group, handler, NULL, NULL, &running);
+    instr_refresh();
+
+    tsn_capture_group_t *g = file_group;
+    file_group = NULL;
+    tsn_capture_group_close(g);
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 3) {
+    const char *pos[8];
+    int npos = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--interval-ms") == 0 && i + 1 < argc) {
+            update_interval_ms = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--read") == 0 && i + 1 < argc) {
+            read_file = argv[++i];
+        } else if (strcmp(argv[i], "--rx-workers") == 0 && i + 1 < argc) {
+            rx_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (strcmp(argv[i], "--max-interference") == 0 && i + 1 < argc) {
+            max_interference = atol(argv[++i]);
+        } else if (npos < 8) {
+            pos[npos++] = argv[i];
+        }
+    }
+
+    // A file replaces <interface> <duration>
+    int first = read_file ? 0 : 2;
+    if (npos < first) {
         fprintf(stderr, "CBS Idle Slope Estimator\n");
-        fprintf(stderr, "Usage: %s <interface> <duration_sec> [vlan_id] [link_speed_mbps]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--interval-ms N] [--shm NAME] [--max-interference BYTES] <interface> <duration_sec> [vlan_id] [link_speed_mbps]\n", argv[0]);
+        fprintf(stderr, "       %s --read <file.pcap|file.pcapng> [--rx-workers N] [vlan_id] [link_speed_mbps]\n", argv[0]);
         fprintf(stderr, "Example: %s enxc84d44263ba6 10 100 100\n", argv[0]);
+        fprintf(stderr, "         %s --interval-ms 500 enxc84d44263ba6 30 100   (live idleSlope updates)\n", argv[0]);
+        fprintf(stderr, "         %s --read bench.pcapng 100 1000\n", argv[0]);
+        fprintf(stderr, "--max-interference: largest frame (wire bytes) that can delay a TC, for hiCredit\n"
+                        "  (default: the largest frame of the other TCs in the capture)\n");
         return 1;
     }
 
-    const char *ifname = argv[1];
-    int duration = atoi(argv[2]);
-    target_vlan = argc > 3 ? atoi(argv[3]) : 100;
-    if (argc > 4) {
-        link_speed_bps = atof(argv[4]) * 1e6;
+    const char *ifname = read_file ? NULL : pos[0];
+    int duration = read_file ? 0 : atoi(pos[1]);
+    target_vlan = npos > first ? atoi(pos[first]) : 100;
+    if (npos > first + 1) {
+        link_speed_bps = atof(pos[first + 1]) * 1e6;
     }
 
     // Initialize
     memset(tc_data, 0, sizeof(tc_data));
+    for (int i = 0; i < MAX_TC; i++) {
+        tsn_stream_init(&tc_data[i].stream, BURST_GAP_THRESHOLD_US * 1000, 0);
+        tsn_cbs_trace_init(&tc_data[i].trace, FIT_CHUNK_FRAMES);
+        tsn_cbs_trace_init(&fitter.trace[i], FIT_CHUNK_FRAMES);
+    }
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
-    // Open capture
-    char errbuf[PCAP_ERRBUF_SIZE];
-    handle = pcap_open_live(ifname, 128, 1, 1, errbuf);
-    if (!handle) {
-        fprintf(stderr, "Error: %s\n", errbuf);
-        return 1;
+    if (shm_name) {
+        char errbuf[256];
+        shm = tsn_shm_create(shm_name, "cbs-estimator", errbuf);
+        if (!shm) {
+            fprintf(stderr, "Error: %s\n", errbuf);
+            return 1;
+        }
     }
 
-    // VLAN filter
-    struct bpf_program fp;
     char filter[64];
     snprintf(filter, sizeof(filter), "vlan %d", target_vlan);
-    if (pcap_compile(handle, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) == 0) {
-        pcap_setfilter(handle, &fp);
-        pcap_freecode(&fp);
-    }
-
-    fprintf(stderr, "Capturing on %s for %d seconds (VLAN %d)...\n",
-            ifname, duration, target_vlan);
+    vlan_match.vlan_id = target_vlan > 0 ? target_vlan : 0;
 
-    // Capture packets
-    uint64_t start = get_time_ns();
-    uint64_t end = start + (uint64_t)duration * 1000000000ULL;
-
-    while (running && get_time_ns() < end) {
-        pcap_dispatch(handle, 100, packet_handler, NULL);
+    uint64_t start = tsn_time_ns();
+    int rc = read_file ? read_capture_file(filter) : capture_live(ifname, duration, filter);
+    if (rc < 0) {
+        tsn_shm_close(shm);
+        return 1;
     }
 
-    pcap_close(handle);
-
     fprintf(stderr, "Analyzing captured data...\n");
 
     // Analyze each TC
+    fit_all(false);
     for (int i = 0; i < MAX_TC; i++) {
-        if (tc_data[i].packet_count > 0) {
-            detect_bursts(&tc_data[i]);
-            analyze_cbs(&tc_data[i]);
-        }
+        analyze_cbs(&tc_data[i]);
+    }
+    if (shm) {
+        publish_shm(tsn_time_ns() - start, false);
+        tsn_shm_close(shm);
     }
 
     // Output
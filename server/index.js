@@ -5,6 +5,8 @@ import { dirname, join } from 'path';
 import fs from 'fs';
 import http from 'http';
 import { WebSocketServer } from 'ws';
+import { watchShmStats } from './lib/tsn-stats-shm.js';
+import { configEngine } from './lib/config-engine.js';
 
 // Prevent server crash on unhandled errors
 process.on('uncaughtException', (err) => {
@@ -61,14 +63,48 @@ wss.on('connection', (ws) => {
     // Ignore
   }
 
+  // { type: 'subscribe-shm', name, hz } streams a tool's --shm block as
+  // 'shm-stats' messages (only when it changed); 'unsubscribe-shm' stops it
+  const shmWatches = new Map();
+  const unwatchAll = () => {
+    for (const stop of shmWatches.values()) stop();
+    shmWatches.clear();
+  };
+
+  ws.on('message', (raw) => {
+    let msg;
+    try {
+      msg = JSON.parse(raw.toString());
+    } catch (e) {
+      return;
+    }
+    const name = String(msg.name || '');
+    if (!/^[\w.-]+$/.test(name)) return;
+
+    if (msg.type === 'subscribe-shm' && !shmWatches.has(name)) {
+      shmWatches.set(name, watchShmStats(name, Number(msg.hz) || 50, (data) => {
+        try {
+          ws.send(JSON.stringify({ type: 'shm-stats', name, data }));
+        } catch (e) {
+          // Ignore
+        }
+      }));
+    } else if (msg.type === 'unsubscribe-shm' && shmWatches.has(name)) {
+      shmWatches.get(name)();
+      shmWatches.delete(name);
+    }
+  });
+
   ws.on('close', () => {
     console.log('WebSocket client disconnected');
+    unwatchAll();
     wsClients.delete(ws);
     setWsClients(wsClients);
   });
 
   ws.on('error', (err) => {
     console.error('WebSocket error:', err.message);
+    unwatchAll();
     wsClients.delete(ws);
     setWsClients(wsClients);
   });
@@ -118,4 +154,6 @@ app.get('*', (req, res) => {
 server.listen(PORT, () => {
   console.log(`TSN UI Server running on http://localhost:${PORT}`);
   console.log(`WebSocket available at ws://localhost:${PORT}/ws/capture`);
+  // YANG/SID tables in memory before the first config change
+  configEngine.preload();
 });
@@ -0,0 +1,332 @@
+import path from 'path';
+import fs from 'fs';
+import yaml from 'js-yaml';
+import { fileURLToPath } from 'url';
+
+const __dirname = path.dirname(fileURLToPath(import.meta.url));
+const TSC2CBOR = path.resolve(__dirname, '../../tsc2cbor');
+const TSC2CBOR_LIB = path.join(TSC2CBOR, 'lib');
+
+export const DEFAULT_DEVICE = '/dev/ttyACM0';
+
+// A device link stays open this long after its last exchange, then is
+// closed so routes that open the port themselves can get it
+const IDLE_CLOSE_MS = Number(process.env.CONFIG_ENGINE_IDLE_MS) || 2000;
+// Instance-identifier items per coalesced iPATCH
+const MAX_COALESCE = 64;
+// Errors after which the link is not trusted any more
+const LINK_ERROR = /timeout|not connected|write failed|not ready/i;
+// Wait for a fresh link to answer, and for it to come up at all
+const READY_MS = 5000;
+const CONNECT_MS = 20000;
+
+/**
+ * ConfigEngine - In-process CORECONF path to the switch
+ *
+ * Replaces a process per change (YANG/SID tables re-loaded, port opened,
+ * one exchange, port closed) with:
+ *   - one encoder, decoder and SID table, loaded once (preload() at startup)
+ *   - one transport per device, kept open while requests keep coming
+ *   - patch() requests submitted together, or queued behind the exchange on
+ *     the wire, coalesced into one CBOR payload: one iPATCH, sent block-wise
+ *     (Block1) when it is larger than a block. If the device rejects it,
+ *     each request is retried alone so every caller gets its own answer
+ * Exchanges on one device run one at a time: the UART bridge answers one
+ * request before it reads the next. Every route that talks to the device goes
+ * through here (withTransport() for GET, RPC, checksum, ...), so none of
+ * them finds the port held by the engine.
+ */
+export class ConfigEngine {
+  constructor() {
+    this.loading = null;     // Promise of { encoder, decoder, sidInfo, extractSids }
+    this.transportModule = null;
+    this.cacheDir = null;
+    this.links = new Map();  // link key → { options, transport, queue, busy, scheduled, idleTimer }
+    this.stats = { exchanges: 0, requests: 0, coalesced: 0, retried: 0, connects: 0 };
+  }
+
+  /**
+   * Load the YANG/SID tables once; later calls share the result (another
+   * cacheDir replaces them)
+   * @param {string} [cacheDir] - YANG cache (default: first cached catalog)
+   */
+  load(cacheDir) {
+    if (cacheDir && this.cacheDir && cacheDir !== this.cacheDir) this.loading = null;
+    if (!this.loading) {
+      this.loading = this.loadInputs(cacheDir).catch((err) => {
+        this.loading = null;
+        throw err;
+      });
+    }
+    return this.loading;
+  }
+
+  async loadInputs(cacheDir) {
+    let dir = cacheDir;
+    if (dir && !fs.existsSync(dir)) throw new Error(`Cache directory not found: ${dir}`);
+    if (!dir) {
+      const { YangCatalogManager } = await import(`${TSC2CBOR_LIB}/yang-catalog/yang-catalog.js`);
+      const catalogs = new YangCatalogManager().listCachedCatalogs();
+      if (catalogs.length === 0) throw new Error('No YANG catalog found. Please download first.');
+      dir = catalogs[0].path;
+    }
+
+    const { Tsc2CborConverter } = await import(`${TSC2CBOR}/tsc2cbor.js`);
+    const { Cbor2TscConverter } = await import(`${TSC2CBOR}/cbor2tsc.js`);
+    const { extractSidsFromInstanceIdentifier } = await import(`${TSC2CBOR_LIB}/encoder/transformer-instance-id.js`);
+
+    const encoder = new Tsc2CborConverter(dir);
+    const decoder = new Cbor2TscConverter(dir);
+    await encoder.loadInputs(false);
+    await decoder.loadInputs(false);
+    this.cacheDir = dir;
+    return {
+      encoder,
+      decoder,
+      sidInfo: encoder.sidInfo,
+      extractSids: extractSidsFromInstanceIdentifier
+    };
+  }
+
+  /**
+   * Load the tables at startup so the first change does not pay for it;
+   * a failure is only logged (requests load again)
+   */
+  async preload() {
+    const t0 = Date.now();
+    try {
+      await this.load();
+      console.log(`[ConfigEngine] YANG/SID tables from ${this.cacheDir} loaded in ${Date.now() - t0} ms`);
+    } catch (err) {
+      console.log(`[ConfigEngine] Not preloaded: ${err.message}`);
+    }
+  }
+
+  /**
+   * Apply instance-identifier items, e.g. [{ "/ietf-interfaces:...": value }]
+   * @param {Array<object>} items
+   * @param {object} [options] - { transport, device, host, port }
+   * @returns {Promise<{success: boolean, error?: string, coalesced?: number}>}
+   *   coalesced: requests that shared the exchange; rejects on link failures
+   */
+  patch(items, options = {}) {
+    return this.enqueue(options, { kind: 'patch', items });
+  }
+
+  /**
+   * iFETCH instance-identifier paths
+   * @param {Array<string>} paths
+   * @param {object} [options] - link options plus format ('rfc7951' default)
+   * @returns {Promise<{success: boolean, yaml?: string, error?: string}>}
+   */
+  fetch(paths, options = {}) {
+    return this.enqueue(options, { kind: 'fetch', paths, format: options.format || 'rfc7951' });
+  }
+
+  /**
+   * Run fn(transport) on the shared link, between other exchanges. The YANG
+   * tables are not needed for it (a checksum comes before any catalog);
+   * load(cache) gives them when fn decodes
+   * @param {object} options - link options plus readyMs / connectMs for a fresh link
+   * @returns {Promise<*>} - fn's result
+   */
+  withTransport(options, fn) {
+    return this.enqueue(options, { kind: 'raw', fn });
+  }
+
+  linkOptions(options) {
+    const transport = options.transport || 'serial';
+    if (transport === 'wifi') {
+      if (!options.host) throw new Error('WiFi transport requires host parameter');
+      const port = parseInt(options.port) || 5683;
+      return { key: `wifi:${options.host}:${port}`, transport, connect: { host: options.host, port } };
+    }
+    const device = options.device || DEFAULT_DEVICE;
+    return { key: `serial:${device}`, transport, connect: { device } };
+  }
+
+  enqueue(options, job) {
+    return new Promise((resolve, reject) => {
+      let link;
+      try {
+        const o = this.linkOptions(options);
+        link = this.links.get(o.key);
+        if (!link) {
+          link = { options: o, transport: null, queue: [], busy: false, scheduled: false, idleTimer: null };
+          this.links.set(o.key, link);
+        }
+      } catch (err) {
+        return reject(err);
+      }
+      link.queue.push({ ...job, cache: options.cache, readyMs: options.readyMs, connectMs: options.connectMs, resolve, reject });
+      this.stats.requests++;
+      // Requests submitted in the same tick share the first exchange
+      if (!link.busy && !link.scheduled) {
+        link.scheduled = true;
+        setImmediate(() => this.drain(link));
+      }
+    });
+  }
+
+  async drain(link) {
+    link.scheduled = false;
+    if (link.busy) return;
+    link.busy = true;
+    clearTimeout(link.idleTimer);
+
+    while (link.queue.length > 0) {
+      // Only patches encoded with the same tables share a payload
+      const batch = [link.queue.shift()];
+      if (batch[0].kind === 'patch') {
+        let n = batch[0].items.length;
+        while (link.queue.length > 0 && link.queue[0].kind === 'patch' &&
+               link.queue[0].cache === batch[0].cache &&
+               n + link.queue[0].items.length <= MAX_COALESCE) {
+          n += link.queue[0].items.length;
+          batch.push(link.queue.shift());
+        }
+      }
+
+      const job = batch[0];
+      try {
+        const conv = job.kind === 'raw' ? null : await this.load(job.cache);
+        const transport = await this.connect(link, job);
+        if (job.kind === 'patch') await this.runPatch(conv, transport, batch);
+        else if (job.kind === 'fetch') job.resolve(await this.runFetch(conv, transport, job));
+        else job.resolve(await job.fn(transport));
+      } catch (err) {
+        // Timeouts and write errors: the next request starts a fresh link.
+        // A raw job's own errors (a failed decode) leave it open
+        if (job.kind !== 'raw' || LINK_ERROR.test(err.message)) await this.close(link);
+        for (const j of batch) j.reject(err);
+      }
+    }
+
+    link.busy = false;
+    link.idleTimer = setTimeout(() => this.close(link), IDLE_CLOSE_MS);
+  }
+
+  async connect(link, { readyMs = READY_MS, connectMs = CONNECT_MS } = {}) {
+    if (link.transport && link.transport.isConnected) return link.transport;
+    if (!this.transportModule) this.transportModule = import(`${TSC2CBOR_LIB}/transport/index.js`);
+    const { createTransport } = await this.transportModule;
+    const transport = createTransport(link.options.transport, { verbose: false });
+    transport.on('error', (err) => console.error(`[ConfigEngine] ${link.options.key}: ${err.message}`));
+    transport.on('disconnected', () => {
+      if (link.transport === transport) link.transport = null;
+    });
+    let timer;
+    const timeout = new Promise((resolve, reject) => {
+      timer = setTimeout(() => reject(new Error('Connection timeout')), connectMs);
+    });
+    try {
+      await Promise.race([
+        transport.connect(link.options.connect).then(() => transport.waitForReady(readyMs)),
+        timeout
+      ]);
+    } catch (err) {
+      try { await transport.disconnect(); } catch (e) { /* ignore */ }
+      throw err;
+    } finally {
+      clearTimeout(timer);
+    }
+    this.stats.connects++;
+    link.transport = transport;
+    return transport;
+  }
+
+  async close(link) {
+    clearTimeout(link.idleTimer);
+    const transport = link.transport;
+    link.transport = null;
+    if (transport) {
+      try { await transport.disconnect(); } catch (e) { /* ignore */ }
+    }
+  }
+
+  async runPatch(conv, transport, batch) {
+    const encoded = [];
+    for (const job of batch) {
+      try {
+        const result = await conv.encoder.convertString(yaml.dump(job.items), { verbose: false });
+        job.cbor = result.cbor;
+        encoded.push(job);
+      } catch (err) {
+        job.resolve({ success: false, error: err.message });
+      }
+    }
+    if (encoded.length === 0) return;
+
+    // Encoded items are a sequence of single-entry maps, so payloads concatenate
+    const first = await this.sendPatch(conv, transport, Buffer.concat(encoded.map(j => j.cbor)));
+    this.stats.exchanges++;
+    if (encoded.length > 1) this.stats.coalesced += encoded.length;
+    if (first.success || encoded.length === 1) {
+      for (const job of encoded) job.resolve({ ...first, coalesced: encoded.length });
+      return;
+    }
+
+    // One bad request fails the whole payload; find out whose it was
+    for (const job of encoded) {
+      this.stats.exchanges++;
+      this.stats.retried++;
+      job.resolve({ ...(await this.sendPatch(conv, transport, job.cbor)), coalesced: 1 });
+    }
+  }
+
+  async sendPatch(conv, transport, cbor) {
+    let response;
+    try {
+      response = await transport.sendiPatchRequest(cbor);
+    } catch (err) {
+      // A block-wise transfer reports a refused block as an exception
+      if (LINK_ERROR.test(err.message)) throw err;
+      return { success: false, error: err.message };
+    }
+    if (response.isSuccess()) return { success: true };
+
+    let error = `CoAP code ${response.code}`;
+    if (response.payload && response.payload.length > 0) {
+      try {
+        const decoded = await conv.decoder.convertBuffer(response.payload, { verbose: false, outputFormat: 'rfc7951' });
+        error = decoded.yaml;
+      } catch {
+        error = `Payload: ${response.payload.toString('hex')}`;
+      }
+    }
+    return { success: false, error };
+  }
+
+  async runFetch(conv, transport, job) {
+    const queries = conv.extractSids(job.paths.map(p => ({ [p]: null })), conv.sidInfo, { verbose: false });
+    if (queries.length === 0) return { success: false, error: 'No valid SIDs found in paths' };
+
+    const response = await transport.sendiFetchRequest(queries);
+    this.stats.exchanges++;
+    if (!response.isSuccess()) return { success: false, error: `iFETCH failed: CoAP code ${response.code}` };
+
+    const result = await conv.decoder.convertBuffer(response.payload, { verbose: false, outputFormat: job.format });
+    return { success: true, yaml: result.yaml };
+  }
+
+  /**
+   * @returns {object} - counters and open links
+   */
+  getStatus() {
+    return {
+      cacheDir: this.cacheDir,
+      idleCloseMs: IDLE_CLOSE_MS,
+      links: [...this.links.values()].map(l => ({
+        key: l.options.key,
+        open: !!l.transport,
+        queued: l.queue.length,
+        busy: l.busy
+      })),
+      ...this.stats
+    };
+  }
+}
+
+// Singleton instance
+export const configEngine = new ConfigEngine();
+export default configEngine;
@@ -3,6 +3,7 @@ import path from 'path';
 import fs from 'fs';
 import { fileURLToPath } from 'url';
 import { EventEmitter } from 'events';
+import { RecordDecoder } from './tsn-records.js';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 const BINARY_DIR = path.resolve(__dirname, '..');
@@ -18,6 +19,18 @@ export class TrafficManager extends EventEmitter {
     this.setupCleanup();
   }
 
+  /**
+   * Fold one JSON stats line into the capture stats and emit it
+   */
+  updateCaptureStats(key, stats, json) {
+    stats.elapsed_ms = json.elapsed_ms;
+    stats.packets = json.total || 0;
+    if (json.tc) stats.tc = json.tc;
+    if (json.final) stats.final = true;
+
+    this.emit('capture-stats', { key, iface: stats.interface, data: json });
+  }
+
   setupCleanup() {
     const cleanup = () => {
       console.log('[TrafficManager] Cleaning up processes...');
@@ -33,6 +46,8 @@ export class TrafficManager extends EventEmitter {
    * Start a capture process
    * @param {string} iface - Network interface name
    * @param {object} options - { duration, vlanId, outputMode }
+   *   outputMode 'binary' reads tsn-record frames from stdout instead of JSON
+   *   lines and also emits 'capture-records' with the decoded records
    * @returns {object} - { success, key, error }
    */
   startCapture(iface, options = {}) {
@@ -61,8 +76,14 @@ export class TrafficManager extends EventEmitter {
       };
 
       let buffer = '';
+      const decoder = outputMode === 'binary' ? new RecordDecoder() : null;
 
       proc.stdout.on('data', (data) => {
+        if (decoder) {
+          this.handleRecords(key, iface, stats, decoder, data);
+          return;
+        }
+
         buffer += data.toString();
         const lines = buffer.split('\n');
         buffer = lines.pop();
@@ -70,13 +91,7 @@ export class TrafficManager extends EventEmitter {
         for (const line of lines) {
           if (!line.trim()) continue;
           try {
-            const json = JSON.parse(line);
-            stats.elapsed_ms = json.elapsed_ms;
-            stats.packets = json.total || 0;
-            if (json.tc) stats.tc = json.tc;
-            if (json.final) stats.final = true;
-
-            this.emit('capture-stats', { key, iface, data: json });
+            this.updateCaptureStats(key, stats, JSON.parse(line));
           } catch (e) {}
         }
       });
@@ -88,6 +103,10 @@ export class TrafficManager extends EventEmitter {
 
       proc.on('close', (code) => {
         console.log(`[Capture:${iface}] Exited with code ${code}`);
+        if (decoder) {
+          stats.final = true;
+          this.emit('capture-stats', { key, iface, data: this.recordStatsJson(stats, true) });
+        }
         this.emit('capture-stopped', { key, iface, stats, code });
         this.processes.delete(key);
       });
@@ -105,10 +124,54 @@ export class TrafficManager extends EventEmitter {
     }
   }
 
+  /**
+   * Fold a chunk of binary records into the per-TC stats
+   */
+  handleRecords(key, iface, stats, decoder, data) {
+    let records;
+    try {
+      records = decoder.push(data);
+    } catch (e) {
+      console.error(`[Capture:${iface}]`, e.message);
+      return;
+    }
+    if (records.length === 0) return;
+
+    for (const r of records) {
+      const tc = stats.tc[r.pcp] || (stats.tc[r.pcp] = { count: 0, bytes: 0, first_ts_ns: r.ts_ns, last_ts_ns: r.ts_ns });
+      tc.count++;
+      tc.bytes += r.len;
+      if (r.ts_ns > tc.last_ts_ns) tc.last_ts_ns = r.ts_ns;
+    }
+    stats.packets += records.length;
+    stats.elapsed_ms = Date.now() - stats.startTime;
+
+    this.emit('capture-records', { key, iface, records });
+    this.emit('capture-stats', { key, iface, data: this.recordStatsJson(stats, false) });
+  }
+
+  /**
+   * Same shape as the traffic-capture JSON lines
+   */
+  recordStatsJson(stats, final) {
+    const tc = {};
+    for (const [pcp, t] of Object.entries(stats.tc)) {
+      const spanNs = Number(t.last_ts_ns - t.first_ts_ns);
+      tc[pcp] = {
+        count: t.count,
+        avg_us: t.count > 1 ? spanNs / (t.count - 1) / 1000 : 0,
+        kbps: spanNs > 0 ? t.bytes * 8 * 1e6 / spanNs : 0
+      };
+    }
+    return { elapsed_ms: stats.elapsed_ms || 0, total: stats.packets, tc, ...(final && { final: true }) };
+  }
+
   /**
    * Start a traffic sender process
    * @param {string} iface - Network interface name
-   * @param {object} options - { dstMac, srcMac, vlanId, tcList, pps, duration }
+   * @param {object} options - { dstMac, srcMac, vlanId, tcList, pps, duration,
+   *   flows, imix, pacing } (flows/imix: stream mix, see traffic-sender --flows/--imix;
+   *   pacing: hybrid|spin|sleep|txtime, see traffic-sender --pacing)
    * @returns {object} - { success, key, error }
    */
   startSender(iface, options = {}) {
@@ -134,10 +197,14 @@ export class TrafficManager extends EventEmitter {
 
     // Get source MAC if not provided
     const sourceMac = srcMac || this.getInterfaceMac(iface);
+
     const tcListStr = Array.isArray(tcList) ? tcList.join(',') : String(tcList);
 
     const binaryPath = path.join(BINARY_DIR, 'traffic-sender');
     const args = [iface, dstMac, sourceMac, String(vlanId), tcListStr, String(pps), String(duration)];
+    if (options.flows > 1) args.push('--flows', String(options.flows));
+    if (options.imix) args.push('--imix', String(options.imix));
+    if (options.pacing) args.push('--pacing', String(options.pacing));
 
     try {
       const proc = spawn(binaryPath, args, {
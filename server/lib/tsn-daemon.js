@@ -0,0 +1,111 @@
+import net from 'net';
+import { EventEmitter } from 'events';
+
+/**
+ * Client for tsn-daemon's control socket (see tsn-daemon.c)
+ *
+ * Commands go out as text lines; everything coming back is a frame of
+ * length u32 LE | type u8 | JSON, type 'R' answering the oldest pending
+ * command and 'E' an event. Events are emitted as 'event' and under their
+ * own type ('capture_stats', 'send_stats', 'send_done').
+ */
+
+export const DEFAULT_SOCKET = '/tmp/tsn-daemon.sock';
+
+const FRAME_HDR = 5;
+const FRAME_REPLY = 0x52;  // 'R'
+const FRAME_EVENT = 0x45;  // 'E'
+
+export class TsnDaemonClient extends EventEmitter {
+  constructor(socketPath = DEFAULT_SOCKET) {
+    super();
+    this.socketPath = socketPath;
+    this.socket = null;
+    this.pending = [];  // { resolve, reject } in command order
+    this.buffer = Buffer.alloc(0);
+  }
+
+  get connected() {
+    return this.socket !== null;
+  }
+
+  /**
+   * @returns {Promise} - resolves once connected (and subscribed to stats)
+   */
+  connect({ subscribe = true } = {}) {
+    return new Promise((resolve, reject) => {
+      const socket = net.createConnection(this.socketPath);
+      socket.once('error', reject);
+      socket.once('connect', () => {
+        socket.off('error', reject);
+        this.socket = socket;
+        socket.on('data', (chunk) => this.onData(chunk));
+        socket.on('error', (err) => this.emit('error', err));
+        socket.on('close', () => this.onClose());
+        (subscribe ? this.command('subscribe') : Promise.resolve()).then(resolve, reject);
+      });
+    });
+  }
+
+  /**
+   * Send one command line
+   * @returns {Promise<object>} - the reply; rejects if it has ok:false
+   */
+  command(line) {
+    if (!this.socket) return Promise.reject(new Error('tsn-daemon not connected'));
+    return new Promise((resolve, reject) => {
+      this.pending.push({ resolve, reject });
+      this.socket.write(line + '\n');
+    });
+  }
+
+  close() {
+    if (this.socket) this.socket.end();
+  }
+
+  onData(chunk) {
+    this.buffer = this.buffer.length ? Buffer.concat([this.buffer, chunk]) : chunk;
+    while (this.buffer.length >= FRAME_HDR) {
+      const len = this.buffer.readUInt32LE(0);
+      if (this.buffer.length < FRAME_HDR + len) break;
+      const type = this.buffer[4];
+      const payload = this.buffer.subarray(FRAME_HDR, FRAME_HDR + len).toString();
+      this.buffer = this.buffer.subarray(FRAME_HDR + len);
+
+      let msg;
+      try {
+        msg = JSON.parse(payload);
+      } catch (e) {
+        continue;
+      }
+      if (type === FRAME_REPLY) {
+        const p = this.pending.shift();
+        if (!p) continue;
+        if (msg.ok === false) p.reject(new Error(msg.error));
+        else p.resolve(msg);
+      } else if (type === FRAME_EVENT) {
+        this.emit('event', msg);
+        if (msg.type) this.emit(msg.type, msg);
+      }
+    }
+  }
+
+  onClose() {
+    this.socket = null;
+    this.buffer = Buffer.alloc(0);
+    for (const p of this.pending.splice(0)) p.reject(new Error('tsn-daemon connection closed'));
+    this.emit('close');
+  }
+}
+
+/**
+ * "key=value" arguments for a command line; undefined/null values are left out
+ */
+export function commandArgs(args) {
+  return Object.entries(args)
+    .filter(([, v]) => v !== undefined && v !== null)
+    .map(([k, v]) => `${k}=${Array.isArray(v) ? v.join(',') : v}`)
+    .join(' ');
+}
+
+export default TsnDaemonClient;
@@ -0,0 +1,93 @@
+import fs from 'fs';
+
+/**
+ * tsn-record binary capture format (see tsn-record.h)
+ *
+ * header  16 bytes: magic "TSNR" | version u16 | record size u16 |
+ *                   timestamp resolution ns u32 | flags u32
+ * record  24 bytes: ts_ns u64 | seq u32 | lat_ns i32 | len u16 | vid u16 |
+ *                   pcp u8 | flags u8 | reserved u16
+ * All little-endian. ts_ns is returned as a BigInt (epoch nanoseconds do not
+ * fit a double); seq and latNs are null when the frame had no test header.
+ */
+
+export const REC_MAGIC = 0x524e5354;  // "TSNR"
+export const REC_VERSION = 1;
+export const HDR_SIZE = 16;
+export const REC_SIZE = 24;
+
+const FLAG_HWTS = 0x1;
+const FLAG_SEQ = 0x1;
+
+/**
+ * Parse a file header
+ * @returns {object|null} - { version, tsResolutionNs, hwTimestamps } or null if not a record stream
+ */
+export function parseHeader(buf) {
+  if (buf.length < HDR_SIZE || buf.readUInt32LE(0) !== REC_MAGIC) return null;
+  const version = buf.readUInt16LE(4);
+  if (version !== REC_VERSION || buf.readUInt16LE(6) !== REC_SIZE) return null;
+  const flags = buf.readUInt32LE(12);
+  return { version, tsResolutionNs: buf.readUInt32LE(8), hwTimestamps: (flags & FLAG_HWTS) !== 0 };
+}
+
+export function decodeRecord(buf, off = 0) {
+  const hasSeq = (buf.readUInt8(off + 21) & FLAG_SEQ) !== 0;
+  return {
+    ts_ns: buf.readBigUInt64LE(off),
+    seq: hasSeq ? buf.readUInt32LE(off + 8) : null,
+    latNs: hasSeq ? buf.readInt32LE(off + 12) : null,
+    len: buf.readUInt16LE(off + 16),
+    vid: buf.readUInt16LE(off + 18),
+    pcp: buf.readUInt8(off + 20)
+  };
+}
+
+/**
+ * Incremental decoder for a record stream arriving in arbitrary chunks
+ * (e.g. traffic-capture ... binary on stdout)
+ */
+export class RecordDecoder {
+  constructor() {
+    this.header = null;
+    this.pending = Buffer.alloc(0);
+  }
+
+  /**
+   * @returns {Array} - records completed by this chunk
+   * @throws if the stream does not start with a record header
+   */
+  push(chunk) {
+    let buf = this.pending.length ? Buffer.concat([this.pending, chunk]) : chunk;
+    let off = 0;
+
+    if (!this.header) {
+      if (buf.length < HDR_SIZE) {
+        this.pending = buf;
+        return [];
+      }
+      this.header = parseHeader(buf);
+      if (!this.header) throw new Error('not a tsn-record stream');
+      off = HDR_SIZE;
+    }
+
+    const records = [];
+    for (; off + REC_SIZE <= buf.length; off += REC_SIZE) {
+      records.push(decodeRecord(buf, off));
+    }
+    this.pending = buf.subarray(off);
+    return records;
+  }
+}
+
+/**
+ * Read a whole record file (a partial trailing record is ignored)
+ * @returns {object} - { header, records }
+ */
+export function readRecordFile(filePath) {
+  const decoder = new RecordDecoder();
+  const records = decoder.push(fs.readFileSync(filePath));
+  return { header: decoder.header, records };
+}
+
+export default { parseHeader, decodeRecord, RecordDecoder, readRecordFile };
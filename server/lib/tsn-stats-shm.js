@@ -0,0 +1,149 @@
+import fs from 'fs';
+
+/**
+ * Reader for the tsn-shm live stats block (see tsn-shm.h)
+ *
+ * A tool run with --shm NAME keeps /dev/shm/NAME current; read() copies the
+ * block with one pread into a preallocated buffer and decodes it by offset,
+ * so polling at 50-100 Hz costs no JSON and no work in the tool. A copy torn
+ * by a concurrent update (seq !== seq_end) is retried.
+ */
+
+export const SHM_MAGIC = 0x534e5354;  // "TSNS"
+export const SHM_VERSION = 2;
+export const SHM_DIR = '/dev/shm';
+
+const F_FINAL = 0x1;
+const MAX_TC = 8;
+const HDR_FIXED = 40;   // magic .. source
+const HDR_SIZE = 192;
+const PCTL = ['p50_us', 'p90_us', 'p99_us', 'p999_us', 'max_us'];
+
+// Header fields after source, 8 bytes each ('u' = u64, 'd' = double)
+const HDR_FIELDS = [
+  ['update_ns', 'u'], ['updates', 'u'], ['elapsed_ms', 'd'], ['total', 'u'],
+  ['cycle_us', 'd'], ['cycle_confidence', 'd'],
+  ['rx_kernel_drops', 'u'], ['rx_if_drops', 'u'], ['rx_ring_freezes', 'u'], ['truncated', 'u'],
+  ['tx_eagain', 'u'], ['tx_enobufs', 'u'], ['tx_errors', 'u'], ['tx_dropped', 'u'],
+  ['tx_late', 'u'], ['txtime_dropped', 'u'],
+  ['rx_ns_per_frame', 'd'], ['handler_ns_per_frame', 'd'], ['tx_ns_per_frame', 'd']
+];
+
+// tsn_shm_tc_t; '<name>_*' expands to the five percentiles
+const TC_FIELDS = [
+  ['count', 'u'], ['bytes', 'u'], ['first_ts_ns', 'u'], ['last_ts_ns', 'u'],
+  ['kbps', 'd'], ['avg_interval_us', 'd'], ['min_interval_us', 'd'], ['max_interval_us', 'd'],
+  ...PCTL.map((p) => [`interval_${p}`, 'd']),
+  ['lost', 'u'], ['dup', 'u'], ['reorder', 'u'], ['lat_avg_us', 'd'],
+  ...PCTL.map((p) => [`lat_${p}`, 'd']),
+  ['idle_slope_kbps', 'd'], ['hi_credit_bytes', 'd'], ['shaped', 'u'],
+  ['window_start_us', 'd'], ['window_us', 'd']
+];
+
+const TC_SIZE = TC_FIELDS.length * 8;
+export const SHM_SIZE = HDR_SIZE + MAX_TC * TC_SIZE + 8;
+
+function readField(buf, off, type) {
+  // Counters stay below 2^53 for any realistic run
+  return type === 'u' ? Number(buf.readBigUInt64LE(off)) : buf.readDoubleLE(off);
+}
+
+export class ShmStatsReader {
+  /**
+   * @param {string} name - as given to the tool's --shm (leading '/' optional)
+   */
+  constructor(name) {
+    this.path = `${SHM_DIR}/${String(name).replace(/^\/+/, '')}`;
+    this.fd = null;
+    this.buf = Buffer.alloc(SHM_SIZE);
+    this.lastSeq = null;
+  }
+
+  /**
+   * @param {object} [opts] - { changedOnly } returns null if nothing was
+   *   published since the last read
+   * @returns {object|null} - snapshot, or null if the block is missing,
+   *   incompatible, unchanged (changedOnly) or kept changing under us
+   */
+  read({ changedOnly = false } = {}) {
+    if (this.fd === null) {
+      try {
+        this.fd = fs.openSync(this.path, 'r');
+      } catch (e) {
+        return null;
+      }
+    }
+
+    const buf = this.buf;
+    for (let attempt = 0; attempt < 4; attempt++) {
+      let n;
+      try {
+        n = fs.readSync(this.fd, buf, 0, SHM_SIZE, 0);
+      } catch (e) {
+        this.close();
+        return null;
+      }
+      if (n < SHM_SIZE) return null;
+      if (buf.readUInt32LE(0) !== SHM_MAGIC || buf.readUInt16LE(4) !== SHM_VERSION ||
+          buf.readUInt16LE(6) !== TC_SIZE) {
+        return null;
+      }
+
+      const seq = buf.readUInt32LE(8);
+      if (seq !== buf.readUInt32LE(SHM_SIZE - 8)) continue;
+      if (changedOnly && seq === this.lastSeq) return null;
+      this.lastSeq = seq;
+      return this.decode(buf);
+    }
+    return null;
+  }
+
+  decode(buf) {
+    const end = buf.indexOf(0, 24);
+    const out = {
+      source: buf.toString('latin1', 24, end >= 0 && end < HDR_FIXED ? end : HDR_FIXED),
+      pid: buf.readUInt32LE(16),
+      final: (buf.readUInt32LE(12) & F_FINAL) !== 0,
+      seq: buf.readUInt32LE(8)
+    };
+    HDR_FIELDS.forEach(([name, type], i) => { out[name] = readField(buf, HDR_FIXED + i * 8, type); });
+
+    // Same shape as the tools' JSON: only TCs with traffic, keyed by PCP
+    out.tc = {};
+    for (let t = 0; t < MAX_TC; t++) {
+      const base = HDR_SIZE + t * TC_SIZE;
+      if (buf.readBigUInt64LE(base) === 0n) continue;
+      const tc = {};
+      TC_FIELDS.forEach(([name, type], i) => { tc[name] = readField(buf, base + i * 8, type); });
+      tc.shaped = tc.shaped !== 0;
+      out.tc[t] = tc;
+    }
+    return out;
+  }
+
+  close() {
+    if (this.fd !== null) {
+      try { fs.closeSync(this.fd); } catch (e) {}
+      this.fd = null;
+    }
+  }
+}
+
+/**
+ * Poll a block and call onStats with every new snapshot
+ * @returns {function} - stop polling
+ */
+export function watchShmStats(name, hz, onStats) {
+  const reader = new ShmStatsReader(name);
+  const period = Math.max(5, Math.round(1000 / Math.min(Math.max(hz, 1), 200)));
+  const timer = setInterval(() => {
+    const stats = reader.read({ changedOnly: true });
+    if (stats) onStats(stats);
+  }, period);
+  return () => {
+    clearInterval(timer);
+    reader.close();
+  };
+}
+
+export default { ShmStatsReader, watchShmStats };
@@ -1,6 +1,17 @@
 /*
  * Quick connectivity test - send untagged packets
- * Compile: gcc -O2 -o quick-test quick-test.c -lpcap -lpthread
+ *
+ * Sweep mode (--sweep) checks every port at once instead of one pair per run:
+ * each port sends a few untagged test frames (EtherType 0x88B5, broadcast so
+ * the switch floods them to every other port; unicast to the RX MAC for
+ * --pair) while all ports capture on tpacket rings with a generated kernel
+ * filter, woken by one epoll set. The result is a TX x RX matrix of frames
+ * received and one-way latency (TX stamp to kernel RX stamp, same host
+ * clock), typically in well under a second including socket setup.
+ *
+ * Compile: make quick-test (links libtsntest.a)
+ * Run: sudo ./quick-test --sweep [--ifaces a,b,...] [--json]
+ *      sudo ./quick-test --sweep --pair enp1s0:enp2s0 --pair enp2s0:enp1s0
  */
 
 #define _GNU_SOURCE
@@ -9,14 +20,23 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
-#include <pthread.h>
+#include <time.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
-#include <sys/ioctl.h>
 #include <net/if.h>
-#include <linux/if_packet.h>
-#include <linux/if_ether.h>
-#include <arpa/inet.h>
-#include <pcap/pcap.h>
+
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-tx.h"
+#include "tsn-capture.h"
+
+#define MAX_PORTS 32
+#define MAX_PROBES 64
+#define SWEEP_STREAM 0x5100     // stream_id of sweep probes | probe index
+#define SWEEP_RING_BLOCKS 4     // 1 MiB per port is plenty for a few frames
 
 static volatile int running = 1;
 static int rx_count = 0;
@@ -27,31 +47,389 @@ static void signal_handler(int sig) {
     running = 0;
 }
 
-static int get_mac(const char *ifname, unsigned char *mac) {
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) return -1;
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
-    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
-        close(fd);
+static void packet_handler(void *user, const tsn_packet_t *pkt) {
+    (void)user;
+    (void)pkt;
+    rx_count++;
+}
+
+// ---------------------------------------------------------------------------
+// Sweep
+
+typedef struct {
+    char name[IFNAMSIZ];
+    unsigned char mac[6];
+    tsn_tx_t *tx;
+    tsn_capture_t *cap;
+    tsn_test_rx_fn decode;    // NULL: no kernel filter, parse every frame
+    char error[256];
+} port_t;
+
+// One frame stream: a TX port and its destination
+typedef struct {
+    int tx, rx;               // rx < 0: broadcast
+    tsn_frame_t frame;
+} probe_t;
+
+typedef struct {
+    bool wanted;
+    uint64_t received;
+    int64_t lat_min, lat_max, lat_sum;   // ns
+} cell_t;
+
+static port_t ports[MAX_PORTS];
+static int n_ports;
+static probe_t probes[MAX_PROBES];
+static int n_probes;
+static cell_t cells[MAX_PORTS][MAX_PORTS];   // [tx][rx]
+static uint64_t sweep_start_ns;              // CLOCK_REALTIME, older stamps are stale
+
+static int port_find(const char *name) {
+    for (int i = 0; i < n_ports; i++) {
+        if (strcmp(ports[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int port_add(const char *name) {
+    int i = port_find(name);
+    if (i >= 0) return i;
+    if (n_ports == MAX_PORTS || strlen(name) >= IFNAMSIZ) return -1;
+    port_t *p = &ports[n_ports];
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    return n_ports++;
+}
+
+static int sysfs_read(const char *ifname, const char *attr, char *buf, size_t len) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/%s", ifname, attr);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int ok = fgets(buf, len, f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// Every Ethernet interface that is up, except bridges (their member ports are
+// probed instead)
+static void ports_discover(void) {
+    DIR *d = opendir("/sys/class/net");
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        char buf[32], path[300];
+        if (e->d_name[0] == '.' || strcmp(e->d_name, "lo") == 0) continue;
+        if (sysfs_read(e->d_name, "type", buf, sizeof(buf)) < 0 || atoi(buf) != 1) continue;
+        if (sysfs_read(e->d_name, "operstate", buf, sizeof(buf)) < 0 || strcmp(buf, "up") != 0) continue;
+        snprintf(path, sizeof(path), "/sys/class/net/%s/bridge", e->d_name);
+        if (access(path, F_OK) == 0) continue;
+        port_add(e->d_name);
+    }
+    closedir(d);
+}
+
+static void sweep_handler(void *user, const tsn_packet_t *pkt) {
+    int rx = (int)(intptr_t)user;
+    tsn_test_rx_t r;
+    if (ports[rx].decode) {
+        if (ports[rx].decode(pkt->data, pkt->caplen, &r) < 0) return;
+    } else if (tsn_test_hdr_parse(pkt->data, pkt->caplen, &r.hdr) < 0) {
+        return;
+    }
+    if ((r.hdr.stream_id & 0xFF00) != SWEEP_STREAM || r.hdr.tx_ns < sweep_start_ns) return;
+    int p = r.hdr.stream_id & 0xFF;
+    if (p >= n_probes) return;
+    int tx = probes[p].tx;
+    if (tx == rx) return;   // our own frame on the way out
+    if (probes[p].rx >= 0 && probes[p].rx != rx) return;   // a pair's frame flooded elsewhere
+
+    cell_t *c = &cells[tx][rx];
+    int64_t lat = (int64_t)(pkt->ts_ns - r.hdr.tx_ns);
+    if (c->received == 0 || lat < c->lat_min) c->lat_min = lat;
+    if (c->received == 0 || lat > c->lat_max) c->lat_max = lat;
+    c->lat_sum += lat;
+    c->received++;
+}
+
+static int port_open(port_t *p, int epfd, int idx) {
+    char errbuf[256] = "";
+    if (tsn_get_iface_mac(p->name, p->mac) < 0) {
+        snprintf(p->error, sizeof(p->error), "no MAC address");
+        return -1;
+    }
+
+    tsn_capture_opts_t copts;
+    tsn_capture_opts_init(&copts);
+    copts.timeout_ms = 0;
+    copts.ring_blocks = SWEEP_RING_BLOCKS;
+    copts.hw_tstamp = TSN_HWTSTAMP_OFF;   // TX stamps are host clock
+    p->cap = tsn_capture_open(p->name, &copts, errbuf);
+    int fd = p->cap ? tsn_capture_fd(p->cap) : -1;
+    if (fd < 0) {
+        snprintf(p->error, sizeof(p->error), "capture: %s",
+                 p->cap ? "not pollable" : errbuf[0] ? errbuf : "cannot open");
+        return -1;
+    }
+    tsn_capture_match_t match = {
+        .vlan_id = -1, .ethertype = TSN_ETHERTYPE_EXP, .test_hdr = 1
+    };
+    if (tsn_capture_set_match(p->cap, &match) == 0) p->decode = tsn_test_rx(0, TSN_FRAME_EXP);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)idx };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        snprintf(p->error, sizeof(p->error), "epoll: %s", strerror(errno));
+        return -1;
+    }
+
+    tsn_tx_opts_t topts;
+    tsn_tx_opts_init(&topts);
+    topts.engine = TSN_TX_SEND;
+    p->tx = tsn_tx_open(p->name, &topts);
+    if (!p->tx) {
+        snprintf(p->error, sizeof(p->error), "cannot open TX socket");
         return -1;
     }
-    close(fd);
-    memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
     return 0;
 }
 
-static void packet_handler(u_char *user, const struct pcap_pkthdr *hdr, const u_char *pkt) {
-    (void)user;
-    (void)hdr;
-    (void)pkt;
-    rx_count++;
+static void dispatch_ready(int epfd, int timeout_ms) {
+    struct epoll_event ev[MAX_PORTS];
+    int n = epoll_wait(epfd, ev, MAX_PORTS, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        int idx = (int)ev[i].data.u32;
+        while (tsn_capture_dispatch(ports[idx].cap, sweep_handler, (void *)(intptr_t)idx) > 0) {}
+    }
+}
+
+static bool sweep_complete(int count) {
+    for (int t = 0; t < n_ports; t++) {
+        for (int r = 0; r < n_ports; r++) {
+            if (cells[t][r].wanted && cells[t][r].received < (uint64_t)count) return false;
+        }
+    }
+    return true;
+}
+
+static void sweep_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s --sweep [options]\n", prog);
+    fprintf(stderr, "  --ifaces LIST      comma-separated ports (default: every Ethernet interface that is up)\n");
+    fprintf(stderr, "  --pair TX:RX       probe only this direction (repeatable, unicast to RX's MAC)\n");
+    fprintf(stderr, "  --count N          probes per TX port (default 5)\n");
+    fprintf(stderr, "  --gap-us N         spacing of the probe rounds (default 1000)\n");
+    fprintf(stderr, "  --timeout-ms N     wait for stragglers after the last round (default 100)\n");
+    fprintf(stderr, "  --json             JSON on stdout\n");
+}
+
+static int run_sweep(int argc, char *argv[]) {
+    int count = 5, gap_us = 1000, timeout_ms = 100;
+    bool json = false, pairs = false;
+    char pair_tx[MAX_PROBES][IFNAMSIZ], pair_rx[MAX_PROBES][IFNAMSIZ];
+    int n_pairs = 0;
+
+    for (int i = 2; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--json") == 0) {
+            json = true;
+            continue;
+        }
+        if (!v) {
+            sweep_usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (strcmp(a, "--ifaces") == 0) {
+            char list[1024];
+            snprintf(list, sizeof(list), "%s", v);
+            for (char *sv, *t = strtok_r(list, ",", &sv); t; t = strtok_r(NULL, ",", &sv)) {
+                if (port_add(t) < 0) {
+                    fprintf(stderr, "Too many ports or bad name: %s\n", t);
+                    return 1;
+                }
+            }
+        } else if (strcmp(a, "--pair") == 0) {
+            const char *colon = strchr(v, ':');
+            if (!colon || colon == v || !colon[1] || colon - v >= IFNAMSIZ ||
+                strlen(colon + 1) >= IFNAMSIZ || n_pairs == MAX_PROBES) {
+                fprintf(stderr, "Invalid --pair '%s' (TX:RX)\n", v);
+                return 1;
+            }
+            snprintf(pair_tx[n_pairs], IFNAMSIZ, "%.*s", (int)(colon - v), v);
+            snprintf(pair_rx[n_pairs], IFNAMSIZ, "%s", colon + 1);
+            n_pairs++;
+            pairs = true;
+        } else if (strcmp(a, "--count") == 0) {
+            count = atoi(v);
+        } else if (strcmp(a, "--gap-us") == 0) {
+            gap_us = atoi(v);
+        } else if (strcmp(a, "--timeout-ms") == 0) {
+            timeout_ms = atoi(v);
+        } else {
+            sweep_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (count < 1 || gap_us < 0 || timeout_ms < 0) {
+        fprintf(stderr, "--count must be >= 1, --gap-us and --timeout-ms >= 0\n");
+        return 1;
+    }
+
+    for (int i = 0; i < n_pairs; i++) {
+        int t = port_add(pair_tx[i]), r = port_add(pair_rx[i]);
+        if (t < 0 || r < 0) {
+            fprintf(stderr, "Too many ports (max %d)\n", MAX_PORTS);
+            return 1;
+        }
+        probes[n_probes++] = (probe_t){ .tx = t, .rx = r };
+        cells[t][r].wanted = true;
+    }
+    if (n_ports == 0) ports_discover();
+    if (n_ports < 2) {
+        fprintf(stderr, "Need at least two ports (found %d)\n", n_ports);
+        return 1;
+    }
+
+    uint64_t t0 = tsn_time_ns();
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+    for (int i = 0; i < n_ports; i++) {
+        if (port_open(&ports[i], epfd, i) < 0 && !json) {
+            fprintf(stderr, "%s: %s\n", ports[i].name, ports[i].error);
+        }
+    }
+    if (!pairs) {
+        for (int t = 0; t < n_ports && n_probes < MAX_PROBES; t++) {
+            probes[n_probes++] = (probe_t){ .tx = t, .rx = -1 };
+            for (int r = 0; r < n_ports; r++) cells[t][r].wanted = r != t;
+        }
+    }
+
+    static const unsigned char bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    for (int p = 0; p < n_probes; p++) {
+        tsn_frame_spec_t spec = {
+            .dst_mac = probes[p].rx >= 0 ? ports[probes[p].rx].mac : bcast,
+            .src_mac = ports[probes[p].tx].mac,
+            .vlan_id = -1, .pcp = 0, .frame_size = 64, .proto = TSN_FRAME_EXP,
+            .stream_id = (uint16_t)(SWEEP_STREAM | p)
+        };
+        tsn_frame_build(&probes[p].frame, &spec);
+    }
+    // Ports that failed to open stay in the matrix, unreachable
+    // Rounds of one probe per stream, received frames handled in between
+    uint64_t setup_ns = tsn_time_ns() - t0;
+    sweep_start_ns = tsn_realtime_ns();
+    uint64_t next = tsn_time_ns();
+    for (int round = 0; round < count && running; round++) {
+        for (int p = 0; p < n_probes; p++) {
+            if (!ports[probes[p].tx].error[0]) tsn_tx_queue(ports[probes[p].tx].tx, &probes[p].frame, 0, 0);
+        }
+        next += (uint64_t)gap_us * 1000;
+        for (uint64_t now; running && (now = tsn_time_ns()) < next;) {
+            dispatch_ready(epfd, (int)((next - now + 999999) / 1000000));
+        }
+    }
+    uint64_t deadline = tsn_time_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    for (uint64_t now; running && !sweep_complete(count) && (now = tsn_time_ns()) < deadline;) {
+        dispatch_ready(epfd, (int)((deadline - now + 999999) / 1000000));
+    }
+    uint64_t elapsed_ns = tsn_time_ns() - t0;
+
+    tsn_instr_t instr = { 0 };
+    for (int i = 0; i < n_ports; i++) {
+        if (ports[i].tx) {
+            tsn_tx_finish(ports[i].tx);
+            tsn_tx_instr(ports[i].tx, &instr);
+        }
+        if (ports[i].cap) tsn_capture_instr(ports[i].cap, &instr);
+    }
+
+    int wanted = 0, reachable = 0;
+    for (int t = 0; t < n_ports; t++) {
+        for (int r = 0; r < n_ports; r++) {
+            if (!cells[t][r].wanted) continue;
+            wanted++;
+            reachable += cells[t][r].received > 0;
+        }
+    }
+
+    if (json) {
+        printf("{\"mode\":\"sweep\",\"count\":%d,\"setup_ms\":%.1f,\"elapsed_ms\":%.1f,\"ports\":[",
+               count, setup_ns / 1e6, elapsed_ns / 1e6);
+        for (int i = 0; i < n_ports; i++) {
+            port_t *p = &ports[i];
+            printf("%s{\"name\":\"%s\",\"mac\":\"%02x:%02x:%02x:%02x:%02x:%02x\"", i ? "," : "",
+                   p->name, p->mac[0], p->mac[1], p->mac[2], p->mac[3], p->mac[4], p->mac[5]);
+            if (p->error[0]) printf(",\"error\":\"%s\"", p->error);
+            else printf(",\"backend\":\"%s\"", tsn_capture_backend_name(p->cap));
+            printf("}");
+        }
+        printf("],\"links\":[");
+        int first = 1;
+        for (int t = 0; t < n_ports; t++) {
+            for (int r = 0; r < n_ports; r++) {
+                cell_t *c = &cells[t][r];
+                if (!c->wanted) continue;
+                printf("%s{\"tx\":\"%s\",\"rx\":\"%s\",\"sent\":%d,\"received\":%lu",
+                       first ? "" : ",", ports[t].name, ports[r].name,
+                       ports[t].error[0] ? 0 : count, c->received);
+                if (c->received) {
+                    printf(",\"lat_min_us\":%.1f,\"lat_avg_us\":%.1f,\"lat_max_us\":%.1f",
+                           c->lat_min / 1e3, c->lat_sum / 1e3 / c->received, c->lat_max / 1e3);
+                }
+                printf("}");
+                first = 0;
+            }
+        }
+        printf("],\"reachable\":%d,\"probed\":%d,", reachable, wanted);
+        tsn_instr_print_json(stdout, &instr);
+        printf("}\n");
+    } else {
+        printf("Port sweep: %d ports, %d probes per stream, %.0f ms (%.0f ms setup)\n\n",
+               n_ports, count, elapsed_ns / 1e6, setup_ns / 1e6);
+        printf("%-16s", "TX \\ RX");
+        for (int r = 0; r < n_ports; r++) printf(" %16s", ports[r].name);
+        printf("\n");
+        for (int t = 0; t < n_ports; t++) {
+            printf("%-16s", ports[t].name);
+            for (int r = 0; r < n_ports; r++) {
+                cell_t *c = &cells[t][r];
+                char cell[48];
+                if (!c->wanted) snprintf(cell, sizeof(cell), "-");
+                else if (!c->received) snprintf(cell, sizeof(cell), "0/%d", count);
+                else snprintf(cell, sizeof(cell), "%lu/%d %.1fus", c->received, count,
+                              c->lat_sum / 1e3 / c->received);
+                printf(" %16s", cell);
+            }
+            printf("%s%s\n", ports[t].error[0] ? "  " : "", ports[t].error);
+        }
+        printf("\n%d of %d links reachable (cells: received/sent, avg one-way latency)\n",
+               reachable, wanted);
+        tsn_instr_print_human(stdout, &instr);
+    }
+
+    for (int i = 0; i < n_ports; i++) {
+        tsn_tx_close(ports[i].tx);
+        tsn_capture_close(ports[i].cap);
+    }
+    close(epfd);
+
+    // Pairs: every one must answer; all ports: any link proves the switch forwards
+    return (pairs ? reachable == wanted && wanted > 0 : reachable > 0) ? 0 : 1;
 }
 
 int main(int argc, char *argv[]) {
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) return run_sweep(argc, argv);
+
     if (argc < 3) {
         fprintf(stderr, "Usage: %s <tx_interface> <rx_interface> [duration]\n", argv[0]);
+        fprintf(stderr, "       %s --sweep [--ifaces LIST | --pair TX:RX ...] [--json]\n", argv[0]);
         return 1;
     }
 
@@ -59,13 +437,10 @@ int main(int argc, char *argv[]) {
     const char *rx_if = argv[2];
     int duration = argc > 3 ? atoi(argv[3]) : 3;
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-
     // Get MACs
     unsigned char tx_mac[6], rx_mac[6];
-    get_mac(tx_if, tx_mac);
-    get_mac(rx_if, rx_mac);
+    tsn_get_iface_mac(tx_if, tx_mac);
+    tsn_get_iface_mac(rx_if, rx_mac);
 
     printf("TX: %s (%02x:%02x:%02x:%02x:%02x:%02x)\n", tx_if,
            tx_mac[0], tx_mac[1], tx_mac[2], tx_mac[3], tx_mac[4], tx_mac[5]);
@@ -73,27 +448,8 @@ int main(int argc, char *argv[]) {
            rx_mac[0], rx_mac[1], rx_mac[2], rx_mac[3], rx_mac[4], rx_mac[5]);
 
     // Create TX socket
-    int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
-    if (sock < 0) {
-        perror("socket");
-        return 1;
-    }
-
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, tx_if, IFNAMSIZ - 1);
-    if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
-        perror("ioctl");
-        close(sock);
-        return 1;
-    }
-
-    struct sockaddr_ll sll;
-    memset(&sll, 0, sizeof(sll));
-    sll.sll_family = AF_PACKET;
-    sll.sll_ifindex = ifr.ifr_ifindex;
-    sll.sll_protocol = htons(ETH_P_ALL);
-    bind(sock, (struct sockaddr *)&sll, sizeof(sll));
+    int sock = tsn_raw_socket_open(tx_if);
+    if (sock < 0) return 1;
 
     // Build simple untagged ARP-like frame (EtherType 0x0806)
     unsigned char frame[64];
@@ -104,10 +460,13 @@ int main(int argc, char *argv[]) {
     // Rest is padding
 
     // Open RX capture
-    char errbuf[PCAP_ERRBUF_SIZE];
-    pcap_t *pcap = pcap_open_live(rx_if, 128, 1, 10, errbuf);
-    if (!pcap) {
-        fprintf(stderr, "pcap: %s\n", errbuf);
+    char errbuf[256];
+    tsn_capture_opts_t opts;
+    tsn_capture_opts_init(&opts);
+    opts.timeout_ms = 10;
+    tsn_capture_t *cap = tsn_capture_open(rx_if, &opts, errbuf);
+    if (!cap) {
+        fprintf(stderr, "capture: %s\n", errbuf);
         close(sock);
         return 1;
     }
@@ -116,11 +475,7 @@ int main(int argc, char *argv[]) {
     char filter[128];
     snprintf(filter, sizeof(filter), "ether src %02x:%02x:%02x:%02x:%02x:%02x",
              tx_mac[0], tx_mac[1], tx_mac[2], tx_mac[3], tx_mac[4], tx_mac[5]);
-    struct bpf_program fp;
-    if (pcap_compile(pcap, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) == 0) {
-        pcap_setfilter(pcap, &fp);
-        pcap_freecode(&fp);
-    }
+    tsn_capture_set_filter(cap, filter);
 
     printf("Sending test packets for %d seconds...\n", duration);
 
@@ -131,12 +486,14 @@ int main(int argc, char *argv[]) {
         if (sent > 0) tx_count++;
 
         // Check for received
-        pcap_dispatch(pcap, 10, packet_handler, NULL);
+        tsn_capture_dispatch(cap, packet_handler, NULL);
 
         usleep(10000);  // 10ms
     }
 
-    pcap_close(pcap);
+    tsn_instr_t instr = {0};
+    tsn_capture_instr(cap, &instr);
+    tsn_capture_close(cap);
     close(sock);
 
     printf("\n");
@@ -144,6 +501,7 @@ int main(int argc, char *argv[]) {
     printf("  TX: %d packets\n", tx_count);
     printf("  RX: %d packets\n", rx_count);
     printf("  Loss: %.1f%%\n", tx_count > 0 ? 100.0 * (1 - (double)rx_count / tx_count) : 0);
+    tsn_instr_print_human(stdout, &instr);
 
     if (rx_count > 0) {
         printf("\n[OK] Connectivity confirmed - packets are flowing through the switch\n");
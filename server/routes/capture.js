@@ -2,17 +2,38 @@ import express from 'express';
 import { spawn } from 'child_process';
 import path from 'path';
 import { fileURLToPath } from 'url';
+import { TsnDaemonClient, commandArgs } from '../lib/tsn-daemon.js';
 
 const __filename = fileURLToPath(import.meta.url);
 const __dirname = path.dirname(__filename);
 
 const router = express.Router();
 
-// rxcap process state
+// rxcap process state, or a capture on tsn-daemon ({ timer, last, stopping })
 let rxcapProcess = null;
 let rxcapStats = null;
+let daemonCapture = null;
 let wsClients = new Set();
 
+// A running tsn-daemon replaces the spawned rxcap (capture ring and filter
+// stay open between tests); rxcap is only spawned when there is none. Its
+// capture_stats events become the same 'c-capture-stats' messages
+const daemon = new TsnDaemonClient();
+daemon.on('capture_stats', (msg) => {
+  if (daemonCapture) onDaemonStats(msg);
+});
+daemon.on('close', () => finishDaemonCapture(null));
+daemon.on('error', () => {});
+daemon.connect()
+  .then(() => console.log(`[capture] Using tsn-daemon at ${daemon.socketPath}`))
+  .catch(() => {});
+
+const validIface = /^[A-Za-z0-9_.:@-]+$/;
+
+function captureRunning() {
+  return !!rxcapProcess || !!daemonCapture;
+}
+
 // Set WebSocket clients
 export function setWsClients(clients) {
   wsClients = clients;
@@ -21,8 +42,8 @@ export function setWsClients(clients) {
 // Get current capture state for sync
 export function getCaptureState() {
   return {
-    running: !!rxcapProcess,
-    cCapture: rxcapProcess ? {
+    running: captureRunning(),
+    cCapture: captureRunning() ? {
       running: true,
       stats: rxcapStats
     } : { running: false }
@@ -117,6 +138,90 @@ function parseRxcapLine(line, headers) {
   };
 }
 
+// tsn-daemon capture_stats / capture_final to the same format. Per-TC rates
+// come from the daemon, the total rate from the previous event; latency is
+// only in the final analysis
+function parseDaemonStats(msg, prev) {
+  const tc = {};
+  let totalKbps = 0;
+  let latency = null;
+  let latWeighted = 0;
+  let latCount = 0;
+  for (const [pcp, t] of Object.entries(msg.tc || {})) {
+    totalKbps += t.kbps;
+    tc[pcp] = {
+      count: t.count,
+      kbps: t.kbps,
+      avg_ms: t.lat_avg_us !== undefined ? t.lat_avg_us / 1000 : 0,
+      burst_ratio: 0
+    };
+    if (t.lat_avg_us !== undefined) {
+      latency = {
+        min_ns: Math.min(latency?.min_ns ?? Infinity, Math.round(t.lat_min_us * 1000)),
+        max_ns: Math.max(latency?.max_ns ?? 0, Math.round(t.lat_max_us * 1000))
+      };
+      latWeighted += t.lat_avg_us * t.count;
+      latCount += t.count;
+    }
+  }
+  if (latency) latency.avg_ns = Math.round(latWeighted / latCount * 1000);
+
+  const dt = msg.elapsed_ms - (prev?.elapsed_ms || 0);
+  return {
+    elapsed_ms: Math.round(msg.elapsed_ms),
+    total: msg.total,
+    total_pps: dt > 0 ? Math.round((msg.total - (prev?.total || 0)) * 1000 / dt) : 0,
+    total_mbps: totalKbps / 1000,
+    drops: msg.instrumentation?.rx?.kernel_drops || 0,
+    tc,
+    latency
+  };
+}
+
+function onDaemonStats(msg) {
+  const stats = parseDaemonStats(msg, daemonCapture.last);
+  daemonCapture.last = msg;
+  rxcapStats.packets = stats.total;
+  rxcapStats.tc = stats.tc;
+  rxcapStats.elapsed_ms = stats.elapsed_ms;
+  broadcast({ type: 'c-capture-stats', data: stats });
+}
+
+// The daemon's final analysis (null: lost the daemon), then the same
+// messages as rxcap's exit
+function finishDaemonCapture(final) {
+  if (!daemonCapture) return;
+  clearTimeout(daemonCapture.timer);
+  daemonCapture = null;
+  if (final) {
+    const stats = parseDaemonStats(final, null);
+    rxcapStats.packets = stats.total;
+    rxcapStats.tc = stats.tc;
+    rxcapStats.elapsed_ms = stats.elapsed_ms;
+    rxcapStats.latency = stats.latency;
+    rxcapStats.drops = stats.drops;
+  }
+  broadcast({
+    type: 'c-capture-stats',
+    data: {
+      elapsed_ms: rxcapStats.elapsed_ms || 0,
+      total: rxcapStats.packets,
+      tc: rxcapStats.tc,
+      final: true
+    }
+  });
+  broadcast({ type: 'c-capture-stopped', stats: rxcapStats });
+}
+
+// The daemon captures until told to stop, so the duration is kept here
+function stopDaemonCapture() {
+  if (!daemonCapture.stopping) {
+    daemonCapture.stopping = daemon.command('capture stop')
+      .then((final) => finishDaemonCapture(final), () => finishDaemonCapture(null));
+  }
+  return daemonCapture.stopping;
+}
+
 // Get available interfaces
 router.get('/interfaces', (req, res) => {
   try {
@@ -142,10 +247,43 @@ router.post('/start-c', (req, res) => {
     return res.status(400).json({ error: 'Interface required' });
   }
 
-  if (rxcapProcess) {
+  if (captureRunning()) {
     return res.status(400).json({ error: 'Capture already running' });
   }
 
+  if (daemon.connected) {
+    if (!validIface.test(iface)) return res.status(400).json({ error: 'Invalid interface' });
+    // The daemon filters on the VLAN and reads sequence and latency from the
+    // test header (rxcap's --seq --latency)
+    rxcapStats = {
+      startTime: Date.now(),
+      interface: iface,
+      vlanId,
+      duration,
+      packets: 0,
+      tc: {}
+    };
+    daemonCapture = { timer: null, last: null, stopping: null };
+    const dc = daemonCapture;
+    daemon.command(`capture start ${commandArgs({ iface, vlan: parseInt(vlanId) || 100 })}`)
+      .then(() => {
+        if (daemonCapture !== dc) return;
+        dc.timer = setTimeout(() => stopDaemonCapture(), (parseInt(duration) || 30) * 1000);
+        res.json({
+          success: true,
+          message: `tsn-daemon capture started on ${iface}`,
+          interface: iface,
+          duration,
+          vlanId
+        });
+      })
+      .catch((err) => {
+        if (daemonCapture === dc) daemonCapture = null;
+        res.status(500).json({ error: err.message });
+      });
+    return;
+  }
+
   const rxcapPath = path.join(__dirname, '..', 'rxcap');
 
   // Build rxcap arguments
@@ -272,6 +410,10 @@ router.post('/start-c', (req, res) => {
 
 // Stop rxcap
 router.post('/stop-c', async (req, res) => {
+  if (daemonCapture) {
+    await stopDaemonCapture();
+    return res.json({ success: true, message: 'tsn-daemon capture stopped', stats: rxcapStats });
+  }
   if (!rxcapProcess) {
     return res.json({ success: true, message: 'No capture running' });
   }
@@ -314,7 +456,7 @@ router.post('/stop-c', async (req, res) => {
 // Get rxcap status
 router.get('/status-c', (req, res) => {
   res.json({
-    running: !!rxcapProcess,
+    running: captureRunning(),
     stats: rxcapStats
   });
 });
@@ -327,6 +469,7 @@ router.post('/start', (req, res) => {
 
 router.post('/stop', (req, res) => {
   // Stop rxcap
+  if (daemonCapture) stopDaemonCapture();
   if (rxcapProcess) {
     try {
       rxcapProcess.kill('SIGTERM');
@@ -338,16 +481,17 @@ router.post('/stop', (req, res) => {
 });
 
 router.get('/status', (req, res) => {
+  const running = captureRunning();
   res.json({
-    running: !!rxcapProcess,
-    activeCaptures: rxcapProcess ? [{
+    running,
+    activeCaptures: running ? [{
       interface: rxcapStats?.interface,
       packetCount: rxcapStats?.packets || 0
     }] : [],
-    totalInterfaces: rxcapProcess ? 1 : 0,
+    totalInterfaces: running ? 1 : 0,
     clients: wsClients.size,
     globalPacketCount: rxcapStats?.packets || 0,
-    cCapture: rxcapProcess ? {
+    cCapture: running ? {
       running: true,
       stats: rxcapStats
     } : null
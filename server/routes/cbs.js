@@ -2,7 +2,8 @@
  * CBS (Credit-Based Shaper) API Routes
  *
  * IEEE 802.1Qav CBS configuration for LAN9662
- * Uses keti-tsn CLI for reliable device communication
+ * Goes through the in-process config engine (lib/config-engine.js): tables
+ * loaded once, device link kept open, changes coalesced into one iPATCH
  *
  * CBS Parameters:
  *   - idleSlope: Credit accumulation rate (kilobits/sec) - determines bandwidth allocation
@@ -12,107 +13,19 @@
  */
 
 import express from 'express';
-import path from 'path';
-import { fileURLToPath } from 'url';
-import { spawn } from 'child_process';
-import fs from 'fs';
-import os from 'os';
-
-const __dirname = path.dirname(fileURLToPath(import.meta.url));
+import { configEngine, DEFAULT_DEVICE } from '../lib/config-engine.js';
 
 const router = express.Router();
 
-// keti-tsn CLI path
-const KETI_TSN_CLI = '/home/kim/keti-tsn-cli-new/bin/keti-tsn.js';
-
 // Default settings
-const DEFAULT_DEVICE = '/dev/ttyACM0';
 const DEFAULT_LINK_SPEED_MBPS = 1000;  // 1 Gbps (actual link speed)
 
-// Serial port mutex to prevent concurrent access
-let isLocked = false;
-const waitQueue = [];
-
-async function acquireLock() {
-  if (!isLocked) {
-    isLocked = true;
-    return;
-  }
-  return new Promise(resolve => waitQueue.push(resolve));
-}
-
-function releaseLock() {
-  if (waitQueue.length > 0) {
-    const next = waitQueue.shift();
-    next();
-  } else {
-    isLocked = false;
-  }
-}
-
 /**
- * Execute keti-tsn CLI command with mutex
+ * Device link options of a request (body or query)
  */
-async function executeKetiTsn(command, yamlContent, options = {}) {
-  await acquireLock();
-  try {
-    const result = await executeKetiTsnInternal(command, yamlContent, options);
-    await new Promise(r => setTimeout(r, 100)); // Small delay
-    return result;
-  } finally {
-    releaseLock();
-  }
-}
-
-async function executeKetiTsnInternal(command, yamlContent, options = {}) {
-  return new Promise((resolve, reject) => {
-    // Write YAML to temp file
-    const tmpFile = path.join(os.tmpdir(), `cbs-${Date.now()}.yaml`);
-    fs.writeFileSync(tmpFile, yamlContent, 'utf-8');
-
-    const args = [KETI_TSN_CLI, command, tmpFile];
-    if (options.device) {
-      args.push('-d', options.device);
-    }
-
-    console.log(`[CBS] Running: node ${args.join(' ')}`);
-    console.log(`[CBS] YAML content:\n${yamlContent}`);
-
-    const proc = spawn('node', args, {
-      stdio: ['ignore', 'pipe', 'pipe'],
-      timeout: 30000
-    });
-
-    let stdout = '';
-    let stderr = '';
-
-    proc.stdout.on('data', (data) => {
-      stdout += data.toString();
-    });
-
-    proc.stderr.on('data', (data) => {
-      stderr += data.toString();
-    });
-
-    proc.on('close', (code) => {
-      // Clean up temp file
-      try { fs.unlinkSync(tmpFile); } catch (e) { /* ignore */ }
-
-      if (code === 0) {
-        console.log(`[CBS] Success: ${stdout.trim()}`);
-        resolve({ success: true, output: stdout.trim() });
-      } else {
-        console.error(`[CBS] Failed (code ${code}): ${stderr}`);
-        resolve({ success: false, output: stdout, error: stderr || `Exit code ${code}` });
-      }
-    });
-
-    proc.on('error', (err) => {
-      try { fs.unlinkSync(tmpFile); } catch (e) { /* ignore */ }
-      console.error(`[CBS] Process error: ${err.message}`);
-      reject(err);
-    });
-  });
+function linkOptions(src = {}) {
+  const { transport, device, host, port } = src;
+  return { transport, device: device || DEFAULT_DEVICE, host, port };
 }
 
 /**
@@ -122,26 +35,34 @@ function buildCbsPath(portNum) {
   return `/ietf-interfaces:interfaces/interface[name='${portNum}']/mchp-velocitysp-port:eth-qos/config/traffic-class-shapers`;
 }
 
+/**
+ * Instance-identifier item setting one TC's idle slope
+ */
+function buildCbsItem(portNum, tc, idleSlopeKbps) {
+  return {
+    [buildCbsPath(portNum)]: {
+      'traffic-class': tc,
+      'credit-based': { 'idle-slope': idleSlopeKbps }
+    }
+  };
+}
+
 /**
  * GET /api/cbs/status/:port
  * Get CBS status for a specific port
  */
 router.get('/status/:port', async (req, res) => {
   const portNum = req.params.port;
-  const device = req.query.device || DEFAULT_DEVICE;
 
   try {
-    const queryPath = buildCbsPath(portNum);
-    const yamlContent = `- ${queryPath}`;
-
-    const result = await executeKetiTsn('fetch', yamlContent, { device });
+    const result = await configEngine.fetch([buildCbsPath(portNum)], linkOptions(req.query));
 
     if (!result.success) {
       return res.status(500).json({ error: result.error });
     }
 
     // Parse YAML output
-    const lines = result.output.split('\n');
+    const lines = result.yaml.split('\n');
     const tcConfigs = {};
     let currentTc = null;
     let inCreditBased = false;
@@ -171,7 +92,7 @@ router.get('/status/:port', async (req, res) => {
     res.json({
       port: portNum,
       linkSpeedMbps: DEFAULT_LINK_SPEED_MBPS,
-      raw: result.output,
+      raw: result.yaml,
       tcConfigs
     });
   } catch (error) {
@@ -195,8 +116,7 @@ router.post('/configure/:port', async (req, res) => {
   const {
     tc,
     idleSlope,  // Now in kbps directly (simplified)
-    linkSpeed = DEFAULT_LINK_SPEED_MBPS,
-    device
+    linkSpeed = DEFAULT_LINK_SPEED_MBPS
   } = req.body;
 
   if (tc === undefined || tc < 0 || tc > 7) {
@@ -213,13 +133,7 @@ router.post('/configure/:port', async (req, res) => {
   console.log(`[CBS] Configure Port ${portNum} TC${tc}: ${idleSlopeKbps} kbps (${bandwidthPercent.toFixed(2)}%)`);
 
   try {
-    // Build YAML for keti-tsn patch
-    const yamlContent = `- ${buildCbsPath(portNum)}:
-    traffic-class: ${tc}
-    credit-based:
-      idle-slope: ${idleSlopeKbps}`;
-
-    const result = await executeKetiTsn('patch', yamlContent, { device: device || DEFAULT_DEVICE });
+    const result = await configEngine.patch([buildCbsItem(portNum, tc, idleSlopeKbps)], linkOptions(req.body));
 
     if (!result.success) {
       return res.status(500).json({ error: result.error });
@@ -231,7 +145,8 @@ router.post('/configure/:port', async (req, res) => {
       tc,
       idleSlopeKbps,
       bandwidthPercent,
-      linkSpeedMbps: linkSpeed
+      linkSpeedMbps: linkSpeed,
+      coalesced: result.coalesced
     });
   } catch (error) {
     res.status(500).json({ error: error.message });
@@ -252,8 +167,7 @@ router.post('/configure-all/:port', async (req, res) => {
   const portNum = req.params.port;
   const {
     configs,
-    linkSpeed = DEFAULT_LINK_SPEED_MBPS,
-    device
+    linkSpeed = DEFAULT_LINK_SPEED_MBPS
   } = req.body;
 
   if (!Array.isArray(configs) || configs.length === 0) {
@@ -263,8 +177,8 @@ router.post('/configure-all/:port', async (req, res) => {
   try {
     const results = [];
 
-    // Build YAML with all configs
-    const yamlLines = configs.map(cfg => {
+    // All TCs in one payload
+    const items = configs.map(cfg => {
       if (cfg.tc === undefined || cfg.tc < 0 || cfg.tc > 7) {
         throw new Error(`Invalid tc: ${cfg.tc}`);
       }
@@ -283,14 +197,10 @@ router.post('/configure-all/:port', async (req, res) => {
         bandwidthPercent
       });
 
-      return `- ${buildCbsPath(portNum)}:
-    traffic-class: ${cfg.tc}
-    credit-based:
-      idle-slope: ${idleSlopeKbps}`;
+      return buildCbsItem(portNum, cfg.tc, idleSlopeKbps);
     });
 
-    const yamlContent = yamlLines.join('\n');
-    const result = await executeKetiTsn('patch', yamlContent, { device: device || DEFAULT_DEVICE });
+    const result = await configEngine.patch(items, linkOptions(req.body));
 
     if (!result.success) {
       return res.status(500).json({ error: result.error });
@@ -314,7 +224,6 @@ router.post('/configure-all/:port', async (req, res) => {
 router.delete('/configure/:port/:tc', async (req, res) => {
   const portNum = req.params.port;
   const tc = parseInt(req.params.tc);
-  const device = req.query.device || DEFAULT_DEVICE;
 
   if (isNaN(tc) || tc < 0 || tc > 7) {
     return res.status(400).json({ error: 'tc must be 0-7' });
@@ -325,12 +234,8 @@ router.delete('/configure/:port/:tc', async (req, res) => {
   try {
     // To disable CBS for a TC, we set idle-slope to 0 (or remove the entry)
     // For simplicity, we'll set it to a very high value (effectively unlimited)
-    const yamlContent = `- ${buildCbsPath(portNum)}:
-    traffic-class: ${tc}
-    credit-based:
-      idle-slope: 1000000`;  // 1 Gbps = effectively unlimited
-
-    const result = await executeKetiTsn('patch', yamlContent, { device });
+    // 1 Gbps = effectively unlimited
+    const result = await configEngine.patch([buildCbsItem(portNum, tc, 1000000)], linkOptions(req.query));
 
     if (!result.success) {
       return res.status(500).json({ error: result.error });
@@ -352,20 +257,22 @@ router.delete('/configure/:port/:tc', async (req, res) => {
  * Get CBS status for all ports (1 and 2)
  */
 router.get('/ports', async (req, res) => {
-  const device = req.query.device || DEFAULT_DEVICE;
+  const link = linkOptions(req.query);
   const results = {};
 
   try {
-    for (const portNum of ['1', '2']) {
-      const queryPath = buildCbsPath(portNum);
-      const yamlContent = `- ${queryPath}`;
+    // Both queries go out on the same open link
+    const fetches = ['1', '2'].map(portNum => configEngine.fetch([buildCbsPath(portNum)], link));
+    const settled = await Promise.allSettled(fetches);
 
+    for (const [i, portNum] of ['1', '2'].entries()) {
       try {
-        const result = await executeKetiTsn('fetch', yamlContent, { device });
+        if (settled[i].status === 'rejected') throw settled[i].reason;
+        const result = settled[i].value;
 
         if (result.success) {
           // Parse YAML output
-          const lines = result.output.split('\n');
+          const lines = result.yaml.split('\n');
           const tcConfigs = {};
           let currentTc = null;
 
@@ -386,7 +293,7 @@ router.get('/ports', async (req, res) => {
             }
           }
 
-          results[portNum] = { tcConfigs, raw: result.output };
+          results[portNum] = { tcConfigs, raw: result.yaml };
         } else {
           results[portNum] = { tcConfigs: {}, error: result.error };
         }
@@ -1,6 +1,7 @@
 import express from 'express';
 import path from 'path';
 import { fileURLToPath } from 'url';
+import { configEngine } from '../lib/config-engine.js';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 const TSC2CBOR_LIB = path.resolve(__dirname, '../../tsc2cbor/lib');
@@ -10,33 +11,23 @@ const router = express.Router();
 router.post('/', async (req, res) => {
   const { transport = 'serial', device = '/dev/ttyACM0', host, port = 5683 } = req.body;
 
+  if (transport === 'wifi' && !host) {
+    return res.status(400).json({ error: 'WiFi transport requires host parameter' });
+  }
+
   try {
-    const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
     const { YangCatalogManager } = await import(`${TSC2CBOR_LIB}/yang-catalog/yang-catalog.js`);
-
-    const transportInstance = createTransport(transport, { verbose: false });
     const yangCatalog = new YangCatalogManager();
 
-    // Connect based on transport type
-    if (transport === 'wifi') {
-      if (!host) {
-        return res.status(400).json({ error: 'WiFi transport requires host parameter' });
-      }
-      await transportInstance.connect({ host, port });
-    } else {
-      await transportInstance.connect({ device });
-    }
-
-    // Wait for board to be ready
-    await transportInstance.waitForReady(10000);
-
-    // Get checksum first
-    const checksum = await yangCatalog.queryChecksumFromDevice(transportInstance);
+    // Get checksum first (up to 10 s for the board when the link is fresh)
+    const checksum = await configEngine.withTransport(
+      { transport, device, host, port, readyMs: 10000 },
+      (transportInstance) => yangCatalog.queryChecksumFromDevice(transportInstance)
+    );
 
     // Check if already cached
     let catalogInfo = yangCatalog.getCatalogInfo(checksum);
     if (catalogInfo) {
-      await transportInstance.disconnect();
       return res.json({
         message: 'Catalog already cached',
         checksum,
@@ -44,8 +35,6 @@ router.post('/', async (req, res) => {
       });
     }
 
-    await transportInstance.disconnect();
-
     // Download catalog from remote server (Microchip)
     const tarPath = await yangCatalog.downloadCatalog(checksum);
 
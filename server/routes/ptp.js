@@ -1,7 +1,7 @@
 import express from 'express';
 import path from 'path';
 import { fileURLToPath } from 'url';
-import fs from 'fs';
+import { configEngine } from '../lib/config-engine.js';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 const TSC2CBOR_LIB = path.resolve(__dirname, '../../tsc2cbor/lib');
@@ -77,44 +77,22 @@ const PTP_PROFILES = {
   }
 };
 
-async function findYangCache() {
-  const { YangCatalogManager } = await import(`${TSC2CBOR_LIB}/yang-catalog/yang-catalog.js`);
-  const yangCatalog = new YangCatalogManager();
-  const catalogs = yangCatalog.listCachedCatalogs();
-  if (catalogs.length === 0) throw new Error('No YANG catalog found');
-  return catalogs[0].path;
+// PTP boards (ESP32) over WiFi, through the shared config engine
+function boardLink(host, connectMs = 20000) {
+  return { transport: 'wifi', host, port: 5683, connectMs };
 }
 
-async function createTransportConnection(host, port = 5683, timeout = 20000) {
-  const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
-  const transport = createTransport('wifi', { verbose: false });
-
-  // Add timeout wrapper
-  const connectWithTimeout = new Promise((resolve, reject) => {
-    const timer = setTimeout(() => {
-      reject(new Error('Connection timeout'));
-    }, timeout);
-
-    transport.connect({ host, port })
-      .then(() => transport.waitForReady(5000))
-      .then(() => {
-        clearTimeout(timer);
-        resolve(transport);
-      })
-      .catch((err) => {
-        clearTimeout(timer);
-        reject(err);
-      });
-  });
-
-  return connectWithTimeout;
+// iFETCH the PTP tree of a board, YAML on success
+async function fetchPtp(ip, connectMs) {
+  const result = await configEngine.fetch(['/ieee1588-ptp:ptp'], boardLink(ip, connectMs));
+  if (!result.success) throw new Error(result.error);
+  return result.yaml;
 }
 
 // Health check for a single board
 router.get('/health/:ip', async (req, res) => {
   const { ip } = req.params;
   const startTime = Date.now();
-  let transport = null;
 
   // Check if we have valid cached data (especially for GM)
   const cached = getCachedIfValid(ip);
@@ -145,33 +123,8 @@ router.get('/health/:ip', async (req, res) => {
   markRequestStart(ip);
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { loadYangInputs } = await import(`${TSC2CBOR_LIB}/common/input-loader.js`);
-    const { extractSidsFromInstanceIdentifier } = await import(`${TSC2CBOR_LIB}/encoder/transformer-instance-id.js`);
-    const { Cbor2TscConverter } = await import('../../tsc2cbor/cbor2tsc.js');
-
-    const { sidInfo } = await loadYangInputs(yangCacheDir, false);
-    transport = await createTransportConnection(ip);
-
     // Quick fetch of PTP servo status
-    const queries = extractSidsFromInstanceIdentifier(
-      [{ "/ieee1588-ptp:ptp": null }],
-      sidInfo,
-      { verbose: false }
-    );
-
-    const response = await transport.sendiFetchRequest(queries);
-    try { await transport.disconnect(); } catch (e) {}
-
-    if (!response.isSuccess()) {
-      throw new Error(`CoAP code ${response.code}`);
-    }
-
-    const decoder = new Cbor2TscConverter(yangCacheDir);
-    const result = await decoder.convertBuffer(response.payload, { verbose: false, outputFormat: 'rfc7951' });
-
-    // Parse PTP status
-    const ptpData = parsePtpYaml(result.yaml);
+    const ptpData = parsePtpYaml(await fetchPtp(ip));
     const latency = Date.now() - startTime;
 
     // Update board state
@@ -191,11 +144,6 @@ router.get('/health/:ip', async (req, res) => {
   } catch (error) {
     markRequestEnd(ip);
 
-    // Cleanup transport on error
-    if (transport) {
-      try { await transport.disconnect(); } catch (e) {}
-    }
-
     boardState.set(ip, {
       online: false,
       lastCheck: Date.now(),
@@ -214,35 +162,10 @@ router.get('/health/:ip', async (req, res) => {
 router.get('/offset/:ip', async (req, res) => {
   const { ip } = req.params;
   const startTime = Date.now();
-  let transport = null;
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { loadYangInputs } = await import(`${TSC2CBOR_LIB}/common/input-loader.js`);
-    const { extractSidsFromInstanceIdentifier } = await import(`${TSC2CBOR_LIB}/encoder/transformer-instance-id.js`);
-    const { Cbor2TscConverter } = await import('../../tsc2cbor/cbor2tsc.js');
-
-    const { sidInfo } = await loadYangInputs(yangCacheDir, false);
-    transport = await createTransportConnection(ip, 5683, 15000);
-
-    const queries = extractSidsFromInstanceIdentifier(
-      [{ "/ieee1588-ptp:ptp": null }],
-      sidInfo,
-      { verbose: false }
-    );
-
-    const response = await transport.sendiFetchRequest(queries);
-    try { await transport.disconnect(); } catch (e) {}
-
-    if (!response.isSuccess()) {
-      throw new Error(`CoAP code ${response.code}`);
-    }
-
-    const decoder = new Cbor2TscConverter(yangCacheDir);
-    const result = await decoder.convertBuffer(response.payload, { verbose: false, outputFormat: 'rfc7951' });
-
     // Parse PTP data
-    const yaml = result.yaml || '';
+    const yaml = (await fetchPtp(ip, 15000)) || '';
     const offsetMatch = yaml.match(/offset:\s*(-?\d+)/);
     const stateMatch = yaml.match(/state:\s*(\d+)/);
     const portStateMatch = yaml.match(/port-state:\s*(\w+)/);
@@ -261,9 +184,6 @@ router.get('/offset/:ip', async (req, res) => {
       meanLinkDelay: delayMatch ? parseInt(delayMatch[1]) : null
     });
   } catch (error) {
-    if (transport) {
-      try { await transport.disconnect(); } catch (e) {}
-    }
     res.json({
       online: false,
       error: error.message,
@@ -286,30 +206,12 @@ router.get('/config/:ip', async (req, res) => {
   const { ip } = req.params;
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { loadYangInputs } = await import(`${TSC2CBOR_LIB}/common/input-loader.js`);
-    const { extractSidsFromInstanceIdentifier } = await import(`${TSC2CBOR_LIB}/encoder/transformer-instance-id.js`);
-    const { Cbor2TscConverter } = await import('../../tsc2cbor/cbor2tsc.js');
-
-    const { sidInfo } = await loadYangInputs(yangCacheDir, false);
-    const transport = await createTransportConnection(ip);
-
-    const queries = extractSidsFromInstanceIdentifier(
-      [{ "/ieee1588-ptp:ptp": null }],
-      sidInfo,
-      { verbose: false }
-    );
+    const result = await configEngine.fetch(['/ieee1588-ptp:ptp'], boardLink(ip));
 
-    const response = await transport.sendiFetchRequest(queries);
-    await transport.disconnect();
-
-    if (!response.isSuccess()) {
-      return res.status(500).json({ error: `CoAP code ${response.code}` });
+    if (!result.success) {
+      return res.status(500).json({ error: result.error });
     }
 
-    const decoder = new Cbor2TscConverter(yangCacheDir);
-    const result = await decoder.convertBuffer(response.payload, { verbose: false, outputFormat: 'rfc7951' });
-
     res.json({
       raw: result.yaml,
       parsed: parsePtpYaml(result.yaml)
@@ -329,14 +231,7 @@ router.post('/apply/:ip', async (req, res) => {
   }
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { Tsc2CborConverter } = await import('../../tsc2cbor/tsc2cbor.js');
-    const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
-
-    const encoder = new Tsc2CborConverter(yangCacheDir);
-    const transport = createTransport('wifi', { verbose: false });
-    await transport.connect({ host: ip, port: 5683 });
-    await transport.waitForReady(5000);
+    const { encoder } = await configEngine.load();
 
     // Build configuration YAML
     const profileConfig = PTP_PROFILES[profile].config;
@@ -346,8 +241,10 @@ router.post('/apply/:ip', async (req, res) => {
     const encodeResult = await encoder.convertString(configYaml, { verbose: false });
 
     // Send iPATCH
-    const response = await transport.sendiPatchRequest(encodeResult.cbor);
-    await transport.disconnect();
+    const response = await configEngine.withTransport(
+      boardLink(ip),
+      (transport) => transport.sendiPatchRequest(encodeResult.cbor)
+    );
 
     if (!response.isSuccess()) {
       return res.status(500).json({
@@ -371,14 +268,9 @@ router.post('/save/:ip', async (req, res) => {
   const { ip } = req.params;
 
   try {
-    const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
     const { buildMessage, MessageType, MethodCode, OptionNumber, ContentFormat } = await import(`${TSC2CBOR_LIB}/coap/coap.js`);
     const { Encoder } = await import('cbor-x');
 
-    const transport = createTransport('wifi', { verbose: false });
-    await transport.connect({ host: ip, port: 5683 });
-    await transport.waitForReady(5000);
-
     const cborEncoder = new Encoder({ useRecords: false, mapsAsObjects: false });
     const rpcPayload = cborEncoder.encode(new Map([[21007, null]])); // save-config SID
 
@@ -396,8 +288,10 @@ router.post('/save/:ip', async (req, res) => {
       payload: rpcPayload
     });
 
-    const response = await transport._sendCoAPRequest(coapFrame, messageId);
-    await transport.disconnect();
+    const response = await configEngine.withTransport(
+      boardLink(ip),
+      (transport) => transport._sendCoAPRequest(coapFrame, messageId)
+    );
 
     if (!response.isSuccess()) {
       return res.status(500).json({ error: `Save failed: CoAP code ${response.code}` });
@@ -1,33 +1,13 @@
 import express from 'express';
 import path from 'path';
 import { fileURLToPath } from 'url';
-import fs from 'fs';
+import { configEngine } from '../lib/config-engine.js';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 const TSC2CBOR_LIB = path.resolve(__dirname, '../../tsc2cbor/lib');
 
 const router = express.Router();
 
-async function findYangCache(cacheOption) {
-  const { YangCatalogManager } = await import(`${TSC2CBOR_LIB}/yang-catalog/yang-catalog.js`);
-
-  if (cacheOption) {
-    if (!fs.existsSync(cacheOption)) {
-      throw new Error(`Cache directory not found: ${cacheOption}`);
-    }
-    return cacheOption;
-  }
-
-  const yangCatalog = new YangCatalogManager();
-  const catalogs = yangCatalog.listCachedCatalogs();
-
-  if (catalogs.length === 0) {
-    throw new Error('No YANG catalog found. Please download first.');
-  }
-
-  return catalogs[0].path;
-}
-
 // RPC endpoint for YANG RPCs like save-config
 router.post('/', async (req, res) => {
   const {
@@ -44,29 +24,12 @@ router.post('/', async (req, res) => {
     return res.status(400).json({ error: 'rpcPath is required' });
   }
 
-  try {
-    const yangCacheDir = await findYangCache(cache);
-
-    const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
-    const { Tsc2CborConverter } = await import('../../tsc2cbor/tsc2cbor.js');
-    const { Cbor2TscConverter } = await import('../../tsc2cbor/cbor2tsc.js');
-
-    const encoder = new Tsc2CborConverter(yangCacheDir);
-    const decoder = new Cbor2TscConverter(yangCacheDir);
-
-    // Create transport and connect
-    const transportInstance = createTransport(transport, { verbose: false });
-
-    if (transport === 'wifi') {
-      if (!host) {
-        return res.status(400).json({ error: 'WiFi transport requires host parameter' });
-      }
-      await transportInstance.connect({ host, port });
-    } else {
-      await transportInstance.connect({ device });
-    }
+  if (transport === 'wifi' && !host) {
+    return res.status(400).json({ error: 'WiFi transport requires host parameter' });
+  }
 
-    await transportInstance.waitForReady(5000);
+  try {
+    const { encoder, decoder } = await configEngine.load(cache);
 
     // Encode the RPC path to CBOR (SID)
     let payload = Buffer.alloc(0);
@@ -84,9 +47,10 @@ router.post('/', async (req, res) => {
     }
 
     // Send POST request for RPC
-    const response = await transportInstance.sendPostRequest(payload, {});
-
-    await transportInstance.disconnect();
+    const response = await configEngine.withTransport(
+      { transport, device, host, port },
+      (transportInstance) => transportInstance.sendPostRequest(payload, {})
+    );
 
     if (!response.isSuccess()) {
       let errorDetail = `CoAP code ${response.code}`;
@@ -143,8 +107,11 @@ router.post('/save-config', async (req, res) => {
     port = 5683
   } = req.body;
 
+  if (transport === 'wifi' && !host) {
+    return res.status(400).json({ error: 'WiFi transport requires host parameter' });
+  }
+
   try {
-    const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
     const {
       buildMessage,
       MessageType,
@@ -153,20 +120,6 @@ router.post('/save-config', async (req, res) => {
       ContentFormat
     } = await import(`${TSC2CBOR_LIB}/coap/coap.js`);
 
-    // Create transport and connect
-    const transportInstance = createTransport(transport, { verbose: false });
-
-    if (transport === 'wifi') {
-      if (!host) {
-        return res.status(400).json({ error: 'WiFi transport requires host parameter' });
-      }
-      await transportInstance.connect({ host, port });
-    } else {
-      await transportInstance.connect({ device });
-    }
-
-    await transportInstance.waitForReady(5000);
-
     // Try POST to /c with save-config SID (21007)
     // According to CORECONF, RPC is invoked with POST to /c with the RPC SID
     const { Encoder } = await import('cbor-x');
@@ -189,9 +142,10 @@ router.post('/save-config', async (req, res) => {
       payload: rpcPayload
     });
 
-    const response = await transportInstance._sendCoAPRequest(coapFrame, messageId);
-
-    await transportInstance.disconnect();
+    const response = await configEngine.withTransport(
+      { transport, device, host, port },
+      (transportInstance) => transportInstance._sendCoAPRequest(coapFrame, messageId)
+    );
 
     if (!response.isSuccess()) {
       return res.status(400).json({
@@ -220,8 +174,11 @@ router.get('/discover', async (req, res) => {
     port = 5683
   } = req.query;
 
+  if (transport === 'wifi' && !host) {
+    return res.status(400).json({ error: 'WiFi transport requires host parameter' });
+  }
+
   try {
-    const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
     const {
       buildMessage,
       MessageType,
@@ -229,19 +186,6 @@ router.get('/discover', async (req, res) => {
       OptionNumber
     } = await import(`${TSC2CBOR_LIB}/coap/coap.js`);
 
-    const transportInstance = createTransport(transport, { verbose: false });
-
-    if (transport === 'wifi') {
-      if (!host) {
-        return res.status(400).json({ error: 'WiFi transport requires host parameter' });
-      }
-      await transportInstance.connect({ host, port: parseInt(port) });
-    } else {
-      await transportInstance.connect({ device });
-    }
-
-    await transportInstance.waitForReady(5000);
-
     // GET /.well-known/core
     const messageId = Math.floor(Math.random() * 65536);
     const coapFrame = buildMessage({
@@ -255,8 +199,10 @@ router.get('/discover', async (req, res) => {
       ]
     });
 
-    const response = await transportInstance._sendCoAPRequest(coapFrame, messageId);
-    await transportInstance.disconnect();
+    const response = await configEngine.withTransport(
+      { transport, device, host, port },
+      (transportInstance) => transportInstance._sendCoAPRequest(coapFrame, messageId)
+    );
 
     if (!response.isSuccess()) {
       return res.status(400).json({
@@ -2,51 +2,20 @@
  * TAS (Time-Aware Shaper) API Routes
  *
  * IEEE 802.1Qbv Gate Control List configuration for LAN9662
+ * Device exchanges go through the shared config engine (lib/config-engine.js)
  */
 
 import express from 'express';
-import path from 'path';
-import { fileURLToPath } from 'url';
-import fs from 'fs';
 import yaml from 'js-yaml';
-
-const __dirname = path.dirname(fileURLToPath(import.meta.url));
-const TSC2CBOR_LIB = path.resolve(__dirname, '../../tsc2cbor/lib');
+import { configEngine } from '../lib/config-engine.js';
 
 const router = express.Router();
 
-// Default transport settings
-const DEFAULT_DEVICE = '/dev/ttyACM0';
-const DEFAULT_TRANSPORT = 'serial';
-
 /**
- * Find YANG cache directory
+ * Gate parameter table of a port
  */
-async function findYangCache() {
-  const { YangCatalogManager } = await import(`${TSC2CBOR_LIB}/yang-catalog/yang-catalog.js`);
-  const yangCatalog = new YangCatalogManager();
-  const catalogs = yangCatalog.listCachedCatalogs();
-  if (catalogs.length === 0) {
-    throw new Error('No YANG catalog found');
-  }
-  return catalogs[0].path;
-}
-
-/**
- * Create transport connection
- */
-async function createConnection(options = {}) {
-  const { createTransport } = await import(`${TSC2CBOR_LIB}/transport/index.js`);
-  const transportType = options.transport || DEFAULT_TRANSPORT;
-  const transport = createTransport(transportType, { verbose: false });
-
-  if (transportType === 'wifi') {
-    await transport.connect({ host: options.host, port: options.port || 5683 });
-  } else {
-    await transport.connect({ device: options.device || DEFAULT_DEVICE });
-  }
-  await transport.waitForReady(5000);
-  return transport;
+function buildTasPath(portNum) {
+  return `/ietf-interfaces:interfaces/interface[name='${portNum}']/ieee802-dot1q-bridge:bridge-port/ieee802-dot1q-sched-bridge:gate-parameter-table`;
 }
 
 /**
@@ -58,35 +27,12 @@ router.get('/status/:port', async (req, res) => {
   const { transport, device, host, port } = req.query;
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { loadYangInputs } = await import(`${TSC2CBOR_LIB}/common/input-loader.js`);
-    const { extractSidsFromInstanceIdentifier } = await import(`${TSC2CBOR_LIB}/encoder/transformer-instance-id.js`);
-    const { Cbor2TscConverter } = await import('../../tsc2cbor/cbor2tsc.js');
-
-    const { sidInfo } = await loadYangInputs(yangCacheDir, false);
-    const transportInstance = await createConnection({ transport, device, host, port });
+    const result = await configEngine.fetch([buildTasPath(portNum)], { transport, device, host, port });
 
-    // Query TAS gate-parameter-table
-    const queryPath = `/ietf-interfaces:interfaces/interface[name='${portNum}']/ieee802-dot1q-bridge:bridge-port/ieee802-dot1q-sched-bridge:gate-parameter-table`;
-    const queries = extractSidsFromInstanceIdentifier(
-      [{ [queryPath]: null }],
-      sidInfo,
-      { verbose: false }
-    );
-
-    const response = await transportInstance.sendiFetchRequest(queries);
-    await transportInstance.disconnect();
-
-    if (!response.isSuccess()) {
-      return res.status(500).json({ error: `CoAP code ${response.code}` });
+    if (!result.success) {
+      return res.status(500).json({ error: result.error });
     }
 
-    const decoder = new Cbor2TscConverter(yangCacheDir);
-    const result = await decoder.convertBuffer(response.payload, {
-      verbose: false,
-      outputFormat: 'rfc7951'
-    });
-
     // Parse YAML to JSON
     const tasData = yaml.load(result.yaml);
 
@@ -138,16 +84,8 @@ router.post('/configure/:port', async (req, res) => {
   }
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { Tsc2CborConverter } = await import('../../tsc2cbor/tsc2cbor.js');
-    const { Cbor2TscConverter } = await import('../../tsc2cbor/cbor2tsc.js');
-
-    const encoder = new Tsc2CborConverter(yangCacheDir);
-    const decoder = new Cbor2TscConverter(yangCacheDir);
-    const transportInstance = await createConnection({ transport, device, host, port });
-
     // Build TAS configuration
-    const tasPath = `/ietf-interfaces:interfaces/interface[name='${portNum}']/ieee802-dot1q-bridge:bridge-port/ieee802-dot1q-sched-bridge:gate-parameter-table`;
+    const tasPath = buildTasPath(portNum);
 
     // Calculate total interval and cycle time
     const totalInterval = entries.reduce((sum, e) => sum + e.interval, 0);
@@ -173,28 +111,11 @@ router.post('/configure/:port', async (req, res) => {
       }
     };
 
-    // Convert to YAML and encode
-    const configYaml = yaml.dump([tasConfig]);
-    const encodeResult = await encoder.convertString(configYaml, { verbose: false });
+    // GCL entries past one block go out block-wise
+    const result = await configEngine.patch([tasConfig], { transport, device, host, port });
 
-    // Send iPATCH
-    const response = await transportInstance.sendiPatchRequest(encodeResult.cbor);
-    await transportInstance.disconnect();
-
-    if (!response.isSuccess()) {
-      let errorDetail = `CoAP code ${response.code}`;
-      if (response.payload && response.payload.length > 0) {
-        try {
-          const errorResult = await decoder.convertBuffer(response.payload, {
-            verbose: false,
-            outputFormat: 'rfc7951'
-          });
-          errorDetail = errorResult.yaml;
-        } catch {
-          errorDetail = `Payload: ${response.payload.toString('hex')}`;
-        }
-      }
-      return res.status(500).json({ error: errorDetail });
+    if (!result.success) {
+      return res.status(500).json({ error: result.error });
     }
 
     res.json({
@@ -217,23 +138,11 @@ router.post('/enable/:port', async (req, res) => {
   const { enabled = true, transport, device, host, port } = req.body;
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { Tsc2CborConverter } = await import('../../tsc2cbor/tsc2cbor.js');
+    const config = { [buildTasPath(portNum)]: { 'gate-enabled': enabled } };
+    const result = await configEngine.patch([config], { transport, device, host, port });
 
-    const encoder = new Tsc2CborConverter(yangCacheDir);
-    const transportInstance = await createConnection({ transport, device, host, port });
-
-    const tasPath = `/ietf-interfaces:interfaces/interface[name='${portNum}']/ieee802-dot1q-bridge:bridge-port/ieee802-dot1q-sched-bridge:gate-parameter-table`;
-    const config = { [tasPath]: { 'gate-enabled': enabled } };
-
-    const configYaml = yaml.dump([config]);
-    const encodeResult = await encoder.convertString(configYaml, { verbose: false });
-
-    const response = await transportInstance.sendiPatchRequest(encodeResult.cbor);
-    await transportInstance.disconnect();
-
-    if (!response.isSuccess()) {
-      return res.status(500).json({ error: `CoAP code ${response.code}` });
+    if (!result.success) {
+      return res.status(500).json({ error: result.error });
     }
 
     res.json({ success: true, port: portNum, gateEnabled: enabled });
@@ -251,31 +160,17 @@ router.get('/ports', async (req, res) => {
   const results = {};
 
   try {
-    const yangCacheDir = await findYangCache();
-    const { loadYangInputs } = await import(`${TSC2CBOR_LIB}/common/input-loader.js`);
-    const { extractSidsFromInstanceIdentifier } = await import(`${TSC2CBOR_LIB}/encoder/transformer-instance-id.js`);
-    const { Cbor2TscConverter } = await import('../../tsc2cbor/cbor2tsc.js');
-
-    const { sidInfo } = await loadYangInputs(yangCacheDir, false);
-    const transportInstance = await createConnection({ transport, device, host, port });
-    const decoder = new Cbor2TscConverter(yangCacheDir);
+    // Both queries go out on the same open link
+    const link = { transport, device, host, port };
+    const fetches = ['1', '2'].map(portNum => configEngine.fetch([buildTasPath(portNum)], link));
+    const settled = await Promise.allSettled(fetches);
 
-    for (const portNum of ['1', '2']) {
+    for (const [i, portNum] of ['1', '2'].entries()) {
       try {
-        const queryPath = `/ietf-interfaces:interfaces/interface[name='${portNum}']/ieee802-dot1q-bridge:bridge-port/ieee802-dot1q-sched-bridge:gate-parameter-table`;
-        const queries = extractSidsFromInstanceIdentifier(
-          [{ [queryPath]: null }],
-          sidInfo,
-          { verbose: false }
-        );
-
-        const response = await transportInstance.sendiFetchRequest(queries);
+        if (settled[i].status === 'rejected') throw settled[i].reason;
+        const result = settled[i].value;
 
-        if (response.isSuccess()) {
-          const result = await decoder.convertBuffer(response.payload, {
-            verbose: false,
-            outputFormat: 'rfc7951'
-          });
+        if (result.success) {
           const tasData = yaml.load(result.yaml);
           const gpt = tasData?.['ieee802-dot1q-sched-bridge:gate-parameter-table'] || tasData;
 
@@ -293,7 +188,6 @@ router.get('/ports', async (req, res) => {
       }
     }
 
-    await transportInstance.disconnect();
     res.json(results);
   } catch (error) {
     res.status(500).json({ error: error.message });
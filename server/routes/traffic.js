@@ -3,13 +3,38 @@ import { spawn, execSync } from 'child_process';
 import path from 'path';
 import fs from 'fs';
 import { fileURLToPath } from 'url';
+import { TsnDaemonClient, commandArgs } from '../lib/tsn-daemon.js';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 const router = express.Router();
 
-// Active txgen process
+// Active txgen process, or a run on tsn-daemon
 let txgenProcess = null;
 let txgenStats = null;
+let daemonSending = false;
+
+// A running tsn-daemon replaces the spawned txgen (TX sockets stay open
+// between tests); txgen is only spawned when there is none
+const daemon = new TsnDaemonClient();
+daemon.on('send_stats', (stats) => {
+  if (daemonSending) txgenStats.sent = stats.total;
+});
+daemon.on('send_done', (result) => {
+  if (!daemonSending) return;
+  daemonSending = false;
+  txgenStats.sent = result.total;
+  txgenStats.errors = result.instrumentation?.tx?.errors || 0;
+  console.log(`[tsn-daemon] Sender done: ${result.total} pkts in ${result.duration} s`);
+});
+daemon.on('close', () => { daemonSending = false; });
+daemon.on('error', () => {});
+daemon.connect()
+  .then(() => console.log(`[traffic] Using tsn-daemon at ${daemon.socketPath}`))
+  .catch(() => {});
+
+// Daemon commands are single lines of key=value words
+const validIface = /^[A-Za-z0-9_.:@-]+$/;
+const validMac = /^([0-9A-Fa-f]{2}:){5}[0-9A-Fa-f]{2}$/;
 
 // Get interface MAC address
 function getInterfaceMac(ifaceName) {
@@ -96,6 +121,59 @@ router.post('/start-precision', (req, res) => {
   const tcListStr = tcArray.join(',');
   const multiTcSpec = `${tcListStr}:${vlanId}`;
 
+  if (daemon.connected) {
+    const dst = dstMac || 'ff:ff:ff:ff:ff:ff';
+    if (!validIface.test(ifaceName) || !validMac.test(dst) || !validMac.test(sourceMac)) {
+      return res.status(400).json({ error: 'Invalid interface or MAC address' });
+    }
+    // txgen's rate is packetsPerSecond frames of frameSize over all TCs, as
+    // is the daemon's pps; its frames carry the sequence and TX timestamp
+    const args = commandArgs({
+      iface: ifaceName,
+      dst,
+      src: sourceMac,
+      vlan: parseInt(vlanId) || 100,
+      tcs: tcArray.map(tc => parseInt(tc) || 0),
+      pps: parseInt(packetsPerSecond) || 1000,
+      duration: parseInt(duration) || 10,
+      size: parseInt(frameSize) || 1000
+    });
+    daemon.command('send stop').catch(() => {});
+    daemon.command(`send start ${args}`)
+      .then(() => {
+        txgenStats = {
+          startTime: Date.now(),
+          interface: ifaceName,
+          tcList: tcArray,
+          vlanId,
+          pps: packetsPerSecond,
+          rateMbps: totalRateMbps,
+          duration,
+          frameSize,
+          sent: 0,
+          errors: 0
+        };
+        daemonSending = true;
+        res.json({
+          success: true,
+          message: 'Traffic generator started (tsn-daemon)',
+          config: {
+            interface: ifaceName,
+            dstMac: dst,
+            srcMac: sourceMac,
+            vlanId,
+            tcList: tcArray,
+            packetsPerSecond,
+            rateMbps: totalRateMbps,
+            duration,
+            frameSize
+          }
+        });
+      })
+      .catch((err) => res.status(500).json({ error: err.message }));
+    return;
+  }
+
   const txgenPath = path.join(__dirname, '..', 'txgen');
 
   const args = [
@@ -191,7 +269,12 @@ router.post('/start-precision', (req, res) => {
 });
 
 // Stop txgen
-router.post('/stop-precision', (req, res) => {
+router.post('/stop-precision', async (req, res) => {
+  if (daemonSending) {
+    // Replies once the run's send_done is in
+    await daemon.command('send stop').catch(() => {});
+    return res.json({ success: true, message: 'tsn-daemon sender stopped', stats: txgenStats });
+  }
   if (txgenProcess) {
     try {
       txgenProcess.kill('SIGTERM');
@@ -236,8 +319,25 @@ router.post('/start', (req, res) => {
   return router.handle(req, res, () => {});
 });
 
+// Change the rate of a running sender in place: only tsn-daemon can, txgen
+// takes its rate at start
+router.post('/rate', (req, res) => {
+  const pps = parseInt(req.body?.packetsPerSecond);
+  if (!(pps > 0)) return res.status(400).json({ error: 'packetsPerSecond required' });
+  if (!daemonSending) return res.status(409).json({ error: 'No tsn-daemon sender running' });
+
+  daemon.command(`send rate ${commandArgs({ pps })}`)
+    .then((reply) => {
+      txgenStats.pps = pps;
+      txgenStats.rateMbps = Math.ceil((pps * txgenStats.frameSize * 8) / 1000000);
+      res.json({ success: true, pps: reply.pps, workers: reply.workers });
+    })
+    .catch((err) => res.status(500).json({ error: err.message }));
+});
+
 router.post('/stop', (req, res) => {
   // Stop all traffic
+  if (daemonSending) daemon.command('send stop').catch(() => {});
   if (txgenProcess) {
     try {
       txgenProcess.kill('SIGTERM');
@@ -250,16 +350,71 @@ router.post('/stop', (req, res) => {
 
 // Get status
 router.get('/status', (req, res) => {
+  const running = !!txgenProcess || daemonSending;
   res.json({
-    active: txgenProcess ? 1 : 0,
-    generators: txgenProcess ? [{
-      type: 'txgen',
+    active: running ? 1 : 0,
+    generators: running ? [{
+      type: daemonSending ? 'tsn-daemon' : 'txgen',
       running: true,
       stats: txgenStats
     }] : []
   });
 });
 
+// Port reachability sweep: every port (or the listed pairs) probed at once by
+// quick-test --sweep; returns its TX x RX links with latency in well under a
+// second, cheap enough to run before every long test
+router.post('/port-sweep', (req, res) => {
+  const { interfaces, pairs, count = 5, timeoutMs = 100 } = req.body || {};
+  const ifaceName = /^[A-Za-z0-9_.:@-]+$/;
+
+  const args = ['--sweep', '--json', '--count', String(parseInt(count) || 5),
+    '--timeout-ms', String(parseInt(timeoutMs) || 100)];
+  if (Array.isArray(interfaces) && interfaces.length > 0) {
+    if (!interfaces.every(i => ifaceName.test(i))) {
+      return res.status(400).json({ error: 'Invalid interface name' });
+    }
+    args.push('--ifaces', interfaces.join(','));
+  }
+  if (Array.isArray(pairs)) {
+    for (const { tx, rx } of pairs) {
+      if (!ifaceName.test(tx || '') || !ifaceName.test(rx || '')) {
+        return res.status(400).json({ error: 'Invalid pair, expected { tx, rx }' });
+      }
+      args.push('--pair', `${tx}:${rx}`);
+    }
+  }
+
+  const quickTestPath = path.join(__dirname, '..', 'quick-test');
+  const proc = spawn('sudo', ['-S', quickTestPath, ...args], {
+    stdio: ['pipe', 'pipe', 'pipe']
+  });
+  proc.stdin.write('1\n');
+  proc.stdin.end();
+
+  let stdout = '';
+  let stderr = '';
+  const timer = setTimeout(() => proc.kill('SIGTERM'), 10000);
+  proc.stdout.on('data', (data) => { stdout += data.toString(); });
+  proc.stderr.on('data', (data) => { stderr += data.toString(); });
+
+  proc.on('error', (err) => {
+    clearTimeout(timer);
+    if (!res.headersSent) res.status(500).json({ error: err.message });
+  });
+  proc.on('close', (code) => {
+    clearTimeout(timer);
+    if (res.headersSent) return;
+    try {
+      // Exit code 1 only means some links are down; the JSON says which
+      const result = JSON.parse(stdout.trim().split('\n').pop());
+      res.json({ success: code === 0, ...result });
+    } catch (e) {
+      res.status(500).json({ error: stderr.trim() || `quick-test exited with code ${code}` });
+    }
+  });
+});
+
 // Send single packet (for testing)
 router.post('/send', (req, res) => {
   const {
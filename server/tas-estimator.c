@@ -14,9 +14,41 @@
  *   4. Map traffic presence to gate open windows
  *   5. Generate GCL from detected windows
  *
- * Compile: gcc -O2 -o tas-estimator tas-estimator.c -lpcap -lpthread -lm -lfftw3
- *          (or without FFTW: gcc -O2 -o tas-estimator tas-estimator.c -lpcap -lpthread -lm -DNO_FFTW)
- * Run: sudo ./tas-estimator <interface> <duration> <vlan_id> [expected_cycle_ms]
+ * With --interval-ms N the current estimate is also printed every N ms as
+ * one JSON line ("type": "tas_update") while capturing. --shm NAME publishes
+ * the cycle and each TC's first window to /dev/shm/NAME (tsn-shm), every
+ * --interval-ms or 100 ms.
+ *
+ * With --read FILE a pcap / pcapng capture (tcpdump, hardware tap) is analyzed
+ * instead, split by PCP over --rx-workers threads (default: all CPUs, max 8).
+ *
+ * Phase origin: window offsets of every TC are on one time axis, by default
+ * the first packet of the capture. With --base-time NS they are relative to
+ * the configured GCL base-time instead, given in the --clock time base
+ * (tsn-clock.h; default TSN_CLOCK or tai, phc:IFACE for the gPTP time of a
+ * ptp4l port). The RX timestamps (software: CLOCK_REALTIME, hardware: the RX
+ * NIC's PHC) are carried into that time base with the clock offset measured
+ * at the start and end of the capture, so a window start of 0 means the gate
+ * opens at base-time + k * cycle. File timestamps are taken to be in the
+ * time base already.
+ *
+ * Conformance check: with --gcl "MASK:NS,..." (the entries pushed through
+ * routes/tas.js; cycle = their sum or expected_cycle_ms) nothing is estimated.
+ * The configured list is compiled into a per-TC gate table (tsn-gcl.h) and
+ * every frame is classified as it arrives: in its window, in the guard band
+ * (closed, but within --guard-ns of an edge; default a 1522-byte frame at
+ * 1 Gb/s) or a violation, with the early / late offset. --interval-ms streams
+ * the counts as "type": "gcl_check" lines. The phase is taken from
+ * --base-time (default 0: cycles counted from the time base epoch).
+ *
+ * Every result and live line carries an "instrumentation" object (tsn-instr.h):
+ * kernel ring drops, per-frame capture cost and the cost of the analysis. A
+ * window estimate from a capture that dropped frames is suspect.
+ *
+ * Compile: make tas-estimator (links libtsntest.a)
+ * Run: sudo ./tas-estimator [--interval-ms N] [--shm NAME] [--base-time NS] [--clock NAME] <interface> <duration> <vlan_id> [expected_cycle_ms]
+ *      sudo ./tas-estimator --gcl SPEC [--guard-ns NS] [--base-time NS] [--clock NAME] <interface> <duration> <vlan_id>
+ *      ./tas-estimator --read FILE [--rx-workers N] [vlan_id] [expected_cycle_ms]
  */
 
 #define _GNU_SOURCE
@@ -28,22 +60,19 @@
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
-#include <math.h>
-#include <sys/mman.h>
-#include <pcap/pcap.h>
-#include <pthread.h>
 
-#define MAX_TC 8
-#define MAX_PACKETS 200000
-#define MAX_GCL_ENTRIES 64
-#define HISTOGRAM_BINS 2000
-#define TIME_BIN_US 100  // 100 microsecond bins
+#include "tsn-common.h"
+#include "tsn-capture.h"
+#include "tsn-analysis.h"
+#include "tsn-cycle.h"
+#include "tsn-shm.h"
+#include "tsn-simd.h"
+#include "tsn-clock.h"
+#include "tsn-gcl.h"
 
-// Packet record
-typedef struct {
-    uint64_t ts_ns;
-    uint16_t len;
-} packet_t;
+#define MAX_TC TSN_MAX_TC
+#define MAX_GCL_ENTRIES 64
+#define HISTOGRAM_BINS 2000  // upper bound; bins never go below timestamp resolution
 
 // GCL entry
 typedef struct {
@@ -51,31 +80,24 @@ typedef struct {
     uint32_t time_ns;      // Duration of this entry
 } gcl_entry_t;
 
-// Gate window (detected open period)
-typedef struct {
-    uint64_t start_offset_ns;  // Offset from cycle start
-    uint64_t duration_ns;      // Duration of open window
-    int tc;
-} gate_window_t;
-
 // Per-TC data
 typedef struct {
-    packet_t packets[MAX_PACKETS];
-    int packet_count;
-    uint64_t first_ts;
-    uint64_t last_ts;
-
-    // Time histogram (packets per time bin within cycle)
-    int histogram[HISTOGRAM_BINS];
-    int histogram_size;
+    tsn_stream_t stream;
 
-    // Detected windows
-    gate_window_t windows[16];
+    // Detected gate open windows (offset from cycle start)
+    tsn_window_t windows[16];
     int window_count;
 
     // Statistics
     double avg_interval_us;
     double stddev_interval_us;
+
+    // --gcl: frames per class, distance of guard / violation frames from
+    // their window
+    uint64_t check[TSN_GCL_CLASSES];
+    int64_t early_max_ns;
+    int64_t late_max_ns;
+    tsn_hist_t miss_hist;
 } tc_data_t;
 
 // Global state
@@ -83,224 +105,204 @@ static volatile int running = 1;
 static tc_data_t tc_data[MAX_TC];
 static int target_vlan = 100;
 static double expected_cycle_ms = 0;  // 0 = auto-detect
-static pcap_t *handle = NULL;
-static pthread_mutex_t data_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Cycle search range
+#define MIN_CYCLE_NS 100000ULL     // 100 us
+#define MAX_CYCLE_NS 500000000ULL  // 500 ms
+static tsn_capture_t *cap = NULL;
+static uint32_t ts_resolution_ns = 1000;
+static const char *ts_source = "software";
 
 // Estimated TAS parameters
 static uint64_t estimated_cycle_ns = 0;
+static double cycle_confidence = 0;
 static gcl_entry_t estimated_gcl[MAX_GCL_ENTRIES];
 static int estimated_gcl_size = 0;
 
-static uint64_t get_time_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
-}
+// Live estimate: the cycle search reruns each time the arrival sample has
+// grown by half, so all searches together cost about two final ones. A cycle
+// found twice in a row gets a running phase histogram and is not searched again
+#define LOCK_CONFIDENCE 0.2
+static uint64_t update_interval_ms = 0;  // 0 = final result only
+static uint64_t live_cycle_ns = 0;
+static uint64_t live_sampled = 0;  // sampled arrivals at the last search
+static bool live_locked = false;
+
+// Time base and phase origin
+static const char *clock_name = NULL;  // NULL = TSN_CLOCK or tai
+static tsn_clock_t time_base;
+static uint64_t base_time_ns = 0;      // GCL base-time in time_base, 0 = none
+static int64_t rx_offset_ns = 0;       // time_base - RX timestamp clock
+static uint64_t rx_offset_err_ns = 0;
+static int64_t rx_offset_drift_ns = 0; // change of the offset over the capture
+
+static const char *read_file = NULL;  // offline analysis
+static int rx_workers = 0;            // file workers, 0 = one per CPU
+static tsn_capture_group_t *file_group = NULL;
+static const char *shm_name = NULL;
+static tsn_shm_stats_t *shm = NULL;
+
+// Conformance check against the configured GCL
+#define DEFAULT_GUARD_NS 12304  // 1522 bytes + preamble / IFG at 1 Gb/s
+static const char *gcl_spec = NULL;
+static uint64_t guard_ns = DEFAULT_GUARD_NS;
+static tsn_gcl_t *gcl = NULL;
+
+// Shared-memory updates when no --interval-ms is given
+#define SHM_INTERVAL_MS 100
+
+// Kernel filter on the VLAN (tsn_capture_set_match), else the pcap expression
+// and the generic parser
+static tsn_capture_match_t vlan_match;
+static tsn_capture_handler_t handler;
+
+// Capture counters, refreshed while the capture is open, and the cost of
+// the cycle search / window detection (tsn-instr.h)
+static tsn_instr_t capture_instr;
+static tsn_stage_t analysis_stage;
 
 static void signal_handler(int sig) {
     (void)sig;
     running = 0;
-    if (handle) pcap_breakloop(handle);
+    if (cap) tsn_capture_breakloop(cap);
+    if (file_group) tsn_capture_group_breakloop(file_group);
 }
 
-// Packet handler
-static void packet_handler(u_char *user, const struct pcap_pkthdr *hdr, const u_char *pkt) {
-    (void)user;
-    if (hdr->caplen < 18) return;
-
-    uint16_t ethertype = (pkt[12] << 8) | pkt[13];
-    if (ethertype != 0x8100) return;
-
-    uint16_t tci = (pkt[14] << 8) | pkt[15];
-    int pcp = (tci >> 13) & 0x07;
-    int vid = tci & 0x0FFF;
-
-    if (target_vlan > 0 && vid != target_vlan) return;
+// Packet handlers
+// Capture and analysis run on the same thread, so the hot path takes no lock;
+// a file is split by PCP, so each TC still has a single writer
+static inline void account(int pcp, const tsn_packet_t *hdr) {
+    tc_data_t *tc = &tc_data[pcp];
+    tsn_stream_add(&tc->stream, hdr->ts_ns, hdr->len);
+    if (!gcl) return;
+
+    int64_t off;
+    tsn_gcl_class_t c = tsn_gcl_classify(gcl, pcp, hdr->ts_ns, &off);
+    tc->check[c]++;
+    if (c == TSN_GCL_IN_WINDOW) return;
+    if (off < tc->early_max_ns) tc->early_max_ns = off;
+    if (off > tc->late_max_ns) tc->late_max_ns = off;
+    tsn_hist_add(&tc->miss_hist, (uint64_t)(off < 0 ? -off : off));
+}
 
-    uint64_t ts_ns = (uint64_t)hdr->ts.tv_sec * 1000000000ULL +
-                     (uint64_t)hdr->ts.tv_usec * 1000ULL;
+static void packet_handler(void *user, const tsn_packet_t *hdr) {
+    (void)user;
 
-    pthread_mutex_lock(&data_mutex);
+    tsn_vlan_t vlan;
+    if (tsn_parse_vlan(hdr->data, hdr->caplen, &vlan) < 0) return;
+    if (target_vlan > 0 && vlan.vid != target_vlan) return;
+    account(vlan.pcp, hdr);
+}
 
-    tc_data_t *tc = &tc_data[pcp];
-    if (tc->packet_count < MAX_PACKETS) {
-        packet_t *p = &tc->packets[tc->packet_count];
-        p->ts_ns = ts_ns;
-        p->len = hdr->len;
-        tc->packet_count++;
+// Behind the generated kernel filter every frame carries the VLAN in-band
+static void packet_handler_matched(void *user, const tsn_packet_t *hdr) {
+    (void)user;
+    account(hdr->data[14] >> 5, hdr);
+}
 
-        if (tc->first_ts == 0) tc->first_ts = ts_ns;
-        tc->last_ts = ts_ns;
+// The cycle search folds a sample of the first arrivals; a known cycle also
+// gets a running phase histogram over the whole capture. Bins are
+// cycle/HISTOGRAM_BINS wide but never narrower than the timestamp resolution,
+// otherwise microsecond stamps would leave every other bin empty
+static int init_stream(tc_data_t *tc) {
+    tsn_stream_init(&tc->stream, 0, 1000000000ULL);  // ignore huge gaps (> 1 sec)
+    tsn_hist_init(&tc->miss_hist);
+    if (gcl) return 0;  // nothing to search
+    if (tsn_stream_keep_arrivals(&tc->stream, TSN_CYCLE_SAMPLES) < 0) return -1;
+    if (expected_cycle_ms > 0) {
+        return tsn_stream_add_phase(&tc->stream, (uint64_t)(expected_cycle_ms * 1e6),
+                                    HISTOGRAM_BINS, ts_resolution_ns);
     }
-
-    pthread_mutex_unlock(&data_mutex);
+    return 0;
 }
 
 // Calculate interval statistics
 static void calc_interval_stats(tc_data_t *tc) {
-    if (tc->packet_count < 3) return;
-
-    double sum = 0;
-    double sum_sq = 0;
-    int count = 0;
-
-    for (int i = 1; i < tc->packet_count; i++) {
-        double interval = (tc->packets[i].ts_ns - tc->packets[i-1].ts_ns) / 1000.0;
-        if (interval < 1000000) {  // Ignore huge gaps (> 1 sec)
-            sum += interval;
-            sum_sq += interval * interval;
-            count++;
-        }
-    }
-
-    if (count > 0) {
-        tc->avg_interval_us = sum / count;
-        double variance = (sum_sq / count) - (tc->avg_interval_us * tc->avg_interval_us);
-        tc->stddev_interval_us = variance > 0 ? sqrt(variance) : 0;
-    }
+    if (tc->stream.count < 3) return;
+    tsn_interval_stats(&tc->stream, &tc->avg_interval_us, &tc->stddev_interval_us);
 }
 
-// Detect cycle time using autocorrelation of packet intervals
+// Detect cycle time from the arrivals of all TCs, with its confidence
 static uint64_t detect_cycle_time(void) {
-    // Try common TAS cycle times: 100us to 500ms
-    uint64_t candidate_cycles[] = {
-        100000,      // 100 us
-        500000,      // 500 us
-        1000000,     // 1 ms
-        2000000,     // 2 ms
-        5000000,     // 5 ms
-        10000000,    // 10 ms
-        20000000,    // 20 ms
-        50000000,    // 50 ms
-        100000000,   // 100 ms
-        200000000,   // 200 ms
-        500000000,   // 500 ms
-    };
-    int n_candidates = sizeof(candidate_cycles) / sizeof(candidate_cycles[0]);
-
-    double best_score = 0;
-    uint64_t best_cycle = 0;
-
-    // Test each candidate cycle time
-    for (int c = 0; c < n_candidates; c++) {
-        uint64_t cycle = candidate_cycles[c];
-        double total_score = 0;
-        int tc_count = 0;
-
-        // For each TC with data
-        for (int t = 0; t < MAX_TC; t++) {
-            tc_data_t *tc = &tc_data[t];
-            if (tc->packet_count < 100) continue;
-
-            tc_count++;
-
-            // Build histogram of packet positions within cycle
-            int bins[100] = {0};
-            int n_bins = 100;
-            uint64_t bin_size = cycle / n_bins;
-
-            for (int i = 0; i < tc->packet_count; i++) {
-                uint64_t offset = (tc->packets[i].ts_ns - tc->first_ts) % cycle;
-                int bin = (offset / bin_size) % n_bins;
-                bins[bin]++;
-            }
-
-            // Calculate variance of histogram (higher = more periodic)
-            double mean = (double)tc->packet_count / n_bins;
-            double variance = 0;
-            for (int b = 0; b < n_bins; b++) {
-                double diff = bins[b] - mean;
-                variance += diff * diff;
-            }
-            variance /= n_bins;
-
-            // Normalize by mean squared
-            double score = variance / (mean * mean + 0.001);
-            total_score += score;
-        }
-
-        if (tc_count > 0) {
-            total_score /= tc_count;
-            if (total_score > best_score) {
-                best_score = total_score;
-                best_cycle = cycle;
-            }
-        }
-    }
+    tsn_stream_t streams[MAX_TC];
+    for (int t = 0; t < MAX_TC; t++) streams[t] = tc_data[t].stream;
 
     // If expected cycle provided, use it
     if (expected_cycle_ms > 0) {
-        best_cycle = (uint64_t)(expected_cycle_ms * 1e6);
+        uint64_t cycle_ns = (uint64_t)(expected_cycle_ms * 1e6);
+        cycle_confidence = tsn_cycle_confidence(streams, MAX_TC, cycle_ns, 100);
+        return cycle_ns;
     }
 
-    return best_cycle;
+    tsn_cycle_t c;
+    if (tsn_cycle_search(streams, MAX_TC, MIN_CYCLE_NS, MAX_CYCLE_NS, 100,
+                         ts_resolution_ns, &c) < 0) return 0;
+    cycle_confidence = c.confidence;
+    return c.cycle_ns;
 }
 
-// Build histogram for a TC with detected cycle time
-static void build_histogram(tc_data_t *tc, uint64_t cycle_ns) {
-    if (tc->packet_count < 10 || cycle_ns == 0) return;
-
-    int n_bins = HISTOGRAM_BINS;
-    uint64_t bin_size = cycle_ns / n_bins;
-    if (bin_size == 0) bin_size = 1;
-
-    memset(tc->histogram, 0, sizeof(tc->histogram));
-    tc->histogram_size = n_bins < HISTOGRAM_BINS ? n_bins : HISTOGRAM_BINS;
+// Phase origin in the RX timestamp domain: the base-time carried over from
+// the time base, else the earliest first packet of all TCs
+static uint64_t phase_origin_ns(void) {
+    if (base_time_ns) return (uint64_t)((int64_t)base_time_ns - rx_offset_ns);
+    uint64_t origin = UINT64_MAX;
+    for (int t = 0; t < MAX_TC; t++) {
+        if (tc_data[t].stream.count > 0 && tc_data[t].stream.first_ts < origin) origin = tc_data[t].stream.first_ts;
+    }
+    return origin == UINT64_MAX ? 0 : origin;
+}
 
-    for (int i = 0; i < tc->packet_count; i++) {
-        uint64_t offset = (tc->packets[i].ts_ns - tc->first_ts) % cycle_ns;
-        int bin = (offset / bin_size) % tc->histogram_size;
-        tc->histogram[bin]++;
+// Phase histograms start at the stream's first packet: move the windows onto
+// the common origin and keep them in start order
+static void align_windows(tc_data_t *tc, uint64_t cycle_ns) {
+    uint64_t origin = phase_origin_ns(), first = tc->stream.first_ts;
+    uint64_t shift = first >= origin ? (first - origin) % cycle_ns
+                                     : (cycle_ns - (origin - first) % cycle_ns) % cycle_ns;
+    for (int w = 0; w < tc->window_count; w++) {
+        tsn_window_t win = tc->windows[w];
+        win.start_offset_ns = (win.start_offset_ns + shift) % cycle_ns;
+        int i = w;
+        for (; i > 0 && tc->windows[i - 1].start_offset_ns > win.start_offset_ns; i--) {
+            tc->windows[i] = tc->windows[i - 1];
+        }
+        tc->windows[i] = win;
     }
 }
 
-// Detect gate windows from histogram
-static void detect_windows(tc_data_t *tc, uint64_t cycle_ns, int tc_idx) {
-    if (tc->histogram_size == 0 || tc->packet_count < 10) return;
+// Detect gate windows from the phase histogram of the cycle: the running one
+// for an expected or locked cycle, the folded arrival sample otherwise
+static void detect_windows(tc_data_t *tc, uint64_t cycle_ns) {
+    if (tc->stream.count < 10) return;
+
+    static uint32_t folded[HISTOGRAM_BINS];
+    const uint32_t *bins;
+    uint32_t n_bins;
+    uint64_t count;
+
+    const tsn_phase_hist_t *hist = tsn_stream_phase(&tc->stream, cycle_ns);
+    if (hist) {
+        bins = hist->bins;
+        n_bins = hist->n_bins;
+        count = hist->count;
+    } else {
+        n_bins = HISTOGRAM_BINS;
+        if (ts_resolution_ns > 0 && cycle_ns / n_bins < ts_resolution_ns) {
+            n_bins = cycle_ns / ts_resolution_ns;
+        }
+        if (n_bins == 0) return;
+        tsn_cycle_fold(&tc->stream, (double)cycle_ns, n_bins, folded);
+        bins = folded;
+        count = tc->stream.n_arrivals;
+    }
 
     // Find threshold (packets present vs absent)
-    double mean = (double)tc->packet_count * 2.0 / tc->histogram_size;
-    int threshold = (int)(mean * 0.3);  // 30% of mean
+    double mean = (double)count * 2.0 / n_bins;
+    uint32_t threshold = (uint32_t)(mean * 0.3);  // 30% of mean
     if (threshold < 1) threshold = 1;
 
-    uint64_t bin_size = cycle_ns / tc->histogram_size;
-
-    // Scan for windows
-    tc->window_count = 0;
-    bool in_window = false;
-    int window_start = 0;
-
-    for (int i = 0; i <= tc->histogram_size; i++) {
-        int bin_val = (i < tc->histogram_size) ? tc->histogram[i] : 0;
-        bool has_traffic = bin_val >= threshold;
-
-        if (has_traffic && !in_window) {
-            // Window starts
-            in_window = true;
-            window_start = i;
-        } else if (!has_traffic && in_window) {
-            // Window ends
-            in_window = false;
-            if (tc->window_count < 16) {
-                gate_window_t *w = &tc->windows[tc->window_count];
-                w->tc = tc_idx;
-                w->start_offset_ns = (uint64_t)window_start * bin_size;
-                w->duration_ns = (uint64_t)(i - window_start) * bin_size;
-                tc->window_count++;
-            }
-        }
-    }
-
-    // Handle wrap-around (window that spans cycle boundary)
-    if (in_window && tc->window_count > 0 && tc->histogram[0] >= threshold) {
-        // Merge with first window
-        gate_window_t *last = &tc->windows[tc->window_count - 1];
-        gate_window_t *first = &tc->windows[0];
-        first->start_offset_ns = last->start_offset_ns;
-        first->duration_ns = last->duration_ns + first->duration_ns;
-        if (first->duration_ns > cycle_ns) first->duration_ns = cycle_ns;
-        tc->window_count--;
-    }
+    tc->window_count = tsn_detect_windows(bins, n_bins, threshold,
+                                          cycle_ns, tc->windows, 16);
+    align_windows(tc, cycle_ns);
 }
 
 // Merge windows into GCL
@@ -318,7 +320,7 @@ static void build_gcl(uint64_t cycle_ns) {
     for (int t = 0; t < MAX_TC; t++) {
         tc_data_t *tc = &tc_data[t];
         for (int w = 0; w < tc->window_count; w++) {
-            gate_window_t *win = &tc->windows[w];
+            tsn_window_t *win = &tc->windows[w];
             events[n_events].time = win->start_offset_ns;
             events[n_events].tc = t;
             events[n_events].is_start = true;
@@ -349,7 +351,7 @@ static void build_gcl(uint64_t cycle_ns) {
     for (int t = 0; t < MAX_TC; t++) {
         tc_data_t *tc = &tc_data[t];
         for (int w = 0; w < tc->window_count; w++) {
-            gate_window_t *win = &tc->windows[w];
+            tsn_window_t *win = &tc->windows[w];
             if (win->start_offset_ns == 0 ||
                 (win->start_offset_ns + win->duration_ns > cycle_ns)) {
                 current_gates |= (1 << t);
@@ -408,6 +410,224 @@ static void build_gcl(uint64_t cycle_ns) {
     estimated_gcl_size = merged;
 }
 
+// Refresh live_cycle_ns and cycle_confidence from the data so far
+static void update_live_cycle(void) {
+    if (expected_cycle_ms > 0 || live_locked) {
+        tsn_stream_t streams[MAX_TC];
+        for (int t = 0; t < MAX_TC; t++) streams[t] = tc_data[t].stream;
+        if (!live_cycle_ns) live_cycle_ns = (uint64_t)(expected_cycle_ms * 1e6);
+        cycle_confidence = tsn_cycle_confidence(streams, MAX_TC, live_cycle_ns, 100);
+        return;
+    }
+
+    uint64_t sampled = 0;
+    for (int t = 0; t < MAX_TC; t++) sampled += tc_data[t].stream.n_arrivals;
+    if (sampled < 100 || sampled * 2 < live_sampled * 3) return;
+    live_sampled = sampled;
+
+    uint64_t prev = live_cycle_ns;
+    uint64_t cycle_ns = detect_cycle_time();
+    if (cycle_ns == 0) return;
+    live_cycle_ns = cycle_ns;
+
+    // Same cycle within a histogram bin: keep per-packet phase from now on
+    uint64_t diff = cycle_ns > prev ? cycle_ns - prev : prev - cycle_ns;
+    if (prev == 0 || diff * HISTOGRAM_BINS > cycle_ns || cycle_confidence < LOCK_CONFIDENCE) return;
+    for (int t = 0; t < MAX_TC; t++) {
+        tsn_stream_add_phase(&tc_data[t].stream, cycle_ns, HISTOGRAM_BINS, ts_resolution_ns);
+    }
+    live_locked = true;
+}
+
+// Live cycle, windows and GCL from the data so far
+static void update_estimate(void) {
+    update_live_cycle();
+
+    estimated_gcl_size = 0;
+    if (live_cycle_ns > 0) {
+        for (int t = 0; t < MAX_TC; t++) detect_windows(&tc_data[t], live_cycle_ns);
+        build_gcl(live_cycle_ns);
+    }
+}
+
+static void instr_refresh(void) {
+    if (!cap && !file_group) return;
+    memset(&capture_instr, 0, sizeof(capture_instr));
+    if (cap) tsn_capture_instr(cap, &capture_instr);
+    else tsn_capture_group_instr(file_group, &capture_instr);
+}
+
+static void instr_get(tsn_instr_t *in) {
+    *in = capture_instr;
+    tsn_stage_merge(&in->stage[TSN_STAGE_ANALYSIS], &analysis_stage);
+}
+
+// Close the analysis stage opened at t0 (cycle search, windows, GCL) over
+// every frame so far
+static void analysis_done(uint64_t t0) {
+    uint64_t frames = 0;
+    for (int t = 0; t < MAX_TC; t++) frames += tc_data[t].stream.count;
+    tsn_stage_add(&analysis_stage, t0, tsn_instr_ticks(), frames);
+}
+
+// Estimate for cycle_ns (0 = none yet) into the shared-memory block
+static void publish_shm(uint64_t elapsed_ns, uint64_t cycle_ns) {
+    tsn_shm_begin(shm);
+    uint64_t total = 0;
+    for (int t = 0; t < MAX_TC; t++) {
+        tc_data_t *tc = &tc_data[t];
+        total += tc->stream.count;
+        if (tc->stream.count == 0) continue;
+
+        tsn_shm_tc_t *s = &shm->tc[t];
+        tsn_shm_put_stream(s, &tc->stream);
+        if (gcl) {
+            const tsn_gcl_tc_t *g = &gcl->tc[t];
+            s->window_start_us = g->n_windows ? g->windows[0].start_ns / 1000.0 : 0;
+            s->window_us = g->n_windows ? (g->windows[0].end_ns - g->windows[0].start_ns) / 1000.0 : 0;
+            continue;
+        }
+        bool window = cycle_ns > 0 && tc->window_count > 0;
+        s->window_start_us = window ? tc->windows[0].start_offset_ns / 1000.0 : 0;
+        s->window_us = window ? tc->windows[0].duration_ns / 1000.0 : 0;
+    }
+    shm->elapsed_ms = elapsed_ns / 1e6;
+    shm->total = total;
+    shm->cycle_us = cycle_ns / 1000.0;
+    shm->cycle_confidence = gcl ? 1.0 : cycle_ns > 0 ? cycle_confidence : 0;  // configured
+    tsn_instr_t in;
+    instr_get(&in);
+    tsn_shm_put_instr(shm, &in);
+    tsn_shm_end(shm);
+}
+
+// One-line JSON with the estimate so far (update_estimate() first)
+static void print_update_json(uint64_t elapsed_ns) {
+    uint64_t total = 0;
+    for (int t = 0; t < MAX_TC; t++) total += tc_data[t].stream.count;
+
+    printf("{\"type\":\"tas_update\",\"elapsed_ms\":%.1f,\"total\":%lu,"
+           "\"estimated_cycle_ns\":%lu,\"cycle_confidence\":%.3f,\"cycle_locked\":%s,"
+           "\"phase_origin\":\"%s\",\"tc\":{",
+           elapsed_ns / 1e6, total, live_cycle_ns, cycle_confidence,
+           live_locked || expected_cycle_ms > 0 ? "true" : "false",
+           base_time_ns ? "base_time" : "first_packet");
+
+    int first = 1;
+    for (int t = 0; t < MAX_TC; t++) {
+        tc_data_t *tc = &tc_data[t];
+        if (tc->stream.count < 10) continue;
+
+        if (!first) printf(",");
+        first = 0;
+
+        printf("\"%d\":{\"packets\":%lu,\"windows\":[", t, tc->stream.count);
+        for (int w = 0; live_cycle_ns > 0 && w < tc->window_count; w++) {
+            printf("%s{\"start_us\":%.3f,\"duration_us\":%.3f}", w ? "," : "",
+                   tc->windows[w].start_offset_ns / 1000.0, tc->windows[w].duration_ns / 1000.0);
+        }
+        printf("]}");
+    }
+
+    printf("},\"gcl\":[");
+    for (int i = 0; i < estimated_gcl_size; i++) {
+        printf("%s{\"gate_value\":%d,\"time_ns\":%u}", i ? "," : "",
+               estimated_gcl[i].gate_states, estimated_gcl[i].time_ns);
+    }
+    tsn_instr_t in;
+    instr_get(&in);
+    printf("],");
+    tsn_instr_print_json(stdout, &in);
+    printf("}\n");
+    fflush(stdout);
+}
+
+// One-line JSON with the conformance counts so far, or the final report
+static void print_check_json(uint64_t elapsed_ns, bool final) {
+    uint64_t total = 0;
+    for (int t = 0; t < MAX_TC; t++) total += tc_data[t].stream.count;
+
+    printf("{\"type\":\"gcl_check\",%s\"elapsed_ms\":%.1f,\"total\":%lu,"
+           "\"cycle_ns\":%lu,\"guard_ns\":%lu,\"base_time_ns\":%lu",
+           final ? "\"final\":true," : "", elapsed_ns / 1e6, total,
+           gcl->cycle_ns, gcl->guard_ns, base_time_ns);
+    if (final) {
+        printf(",\"vlan\":%d,\"timestamp_source\":\"%s\",\"timestamp_resolution_ns\":%u,"
+               "\"time_base\":{\"clock\":\"%s\",\"rx_offset_ns\":%ld,\"rx_offset_err_ns\":%lu,"
+               "\"rx_offset_drift_ns\":%ld}",
+               target_vlan, ts_source, ts_resolution_ns, time_base.name,
+               rx_offset_ns, rx_offset_err_ns, rx_offset_drift_ns);
+    }
+    printf(",\"tc\":{");
+
+    int first = 1;
+    for (int t = 0; t < MAX_TC; t++) {
+        tc_data_t *tc = &tc_data[t];
+        if (tc->stream.count == 0) continue;
+
+        printf("%s\"%d\":{\"packets\":%lu", first ? "" : ",", t, tc->stream.count);
+        first = 0;
+        for (int c = 0; c < TSN_GCL_CLASSES; c++) {
+            printf(",\"%s\":%lu", tsn_gcl_class_name(c), tc->check[c]);
+        }
+        printf(",\"conformance\":%.6f,\"early_max_us\":%.3f,\"late_max_us\":%.3f",
+               (double)tc->check[TSN_GCL_IN_WINDOW] / tc->stream.count,
+               -tc->early_max_ns / 1000.0, tc->late_max_ns / 1000.0);
+        if (tc->miss_hist.count > 0) {
+            tsn_pctl_t m;
+            tsn_hist_pctl(&tc->miss_hist, &m);
+            printf(",\"miss_p50_us\":%.3f,\"miss_p99_us\":%.3f,\"miss_max_us\":%.3f",
+                   m.p50, m.p99, m.max);
+        }
+        if (final) {
+            const tsn_gcl_tc_t *g = &gcl->tc[t];
+            printf(",\"windows\":[");
+            for (int w = 0; w < g->n_windows; w++) {
+                printf("%s{\"start_us\":%.3f,\"duration_us\":%.3f}", w ? "," : "",
+                       g->windows[w].start_ns / 1000.0,
+                       (g->windows[w].end_ns - g->windows[w].start_ns) / 1000.0);
+            }
+            printf("]");
+        }
+        printf("}");
+    }
+    tsn_instr_t in;
+    instr_get(&in);
+    printf("},");
+    tsn_instr_print_json(stdout, &in);
+    printf("}\n");
+    fflush(stdout);
+}
+
+static void print_check_human(void) {
+    printf("\n");
+    printf("GCL conformance: cycle %.3f ms, %d entries, guard %.1f us, base-time %lu ns (%s)\n\n",
+           gcl->cycle_ns / 1e6, gcl->n_entries, gcl->guard_ns / 1000.0, base_time_ns, time_base.name);
+    printf("TC  Packets    In window  Guard      Violation  Conform   Early max   Late max\n");
+    printf("--------------------------------------------------------------------------------\n");
+    for (int t = 0; t < MAX_TC; t++) {
+        tc_data_t *tc = &tc_data[t];
+        if (tc->stream.count == 0) continue;
+        printf("TC%d %-10lu %-10lu %-10lu %-10lu %6.2f%%  %8.1f us %8.1f us\n",
+               t, tc->stream.count, tc->check[TSN_GCL_IN_WINDOW], tc->check[TSN_GCL_GUARD],
+               tc->check[TSN_GCL_VIOLATION],
+               100.0 * tc->check[TSN_GCL_IN_WINDOW] / tc->stream.count,
+               -tc->early_max_ns / 1000.0, tc->late_max_ns / 1000.0);
+    }
+    printf("\n");
+    tsn_instr_t in;
+    instr_get(&in);
+    tsn_instr_print_human(stdout, &in);
+}
+
+// Cycle start in the RX timestamp domain, reduced into the cycle so a clock
+// offset larger than base-time stays positive
+static void set_gcl_base(void) {
+    int64_t b = (int64_t)base_time_ns - rx_offset_ns;
+    if (b < 0) b = b % (int64_t)gcl->cycle_ns + (int64_t)gcl->cycle_ns;
+    gcl->base_ns = (uint64_t)b;
+}
+
 // Print JSON results
 static void print_results_json(void) {
     printf("{\n");
@@ -415,25 +635,39 @@ static void print_results_json(void) {
     printf("  \"vlan\": %d,\n", target_vlan);
     printf("  \"estimated_cycle_ns\": %lu,\n", estimated_cycle_ns);
     printf("  \"estimated_cycle_ms\": %.3f,\n", estimated_cycle_ns / 1e6);
+    printf("  \"cycle_confidence\": %.3f,\n", cycle_confidence);
+    printf("  \"timestamp_source\": \"%s\",\n", ts_source);
+    printf("  \"timestamp_resolution_ns\": %u,\n", ts_resolution_ns);
+    printf("  \"time_base\": {\"clock\": \"%s\", \"rx_offset_ns\": %ld, \"rx_offset_err_ns\": %lu, "
+           "\"rx_offset_drift_ns\": %ld},\n", time_base.name, rx_offset_ns, rx_offset_err_ns, rx_offset_drift_ns);
+    printf("  \"phase_origin\": \"%s\",\n", base_time_ns ? "base_time" : "first_packet");
+    if (base_time_ns) printf("  \"base_time_ns\": %lu,\n", base_time_ns);
 
     // Per-TC statistics
     printf("  \"tc\": {\n");
     int first = 1;
     for (int t = 0; t < MAX_TC; t++) {
         tc_data_t *tc = &tc_data[t];
-        if (tc->packet_count < 10) continue;
+        if (tc->stream.count < 10) continue;
 
         if (!first) printf(",\n");
         first = 0;
 
         printf("    \"%d\": {\n", t);
-        printf("      \"packets\": %d,\n", tc->packet_count);
+        printf("      \"packets\": %lu,\n", tc->stream.count);
         printf("      \"avg_interval_us\": %.1f,\n", tc->avg_interval_us);
         printf("      \"stddev_us\": %.1f,\n", tc->stddev_interval_us);
+        tsn_pctl_t ia;
+        tsn_hist_pctl(&tc->stream.interval_hist, &ia);
+        printf("      \"interval_p50_us\": %.1f,\n", ia.p50);
+        printf("      \"interval_p90_us\": %.1f,\n", ia.p90);
+        printf("      \"interval_p99_us\": %.1f,\n", ia.p99);
+        printf("      \"interval_p999_us\": %.1f,\n", ia.p999);
+        printf("      \"interval_max_us\": %.1f,\n", ia.max);
         printf("      \"windows\": [\n");
         for (int w = 0; w < tc->window_count; w++) {
-            gate_window_t *win = &tc->windows[w];
-            printf("        {\"start_us\": %.1f, \"duration_us\": %.1f}%s\n",
+            tsn_window_t *win = &tc->windows[w];
+            printf("        {\"start_us\": %.3f, \"duration_us\": %.3f}%s\n",
                    win->start_offset_ns / 1000.0, win->duration_ns / 1000.0,
                    w < tc->window_count - 1 ? "," : "");
         }
@@ -481,8 +715,12 @@ static void print_results_json(void) {
     }
     printf("      ]\n");
     printf("    }\n");
-    printf("  }\n");
-    printf("}\n");
+    printf("  },\n");
+    tsn_instr_t in;
+    instr_get(&in);
+    printf("  ");
+    tsn_instr_print_json(stdout, &in);
+    printf("\n}\n");
 }
 
 static void print_results_human(void) {
@@ -491,19 +729,25 @@ static void print_results_human(void) {
     printf("║        TAS (Time-Aware Shaper) GCL Estimation Results          ║\n");
     printf("╚════════════════════════════════════════════════════════════════╝\n");
     printf("\n");
-    printf("VLAN: %d    Estimated Cycle Time: %.3f ms (%lu ns)\n\n",
-           target_vlan, estimated_cycle_ns / 1e6, estimated_cycle_ns);
+    printf("VLAN: %d    Estimated Cycle Time: %.3f ms (%lu ns)    Confidence: %.2f\n",
+           target_vlan, estimated_cycle_ns / 1e6, estimated_cycle_ns, cycle_confidence);
+    if (base_time_ns) {
+        printf("Phase origin: base-time %lu ns (%s, RX offset %ld ns +/- %lu ns, drift %ld ns)\n\n",
+               base_time_ns, time_base.name, rx_offset_ns, rx_offset_err_ns, rx_offset_drift_ns);
+    } else {
+        printf("Phase origin: first packet\n\n");
+    }
 
     // Per-TC windows
     printf("Detected Gate Windows per TC:\n");
     printf("─────────────────────────────────────────────────────────────────\n");
     for (int t = 0; t < MAX_TC; t++) {
         tc_data_t *tc = &tc_data[t];
-        if (tc->packet_count < 10) continue;
+        if (tc->stream.count < 10) continue;
 
-        printf("TC%d: %d packets, avg_interval=%.1f us\n", t, tc->packet_count, tc->avg_interval_us);
+        printf("TC%d: %lu packets, avg_interval=%.1f us\n", t, tc->stream.count, tc->avg_interval_us);
         for (int w = 0; w < tc->window_count; w++) {
-            gate_window_t *win = &tc->windows[w];
+            tsn_window_t *win = &tc->windows[w];
             printf("     Window %d: start=%.1f us, duration=%.1f us\n",
                    w, win->start_offset_ns / 1000.0, win->duration_ns / 1000.0);
         }
@@ -537,55 +781,244 @@ static void print_results_human(void) {
     }
     printf("└───────┴──────────────┴───────────┴─────────────┘\n");
     printf("\n");
+    tsn_instr_t in;
+    instr_get(&in);
+    tsn_instr_print_human(stdout, &in);
+}
+
+// Streams need the timestamp resolution for their phase histograms
+static int init_streams(void) {
+    for (int t = 0; t < MAX_TC; t++) {
+        if (init_stream(&tc_data[t]) < 0) {
+            fprintf(stderr, "Error: cannot allocate phase histograms\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// time_base - the clock RX timestamps of ifname are on
+static int measure_rx_offset(const char *ifname, int64_t *offset_ns, uint64_t *err_ns) {
+    char errbuf[256], phc[64];
+    tsn_clock_t rx;
+    snprintf(phc, sizeof(phc), "phc:%s", ifname);
+    if (tsn_clock_open(&rx, strcmp(ts_source, "hardware") == 0 ? phc : "realtime", errbuf) < 0) {
+        fprintf(stderr, "Warning: RX clock: %s\n", errbuf);
+        return -1;
+    }
+    int rc = tsn_clock_offset(&time_base, &rx, offset_ns, err_ns);
+    tsn_clock_close(&rx);
+    return rc;
+}
+
+// Live capture for duration seconds, with optional JSON updates
+static int capture_live(const char *ifname, int duration, const char *filter) {
+    char errbuf[256];
+    tsn_capture_opts_t opts;
+    tsn_capture_opts_init(&opts);
+    cap = tsn_capture_open(ifname, &opts, errbuf);
+    if (!cap) {
+        fprintf(stderr, "Error: %s\n", errbuf);
+        return -1;
+    }
+
+    ts_resolution_ns = tsn_capture_ts_resolution_ns(cap);
+    ts_source = tsn_capture_ts_source(cap);
+    if (init_streams() < 0) return -1;
+    handler = packet_handler_matched;
+    if (tsn_capture_set_match(cap, &vlan_match) < 0) {
+        handler = packet_handler;
+        tsn_capture_set_filter(cap, filter);
+    }
+
+    int64_t offset_start = 0;
+    bool have_offset = measure_rx_offset(ifname, &offset_start, &rx_offset_err_ns) == 0;
+    rx_offset_ns = offset_start;
+    if (gcl) set_gcl_base();
+
+    fprintf(stderr, "Capturing on %s for %d seconds (VLAN %d)...\n",
+            ifname, duration, target_vlan);
+
+    uint64_t start = tsn_time_ns();
+    uint64_t end = start + (uint64_t)duration * 1000000000ULL;
+    uint64_t interval_ns = (update_interval_ms ? update_interval_ms : shm ? SHM_INTERVAL_MS : 0) * 1000000ULL;
+    uint64_t next_update = start + interval_ns;
+
+    while (running && tsn_time_ns() < end) {
+        tsn_capture_dispatch(cap, handler, NULL);
+
+        uint64_t now = tsn_time_ns();
+        if (interval_ns > 0 && now >= next_update) {
+            instr_refresh();
+            if (gcl) {
+                if (update_interval_ms > 0) print_check_json(now - start, false);
+                if (shm) publish_shm(now - start, gcl->cycle_ns);
+            } else {
+                uint64_t t0 = tsn_instr_ticks();
+                update_estimate();
+                analysis_done(t0);
+                if (update_interval_ms > 0) print_update_json(now - start);
+                if (shm) publish_shm(now - start, live_cycle_ns);
+            }
+            next_update += interval_ns;
+            if (next_update < now) next_update = now + interval_ns;
+        }
+    }
+
+    // Average the two offsets; a large drift means the clocks are not synchronized
+    int64_t offset_end;
+    uint64_t err_end;
+    if (have_offset && measure_rx_offset(ifname, &offset_end, &err_end) == 0) {
+        rx_offset_ns = offset_start + (offset_end - offset_start) / 2;
+        rx_offset_drift_ns = offset_end - offset_start;
+        if (err_end > rx_offset_err_ns) rx_offset_err_ns = err_end;
+    }
+
+    instr_refresh();
+    tsn_capture_close(cap);
+    cap = NULL;
+    return 0;
+}
+
+// Whole capture file, one worker per PCP slice
+static int read_capture_file(const char *filter) {
+    char errbuf[256];
+    if (rx_workers <= 0) rx_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (rx_workers > TSN_CAPTURE_MAX_WORKERS) rx_workers = TSN_CAPTURE_MAX_WORKERS;
+
+    file_group = tsn_capture_group_open_file(read_file, rx_workers, errbuf);
+    if (!file_group) {
+        fprintf(stderr, "Error: %s\n", errbuf);
+        return -1;
+    }
+
+    tsn_capture_t *f = tsn_capture_group_member(file_group, 0);
+    ts_resolution_ns = tsn_capture_ts_resolution_ns(f);
+    ts_source = tsn_capture_ts_source(f);
+    if (init_streams() < 0) return -1;
+    if (gcl) set_gcl_base();
+    handler = packet_handler_matched;
+    if (tsn_capture_group_set_match(file_group, &vlan_match) < 0) {
+        handler = packet_handler;
+        tsn_capture_group_set_filter(file_group, filter);
+    }
+
+    fprintf(stderr, "Reading %s (%s, %d workers, VLAN %d)...\n",
+            read_file, tsn_capture_backend_name(f), rx_workers, target_vlan);
+
+    tsn_capture_group_run(file_group, handler, NULL, NULL, &running);
+    instr_refresh();
+
+    tsn_capture_group_t *g = file_group;
+    file_group = NULL;
+    tsn_capture_group_close(g);
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 3) {
+    const char *pos[8];
+    int npos = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--interval-ms") == 0 && i + 1 < argc) {
+            update_interval_ms = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--read") == 0 && i + 1 < argc) {
+            read_file = argv[++i];
+        } else if (strcmp(argv[i], "--rx-workers") == 0 && i + 1 < argc) {
+            rx_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (strcmp(argv[i], "--base-time") == 0 && i + 1 < argc) {
+            base_time_ns = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc) {
+            clock_name = argv[++i];
+        } else if (strcmp(argv[i], "--gcl") == 0 && i + 1 < argc) {
+            gcl_spec = argv[++i];
+        } else if (strcmp(argv[i], "--guard-ns") == 0 && i + 1 < argc) {
+            guard_ns = strtoull(argv[++i], NULL, 10);
+        } else if (npos < 8) {
+            pos[npos++] = argv[i];
+        }
+    }
+
+    // A file replaces <interface> <duration>
+    int first = read_file ? 0 : 2;
+    if (npos < first) {
         fprintf(stderr, "TAS GCL Estimator\n");
-        fprintf(stderr, "Usage: %s <interface> <duration_sec> [vlan_id] [expected_cycle_ms]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--interval-ms N] [--shm NAME] [--base-time NS] [--clock NAME]\n"
+                        "          <interface> <duration_sec> [vlan_id] [expected_cycle_ms]\n", argv[0]);
+        fprintf(stderr, "       %s --read <file.pcap|file.pcapng> [--rx-workers N] [--base-time NS] [vlan_id] [expected_cycle_ms]\n", argv[0]);
+        fprintf(stderr, "       %s --gcl MASK:NS,... [--guard-ns NS] [--base-time NS] <interface> <duration_sec> [vlan_id] [cycle_ms]\n", argv[0]);
         fprintf(stderr, "Example: %s enxc84d44263ba6 10 100 200\n", argv[0]);
+        fprintf(stderr, "         %s --interval-ms 1000 enxc84d44263ba6 30 100   (live GCL updates)\n", argv[0]);
+        fprintf(stderr, "         %s --read bench.pcapng 100\n", argv[0]);
+        fprintf(stderr, "         %s --base-time 1700000000000000000 --clock phc:eth0 eth0 2 100 1\n", argv[0]);
+        fprintf(stderr, "         %s --gcl 0x80:300000,0x7f:700000 --base-time 1700000000000000000 eth0 10 100\n", argv[0]);
+        fprintf(stderr, "--base-time: window offsets relative to the GCL base-time (ns in --clock:\n"
+                        "  monotonic, realtime, tai, phc:IFACE, /dev/ptpN; default TSN_CLOCK or tai)\n");
+        fprintf(stderr, "--gcl: check every frame against the configured GCL (gate-states:interval-ns\n"
+                        "  entries) instead of estimating one; --guard-ns default %d\n", DEFAULT_GUARD_NS);
+        return 1;
+    }
+
+    char clock_err[256];
+    if (tsn_clock_open(&time_base, clock_name, clock_err) < 0) {
+        fprintf(stderr, "Error: %s\n", clock_err);
         return 1;
     }
 
-    const char *ifname = argv[1];
-    int duration = atoi(argv[2]);
-    target_vlan = argc > 3 ? atoi(argv[3]) : 100;
-    expected_cycle_ms = argc > 4 ? atof(argv[4]) : 0;
+    const char *ifname = read_file ? NULL : pos[0];
+    int duration = read_file ? 0 : atoi(pos[1]);
+    target_vlan = npos > first ? atoi(pos[first]) : 100;
+    expected_cycle_ms = npos > first + 1 ? atof(pos[first + 1]) : 0;
 
     memset(tc_data, 0, sizeof(tc_data));
+    if (gcl_spec) {
+        char errbuf[256];
+        gcl = malloc(sizeof(*gcl));
+        if (!gcl || tsn_gcl_compile(gcl, gcl_spec, (uint64_t)(expected_cycle_ms * 1e6), errbuf) < 0) {
+            fprintf(stderr, "Error: --gcl: %s\n", gcl ? errbuf : "out of memory");
+            return 1;
+        }
+        gcl->guard_ns = guard_ns;
+    }
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
-    char errbuf[PCAP_ERRBUF_SIZE];
-    handle = pcap_open_live(ifname, 128, 1, 1, errbuf);
-    if (!handle) {
-        fprintf(stderr, "Error: %s\n", errbuf);
-        return 1;
+    if (shm_name) {
+        char errbuf[256];
+        shm = tsn_shm_create(shm_name, "tas-estimator", errbuf);
+        if (!shm) {
+            fprintf(stderr, "Error: %s\n", errbuf);
+            return 1;
+        }
     }
 
-    struct bpf_program fp;
     char filter[64];
     snprintf(filter, sizeof(filter), "vlan %d", target_vlan);
-    if (pcap_compile(handle, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) == 0) {
-        pcap_setfilter(handle, &fp);
-        pcap_freecode(&fp);
-    }
-
-    fprintf(stderr, "Capturing on %s for %d seconds (VLAN %d)...\n",
-            ifname, duration, target_vlan);
-
-    uint64_t start = get_time_ns();
-    uint64_t end = start + (uint64_t)duration * 1000000000ULL;
+    vlan_match.vlan_id = target_vlan > 0 ? target_vlan : 0;
 
-    while (running && get_time_ns() < end) {
-        pcap_dispatch(handle, 100, packet_handler, NULL);
+    uint64_t start = tsn_time_ns();
+    int rc = read_file ? read_capture_file(filter) : capture_live(ifname, duration, filter);
+    if (rc < 0) {
+        tsn_shm_close(shm);
+        return 1;
     }
 
-    pcap_close(handle);
+    if (gcl) {
+        if (shm) {
+            publish_shm(tsn_time_ns() - start, gcl->cycle_ns);
+            tsn_shm_close(shm);
+        }
+        if (isatty(STDOUT_FILENO)) print_check_human();
+        else print_check_json(tsn_time_ns() - start, true);
+        free(gcl);
+        return 0;
+    }
 
-    fprintf(stderr, "Analyzing for TAS patterns...\n");
+    fprintf(stderr, "Analyzing for TAS patterns (%s kernels)...\n", tsn_simd_name());
 
     // Calculate statistics
+    uint64_t t0 = tsn_instr_ticks();
     for (int t = 0; t < MAX_TC; t++) {
         calc_interval_stats(&tc_data[t]);
     }
@@ -593,20 +1026,30 @@ int main(int argc, char *argv[]) {
     // Detect cycle time
     estimated_cycle_ns = detect_cycle_time();
     if (estimated_cycle_ns == 0) {
+        analysis_done(t0);
         fprintf(stderr, "Could not detect cycle time\n");
+        if (shm) {
+            publish_shm(tsn_time_ns() - start, 0);
+            tsn_shm_close(shm);
+        }
         return 1;
     }
 
-    fprintf(stderr, "Detected cycle time: %.3f ms\n", estimated_cycle_ns / 1e6);
+    fprintf(stderr, "Detected cycle time: %.3f ms (confidence %.2f)\n",
+            estimated_cycle_ns / 1e6, cycle_confidence);
 
-    // Build histograms and detect windows
+    // Detect windows
     for (int t = 0; t < MAX_TC; t++) {
-        build_histogram(&tc_data[t], estimated_cycle_ns);
-        detect_windows(&tc_data[t], estimated_cycle_ns, t);
+        detect_windows(&tc_data[t], estimated_cycle_ns);
     }
 
     // Build GCL
     build_gcl(estimated_cycle_ns);
+    analysis_done(t0);
+    if (shm) {
+        publish_shm(tsn_time_ns() - start, estimated_cycle_ns);
+        tsn_shm_close(shm);
+    }
 
     // Output
     if (isatty(STDOUT_FILENO)) {
@@ -1,9 +1,33 @@
 /*
  * traffic-capture.c - High-precision packet capture for TSN analysis
- * Using libpcap for reliable capture
+ * Capture through tsn-capture (TPACKET_V3 ring or libpcap, nanosecond timestamps)
  *
- * Compile: gcc -O2 -o traffic-capture traffic-capture.c -lpcap -lpthread -lm
- * Run: sudo ./traffic-capture <interface> [duration] [vlan_id] [output_mode]
+ * Compile: make traffic-capture (links libtsntest.a)
+ * Run: sudo ./traffic-capture [--rx-workers N] [--out FILE] <interface> [duration] [vlan_id] [output_mode]
+ *
+ * --rx-workers N fans the frames out by PCP over N pinned capture threads
+ * (tsn-capture); each TC is still written by one thread only.
+ *
+ * Output mode "binary" writes one 24-byte tsn-record per packet to --out
+ * (default stdout) through per-worker buffers, so logging costs no syscall
+ * per packet. With --out FILE the JSON stats still go to stdout. Dump or
+ * convert with tsn-records; the estimators and tsn-verify take the file
+ * with --read.
+ *
+ * --shm NAME also publishes the live per-TC counters, interval and latency
+ * percentiles to /dev/shm/NAME (tsn-shm) --shm-hz times a second (default
+ * 50), for dashboards polling faster than the JSON lines.
+ *
+ * --ebpf (json and stats modes) counts in the kernel instead: an eBPF socket
+ * filter keeps the per-TC counters and interval histograms in per-CPU maps and
+ * drops every frame, so nothing is copied to user space and the stats thread
+ * just reads the maps (tsn-kstats). Loss comes from the sequence range;
+ * duplicate, reorder and latency figures need the copying path.
+ *
+ * Every JSON line, the stats mode summary and the shm block carry the
+ * kernel's ring drops and freezes and the per-frame capture cost
+ * (tsn-instr.h), so a loss figure can be told apart from a capture that fell
+ * behind.
  */
 
 #define _GNU_SOURCE
@@ -15,118 +39,209 @@
 #include <signal.h>
 #include <time.h>
 #include <math.h>
-#include <sys/mman.h>
-#include <sched.h>
 #include <pthread.h>
-#include <pcap/pcap.h>
 
-#define MAX_TC 8
-#define MAX_PACKETS_PER_TC 50000
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-capture.h"
+#include "tsn-analysis.h"
+#include "tsn-record.h"
+#include "tsn-shm.h"
+#include "tsn-kstats.h"
+
+#define MAX_TC TSN_MAX_TC
 #define STATS_INTERVAL_MS 200
+#define BURST_INTERVAL_NS 1000000  // intervals below 1ms count as burst
 
-// Per-TC statistics
+// Running per-TC counters shown by the live stats output
 typedef struct {
     uint64_t count;
-    uint64_t first_ts_us;
-    uint64_t last_ts_us;
-    uint64_t total_interval_us;
-    uint64_t min_interval_us;
-    uint64_t max_interval_us;
-    uint64_t intervals[MAX_PACKETS_PER_TC];
-    int interval_count;
-} tc_stats_t;
+    uint64_t bytes;
+    uint64_t first_ts_ns;
+    uint64_t last_ts_ns;
+    uint64_t total_interval_ns;
+    uint64_t min_interval_ns;
+    uint64_t max_interval_ns;
+} tc_counters_t;
+
+// Per-TC statistics
+// The capture thread owning the TC is the only writer. It publishes `live` under a sequence
+// counter (odd while an update is in flight), so the stats thread takes a
+// consistent snapshot by retrying instead of blocking the capture path.
+typedef struct {
+    uint32_t seq;
+    tc_counters_t live;
+    tsn_welford_t interval;       // read only after capture stops
+    tsn_hist_t interval_hist;     // same
+    uint64_t burst_intervals;
+    tsn_seq_t stream_seq;         // test header sequence / latency, same
+} __attribute__((aligned(64))) tc_stats_t;
 
 // Global state
 static volatile int running = 1;
 static tc_stats_t tc_stats[MAX_TC];
-static uint64_t total_packets = 0;
 static uint64_t start_time_us = 0;
 static int target_vlan = 100;
-static int output_mode = 0;  // 0=json, 1=stats, 2=raw
-static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pcap_t *handle = NULL;
+static int output_mode = 0;  // 0=json, 1=stats, 2=raw, 3=binary
+static int rx_workers = 1;
+static tsn_capture_group_t *group = NULL;
+
+// Binary mode: buffers are written out at least every stats interval
+static const char *out_path = "-";
+static tsn_rec_out_t *rec_out = NULL;
+static tsn_rec_buf_t *rec_bufs = NULL;  // one per capture worker
+
+// --ebpf: counters in the kernel, pulled into tc_stats by snapshot_all()
+static tsn_kstats_t *ks = NULL;
+static tsn_kstats_tc_t ks_tc[MAX_TC];
+
+// Shared-memory stats, written by the stats thread
+static const char *shm_name = NULL;
+static int shm_hz = 50;
+static tsn_shm_stats_t *shm = NULL;
 
 // Get current time in microseconds
-static uint64_t get_time_us(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+static inline uint64_t get_time_us(void) {
+    return tsn_time_ns() / 1000;
+}
+
+// Seqlock write side: only called from the TC's capture thread
+static inline void tc_write_begin(tc_stats_t *tc) {
+    __atomic_store_n(&tc->seq, tc->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void tc_write_end(tc_stats_t *tc) {
+    __atomic_store_n(&tc->seq, tc->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Seqlock read side: copy the counters, retry if the writer was mid-update
+static void tc_snapshot(tc_stats_t *tc, tc_counters_t *out) {
+    uint32_t start, end;
+    do {
+        start = __atomic_load_n(&tc->seq, __ATOMIC_ACQUIRE);
+        memcpy(out, &tc->live, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&tc->seq, __ATOMIC_RELAXED);
+    } while ((start & 1) || start != end);
 }
 
 // Signal handler
 static void signal_handler(int sig) {
     (void)sig;
     running = 0;
-    if (handle) pcap_breakloop(handle);
-}
-
-// Setup real-time scheduling
-static void setup_realtime(void) {
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
-    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
-        // Not critical
-    }
-    mlockall(MCL_CURRENT | MCL_FUTURE);
+    if (group) tsn_capture_group_breakloop(group);
 }
 
 // Packet handler callback
-static void packet_handler(u_char *user, const struct pcap_pkthdr *hdr, const u_char *pkt) {
-    (void)user;
-
-    if (hdr->caplen < 18) return;
-
-    // Timestamp from pcap (microseconds)
-    uint64_t ts_us = (uint64_t)hdr->ts.tv_sec * 1000000ULL + hdr->ts.tv_usec;
+// user: the worker's record buffer in binary mode
+static void packet_handler(void *user, const tsn_packet_t *p) {
 
-    // Check for VLAN tag (ethertype at offset 12)
-    uint16_t ethertype = (pkt[12] << 8) | pkt[13];
-    if (ethertype != 0x8100) return;
+    // Timestamp from the capture backend (nanoseconds)
+    uint64_t ts_ns = p->ts_ns;
 
-    // Parse VLAN TCI (offset 14-15)
-    uint16_t tci = (pkt[14] << 8) | pkt[15];
-    int pcp = (tci >> 13) & 0x07;
-    int vid = tci & 0x0FFF;
+    // Must be VLAN tagged
+    tsn_vlan_t vlan;
+    if (tsn_parse_vlan(p->data, p->caplen, &vlan) < 0) return;
+    int pcp = vlan.pcp;
+    int vid = vlan.vid;
 
     // Filter by VLAN ID
     if (target_vlan > 0 && vid != target_vlan) return;
 
     // Filter by inner protocol - must be IPv4 UDP
-    uint16_t inner_proto = (pkt[16] << 8) | pkt[17];
-    if (inner_proto != 0x0800) return;  // Not IPv4
+    if (vlan.ethertype != 0x0800) return;  // Not IPv4
 
     // Update statistics
-    pthread_mutex_lock(&stats_mutex);
-
     tc_stats_t *tc = &tc_stats[pcp];
+    tc_counters_t *c = &tc->live;
+
+    tc_write_begin(tc);
 
-    if (tc->count == 0) {
-        tc->first_ts_us = ts_us;
-        tc->min_interval_us = UINT64_MAX;
+    if (c->count == 0) {
+        c->first_ts_ns = ts_ns;
+        c->min_interval_ns = UINT64_MAX;
     } else {
-        uint64_t interval = ts_us - tc->last_ts_us;
-        tc->total_interval_us += interval;
+        uint64_t interval = ts_ns - c->last_ts_ns;
+        c->total_interval_ns += interval;
 
-        if (interval < tc->min_interval_us) tc->min_interval_us = interval;
-        if (interval > tc->max_interval_us) tc->max_interval_us = interval;
+        if (interval < c->min_interval_ns) c->min_interval_ns = interval;
+        if (interval > c->max_interval_ns) c->max_interval_ns = interval;
 
-        if (tc->interval_count < MAX_PACKETS_PER_TC) {
-            tc->intervals[tc->interval_count++] = interval;
-        }
+        tsn_welford_add(&tc->interval, (double)interval);
+        tsn_hist_add(&tc->interval_hist, interval);
+        if (interval < BURST_INTERVAL_NS) tc->burst_intervals++;
     }
 
-    tc->last_ts_us = ts_us;
-    tc->count++;
-    total_packets++;
+    c->last_ts_ns = ts_ns;
+    c->bytes += p->len;
+    c->count++;
+
+    tc_write_end(tc);
+
+    // Sequence and one-way latency; latency is meaningful when the sender's
+    // clock is synchronized to ours (same host or PTP)
+    tsn_test_hdr_t th;
+    int has_seq = tsn_test_hdr_parse(p->data, p->caplen, &th) == 0;
+    if (has_seq) tsn_seq_add(&tc->stream_seq, th.seq, (int64_t)(ts_ns - th.tx_ns));
+
+    if (output_mode == 3) {
+        tsn_rec_t r;
+        tsn_rec_make(&r, ts_ns, pcp, vid, p->len, has_seq ? &th : NULL);
+        tsn_rec_put(user, &r, STATS_INTERVAL_MS * 1000000ULL);
+    } else if (output_mode == 2) {
+        // Raw text; stdout is flushed by the stats thread, not per packet
+        printf("%lu.%09lu TC%d VID%d len=%u\n",
+               ts_ns / 1000000000, ts_ns % 1000000000, pcp, vid, p->len);
+    }
+}
+
+// --ebpf: the kernel's totals replace the capture threads' writes. Only the
+// stats thread, and main once it is joined, get here. Interval mean and
+// variance are rebuilt from the histogram
+static void kstats_refresh(void) {
+    if (tsn_kstats_read(ks, ks_tc) < 0) return;
+    for (int i = 0; i < MAX_TC; i++) {
+        const tsn_kstats_tc_t *k = &ks_tc[i];
+        tc_stats_t *tc = &tc_stats[i];
 
-    pthread_mutex_unlock(&stats_mutex);
+        tc_write_begin(tc);
+        tc->live.count = k->count;
+        tc->live.bytes = k->bytes;
+        tc->live.first_ts_ns = k->first_ts_ns;
+        tc->live.last_ts_ns = k->last_ts_ns;
+        tc->live.total_interval_ns = k->total_interval_ns;
+        tc->live.min_interval_ns = k->min_interval_ns;
+        tc->live.max_interval_ns = k->max_interval_ns;
+        tc_write_end(tc);
+
+        tc->interval_hist = k->interval_hist;
+        tc->burst_intervals = k->burst_intervals;
+        uint64_t n = k->interval_hist.count;
+        double sd = tsn_hist_stddev(&k->interval_hist);
+        tc->interval.n = n;
+        tc->interval.mean = n ? (double)k->total_interval_ns / n : 0;
+        tc->interval.m2 = sd * sd * n;
+    }
+}
 
-    // Raw output
-    if (output_mode == 2) {
-        printf("%lu.%06lu TC%d VID%d len=%d\n",
-               ts_us / 1000000, ts_us % 1000000, pcp, vid, hdr->len);
-        fflush(stdout);
+// Snapshot every TC; returns the packet total. With several capture threads
+// there is no shared packet counter, the total is the sum of the TC counts
+static uint64_t snapshot_all(tc_counters_t *snap) {
+    uint64_t total = 0;
+    if (ks) kstats_refresh();
+    for (int i = 0; i < MAX_TC; i++) {
+        tc_snapshot(&tc_stats[i], &snap[i]);
+        total += snap[i].count;
     }
+    return total;
+}
+
+// Kernel drops and stage costs so far: the stats thread, then main after
+// the workers and the stats thread are joined
+static void instr_snapshot(tsn_instr_t *in) {
+    memset(in, 0, sizeof(*in));
+    if (group) tsn_capture_group_instr(group, in);
 }
 
 // Print JSON stats
@@ -134,34 +249,35 @@ static void print_stats_json(void) {
     uint64_t now = get_time_us();
     uint64_t elapsed_us = now - start_time_us;
 
-    pthread_mutex_lock(&stats_mutex);
-
-    printf("{\"elapsed_ms\":%.1f,\"total\":%lu,\"tc\":{",
-           elapsed_us / 1000.0, total_packets);
+    tc_counters_t snap[MAX_TC];
+    uint64_t total = snapshot_all(snap);
+    printf("{\"elapsed_ms\":%.1f,\"total\":%lu,\"tc\":{", elapsed_us / 1000.0, total);
 
     int first = 1;
     for (int i = 0; i < MAX_TC; i++) {
-        tc_stats_t *tc = &tc_stats[i];
+        tc_counters_t *tc = &snap[i];
         if (tc->count == 0) continue;
 
         double avg_interval = tc->count > 1 ?
-            (double)tc->total_interval_us / (tc->count - 1) : 0;
-        double throughput_kbps = tc->count > 1 && tc->last_ts_us > tc->first_ts_us ?
-            (tc->count * 60.0 * 8.0 * 1000.0) / (tc->last_ts_us - tc->first_ts_us) : 0;
+            (double)tc->total_interval_ns / (tc->count - 1) / 1000.0 : 0;
+        double throughput_kbps = tc->count > 1 && tc->last_ts_ns > tc->first_ts_ns ?
+            (tc->count * 60.0 * 8.0 * 1000000.0) / (tc->last_ts_ns - tc->first_ts_ns) : 0;
 
         if (!first) printf(",");
         first = 0;
 
-        printf("\"%d\":{\"count\":%lu,\"avg_us\":%.1f,\"min_us\":%lu,\"max_us\":%lu,\"kbps\":%.1f}",
+        printf("\"%d\":{\"count\":%lu,\"avg_us\":%.1f,\"min_us\":%.3f,\"max_us\":%.3f,\"kbps\":%.1f}",
                i, tc->count, avg_interval,
-               tc->min_interval_us == UINT64_MAX ? 0 : tc->min_interval_us,
-               tc->max_interval_us, throughput_kbps);
+               tc->min_interval_ns == UINT64_MAX ? 0 : tc->min_interval_ns / 1000.0,
+               tc->max_interval_ns / 1000.0, throughput_kbps);
     }
 
-    printf("}}\n");
+    tsn_instr_t in;
+    instr_snapshot(&in);
+    printf("},");
+    tsn_instr_print_json(stdout, &in);
+    printf("}\n");
     fflush(stdout);
-
-    pthread_mutex_unlock(&stats_mutex);
 }
 
 // Print human-readable stats
@@ -169,169 +285,374 @@ static void print_stats_human(void) {
     uint64_t now = get_time_us();
     uint64_t elapsed_us = now - start_time_us;
 
-    pthread_mutex_lock(&stats_mutex);
-
+    tc_counters_t snap[MAX_TC];
+    uint64_t total = snapshot_all(snap);
     printf("\n=== Capture Stats (%.1f sec) ===\n", elapsed_us / 1000000.0);
-    printf("Total: %lu packets\n\n", total_packets);
+    printf("Total: %lu packets\n\n", total);
     printf("TC  Count     Avg(ms)   Min(ms)   Max(ms)   Throughput\n");
     printf("----------------------------------------------------\n");
 
     for (int i = 0; i < MAX_TC; i++) {
-        tc_stats_t *tc = &tc_stats[i];
+        tc_counters_t *tc = &snap[i];
         if (tc->count == 0) continue;
 
         double avg_ms = tc->count > 1 ?
-            (double)tc->total_interval_us / (tc->count - 1) / 1000.0 : 0;
-        double min_ms = tc->min_interval_us == UINT64_MAX ? 0 : tc->min_interval_us / 1000.0;
-        double max_ms = tc->max_interval_us / 1000.0;
-        double kbps = tc->count > 1 && tc->last_ts_us > tc->first_ts_us ?
-            (tc->count * 60.0 * 8.0 * 1000.0) / (tc->last_ts_us - tc->first_ts_us) : 0;
+            (double)tc->total_interval_ns / (tc->count - 1) / 1e6 : 0;
+        double min_ms = tc->min_interval_ns == UINT64_MAX ? 0 : tc->min_interval_ns / 1e6;
+        double max_ms = tc->max_interval_ns / 1e6;
+        double kbps = tc->count > 1 && tc->last_ts_ns > tc->first_ts_ns ?
+            (tc->count * 60.0 * 8.0 * 1000000.0) / (tc->last_ts_ns - tc->first_ts_ns) : 0;
 
         printf("TC%d %8lu %9.2f %9.2f %9.2f %8.1f kbps\n",
                i, tc->count, avg_ms, min_ms, max_ms, kbps);
     }
 
-    pthread_mutex_unlock(&stats_mutex);
+    tsn_instr_t in;
+    instr_snapshot(&in);
+    printf("\n");
+    tsn_instr_print_human(stdout, &in);
 }
 
-// Print final analysis
-static void print_final_analysis(void) {
-    pthread_mutex_lock(&stats_mutex);
+// "<name>_p50_us" ... "<name>_max_us" members
+static void print_pctl_json(const char *name, const tsn_pctl_t *p) {
+    printf(",\"%s_p50_us\":%.1f,\"%s_p90_us\":%.1f,\"%s_p99_us\":%.1f,"
+           "\"%s_p999_us\":%.1f,\"%s_max_us\":%.1f",
+           name, p->p50, name, p->p90, name, p->p99, name, p->p999, name, p->max);
+}
 
+// Print final analysis (capture has stopped, no writer left)
+static void print_final_analysis(void) {
     printf("\n{\"final\":true,\"tc\":{");
 
     int first_tc = 1;
     for (int i = 0; i < MAX_TC; i++) {
-        tc_stats_t *tc = &tc_stats[i];
+        tc_stats_t *ts = &tc_stats[i];
+        tc_counters_t *tc = &ts->live;
         if (tc->count < 2) continue;
 
-        double avg = (double)tc->total_interval_us / (tc->count - 1);
+        double avg = (double)tc->total_interval_ns / (tc->count - 1);
 
-        // Calculate stddev and burst analysis
-        double sum_sq = 0;
-        int burst_count = 0;
-        uint64_t burst_threshold = 1000;  // 1ms
+        // Stddev and burst analysis, accumulated by the capture thread
+        double stddev = tsn_welford_stddev(&ts->interval);
+        uint64_t burst_count = ts->burst_intervals;
+        int is_shaped = (stddev > avg * 0.3) || (burst_count > ts->interval.n / 3);
 
-        for (int j = 0; j < tc->interval_count; j++) {
-            double diff = (double)tc->intervals[j] - avg;
-            sum_sq += diff * diff;
-            if (tc->intervals[j] < burst_threshold) burst_count++;
-        }
+        double kbps = (tc->count * 60.0 * 8.0 * 1000000.0) / (tc->last_ts_ns - tc->first_ts_ns);
 
-        double stddev = tc->interval_count > 0 ? sqrt(sum_sq / tc->interval_count) : 0;
-        int is_shaped = (stddev > avg * 0.3) || (burst_count > tc->interval_count / 3);
-
-        double kbps = (tc->count * 60.0 * 8.0 * 1000.0) / (tc->last_ts_us - tc->first_ts_us);
+        tsn_seq_stats_t q;
+        tsn_seq_stats(&ts->stream_seq, &q);
 
         if (!first_tc) printf(",");
         first_tc = 0;
 
         printf("\"%d\":{\"count\":%lu,\"avg_ms\":%.2f,\"min_ms\":%.2f,\"max_ms\":%.2f,"
-               "\"stddev_ms\":%.2f,\"kbps\":%.1f,\"burst\":%d,\"shaped\":%s}",
-               i, tc->count, avg/1000.0,
-               tc->min_interval_us == UINT64_MAX ? 0 : tc->min_interval_us/1000.0,
-               tc->max_interval_us/1000.0, stddev/1000.0, kbps, burst_count,
+               "\"stddev_ms\":%.2f,\"kbps\":%.1f,\"burst\":%lu,\"shaped\":%s",
+               i, tc->count, avg/1e6,
+               tc->min_interval_ns == UINT64_MAX ? 0 : tc->min_interval_ns/1e6,
+               tc->max_interval_ns/1e6, stddev/1e6, kbps, burst_count,
                is_shaped ? "true" : "false");
+
+        tsn_pctl_t ia;
+        tsn_hist_pctl(&ts->interval_hist, &ia);
+        print_pctl_json("interval", &ia);
+
+        if (q.received > 0) {
+            printf(",\"lost\":%lu,\"dup\":%lu,\"reorder\":%lu,"
+                   "\"lat_min_us\":%.1f,\"lat_avg_us\":%.1f",
+                   q.lost, q.duplicates, q.reordered, q.lat_min_us, q.lat_avg_us);
+            print_pctl_json("lat", &q.lat);
+        } else if (ks && ks_tc[i].seq_seen > 0) {
+            printf(",\"lost\":%lu", tsn_kstats_lost(&ks_tc[i]));
+        }
+        printf("}");
     }
 
-    printf("}}\n");
+    printf("}");
+    if (ks) printf(",\"backend\":\"ebpf\"");
+    if (rx_workers > 1 && group) {
+        printf(",\"rx_workers\":[");
+        for (int w = 0; w < rx_workers; w++) {
+            printf("%s%lu", w ? "," : "", tsn_capture_group_packets(group, w));
+        }
+        printf("]");
+    }
+    tsn_instr_t in;
+    instr_snapshot(&in);
+    printf(",");
+    tsn_instr_print_json(stdout, &in);
+    printf("}\n");
     fflush(stdout);
+}
 
-    pthread_mutex_unlock(&stats_mutex);
+// Histograms and sequence state are updated outside the seqlock, so while
+// capturing their percentiles may trail the counters by a few packets
+static void publish_shm(void) {
+    tc_counters_t snap[MAX_TC];
+    uint64_t total = snapshot_all(snap);
+
+    tsn_shm_begin(shm);
+    shm->elapsed_ms = (get_time_us() - start_time_us) / 1000.0;
+    shm->total = total;
+    for (int i = 0; i < MAX_TC; i++) {
+        tc_counters_t *c = &snap[i];
+        tsn_shm_tc_t *t = &shm->tc[i];
+        if (c->count == 0) continue;
+
+        uint64_t span = c->last_ts_ns - c->first_ts_ns;
+        t->count = c->count;
+        t->bytes = c->bytes;
+        t->first_ts_ns = c->first_ts_ns;
+        t->last_ts_ns = c->last_ts_ns;
+        t->kbps = span > 0 ? c->bytes * 8.0 * 1e6 / span : 0;
+        t->avg_interval_us = c->count > 1 ? c->total_interval_ns / 1000.0 / (c->count - 1) : 0;
+        t->min_interval_us = c->min_interval_ns == UINT64_MAX ? 0 : c->min_interval_ns / 1000.0;
+        t->max_interval_us = c->max_interval_ns / 1000.0;
+        tsn_hist_pctl(&tc_stats[i].interval_hist, &t->interval);
+        if (!ks) tsn_shm_put_seq(t, &tc_stats[i].stream_seq);
+    }
+    tsn_instr_t in;
+    instr_snapshot(&in);
+    tsn_shm_put_instr(shm, &in);
+    tsn_shm_end(shm);
+}
+
+// JSON lines on stdout: json mode, or binary mode writing records to a file
+static int json_stats(void) {
+    return output_mode == 0 || (output_mode == 3 && strcmp(out_path, "-") != 0);
 }
 
 // Stats thread
 static void *stats_thread(void *arg) {
     (void)arg;
+    uint64_t tick_us = shm ? 1000000 / shm_hz : STATS_INTERVAL_MS * 1000;
+    uint64_t next_print = get_time_us() + STATS_INTERVAL_MS * 1000;
     while (running) {
-        usleep(STATS_INTERVAL_MS * 1000);
+        usleep(tick_us);
         if (!running) break;
-        if (output_mode == 0) print_stats_json();
+        if (shm) publish_shm();
+
+        uint64_t now = get_time_us();
+        if (now < next_print) continue;
+        next_print += STATS_INTERVAL_MS * 1000;
+        if (next_print < now) next_print = now + STATS_INTERVAL_MS * 1000;
+
+        if (json_stats()) print_stats_json();
         else if (output_mode == 1) print_stats_human();
+        else if (output_mode == 2) fflush(stdout);
     }
     return NULL;
 }
 
 static void usage(const char *prog) {
-    fprintf(stderr, "Usage: %s <interface> [duration] [vlan_id] [mode]\n", prog);
-    fprintf(stderr, "  mode: json (default), stats, raw\n");
+    fprintf(stderr, "Usage: %s [--rx-workers N] [--out FILE] [--shm NAME [--shm-hz N]] [--ebpf] <interface> [duration] [vlan_id] [mode]\n", prog);
+    fprintf(stderr, "  mode: json (default), stats, raw, binary\n");
+    fprintf(stderr, "  --rx-workers: fan out by PCP over N capture threads pinned to CPU 0..N-1\n");
+    fprintf(stderr, "  --out: binary records file (default: stdout)\n");
+    fprintf(stderr, "  --shm: live stats in /dev/shm/NAME, updated N times a second (default: 50)\n");
+    fprintf(stderr, "  --ebpf: count in the kernel (eBPF socket filter), no frame copied; json/stats modes\n");
     fprintf(stderr, "Example: %s enxc84d44231cc2 5 100 json\n", prog);
+    fprintf(stderr, "         %s --out run.tsnr enxc84d44231cc2 60 100 binary\n", prog);
+}
+
+// --ebpf: the kernel counts, this only runs the stats thread for the duration
+static int run_kstats(int duration, char *errbuf) {
+    if (shm_name) {
+        if (shm_hz < 1) shm_hz = 1;
+        if (shm_hz > 1000) shm_hz = 1000;
+        shm = tsn_shm_create(shm_name, "traffic-capture", errbuf);
+        if (!shm) {
+            fprintf(stderr, "shm: %s\n", errbuf);
+            tsn_kstats_close(ks);
+            return 1;
+        }
+    }
+
+    pthread_t stats_tid;
+    pthread_create(&stats_tid, NULL, stats_thread, NULL);
+
+    start_time_us = get_time_us();
+    uint64_t end_time_us = duration > 0 ? start_time_us + duration * 1000000ULL : UINT64_MAX;
+    while (running && get_time_us() < end_time_us) {
+        usleep(1000);
+    }
+    running = 0;
+    pthread_join(stats_tid, NULL);
+
+    if (shm) {
+        publish_shm();
+        tsn_shm_close(shm);
+    }
+    if (output_mode == 0) print_final_analysis();
+    else print_stats_human();
+
+    tsn_kstats_close(ks);
+    ks = NULL;
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
+    const char *pos[8];
+    int npos = 0;
+    int use_ebpf = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rx-workers") == 0 && i + 1 < argc) {
+            rx_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (strcmp(argv[i], "--shm-hz") == 0 && i + 1 < argc) {
+            shm_hz = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ebpf") == 0) {
+            use_ebpf = 1;
+        } else if (npos < 8) {
+            pos[npos++] = argv[i];
+        }
+    }
+
+    if (npos < 1) {
         usage(argv[0]);
         return 1;
     }
 
-    const char *ifname = argv[1];
-    int duration = argc > 2 ? atoi(argv[2]) : 10;
-    target_vlan = argc > 3 ? atoi(argv[3]) : 100;
+    const char *ifname = pos[0];
+    int duration = npos > 1 ? atoi(pos[1]) : 10;
+    target_vlan = npos > 2 ? atoi(pos[2]) : 100;
 
-    if (argc > 4) {
-        if (strcmp(argv[4], "stats") == 0) output_mode = 1;
-        else if (strcmp(argv[4], "raw") == 0) output_mode = 2;
+    if (npos > 3) {
+        if (strcmp(pos[3], "stats") == 0) output_mode = 1;
+        else if (strcmp(pos[3], "raw") == 0) output_mode = 2;
+        else if (strcmp(pos[3], "binary") == 0) output_mode = 3;
+    }
+    if (use_ebpf && output_mode >= 2) {
+        fprintf(stderr, "--ebpf counts in the kernel: json and stats modes only\n");
+        return 1;
     }
 
     // Initialize
     memset(tc_stats, 0, sizeof(tc_stats));
     for (int i = 0; i < MAX_TC; i++) {
-        tc_stats[i].min_interval_us = UINT64_MAX;
+        tc_stats[i].live.min_interval_ns = UINT64_MAX;
+        tsn_seq_init(&tc_stats[i].stream_seq);
+        tsn_hist_init(&tc_stats[i].interval_hist);
     }
 
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
-    setup_realtime();
+    tsn_setup_realtime(1);
+
+    char errbuf[256];
+    static const char *mode_names[] = { "json", "stats", "raw", "binary" };
+    if (use_ebpf) {
+        rx_workers = 1;
+        ks = tsn_kstats_open(ifname, target_vlan, BURST_INTERVAL_NS, errbuf);
+        if (!ks) {
+            fprintf(stderr, "ebpf: %s\n", errbuf);
+            return 1;
+        }
+        fprintf(stderr, "Capturing on %s, VLAN %d, %ds, mode=%s, backend=ebpf, ts=kernel\n",
+                ifname, target_vlan, duration, mode_names[output_mode]);
+        return run_kstats(duration, errbuf);
+    }
 
-    // Open pcap
-    char errbuf[PCAP_ERRBUF_SIZE];
-    handle = pcap_open_live(ifname, 128, 1, 10, errbuf);
-    if (!handle) {
-        fprintf(stderr, "pcap_open_live: %s\n", errbuf);
+    // Open capture
+    tsn_capture_opts_t opts;
+    tsn_capture_opts_init(&opts);
+    opts.timeout_ms = 10;
+    tsn_capture_group_t *g = tsn_capture_group_open(ifname, &opts, rx_workers, errbuf);
+    if (!g) {
+        fprintf(stderr, "capture open: %s\n", errbuf);
         return 1;
     }
+    tsn_capture_t *cap = tsn_capture_group_member(g, 0);
 
     // Set filter for VLAN
-    struct bpf_program fp;
     char filter[64];
     snprintf(filter, sizeof(filter), "vlan %d", target_vlan);
-    if (pcap_compile(handle, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) == 0) {
-        pcap_setfilter(handle, &fp);
-        pcap_freecode(&fp);
+    tsn_capture_group_set_filter(g, filter);
+
+    fprintf(stderr, "Capturing on %s, VLAN %d, %ds, mode=%s, backend=%s, ts=%s, workers=%d\n",
+            ifname, target_vlan, duration, mode_names[output_mode],
+            tsn_capture_backend_name(cap), tsn_capture_ts_source(cap), rx_workers);
+
+    void *users[TSN_CAPTURE_MAX_WORKERS] = { 0 };
+    if (output_mode == 3) {
+        uint32_t flags = strcmp(tsn_capture_ts_source(cap), "hardware") == 0 ? TSN_REC_F_HWTS : 0;
+        rec_out = tsn_rec_create(out_path, tsn_capture_ts_resolution_ns(cap), flags, errbuf);
+        rec_bufs = calloc(rx_workers, sizeof(tsn_rec_buf_t));
+        if (!rec_out || !rec_bufs) {
+            fprintf(stderr, "record output: %s\n", rec_out ? "out of memory" : errbuf);
+            tsn_capture_group_close(g);
+            return 1;
+        }
+        for (int i = 0; i < rx_workers; i++) {
+            tsn_rec_buf_init(&rec_bufs[i], rec_out);
+            users[i] = &rec_bufs[i];
+        }
     }
 
-    fprintf(stderr, "Capturing on %s, VLAN %d, %ds, mode=%s\n",
-            ifname, target_vlan, duration,
-            output_mode == 0 ? "json" : (output_mode == 1 ? "stats" : "raw"));
+    if (shm_name) {
+        if (shm_hz < 1) shm_hz = 1;
+        if (shm_hz > 1000) shm_hz = 1000;
+        shm = tsn_shm_create(shm_name, "traffic-capture", errbuf);
+        if (!shm) {
+            fprintf(stderr, "shm: %s\n", errbuf);
+            tsn_rec_close(rec_out);
+            free(rec_bufs);
+            tsn_capture_group_close(g);
+            return 1;
+        }
+    }
 
     // Start stats thread
+    group = g;
     pthread_t stats_tid;
-    if (output_mode != 2) {
-        pthread_create(&stats_tid, NULL, stats_thread, NULL);
-    }
+    pthread_create(&stats_tid, NULL, stats_thread, NULL);
 
     // Capture
     start_time_us = get_time_us();
     uint64_t end_time_us = duration > 0 ? start_time_us + duration * 1000000ULL : UINT64_MAX;
 
+    int cpus[TSN_CAPTURE_MAX_WORKERS];
+    for (int i = 0; i < rx_workers; i++) cpus[i] = i % (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (tsn_capture_group_start(g, packet_handler, users, rx_workers > 1 ? cpus : NULL) < 0) {
+        fprintf(stderr, "capture: cannot start workers\n");
+        running = 0;
+    }
+
     while (running && get_time_us() < end_time_us) {
-        pcap_dispatch(handle, 100, packet_handler, NULL);
+        usleep(1000);
     }
 
     running = 0;
+    tsn_capture_group_stop(g);
 
     // Cleanup
-    if (output_mode != 2) {
-        pthread_join(stats_tid, NULL);
+    pthread_join(stats_tid, NULL);
+    if (shm) {
+        publish_shm();
+        tsn_shm_close(shm);
     }
-    pcap_close(handle);
 
     // Final output
-    if (output_mode == 0) {
+    if (json_stats()) {
         print_final_analysis();
     } else if (output_mode == 1) {
         print_stats_human();
+    } else if (output_mode == 2) {
+        fflush(stdout);
     }
 
-    return 0;
+    int rc = 0;
+    if (output_mode == 3) {
+        for (int i = 0; i < rx_workers; i++) tsn_rec_flush(&rec_bufs[i]);
+        fprintf(stderr, "Wrote %lu records to %s\n", tsn_rec_written(rec_out),
+                strcmp(out_path, "-") == 0 ? "stdout" : out_path);
+        if (tsn_rec_close(rec_out) < 0) rc = 1;
+        free(rec_bufs);
+    }
+
+    group = NULL;
+    tsn_capture_group_close(g);
+    return rc;
 }
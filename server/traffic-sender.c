@@ -1,247 +1,353 @@
 /*
  * Precision Traffic Sender for TSN/CBS Testing
- * Compile: gcc -O2 -o traffic-sender traffic-sender.c -lpthread -lrt
+ * Compile: make traffic-sender (links libtsntest.a)
  * Run: ./traffic-sender <interface> <dst_mac> <src_mac> <vlan_id> <tc_list> <pps> <duration> [frame_size]
+ *                       [--engine send|mmsg|ring] [--batch N]
+ *                       [--pacing hybrid|spin|sleep|txtime] [--base-time NS] [--cycle-ns NS]
+ *                       [--offset-ns NS] [--window-ns NS] [--lead-us US] [--prio N]
+ *                       [--clock NAME] [--per-tc] [--tc-pps LIST] [--cpus LIST]
+ *                       [--flows N] [--imix SPEC]
  * Example: ./traffic-sender enp11s0 FA:AE:C9:26:A4:08 00:e0:4c:68:13:36 100 "6,7" 5000 10 1000
+ *
+ * TX engines (tsn-tx.c):
+ *   send - one send() syscall per frame (default, most precise pacing)
+ *   mmsg - frames queued in batches and pushed with one sendmmsg() call
+ *   ring - frames written into an mmap'd PACKET_TX_RING and kicked once per batch
+ *          (falls back to mmsg if the ring cannot be set up)
+ * With mmsg/ring each batch is released at the scheduled time of its first frame,
+ * so a larger --batch gives more throughput at the cost of pacing precision.
+ *
+ * Pacing (tsn-pace.h; the JSON summary reports the send-time error):
+ *   hybrid - clock_nanosleep to a calibrated slack before each send time, then
+ *            busy-wait the last microseconds (default): close to spin precision
+ *            without holding the core, so RX and the web server can share the box
+ *   spin   - busy-wait on CLOCK_MONOTONIC until each send time
+ *   sleep  - clock_nanosleep only
+ *   Frames that fall behind schedule are sent back-to-back as one burst. Send
+ *   failures by errno, frames they lost and late slots are in the summary's
+ *   "instrumentation" object (tsn-instr.h).
+ *   txtime - tag every frame with an SO_TXTIME launch time on CLOCK_TAI and let the
+ *            ETF qdisc / NIC release it; the sender sleeps until --lead-us before
+ *            each launch instead of spinning. Launch times follow the GCL grid
+ *            base-time + k*cycle + offset (+ n*interval inside --window-ns), with
+ *            base-time advanced by whole cycles into the future like 802.1Qbv does.
+ *            Works with the send and mmsg engines; --prio sets SO_PRIORITY so the
+ *            frames reach the queue that carries the ETF qdisc. --clock NAME
+ *            takes --base-time in another time base (tsn-clock.h), e.g.
+ *            phc:IFACE for the switch's gPTP time, and carries it over to TAI.
+ *
+ * Workers:
+ *   default  - one thread, all TCs share one socket and one send timeline
+ *   --per-tc - one TX thread per TC, each with its own socket, SO_PRIORITY = TC
+ *              (unless --prio is given) so mqprio/taprio map it to that TC's
+ *              queue, its own timeline and rate (pps / TCs, or --tc-pps in
+ *              tc_list order), pinned to CPU i of --cpus (default CPU i). The
+ *              per-worker counters are merged into the one JSON summary.
+ *
+ * Stream mix (tsn-frame.h):
+ *   --flows N   - each TC's frame cycles through N flows (source IP/port), so
+ *                 RSS, flow tables and per-flow policers see real spread
+ *   --imix SPEC - frame sizes follow SPEC, "SIZE:WEIGHT,..." or "imix"
+ *                 (64:7,594:4,1518:1), instead of the fixed frame_size
+ *   Frames are patched in place from the prebuilt template with an
+ *   incremental IP checksum, so the send rate does not drop.
  */
 
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
-#include <errno.h>
-#include <time.h>
-#include <sched.h>
 #include <pthread.h>
-#include <sys/mman.h>
-#include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <net/if.h>
-#include <linux/if_packet.h>
-#include <linux/if_ether.h>
-#include <arpa/inet.h>
-
-#define MAX_TCS 8
-#define MAX_FRAME_SIZE 1518
-#define MIN_FRAME_SIZE 64
 
-// Frame buffer for each TC
-static unsigned char frames[MAX_TCS][MAX_FRAME_SIZE];
-static int frame_lens[MAX_TCS];
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-tx.h"
+#include "tsn-clock.h"
+#include "tsn-pace.h"
 
-// Statistics
-static unsigned long tx_counts[MAX_TCS];
-static unsigned long tx_bytes[MAX_TCS];
-static unsigned long total_tx = 0;
+#define MIN_FRAME_SIZE 64
 
-// Parse MAC address string to bytes
-int parse_mac(const char *str, unsigned char *mac) {
-    return sscanf(str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
-                  &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6 ? 0 : -1;
+// Frame for each TC
+static tsn_frame_t frames[TSN_MAX_TC];
+static tsn_frame_mix_t mix = { .flows = 1 };
+static bool vary;
+static tsn_pace_mode_t pace_mode = TSN_PACE_HYBRID;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <iface> <dst_mac> <src_mac> <vlan> <tc_list> <pps> <duration> [frame_size]\n", prog);
+    fprintf(stderr, "          [--engine send|mmsg|ring] [--batch N]\n");
+    fprintf(stderr, "          [--pacing hybrid|spin|sleep|txtime] [--base-time NS] [--cycle-ns NS]\n");
+    fprintf(stderr, "          [--offset-ns NS] [--window-ns NS] [--lead-us US] [--prio N] [--clock NAME]\n");
+    fprintf(stderr, "          [--per-tc] [--tc-pps LIST] [--cpus LIST]\n");
+    fprintf(stderr, "          [--flows N] [--imix SIZE:WEIGHT,...|imix]\n");
+    fprintf(stderr, "Example: %s enp11s0 FA:AE:C9:26:A4:08 00:e0:4c:68:13:36 100 \"6,7\" 5000 10 1000\n", prog);
+    fprintf(stderr, "\nFrame size default: 1000 bytes (gives ~8Mbps at 1000 pps per TC)\n");
+    fprintf(stderr, "Engine default: send. Batch default: %d (max %d), used by mmsg/ring\n",
+            TSN_TX_DEFAULT_BATCH, TSN_TX_MAX_BATCH);
+    fprintf(stderr, "Pacing default: hybrid (sleep, then spin the calibrated slack; TSN_PACE_SLACK_US)\n");
+    fprintf(stderr, "txtime pacing needs an ETF qdisc on the TX queue; times are CLOCK_TAI ns\n");
+    fprintf(stderr, "  (--base-time in --clock instead: realtime, tai, phc:IFACE, /dev/ptpN)\n");
+    fprintf(stderr, "--per-tc runs one pinned TX thread per TC on its own queue (SO_PRIORITY = TC)\n");
+    fprintf(stderr, "--flows/--imix vary source IP/port and frame size per frame (max %d flows)\n",
+            TSN_FRAME_MAX_FLOWS);
 }
 
-// Calculate IP checksum
-unsigned short ip_checksum(unsigned short *buf, int len) {
-    unsigned long sum = 0;
-    while (len > 1) {
-        sum += *buf++;
-        len -= 2;
+// One TX timeline: its TCs are sent round-robin from one socket
+typedef struct {
+    int tcs[TSN_MAX_TC];
+    int num_tcs;
+    uint64_t interval_ns;
+    int cpu;  // -1 = not pinned
+    bool realtime;
+    tsn_tx_t *tx;
+    tsn_pacer_t pacer;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint64_t end_ns;
+    pthread_t tid;
+} tx_worker_t;
+
+static tx_worker_t workers[TSN_MAX_TC];
+
+// "1,2,3" -> ints; returns the count (at most max)
+static int parse_int_list(const char *str, int *out, int max) {
+    int n = 0;
+    char *end;
+    while (*str && n < max) {
+        long v = strtol(str, &end, 10);
+        if (end == str) break;
+        out[n++] = (int)v;
+        str = *end == ',' ? end + 1 : end;
     }
-    if (len == 1)
-        sum += *(unsigned char *)buf;
-    sum = (sum >> 16) + (sum & 0xFFFF);
-    sum += (sum >> 16);
-    return (unsigned short)(~sum);
+    return n;
 }
 
-// Build Ethernet frame with VLAN tag and UDP payload
-int build_frame(unsigned char *frame, unsigned char *dst_mac, unsigned char *src_mac,
-                int vlan_id, int pcp, int target_frame_size) {
-    int offset = 0;
-
-    // Ethernet header (14 bytes)
-    memcpy(frame + offset, dst_mac, 6); offset += 6;
-    memcpy(frame + offset, src_mac, 6); offset += 6;
-
-    // 802.1Q VLAN tag (4 bytes)
-    frame[offset++] = 0x81;
-    frame[offset++] = 0x00;
-    unsigned short tci = ((pcp & 0x7) << 13) | (vlan_id & 0xFFF);
-    frame[offset++] = (tci >> 8) & 0xFF;
-    frame[offset++] = tci & 0xFF;
-
-    // EtherType: IPv4
-    frame[offset++] = 0x08;
-    frame[offset++] = 0x00;
-
-    // Calculate payload size to reach target frame size
-    // Header: 6+6+4+2 = 18 bytes Ethernet+VLAN
-    // IP header: 20 bytes, UDP header: 8 bytes
-    int payload_size = target_frame_size - 18 - 20 - 8;
-    if (payload_size < 10) payload_size = 10;
-    if (payload_size > 1472) payload_size = 1472;  // MTU limit
-
-    // IP header (20 bytes)
-    int ip_start = offset;
-    frame[offset++] = 0x45;  // Version + IHL
-    frame[offset++] = pcp << 5;  // DSCP = PCP, ECN = 0
-
-    int ip_total_len = 20 + 8 + payload_size;
-    frame[offset++] = (ip_total_len >> 8) & 0xFF;
-    frame[offset++] = ip_total_len & 0xFF;
-
-    frame[offset++] = 0x00; frame[offset++] = 0x00;  // ID
-    frame[offset++] = 0x00; frame[offset++] = 0x00;  // Flags + Fragment
-    frame[offset++] = 64;   // TTL
-    frame[offset++] = 17;   // Protocol: UDP
-    frame[offset++] = 0x00; frame[offset++] = 0x00;  // Checksum (placeholder)
-
-    // Source IP: 192.168.100.1
-    frame[offset++] = 192; frame[offset++] = 168; frame[offset++] = 100; frame[offset++] = 1;
-    // Dest IP: 192.168.100.2
-    frame[offset++] = 192; frame[offset++] = 168; frame[offset++] = 100; frame[offset++] = 2;
-
-    // Calculate IP checksum
-    unsigned short ip_cksum = ip_checksum((unsigned short *)(frame + ip_start), 20);
-    frame[ip_start + 10] = (ip_cksum >> 8) & 0xFF;
-    frame[ip_start + 11] = ip_cksum & 0xFF;
-
-    // UDP header (8 bytes)
-    int src_port = 10000 + pcp;
-    int dst_port = 20000 + pcp;
-    frame[offset++] = (src_port >> 8) & 0xFF;
-    frame[offset++] = src_port & 0xFF;
-    frame[offset++] = (dst_port >> 8) & 0xFF;
-    frame[offset++] = dst_port & 0xFF;
-
-    int udp_len = 8 + payload_size;
-    frame[offset++] = (udp_len >> 8) & 0xFF;
-    frame[offset++] = udp_len & 0xFF;
-    frame[offset++] = 0x00; frame[offset++] = 0x00;  // Checksum (optional)
-
-    // Payload with TC marker
-    frame[offset++] = 'T';
-    frame[offset++] = 'C';
-    frame[offset++] = '0' + pcp;
-    for (int i = 3; i < payload_size; i++) {
-        frame[offset++] = (i + pcp) & 0xFF;
-    }
+static void *tx_worker(void *arg) {
+    tx_worker_t *w = arg;
+    tsn_tx_t *tx = w->tx;
+    int batch = tsn_tx_batch(tx);
+    bool use_txtime = tsn_tx_txtime(tx);
 
-    return offset;
-}
+    if (w->cpu >= 0 && tsn_pin_cpu(w->cpu) < 0) {
+        fprintf(stderr, "Warning: cannot pin TX worker to CPU %d\n", w->cpu);
+    }
 
-// Get current time in nanoseconds
-static inline unsigned long get_time_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
-}
+    // Set real-time scheduling and lock memory (may fail without root)
+    if (w->realtime) tsn_setup_realtime(0);
+
+    // Workers start together; the final spin keeps their timelines aligned
+    tsn_pacer_wait(&w->pacer, w->start_ns, NULL);
+    uint64_t next_send = w->start_ns;
+    uint64_t tc_idx = 0;
+
+    // Each batch (one frame with the send engine) is released at the scheduled
+    // time of its first frame, queued in TC round-robin order. Behind
+    // schedule, the slots already due go out in the same burst
+    while (tsn_time_ns() - w->start_ns < w->duration_ns) {
+        int n = batch;
+        if (use_txtime) {
+            tsn_tx_sleep_until(tx, tsn_tx_launch(tx, tc_idx));
+        } else {
+            uint64_t now = tsn_pacer_wait(&w->pacer, next_send, NULL);
+            int due = tsn_pacer_due(&w->pacer, now, next_send, w->interval_ns, TSN_PACE_MAX_CATCHUP);
+            if (due > n) n = (due + batch - 1) / batch * batch;
+        }
 
-// Busy wait until target time
-static inline void wait_until(unsigned long target_ns) {
-    while (get_time_ns() < target_ns) {
-        // Spin
+        for (int b = 0; b < n; b++) {
+            int tc = w->tcs[tc_idx % w->num_tcs];
+            if (vary) tsn_frame_vary(&frames[tc], &mix);
+            tsn_tx_queue(tx, &frames[tc], tc, use_txtime ? tsn_tx_launch(tx, tc_idx) : 0);
+            tc_idx++;
+            next_send += w->interval_ns;
+        }
     }
-}
 
-// Parse TC list string like "6,7"
-int parse_tc_list(const char *str, int *tcs) {
-    int count = 0;
-    char *copy = strdup(str);
-    char *token = strtok(copy, ",");
-    while (token && count < MAX_TCS) {
-        tcs[count++] = atoi(token);
-        token = strtok(NULL, ",");
-    }
-    free(copy);
-    return count;
+    tsn_tx_finish(tx);
+    w->end_ns = tsn_time_ns();
+    return NULL;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 8) {
-        fprintf(stderr, "Usage: %s <iface> <dst_mac> <src_mac> <vlan> <tc_list> <pps> <duration> [frame_size]\n", argv[0]);
-        fprintf(stderr, "Example: %s enp11s0 FA:AE:C9:26:A4:08 00:e0:4c:68:13:36 100 \"6,7\" 5000 10 1000\n", argv[0]);
-        fprintf(stderr, "\nFrame size default: 1000 bytes (gives ~8Mbps at 1000 pps per TC)\n");
+    // Split "--option value" pairs from the positional arguments
+    const char *pos[16];
+    int npos = 0;
+    tsn_tx_opts_t opts;
+    tsn_tx_opts_init(&opts);
+    tsn_txtime_t *txtime = &opts.schedule;
+    bool per_tc = false;
+    int tc_pps[TSN_MAX_TC];
+    int n_tc_pps = 0;
+    int cpus[TSN_MAX_TC];
+    int n_cpus = 0;
+    const char *clock_name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "send") == 0) opts.engine = TSN_TX_SEND;
+            else if (strcmp(name, "mmsg") == 0) opts.engine = TSN_TX_MMSG;
+            else if (strcmp(name, "ring") == 0) opts.engine = TSN_TX_RING;
+            else {
+                fprintf(stderr, "Unknown engine: %s\n", name);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            opts.batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "txtime") == 0) opts.txtime = true;
+            else if (tsn_pace_mode_parse(name, &pace_mode) == 0) opts.txtime = false;
+            else {
+                fprintf(stderr, "Unknown pacing: %s\n", name);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--base-time") == 0 && i + 1 < argc) {
+            txtime->base_ns = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cycle-ns") == 0 && i + 1 < argc) {
+            txtime->cycle_ns = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--offset-ns") == 0 && i + 1 < argc) {
+            txtime->offset_ns = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--window-ns") == 0 && i + 1 < argc) {
+            txtime->window_ns = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--lead-us") == 0 && i + 1 < argc) {
+            txtime->lead_ns = strtoull(argv[++i], NULL, 10) * 1000ULL;
+        } else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc) {
+            clock_name = argv[++i];
+        } else if (strcmp(argv[i], "--prio") == 0 && i + 1 < argc) {
+            opts.so_priority = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--per-tc") == 0) {
+            per_tc = true;
+        } else if (strcmp(argv[i], "--tc-pps") == 0 && i + 1 < argc) {
+            n_tc_pps = parse_int_list(argv[++i], tc_pps, TSN_MAX_TC);
+        } else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            n_cpus = parse_int_list(argv[++i], cpus, TSN_MAX_TC);
+        } else if (strcmp(argv[i], "--flows") == 0 && i + 1 < argc) {
+            long n = atol(argv[++i]);
+            if (n < 1 || n > TSN_FRAME_MAX_FLOWS) {
+                fprintf(stderr, "--flows must be 1..%d\n", TSN_FRAME_MAX_FLOWS);
+                return 1;
+            }
+            mix.flows = n;
+        } else if (strcmp(argv[i], "--imix") == 0 && i + 1 < argc) {
+            if (tsn_frame_mix_parse_sizes(&mix, argv[++i]) < 0) {
+                fprintf(stderr, "Invalid --imix '%s' (SIZE:WEIGHT,... with weights up to %d in total, or imix)\n",
+                        argv[i], TSN_MIX_MAX_SIZES);
+                return 1;
+            }
+        } else if (npos < 16) {
+            pos[npos++] = argv[i];
+        }
+    }
+
+    if (npos < 7) {
+        usage(argv[0]);
         return 1;
     }
 
-    const char *ifname = argv[1];
-    const char *dst_mac_str = argv[2];
-    const char *src_mac_str = argv[3];
-    int vlan_id = atoi(argv[4]);
-    const char *tc_list_str = argv[5];
-    int pps = atoi(argv[6]);
-    int duration = atoi(argv[7]);
-    int frame_size = argc > 8 ? atoi(argv[8]) : 1000;  // Default 1000 bytes
+    const char *ifname = pos[0];
+    const char *dst_mac_str = pos[1];
+    const char *src_mac_str = pos[2];
+    int vlan_id = atoi(pos[3]);
+    const char *tc_list_str = pos[4];
+    int pps = atoi(pos[5]);
+    int duration = atoi(pos[6]);
+    int frame_size = npos > 7 ? atoi(pos[7]) : 1000;  // Default 1000 bytes
 
     if (frame_size < MIN_FRAME_SIZE) frame_size = MIN_FRAME_SIZE;
-    if (frame_size > MAX_FRAME_SIZE) frame_size = MAX_FRAME_SIZE;
+    if (frame_size > TSN_MAX_FRAME_SIZE) frame_size = TSN_MAX_FRAME_SIZE;
 
     unsigned char dst_mac[6], src_mac[6];
-    if (parse_mac(dst_mac_str, dst_mac) < 0 || parse_mac(src_mac_str, src_mac) < 0) {
+    if (tsn_parse_mac(dst_mac_str, dst_mac) < 0 || tsn_parse_mac(src_mac_str, src_mac) < 0) {
         fprintf(stderr, "Invalid MAC address format\n");
         return 1;
     }
 
-    int tcs[MAX_TCS];
-    int num_tcs = parse_tc_list(tc_list_str, tcs);
+    int tcs[TSN_MAX_TC];
+    int num_tcs = tsn_parse_tc_list(tc_list_str, tcs);
     if (num_tcs == 0) {
         fprintf(stderr, "No TCs specified\n");
         return 1;
     }
 
-    // Set real-time scheduling (may fail without root)
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
-        // Not critical, continue anyway
-    }
-
-    // Lock memory
-    mlockall(MCL_CURRENT | MCL_FUTURE);
-
-    // Create raw socket
-    int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
-    if (sock < 0) {
-        perror("socket");
-        return 1;
+    // Pre-build frames for each TC
+    for (int i = 0; i < num_tcs; i++) {
+        tsn_frame_spec_t spec = {
+            .dst_mac = dst_mac, .src_mac = src_mac,
+            .vlan_id = vlan_id, .pcp = tcs[i],
+            .frame_size = frame_size, .proto = TSN_FRAME_UDP,
+            .stream_id = (uint16_t)tcs[i]
+        };
+        tsn_frame_build(&frames[tcs[i]], &spec);
     }
 
-    // Get interface index
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
-    if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
-        perror("ioctl SIOCGIFINDEX");
-        close(sock);
-        return 1;
+    // SO_TXTIME launch times are on CLOCK_TAI: carry a base-time given in
+    // another time base over with the offset measured now
+    if (clock_name && txtime->base_ns) {
+        char errbuf[256];
+        tsn_clock_t src, tai;
+        int64_t offset;
+        uint64_t err;
+        if (tsn_clock_open(&src, clock_name, errbuf) < 0 || tsn_clock_open(&tai, "tai", errbuf) < 0) {
+            fprintf(stderr, "Error: %s\n", errbuf);
+            return 1;
+        }
+        if (tsn_clock_offset(&tai, &src, &offset, &err) < 0) {
+            fprintf(stderr, "Error: cannot read %s\n", clock_name);
+            return 1;
+        }
+        fprintf(stderr, "Base time %lu ns %s = %lu ns TAI (offset %ld ns +/- %lu ns)\n",
+                txtime->base_ns, src.name, txtime->base_ns + offset, offset, err);
+        txtime->base_ns += offset;
+        tsn_clock_close(&src);
     }
 
-    // Bind to interface
-    struct sockaddr_ll sll;
-    memset(&sll, 0, sizeof(sll));
-    sll.sll_family = AF_PACKET;
-    sll.sll_ifindex = ifr.ifr_ifindex;
-    sll.sll_protocol = htons(ETH_P_ALL);
-    if (bind(sock, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
-        perror("bind");
-        close(sock);
-        return 1;
-    }
+    // Calculate interval (PPS is total, divided among TCs)
+    // For CBS testing, we want high rate PER TC
+    uint64_t duration_ns = (uint64_t)duration * 1000000000ULL;
+    int num_workers = per_tc ? num_tcs : 1;
+
+    for (int k = 0; k < num_workers; k++) {
+        tx_worker_t *w = &workers[k];
+        int worker_pps = pps;
+        if (per_tc) {
+            w->tcs[0] = tcs[k];
+            w->num_tcs = 1;
+            worker_pps = k < n_tc_pps ? tc_pps[k] : pps / num_tcs;
+        } else {
+            memcpy(w->tcs, tcs, sizeof(tcs));
+            w->num_tcs = num_tcs;
+        }
+        if (worker_pps < 1) worker_pps = 1;
+        w->interval_ns = 1000000000ULL / worker_pps;
+        w->cpu = k < n_cpus ? cpus[k] : (per_tc ? k % (int)sysconf(_SC_NPROCESSORS_ONLN) : -1);
+        tsn_pacer_init(&w->pacer, pace_mode);
+        w->duration_ns = duration_ns;
+
+        // SCHED_FIFO spinners sharing a CPU would starve each other
+        w->realtime = true;
+        for (int j = 0; j < k; j++) {
+            if (w->cpu >= 0 && workers[j].cpu == w->cpu) w->realtime = workers[j].realtime = false;
+        }
 
-    // Pre-build frames for each TC
-    for (int i = 0; i < num_tcs; i++) {
-        frame_lens[tcs[i]] = build_frame(frames[tcs[i]], dst_mac, src_mac, vlan_id, tcs[i], frame_size);
+        // Each worker gets its own socket, so its TC lands on its own queue
+        tsn_tx_opts_t wopts = opts;
+        if (per_tc && wopts.so_priority < 0) wopts.so_priority = tcs[k];
+        wopts.schedule.interval_ns = w->interval_ns;
+        w->tx = tsn_tx_open(ifname, &wopts);
+        if (!w->tx) return 1;
     }
 
-    // Calculate interval (PPS is total, divided among TCs)
-    // For CBS testing, we want high rate PER TC
-    unsigned long interval_ns = 1000000000UL / pps;
-    unsigned long duration_ns = (unsigned long)duration * 1000000000UL;
+    tsn_tx_t *tx = workers[0].tx;
+    int batch = tsn_tx_batch(tx);
+    bool use_txtime = tsn_tx_txtime(tx);
+    const tsn_txtime_t *sched = tsn_tx_schedule(tx);
 
-    // Calculate expected bandwidth per TC
-    double bits_per_frame = frame_size * 8.0;
+    // Calculate expected bandwidth per TC (mean size of an --imix schedule)
+    vary = mix.flows > 1 || mix.n_sizes > 0;
+    double avg_size = mix.n_sizes ? tsn_frame_mix_avg_size(&mix) : frame_size;
+    double bits_per_frame = avg_size * 8.0;
     double pps_per_tc = (double)pps / num_tcs;
     double mbps_per_tc = (pps_per_tc * bits_per_frame) / 1000000.0;
 
@@ -250,67 +356,128 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "TCs: ");
     for (int i = 0; i < num_tcs; i++) fprintf(stderr, "%d ", tcs[i]);
     fprintf(stderr, "\n");
-    fprintf(stderr, "Frame size: %d bytes\n", frame_size);
-    fprintf(stderr, "Total PPS: %d (%.1f pps/TC)\n", pps, pps_per_tc);
-    fprintf(stderr, "Expected BW/TC: %.2f Mbps\n", mbps_per_tc);
+    if (mix.n_sizes) {
+        fprintf(stderr, "Frame size: mix of %d, avg %.1f bytes\n", mix.n_sizes, avg_size);
+    } else {
+        fprintf(stderr, "Frame size: %d bytes\n", frame_size);
+    }
+    if (mix.flows > 1) fprintf(stderr, "Flows/TC: %u\n", mix.flows);
+    if (per_tc) {
+        fprintf(stderr, "Workers: %d (one per TC)\n", num_workers);
+        for (int k = 0; k < num_workers; k++) {
+            fprintf(stderr, "  TC%d: %.1f pps, %.2f Mbps, CPU %d%s, SO_PRIORITY %d\n",
+                    workers[k].tcs[0], 1e9 / workers[k].interval_ns,
+                    1e9 / workers[k].interval_ns * bits_per_frame / 1e6, workers[k].cpu,
+                    workers[k].realtime ? "" : " (shared, no SCHED_FIFO)",
+                    opts.so_priority >= 0 ? opts.so_priority : workers[k].tcs[0]);
+        }
+    } else {
+        fprintf(stderr, "Total PPS: %d (%.1f pps/TC)\n", pps, pps_per_tc);
+        fprintf(stderr, "Expected BW/TC: %.2f Mbps\n", mbps_per_tc);
+    }
     fprintf(stderr, "Duration: %d sec\n", duration);
+    fprintf(stderr, "TX engine: %s (batch %d)\n", tsn_tx_engine_name(tsn_tx_engine(tx)), batch);
+    if (use_txtime) {
+        fprintf(stderr, "Pacing: txtime, base %lu ns TAI, cycle %lu ns, offset %lu ns, %lu/cycle\n",
+                sched->base_ns, sched->cycle_ns, sched->offset_ns, sched->per_cycle);
+    } else if (pace_mode == TSN_PACE_HYBRID) {
+        fprintf(stderr, "Pacing: hybrid (spin the last %.1f us)\n", workers[0].pacer.slack_ns / 1000.0);
+    } else {
+        fprintf(stderr, "Pacing: %s\n", tsn_pace_mode_name(pace_mode));
+    }
     fprintf(stderr, "========================\n");
 
-    // Initialize stats
-    memset(tx_counts, 0, sizeof(tx_counts));
-    memset(tx_bytes, 0, sizeof(tx_bytes));
-    total_tx = 0;
-
-    unsigned long start_time = get_time_ns();
-    unsigned long next_send = start_time;
-    int tc_idx = 0;
-
-    while (get_time_ns() - start_time < duration_ns) {
-        wait_until(next_send);
-
-        int tc = tcs[tc_idx % num_tcs];
-        ssize_t sent = send(sock, frames[tc], frame_lens[tc], 0);
-        if (sent > 0) {
-            tx_counts[tc]++;
-            tx_bytes[tc] += sent;
-            total_tx++;
+    // Single mode sends from this thread; per-TC workers start together a
+    // little later so every thread is pinned and spinning by then
+    uint64_t start_time = tsn_time_ns() + (per_tc ? 10000000ULL : 0);
+    for (int k = 0; k < num_workers; k++) workers[k].start_ns = start_time;
+
+    if (per_tc) {
+        for (int k = 0; k < num_workers; k++) {
+            if (pthread_create(&workers[k].tid, NULL, tx_worker, &workers[k]) != 0) {
+                perror("pthread_create");
+                return 1;
+            }
         }
-
-        tc_idx++;
-        next_send += interval_ns;
+        for (int k = 0; k < num_workers; k++) pthread_join(workers[k].tid, NULL);
+    } else {
+        tx_worker(&workers[0]);
     }
 
-    close(sock);
+    // Merge the per-worker counters
+    tsn_tx_stats_t merged;
+    memset(&merged, 0, sizeof(merged));
+    tsn_instr_t instr;
+    memset(&instr, 0, sizeof(instr));
+    uint64_t end_time = start_time;
+    for (int k = 0; k < num_workers; k++) {
+        tsn_tx_instr(workers[k].tx, &instr);
+        const tsn_tx_stats_t *ws = tsn_tx_stats(workers[k].tx);
+        for (int i = 0; i < TSN_MAX_TC; i++) {
+            merged.packets[i] += ws->packets[i];
+            merged.bytes[i] += ws->bytes[i];
+        }
+        merged.total += ws->total;
+        merged.txtime_dropped += ws->txtime_dropped;
+        if (workers[k].end_ns > end_time) end_time = workers[k].end_ns;
+        if (k > 0) tsn_pacer_merge(&workers[0].pacer, &workers[k].pacer);
+    }
+    const tsn_pacer_t *pacer = &workers[0].pacer;
+    instr.tx_late = pacer->late;
+    tsn_pctl_t send_err;
+    tsn_hist_pctl(&pacer->error, &send_err);
 
-    unsigned long end_time = get_time_ns();
+    const tsn_tx_stats_t *st = &merged;
     double actual_duration = (end_time - start_time) / 1e9;
-    double actual_pps = total_tx / actual_duration;
-
+    double actual_pps = st->total / actual_duration;
     // Print results to stderr
     fprintf(stderr, "\n=== Results ===\n");
     fprintf(stderr, "Duration: %.2f sec\n", actual_duration);
-    fprintf(stderr, "Total packets: %lu (%.1f pps)\n", total_tx, actual_pps);
-    for (int i = 0; i < MAX_TCS; i++) {
-        if (tx_counts[i] > 0) {
-            double tc_pps = tx_counts[i] / actual_duration;
-            double tc_mbps = (tx_bytes[i] * 8.0) / (actual_duration * 1000000.0);
-            fprintf(stderr, "TC%d: %lu pkts (%.1f pps, %.2f Mbps)\n", i, tx_counts[i], tc_pps, tc_mbps);
+    fprintf(stderr, "Total packets: %lu (%.1f pps)\n", st->total, actual_pps);
+    if (use_txtime) {
+        fprintf(stderr, "Dropped by ETF (missed/invalid launch time): %lu\n", st->txtime_dropped);
+    } else {
+        fprintf(stderr, "Send-time error: p50 %.1f us, p99 %.1f us, max %.1f us (%lu frames caught up)\n",
+                send_err.p50, send_err.p99, send_err.max, pacer->catchup);
+    }
+    for (int i = 0; i < TSN_MAX_TC; i++) {
+        if (st->packets[i] > 0) {
+            double tc_pps = st->packets[i] / actual_duration;
+            double tc_mbps = (st->bytes[i] * 8.0) / (actual_duration * 1000000.0);
+            fprintf(stderr, "TC%d: %lu pkts (%.1f pps, %.2f Mbps)\n", i, st->packets[i], tc_pps, tc_mbps);
         }
     }
+    tsn_instr_print_human(stderr, &instr);
 
     // Print JSON result to stdout
     printf("{\"success\":true,\"duration\":%.2f,\"total\":%lu,\"pps\":%.1f,\"sent\":{",
-           actual_duration, total_tx, actual_pps);
+           actual_duration, st->total, actual_pps);
     int first = 1;
-    for (int i = 0; i < MAX_TCS; i++) {
-        if (tx_counts[i] > 0) {
-            double tc_mbps = (tx_bytes[i] * 8.0) / (actual_duration * 1000000.0);
+    for (int i = 0; i < TSN_MAX_TC; i++) {
+        if (st->packets[i] > 0) {
+            double tc_mbps = (st->bytes[i] * 8.0) / (actual_duration * 1000000.0);
             if (!first) printf(",");
-            printf("\"%d\":{\"packets\":%lu,\"bytes\":%lu,\"mbps\":%.2f}", i, tx_counts[i], tx_bytes[i], tc_mbps);
+            printf("\"%d\":{\"packets\":%lu,\"bytes\":%lu,\"mbps\":%.2f}", i, st->packets[i], st->bytes[i], tc_mbps);
             first = 0;
         }
     }
-    printf("}}\n");
+    printf("}");
+    if (per_tc) {
+        printf(",\"workers\":%d", num_workers);
+    }
+    if (use_txtime) {
+        printf(",\"pacing\":\"txtime\",\"base_time_ns\":%lu,\"txtime_dropped\":%lu",
+               sched->base_ns, st->txtime_dropped);
+    } else {
+        printf(",\"pacing\":\"%s\",\"slack_us\":%.1f,\"send_error_us\":{\"p50\":%.3f,\"p90\":%.3f,"
+               "\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f},\"catchup_frames\":%lu",
+               tsn_pace_mode_name(pace_mode), pacer->slack_ns / 1000.0, send_err.p50, send_err.p90,
+               send_err.p99, send_err.p999, send_err.max, pacer->catchup);
+    }
+    printf(",");
+    tsn_instr_print_json(stdout, &instr);
+    printf("}\n");
 
+    for (int k = 0; k < num_workers; k++) tsn_tx_close(workers[k].tx);
     return 0;
 }
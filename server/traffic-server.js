@@ -3,6 +3,8 @@ import cors from 'cors';
 import { spawn, execSync } from 'child_process';
 import path from 'path';
 import { fileURLToPath } from 'url';
+import { TsnDaemonClient, commandArgs } from './lib/tsn-daemon.js';
+import { ShmStatsReader } from './lib/tsn-stats-shm.js';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 const app = express();
@@ -15,6 +17,14 @@ let activeProcess = null;
 let stats = null;
 let cSenderProcess = null;
 
+// A running tsn-daemon replaces the spawned C sender (no per-test startup)
+const daemon = new TsnDaemonClient();
+daemon.on('send_done', (result) => console.log('C sender result (daemon):', result));
+daemon.on('error', () => {});
+daemon.connect({ subscribe: false })
+  .then(() => console.log(`Using tsn-daemon at ${daemon.socketPath}`))
+  .catch(() => {});
+
 function getInterfaceMac(ifaceName) {
   try {
     const result = execSync(`cat /sys/class/net/${ifaceName}/address 2>/dev/null || echo "00:00:00:00:00:00"`, { encoding: 'utf8' });
@@ -55,6 +65,17 @@ app.post('/api/traffic/start-precision', (req, res) => {
   }
 
   const sourceMac = srcMac || getInterfaceMac(ifaceName);
+  const config = { interface: ifaceName, dstMac, srcMac: sourceMac, vlanId, tcList, packetsPerSecond, duration };
+
+  if (daemon.connected) {
+    const args = commandArgs({ iface: ifaceName, dst: dstMac, src: sourceMac, vlan: vlanId, tcs: tcList, pps: packetsPerSecond, duration });
+    daemon.command('send stop').catch(() => {});
+    daemon.command(`send start ${args}`)
+      .then(() => res.json({ success: true, message: 'Precision traffic started (daemon)', config }))
+      .catch((err) => res.status(500).json({ error: err.message }));
+    return;
+  }
+
   const tcListStr = Array.isArray(tcList) ? tcList.join(',') : String(tcList);
   const senderPath = path.join(__dirname, 'traffic-sender');
 
@@ -85,13 +106,14 @@ app.post('/api/traffic/start-precision', (req, res) => {
       cSenderProcess = null;
     });
 
-    res.json({ success: true, message: 'Precision traffic started (C)', config: { interface: ifaceName, dstMac, srcMac: sourceMac, vlanId, tcList, packetsPerSecond, duration } });
+    res.json({ success: true, message: 'Precision traffic started (C)', config });
   } catch (err) {
     res.status(500).json({ error: err.message });
   }
 });
 
 app.post('/api/traffic/stop-precision', (req, res) => {
+  if (daemon.connected) daemon.command('send stop').catch(() => {});
   if (cSenderProcess) {
     try { cSenderProcess.kill('SIGTERM'); } catch {}
     cSenderProcess = null;
@@ -152,6 +174,17 @@ app.post('/api/traffic/stop', (req, res) => {
   res.json({ success: true, stats: stats ? { sent: stats.sent, total: stats.total } : null });
 });
 
+// Live stats of a tool run with --shm NAME, read straight from /dev/shm
+const shmReaders = new Map();
+app.get('/api/traffic/live-stats/:name', (req, res) => {
+  const { name } = req.params;
+  if (!/^[\w.-]+$/.test(name)) return res.status(400).json({ error: 'Invalid name' });
+  if (!shmReaders.has(name)) shmReaders.set(name, new ShmStatsReader(name));
+  const stats = shmReaders.get(name).read();
+  if (!stats) return res.status(404).json({ error: `No stats block ${name}` });
+  res.json(stats);
+});
+
 app.get('/api/traffic/status', (req, res) => {
   if (stats?.running) {
     res.json({ running: true, sent: stats.sent, total: stats.total, elapsed: Date.now() - stats.startTime });
@@ -0,0 +1,303 @@
+/*
+ * tsn-analysis.c - Per-TC streaming traffic analysis (libtsntest)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "tsn-analysis.h"
+
+void tsn_hist_init(tsn_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+// Lowest value mapped to bucket i and the bucket width
+static void hist_bucket(int i, uint64_t *lo, uint64_t *width) {
+    if (i < (1 << TSN_HIST_SUB_BITS)) {
+        *lo = i;
+        *width = 1;
+        return;
+    }
+    int shift = (i >> TSN_HIST_SUB_BITS) - 1;
+    uint64_t sub = i & ((1 << TSN_HIST_SUB_BITS) - 1);
+    *lo = ((1ULL << TSN_HIST_SUB_BITS) + sub) << shift;
+    *width = 1ULL << shift;
+}
+
+uint64_t tsn_hist_quantile(const tsn_hist_t *h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)ceil(q * h->count);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < TSN_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen < rank) continue;
+
+        uint64_t lo, width;
+        hist_bucket(i, &lo, &width);
+        uint64_t v = lo + width / 2;
+        if (v < h->min) v = h->min;
+        if (v > h->max) v = h->max;
+        return v;
+    }
+    return h->max;
+}
+
+void tsn_hist_pctl(const tsn_hist_t *h, tsn_pctl_t *out) {
+    out->p50 = tsn_hist_quantile(h, 0.50) / 1000.0;
+    out->p90 = tsn_hist_quantile(h, 0.90) / 1000.0;
+    out->p99 = tsn_hist_quantile(h, 0.99) / 1000.0;
+    out->p999 = tsn_hist_quantile(h, 0.999) / 1000.0;
+    out->max = h->max / 1000.0;
+}
+
+double tsn_hist_stddev(const tsn_hist_t *h) {
+    if (h->count < 2) return 0;
+    double sum = 0, sq = 0;
+    for (int i = 0; i < TSN_HIST_BUCKETS; i++) {
+        if (!h->buckets[i]) continue;
+        uint64_t lo, width;
+        hist_bucket(i, &lo, &width);
+        double v = lo + width / 2;
+        sum += v * h->buckets[i];
+        sq += v * v * h->buckets[i];
+    }
+    double mean = sum / h->count;
+    double var = sq / h->count - mean * mean;
+    return var > 0 ? sqrt(var) : 0;
+}
+
+void tsn_stream_init(tsn_stream_t *s, uint64_t burst_gap_ns, uint64_t max_gap_ns) {
+    memset(s, 0, sizeof(*s));
+    s->burst_gap_ns = burst_gap_ns;
+    s->max_gap_ns = max_gap_ns ? max_gap_ns : UINT64_MAX;
+}
+
+void tsn_stream_free(tsn_stream_t *s) {
+    for (int i = 0; i < s->n_phases; i++) free(s->phases[i].bins);
+    s->n_phases = 0;
+    free(s->arrivals);
+    s->arrivals = NULL;
+    s->n_arrivals = s->max_arrivals = 0;
+}
+
+int tsn_stream_keep_arrivals(tsn_stream_t *s, uint32_t max) {
+    free(s->arrivals);
+    s->arrivals = malloc((size_t)max * sizeof(uint32_t));
+    if (!s->arrivals) return -1;
+    s->n_arrivals = 0;
+    s->max_arrivals = max;
+    return 0;
+}
+
+int tsn_stream_add_phase(tsn_stream_t *s, uint64_t cycle_ns, int n_bins, uint64_t min_bin_ns) {
+    if (cycle_ns == 0 || n_bins < 1 || s->n_phases >= TSN_MAX_PHASES) return -1;
+    if (tsn_stream_phase(s, cycle_ns)) return 0;
+
+    uint64_t n = n_bins;
+    if (min_bin_ns > 0 && cycle_ns / n < min_bin_ns) n = cycle_ns / min_bin_ns;
+    if (n == 0) n = 1;
+
+    tsn_phase_hist_t *p = &s->phases[s->n_phases];
+    p->bins = calloc(n, sizeof(uint32_t));
+    if (!p->bins) return -1;
+    p->cycle_ns = cycle_ns;
+    p->n_bins = (uint32_t)n;
+    for (uint32_t i = 0; i < s->n_arrivals; i++) {
+        p->bins[s->arrivals[i] % cycle_ns * n / cycle_ns]++;
+    }
+    p->count = s->n_arrivals;
+    s->n_phases++;
+    return 0;
+}
+
+const tsn_phase_hist_t *tsn_stream_phase(const tsn_stream_t *s, uint64_t cycle_ns) {
+    for (int i = 0; i < s->n_phases; i++) {
+        if (s->phases[i].cycle_ns == cycle_ns) return &s->phases[i];
+    }
+    return NULL;
+}
+
+// Close the current burst and account the gap to the next one
+static inline void burst_close(tsn_stream_t *s, uint64_t next_start_ns) {
+    tsn_burst_t *b = &s->cur_burst;
+    s->total_burst_ns += b->end_ns - b->start_ns;
+    s->total_gap_ns += next_start_ns - b->end_ns;
+    if (b->bytes > s->max_burst_bytes) s->max_burst_bytes = b->bytes;
+}
+
+void tsn_stream_add(tsn_stream_t *s, uint64_t ts_ns, uint16_t len) {
+    if (s->count == 0) {
+        s->first_ts = ts_ns;
+        if (s->burst_gap_ns) {
+            s->cur_burst = (tsn_burst_t){ ts_ns, ts_ns, len, 1 };
+            s->burst_count = 1;
+        }
+    } else {
+        uint64_t gap = ts_ns - s->last_ts;
+        if (gap <= s->max_gap_ns) {
+            tsn_welford_add(&s->interval, (double)gap);
+            tsn_hist_add(&s->interval_hist, gap);
+        }
+
+        if (s->burst_gap_ns) {
+            if (gap > s->burst_gap_ns) {
+                burst_close(s, ts_ns);
+                s->cur_burst = (tsn_burst_t){ ts_ns, ts_ns, len, 1 };
+                s->burst_count++;
+            } else {
+                s->cur_burst.end_ns = ts_ns;
+                s->cur_burst.bytes += len;
+                s->cur_burst.packets++;
+            }
+        }
+    }
+
+    uint64_t since_first = ts_ns - s->first_ts;
+    if (s->n_arrivals < s->max_arrivals && since_first <= UINT32_MAX) {
+        s->arrivals[s->n_arrivals++] = (uint32_t)since_first;
+    }
+
+    for (int i = 0; i < s->n_phases; i++) {
+        tsn_phase_hist_t *p = &s->phases[i];
+        uint64_t offset = since_first % p->cycle_ns;
+        p->bins[offset * p->n_bins / p->cycle_ns]++;
+        p->count++;
+    }
+
+    s->count++;
+    s->total_bytes += len;
+    s->last_ts = ts_ns;
+}
+
+void tsn_burst_stats(const tsn_stream_t *s, tsn_burst_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+
+    double duration_s = (s->last_ts - s->first_ts) / 1e9;
+    if (duration_s <= 0) return;
+
+    out->measured_bps = (s->total_bytes * 8.0) / duration_s;
+    if (s->burst_count == 0) return;
+
+    // The open burst counts like a closed one, without a trailing gap
+    const tsn_burst_t *b = &s->cur_burst;
+    double total_burst_us = (s->total_burst_ns + (b->end_ns - b->start_ns)) / 1e3;
+    double max_bytes = s->max_burst_bytes > b->bytes ? s->max_burst_bytes : b->bytes;
+
+    out->max_burst_bytes = max_bytes;
+    out->avg_burst_us = total_burst_us / s->burst_count;
+    out->avg_gap_us = s->burst_count > 1 ? s->total_gap_ns / 1e3 / (s->burst_count - 1) : 0;
+    out->burst_ratio = total_burst_us / (duration_s * 1e6);
+}
+
+uint64_t tsn_interval_stats(const tsn_stream_t *s, double *avg_us, double *stddev_us) {
+    *avg_us = s->interval.mean / 1000.0;
+    *stddev_us = tsn_welford_stddev(&s->interval) / 1000.0;
+    return s->interval.n;
+}
+
+void tsn_seq_init(tsn_seq_t *q) {
+    memset(q, 0, sizeof(*q));
+}
+
+static inline void seq_mark(tsn_seq_t *q, uint32_t seq) {
+    uint32_t i = seq % TSN_SEQ_WINDOW;
+    q->seen[i / 64] |= 1ULL << (i % 64);
+}
+
+static inline int seq_seen(const tsn_seq_t *q, uint32_t seq) {
+    uint32_t i = seq % TSN_SEQ_WINDOW;
+    return (q->seen[i / 64] >> (i % 64)) & 1;
+}
+
+void tsn_seq_add(tsn_seq_t *q, uint32_t seq, int64_t latency_ns) {
+    if (q->received == 0) {
+        q->first_seq = q->highest_seq = seq;
+        q->span = 1;
+        seq_mark(q, seq);
+    } else {
+        int32_t ahead = (int32_t)(seq - q->highest_seq);  // wraps at 2^32
+        if (ahead > 0) {
+            // Forget the slots the window slides over
+            if (ahead >= TSN_SEQ_WINDOW) {
+                memset(q->seen, 0, sizeof(q->seen));
+            } else {
+                for (uint32_t s = q->highest_seq + 1; s != seq; s++) {
+                    uint32_t i = s % TSN_SEQ_WINDOW;
+                    q->seen[i / 64] &= ~(1ULL << (i % 64));
+                }
+            }
+            q->highest_seq = seq;
+            q->span += ahead;
+            seq_mark(q, seq);
+        } else if (-(int64_t)ahead < TSN_SEQ_WINDOW) {
+            if (seq_seen(q, seq)) {
+                q->duplicates++;
+                q->received++;
+                return;
+            }
+            seq_mark(q, seq);
+            q->reordered++;
+        } else {
+            q->reordered++;  // too late to check for a duplicate
+        }
+    }
+    q->received++;
+
+    if (q->lat_count == 0 || latency_ns < q->lat_min) q->lat_min = latency_ns;
+    if (q->lat_count == 0 || latency_ns > q->lat_max) q->lat_max = latency_ns;
+    q->lat_count++;
+    q->lat_sum += latency_ns;
+    tsn_hist_add(&q->lat_hist, latency_ns > 0 ? (uint64_t)latency_ns : 0);
+}
+
+void tsn_seq_stats(const tsn_seq_t *q, tsn_seq_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->received = q->received;
+    out->duplicates = q->duplicates;
+    out->reordered = q->reordered;
+
+    uint64_t unique = q->received - q->duplicates;
+    out->lost = q->span > unique ? q->span - unique : 0;
+
+    if (q->lat_count == 0) return;
+    out->lat_min_us = q->lat_min / 1000.0;
+    out->lat_max_us = q->lat_max / 1000.0;
+    out->lat_avg_us = q->lat_sum / q->lat_count / 1000.0;
+    tsn_hist_pctl(&q->lat_hist, &out->lat);
+}
+
+int tsn_detect_windows(const uint32_t *hist, int n_bins, uint32_t threshold, uint64_t cycle_ns,
+                       tsn_window_t *windows, int max) {
+    int n = 0;
+    int window_start = -1;
+    int last_end = -1;
+
+    for (int i = 0; i <= n_bins; i++) {
+        int has_traffic = i < n_bins && hist[i] >= threshold;
+
+        if (has_traffic && window_start < 0) {
+            window_start = i;
+        } else if (!has_traffic && window_start >= 0) {
+            if (n < max) {
+                tsn_window_t *w = &windows[n++];
+                w->start_offset_ns = (uint64_t)window_start * cycle_ns / n_bins;
+                w->duration_ns = (uint64_t)i * cycle_ns / n_bins - w->start_offset_ns;
+                last_end = i;
+            }
+            window_start = -1;
+        }
+    }
+
+    // A window running into the cycle boundary continues at bin 0: merge them
+    if (n > 1 && last_end == n_bins && windows[0].start_offset_ns == 0) {
+        tsn_window_t *last = &windows[n - 1];
+        windows[0].start_offset_ns = last->start_offset_ns;
+        windows[0].duration_ns += last->duration_ns;
+        if (windows[0].duration_ns > cycle_ns) windows[0].duration_ns = cycle_ns;
+        n--;
+    }
+    return n;
+}
@@ -0,0 +1,224 @@
+/*
+ * tsn-analysis.h - Per-TC traffic analysis shared by the TSN RX tools (libtsntest)
+ *
+ * Everything is computed online, one packet at a time, in constant memory:
+ *   intervals - Welford mean / variance and a log-linear histogram of
+ *               inter-arrival times
+ *   bursts    - split at gaps as packets arrive, CBS burst/gap statistics
+ *   phase     - running histograms of arrival phase for known cycles, used
+ *               for TAS gate window detection
+ *   arrivals  - an optional bounded sample of the first arrivals, which the
+ *               cycle search in tsn-cycle.h folds at arbitrary periods
+ *   sequence  - loss / duplicate / reorder counts and one-way latency from the
+ *               test header (tsn-frame.h)
+ * so long soak tests never fill up or truncate a packet array.
+ */
+
+#ifndef TSN_ANALYSIS_H
+#define TSN_ANALYSIS_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Welford running mean / variance
+typedef struct {
+    uint64_t n;
+    double mean;
+    double m2;
+} tsn_welford_t;
+
+static inline void tsn_welford_add(tsn_welford_t *w, double x) {
+    w->n++;
+    double d = x - w->mean;
+    w->mean += d / w->n;
+    w->m2 += d * (x - w->mean);
+}
+
+// Population standard deviation
+static inline double tsn_welford_stddev(const tsn_welford_t *w) {
+    return w->n > 0 ? sqrt(w->m2 / w->n) : 0;
+}
+
+/*
+ * Log-linear histogram: values below 2^SUB_BITS get one bucket each, every
+ * power of two above is split into 2^SUB_BITS equal buckets, so each bucket is
+ * within 1/32 (3%) of its value. Values up to 2^MAX_BITS ns (~18 min) fit in
+ * under 5 KB; larger ones land in the last bucket (max stays exact).
+ */
+#define TSN_HIST_SUB_BITS 5
+#define TSN_HIST_MAX_BITS 40
+#define TSN_HIST_BUCKETS ((TSN_HIST_MAX_BITS - TSN_HIST_SUB_BITS + 2) << TSN_HIST_SUB_BITS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint32_t buckets[TSN_HIST_BUCKETS];
+} tsn_hist_t;
+
+// Percentile summary in microseconds
+typedef struct {
+    double p50;
+    double p90;
+    double p99;
+    double p999;
+    double max;
+} tsn_pctl_t;
+
+static inline int tsn_hist_index(uint64_t v) {
+    if (v < (1ULL << TSN_HIST_SUB_BITS)) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    if (msb > TSN_HIST_MAX_BITS) return TSN_HIST_BUCKETS - 1;
+    int shift = msb - TSN_HIST_SUB_BITS;
+    return ((shift + 1) << TSN_HIST_SUB_BITS) + (int)((v >> shift) - (1ULL << TSN_HIST_SUB_BITS));
+}
+
+static inline void tsn_hist_add(tsn_hist_t *h, uint64_t v) {
+    if (h->count == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->count++;
+    h->buckets[tsn_hist_index(v)]++;
+}
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint32_t bytes;
+    uint32_t packets;
+} tsn_burst_t;
+
+typedef struct {
+    double measured_bps;     // bytes over first..last timestamp
+    double burst_ratio;      // time inside bursts / total time
+    double avg_burst_us;
+    double avg_gap_us;
+    double max_burst_bytes;
+} tsn_burst_stats_t;
+
+// Arrival phase histogram for one cycle length; the phase origin is the
+// first packet of the stream
+typedef struct {
+    uint64_t cycle_ns;
+    uint32_t n_bins;
+    uint32_t *bins;
+    uint64_t count;  // packets in bins
+} tsn_phase_hist_t;
+
+#define TSN_MAX_PHASES 16
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_bytes;
+    uint64_t first_ts;
+    uint64_t last_ts;
+
+    // Inter-arrival times (ns), gaps above max_gap_ns are left out
+    uint64_t max_gap_ns;
+    tsn_welford_t interval;
+    tsn_hist_t interval_hist;
+
+    // Bursts: a gap above burst_gap_ns closes the current burst
+    uint64_t burst_gap_ns;
+    tsn_burst_t cur_burst;
+    uint64_t burst_count;
+    uint64_t total_burst_ns;
+    uint64_t total_gap_ns;
+    uint32_t max_burst_bytes;
+
+    tsn_phase_hist_t phases[TSN_MAX_PHASES];
+    int n_phases;
+
+    // First arrivals in ns after first_ts (at most max_arrivals, within 2^32 ns)
+    uint32_t *arrivals;
+    uint32_t n_arrivals;
+    uint32_t max_arrivals;
+} tsn_stream_t;
+
+typedef struct {
+    uint64_t start_offset_ns;  // offset from cycle start
+    uint64_t duration_ns;
+} tsn_window_t;
+
+// Sequence numbers seen within this distance below the highest one are
+// remembered, so duplicates can be told apart from late (reordered) frames
+#define TSN_SEQ_WINDOW 1024
+
+typedef struct {
+    uint64_t received;
+    uint64_t duplicates;
+    uint64_t reordered;      // arrived after a higher sequence number
+    uint32_t first_seq;
+    uint32_t highest_seq;
+    uint64_t span;           // highest - first + 1, across wraps
+    uint64_t seen[TSN_SEQ_WINDOW / 64];
+
+    // One-way latency, rx - tx timestamp (ns)
+    uint64_t lat_count;
+    int64_t lat_min;
+    int64_t lat_max;
+    double lat_sum;
+    tsn_hist_t lat_hist;     // negative latencies (clock offset) count as 0
+} tsn_seq_t;
+
+typedef struct {
+    uint64_t received;
+    uint64_t lost;
+    uint64_t duplicates;
+    uint64_t reordered;
+    double lat_min_us;
+    double lat_avg_us;
+    double lat_max_us;
+    tsn_pctl_t lat;
+} tsn_seq_stats_t;
+
+void tsn_hist_init(tsn_hist_t *h);
+
+// Value at quantile q (0..1): midpoint of its bucket, clamped to min..max
+uint64_t tsn_hist_quantile(const tsn_hist_t *h, double q);
+
+// p50/p90/p99/p99.9/max in us
+void tsn_hist_pctl(const tsn_hist_t *h, tsn_pctl_t *out);
+
+// Stddev from the bucket midpoints (ns), for counters kept without a Welford
+double tsn_hist_stddev(const tsn_hist_t *h);
+
+// burst_gap_ns = 0 disables burst tracking; max_gap_ns = 0 keeps every interval
+void tsn_stream_init(tsn_stream_t *s, uint64_t burst_gap_ns, uint64_t max_gap_ns);
+void tsn_stream_free(tsn_stream_t *s);
+
+// Track the arrival phase modulo cycle_ns in n_bins bins (never narrower than
+// min_bin_ns). Added after the first packet, the histogram starts from the
+// arrival sample and counts every packet from then on. Returns 0 or -1.
+int tsn_stream_add_phase(tsn_stream_t *s, uint64_t cycle_ns, int n_bins, uint64_t min_bin_ns);
+
+// Keep the first max arrivals for tsn_cycle_search(). Must be called before the
+// first packet. Returns 0 or -1.
+int tsn_stream_keep_arrivals(tsn_stream_t *s, uint32_t max);
+
+// Account one packet (timestamps in capture order)
+void tsn_stream_add(tsn_stream_t *s, uint64_t ts_ns, uint16_t len);
+
+// Phase histogram tracked for cycle_ns, or NULL
+const tsn_phase_hist_t *tsn_stream_phase(const tsn_stream_t *s, uint64_t cycle_ns);
+
+// Throughput and burst/gap timing, counting the burst still open
+void tsn_burst_stats(const tsn_stream_t *s, tsn_burst_stats_t *out);
+
+// Mean and stddev of inter-arrival times in us; returns the interval count.
+// Tail percentiles: tsn_hist_pctl(&s->interval_hist, ...)
+uint64_t tsn_interval_stats(const tsn_stream_t *s, double *avg_us, double *stddev_us);
+
+void tsn_seq_init(tsn_seq_t *q);
+
+// Account one frame carrying seq, received latency_ns after its TX timestamp
+void tsn_seq_add(tsn_seq_t *q, uint32_t seq, int64_t latency_ns);
+
+// Lost = sequence numbers never seen between the first and the highest
+void tsn_seq_stats(const tsn_seq_t *q, tsn_seq_stats_t *out);
+
+// Runs of bins with at least threshold packets, merged across the cycle
+// boundary. Returns the window count.
+int tsn_detect_windows(const uint32_t *hist, int n_bins, uint32_t threshold, uint64_t cycle_ns,
+                       tsn_window_t *windows, int max);
+
+#endif
@@ -0,0 +1,1451 @@
+/*
+ * tsn-capture.c - TPACKET_V3 / libpcap / pcap-file capture backend for the TSN RX tools
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <pcap/pcap.h>
+
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-capture.h"
+#include "tsn-record.h"
+
+// TPACKET_V3 ring geometry: 64 blocks of 256 KB
+#define RING_BLOCK_SIZE (1 << 18)
+#define RING_BLOCK_NR 64
+#define RING_FRAME_SIZE 2048
+
+// File backend
+#define FILE_BATCH 256        // records per dispatch
+#define FILE_MAX_IFACES 16    // pcapng interfaces per section
+#define FILE_FEED_BLOCKS 16   // blocks in flight from the file group parser to a worker
+#define FILE_FEED_WAIT_US 50  // parser: worker queue full, worker: queue empty
+#define PCAP_MAGIC_US 0xA1B2C3D4
+#define PCAP_MAGIC_NS 0xA1B23C4D
+#define PCAPNG_SHB 0x0A0D0D0A
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_PB 0x00000002   // obsolete Packet Block
+#define PCAPNG_EPB 0x00000006
+#define PCAPNG_BOM 0x1A2B3C4D
+#define LINKTYPE_ETHERNET 1
+
+// pcapng interface: timestamp units and offset
+typedef struct {
+    uint16_t linktype;
+    uint8_t tsresol;       // if_tsresol: 10^-n, or 2^-n with the top bit set
+    int64_t tsoffset_s;
+} file_iface_t;
+
+// A frame the file group parser found: record or packet data in the mapping
+typedef struct {
+    size_t off;
+    uint64_t ts_ns;
+    uint32_t caplen;
+    uint32_t len;
+} file_frame_t;
+
+typedef struct {
+    int n;
+    file_frame_t frames[FILE_BATCH];
+} file_block_t;
+
+// Single-producer single-consumer block queue from the parser to one worker
+typedef struct {
+    unsigned int head __attribute__((aligned(64)));  // blocks published (parser)
+    int eof;                                         // set after the last block: 1, or -1 on a truncated file
+    unsigned int tail __attribute__((aligned(64)));  // blocks consumed (worker)
+    file_block_t blocks[FILE_FEED_BLOCKS];
+} file_feed_t;
+
+struct tsn_capture {
+    tsn_capture_backend_t backend;
+    char ifname[IFNAMSIZ];
+    int snaplen;
+    int timeout_ms;
+    volatile int breakloop;
+
+    // pcap backend
+    pcap_t *pcap;
+    tsn_capture_handler_t handler;
+    void *user;
+
+    // tpacket backend
+    int fd;
+    uint8_t *ring;
+    size_t ring_len;
+    unsigned int block_idx;
+    unsigned int block_nr;
+
+    // file backend
+    const uint8_t *map;
+    size_t map_len;
+    size_t off;
+    int pcapng;
+    int records;           // tsn-record file
+    int swapped;           // file byte order differs from ours
+    int nsec;              // classic pcap with nanosecond timestamps
+    file_iface_t ifaces[FILE_MAX_IFACES];
+    int n_ifaces;
+    int eof;
+    file_feed_t *feed;     // file group worker: frames come from the parser, the map is shared
+    int feed_pos;          // next frame of the current block
+    struct bpf_program file_filter;
+    int has_filter;
+
+    int hw_ts;
+    uint32_t ts_resolution_ns;
+    tsn_instr_t kernel;    // kernel counters (cumulative), updated by tsn_capture_instr()
+    tsn_stage_t stage[TSN_STAGES];      // rx / handler, dispatching thread only
+    tsn_stage_t stage_pub[TSN_STAGES];  // their copy after the last dispatch (seqlock)
+    uint32_t stage_seq;
+    uint32_t handler_n;
+    uint8_t vlan_buf[RING_FRAME_SIZE];  // frame with the offloaded 802.1Q tag restored
+};
+
+typedef struct {
+    tsn_capture_group_t *group;
+    tsn_capture_t *cap;
+    tsn_capture_handler_t handler;
+    void *user;
+    int cpu;
+    uint64_t packets;
+    int done;
+    pthread_t tid;
+} __attribute__((aligned(64))) group_worker_t;
+
+struct tsn_capture_group {
+    int n;
+    int running;
+    volatile int stop;
+    tsn_capture_t *src;    // file group: the one mapping the parser walks (NULL: live or n = 1)
+    pthread_t parser;
+    uint64_t epoch_frames;  // file group: call epoch() every so many records, 0 = never
+    void (*epoch)(void *);
+    void *epoch_user;
+    group_worker_t workers[TSN_CAPTURE_MAX_WORKERS];
+};
+
+/*
+ * Fan-out steering, run by the kernel on every frame before the socket
+ * filters: the PCP of the (possibly offloaded) 802.1Q tag, or the low bits of
+ * the first payload byte of an untagged test frame, else 0. The kernel takes
+ * it modulo the group size. skb->data is the L2 payload at this point.
+ */
+static struct sock_filter pcp_steer[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_VLAN_TAG_PRESENT),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 4, 0),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_VLAN_TAG),
+    BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 13),
+    BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 7),
+    BPF_STMT(BPF_RET | BPF_A, 0),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TSN_ETHERTYPE_EXP, 0, 3),
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+    BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 7),
+    BPF_STMT(BPF_RET | BPF_A, 0),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+static tsn_hwtstamp_mode_t parse_hwtstamp_env(void) {
+    const char *v = getenv("TSN_HWTSTAMP");
+    if (!v) return TSN_HWTSTAMP_AUTO;
+    if (strcmp(v, "on") == 0 || strcmp(v, "1") == 0) return TSN_HWTSTAMP_ON;
+    if (strcmp(v, "off") == 0 || strcmp(v, "0") == 0) return TSN_HWTSTAMP_OFF;
+    return TSN_HWTSTAMP_AUTO;
+}
+
+void tsn_capture_opts_init(tsn_capture_opts_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->snaplen = 128;
+    opts->promisc = 1;
+    opts->timeout_ms = 1;
+    opts->backend = TSN_CAPTURE_AUTO;
+    opts->hw_tstamp = parse_hwtstamp_env();
+
+    const char *b = getenv("TSN_CAPTURE");
+    if (b && strcmp(b, "tpacket") == 0) opts->backend = TSN_CAPTURE_TPACKET;
+    else if (b && strcmp(b, "pcap") == 0) opts->backend = TSN_CAPTURE_PCAP;
+}
+
+/*
+ * Decide whether NIC RX timestamps can be used. Only HWTSTAMP_FILTER_ALL is
+ * accepted: with a PTP-only filter our test frames would get software stamps
+ * from a different clock mixed into the same stream. Forcing it on keeps the
+ * current tx_type so a running ptp4l keeps its TX timestamps.
+ */
+static int hwtstamp_enable(const char *ifname, tsn_hwtstamp_mode_t mode) {
+    if (mode == TSN_HWTSTAMP_OFF) return 0;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return 0;
+
+    struct hwtstamp_config cfg;
+    struct ifreq ifr;
+    memset(&cfg, 0, sizeof(cfg));
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    ifr.ifr_data = (void *)&cfg;
+
+    int ok = 0;
+    if (ioctl(fd, SIOCGHWTSTAMP, &ifr) == 0 && cfg.rx_filter == HWTSTAMP_FILTER_ALL) {
+        ok = 1;
+    } else if (mode == TSN_HWTSTAMP_ON) {
+        cfg.flags = 0;
+        cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+        if (ioctl(fd, SIOCSHWTSTAMP, &ifr) == 0 && cfg.rx_filter == HWTSTAMP_FILTER_ALL) {
+            ok = 1;
+        } else {
+            fprintf(stderr, "capture: %s has no all-frames RX hardware timestamping, using software\n",
+                    ifname);
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+// Install a snaplen-only filter: every frame, truncated in the kernel
+static int accept_all(tsn_capture_t *cap) {
+    struct sock_filter ret_snaplen = BPF_STMT(BPF_RET | BPF_K, (uint32_t)cap->snaplen);
+    struct sock_fprog prog = { .len = 1, .filter = &ret_snaplen };
+    return setsockopt(cap->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+// fanout_id < 0: standalone socket. A fan-out member drops everything until
+// the group is complete, so no TC is queued on a socket it does not map to
+static int tpacket_open(tsn_capture_t *cap, const tsn_capture_opts_t *opts, int fanout_id,
+                        char *errbuf) {
+    // Protocol 0 until bind so nothing is queued before the filter is in place
+    cap->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (cap->fd < 0) {
+        snprintf(errbuf, 256, "socket: %s", strerror(errno));
+        return -1;
+    }
+
+    int version = TPACKET_V3;
+    if (setsockopt(cap->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        snprintf(errbuf, 256, "PACKET_VERSION: %s", strerror(errno));
+        return -1;
+    }
+
+    if (hwtstamp_enable(cap->ifname, opts->hw_tstamp)) {
+        int req = SOF_TIMESTAMPING_RAW_HARDWARE;
+        if (setsockopt(cap->fd, SOL_PACKET, PACKET_TIMESTAMP, &req, sizeof(req)) == 0) {
+            cap->hw_ts = 1;
+        }
+    }
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = RING_BLOCK_SIZE;
+    req.tp_block_nr = opts->ring_blocks > 0 ? opts->ring_blocks : RING_BLOCK_NR;
+    req.tp_frame_size = RING_FRAME_SIZE;
+    req.tp_frame_nr = (RING_BLOCK_SIZE / RING_FRAME_SIZE) * req.tp_block_nr;
+    req.tp_retire_blk_tov = opts->timeout_ms > 0 ? opts->timeout_ms : 1;
+    if (setsockopt(cap->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        snprintf(errbuf, 256, "PACKET_RX_RING: %s", strerror(errno));
+        return -1;
+    }
+
+    cap->block_nr = req.tp_block_nr;
+    cap->ring_len = (size_t)req.tp_block_size * req.tp_block_nr;
+    cap->ring = mmap(NULL, cap->ring_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_LOCKED, cap->fd, 0);
+    if (cap->ring == MAP_FAILED) {
+        cap->ring = mmap(NULL, cap->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, cap->fd, 0);
+    }
+    if (cap->ring == MAP_FAILED) {
+        cap->ring = NULL;
+        snprintf(errbuf, 256, "mmap: %s", strerror(errno));
+        return -1;
+    }
+
+    // Truncate to snaplen in the kernel until a real filter is installed
+    if (fanout_id < 0) {
+        accept_all(cap);
+    } else {
+        struct sock_filter drop = BPF_STMT(BPF_RET | BPF_K, 0);
+        struct sock_fprog prog = { .len = 1, .filter = &drop };
+        setsockopt(cap->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+    }
+
+    unsigned int ifindex = if_nametoindex(cap->ifname);
+    if (ifindex == 0) {
+        snprintf(errbuf, 256, "%s: no such interface", cap->ifname);
+        return -1;
+    }
+
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ifindex;
+    if (bind(cap->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        snprintf(errbuf, 256, "bind: %s", strerror(errno));
+        return -1;
+    }
+
+    if (fanout_id >= 0) {
+        int arg = (fanout_id & 0xFFFF) | (PACKET_FANOUT_CBPF << 16);
+        struct sock_fprog steer = {
+            .len = sizeof(pcp_steer) / sizeof(pcp_steer[0]),
+            .filter = pcp_steer
+        };
+        if (setsockopt(cap->fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0 ||
+            setsockopt(cap->fd, SOL_PACKET, PACKET_FANOUT_DATA, &steer, sizeof(steer)) < 0) {
+            snprintf(errbuf, 256, "PACKET_FANOUT: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    if (opts->promisc) {
+        struct packet_mreq mr;
+        memset(&mr, 0, sizeof(mr));
+        mr.mr_ifindex = ifindex;
+        mr.mr_type = PACKET_MR_PROMISC;
+        setsockopt(cap->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr));
+    }
+
+    cap->ts_resolution_ns = 1;
+    return 0;
+}
+
+static int pcap_backend_open(tsn_capture_t *cap, const tsn_capture_opts_t *opts, char *errbuf) {
+    cap->pcap = pcap_create(cap->ifname, errbuf);
+    if (!cap->pcap) return -1;
+
+    pcap_set_snaplen(cap->pcap, cap->snaplen);
+    pcap_set_promisc(cap->pcap, opts->promisc);
+    pcap_set_timeout(cap->pcap, opts->timeout_ms > 0 ? opts->timeout_ms : 1);
+    pcap_set_buffer_size(cap->pcap, 16 << 20);
+
+    int nano = pcap_set_tstamp_precision(cap->pcap, PCAP_TSTAMP_PRECISION_NANO) == 0;
+    if (hwtstamp_enable(cap->ifname, opts->hw_tstamp) &&
+        pcap_set_tstamp_type(cap->pcap, PCAP_TSTAMP_ADAPTER_UNSYNCED) == 0) {
+        cap->hw_ts = 1;
+    }
+
+    int rc = pcap_activate(cap->pcap);
+    if (rc < 0) {
+        snprintf(errbuf, 256, "%s", pcap_geterr(cap->pcap));
+        return -1;
+    }
+    if (rc == PCAP_WARNING_TSTAMP_TYPE_NOTSUP) cap->hw_ts = 0;
+    if (opts->timeout_ms == 0 && pcap_setnonblock(cap->pcap, 1, errbuf) < 0) return -1;
+
+    nano = nano && pcap_get_tstamp_precision(cap->pcap) == PCAP_TSTAMP_PRECISION_NANO;
+    cap->ts_resolution_ns = nano ? 1 : 1000;
+    return 0;
+}
+
+static tsn_capture_t *capture_open(const char *ifname, const tsn_capture_opts_t *opts,
+                                   int fanout_id, char *errbuf) {
+    tsn_capture_t *cap = calloc(1, sizeof(*cap));
+    if (!cap) {
+        snprintf(errbuf, 256, "out of memory");
+        return NULL;
+    }
+    strncpy(cap->ifname, ifname, IFNAMSIZ - 1);
+    cap->snaplen = opts->snaplen;
+    cap->timeout_ms = opts->timeout_ms;
+    cap->fd = -1;
+
+    if (opts->backend != TSN_CAPTURE_PCAP) {
+        cap->backend = TSN_CAPTURE_TPACKET;
+        if (tpacket_open(cap, opts, fanout_id, errbuf) == 0) return cap;
+
+        if (opts->backend == TSN_CAPTURE_TPACKET || fanout_id >= 0) {
+            tsn_capture_close(cap);
+            return NULL;
+        }
+        fprintf(stderr, "capture: TPACKET_V3 unavailable (%s), using libpcap\n", errbuf);
+        if (cap->ring) munmap(cap->ring, cap->ring_len);
+        if (cap->fd >= 0) close(cap->fd);
+        cap->ring = NULL;
+        cap->fd = -1;
+        cap->hw_ts = 0;
+    }
+
+    cap->backend = TSN_CAPTURE_PCAP;
+    if (pcap_backend_open(cap, opts, errbuf) == 0) return cap;
+
+    tsn_capture_close(cap);
+    return NULL;
+}
+
+tsn_capture_t *tsn_capture_open(const char *ifname, const tsn_capture_opts_t *opts, char *errbuf) {
+    return capture_open(ifname, opts, -1, errbuf);
+}
+
+int tsn_capture_set_filter(tsn_capture_t *cap, const char *filter) {
+    struct bpf_program fp;
+
+    if (cap->backend == TSN_CAPTURE_FILE) {
+        pcap_t *p = pcap_open_dead(DLT_EN10MB, 65535);
+        if (!p) return -1;
+        int rc = pcap_compile(p, &fp, filter, 1, PCAP_NETMASK_UNKNOWN);
+        pcap_close(p);
+        if (rc < 0) return -1;
+        if (cap->has_filter) pcap_freecode(&cap->file_filter);
+        cap->file_filter = fp;
+        cap->has_filter = 1;
+        return 0;
+    }
+
+    if (cap->backend == TSN_CAPTURE_PCAP) {
+        if (pcap_compile(cap->pcap, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) < 0) return -1;
+        int rc = pcap_setfilter(cap->pcap, &fp);
+        pcap_freecode(&fp);
+        return rc;
+    }
+
+    /*
+     * Compile against a live handle on the same interface: only then does
+     * libpcap emit the VLAN ancillary-data loads the kernel needs when the
+     * NIC strips 802.1Q tags into the skb.
+     */
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *p = pcap_open_live(cap->ifname, cap->snaplen, 0, 0, errbuf);
+    if (!p) p = pcap_open_dead(DLT_EN10MB, cap->snaplen);
+    if (!p) return -1;
+
+    int rc = -1;
+    if (pcap_compile(p, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) == 0) {
+        struct sock_fprog prog = {
+            .len = fp.bf_len,
+            .filter = (struct sock_filter *)fp.bf_insns
+        };
+        rc = setsockopt(cap->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+        pcap_freecode(&fp);
+    }
+    pcap_close(p);
+    return rc;
+}
+
+/*
+ * Test traffic filter. Every failed check jumps to the final drop. The tag
+ * is matched twice, in the skb metadata (the NIC / driver took it off) and
+ * in-band, because the EtherType and payload offsets differ by 4; a file or
+ * an untagged match has only its in-band form. Classic BPF drops the frame
+ * on any load past its end, so short frames need no length checks.
+ */
+#define MATCH_MAX_INSNS 96
+
+typedef struct {
+    struct sock_filter insn[MATCH_MAX_INSNS];
+    int n;
+    int drop_true[MATCH_MAX_INSNS];   // JEQs that drop when equal
+    int n_true;
+    int drop_false[MATCH_MAX_INSNS];  // JEQs that drop when not equal
+    int n_false;
+} match_prog_t;
+
+static void match_emit(match_prog_t *p, uint16_t code, uint32_t k) {
+    p->insn[p->n++] = (struct sock_filter)BPF_STMT(code, k);
+}
+
+// Compare A with k; drop_if_equal selects which outcome drops
+static int match_jeq(match_prog_t *p, uint32_t k, int drop_if_equal) {
+    if (drop_if_equal) p->drop_true[p->n_true++] = p->n;
+    else p->drop_false[p->n_false++] = p->n;
+    p->insn[p->n] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, k, 0, 0);
+    return p->n++;
+}
+
+// Drop unless bit A (0..7) of mask is set
+static void match_pcp(match_prog_t *p, uint8_t mask) {
+    match_emit(p, BPF_ALU | BPF_AND | BPF_K, 7);
+    match_emit(p, BPF_MISC | BPF_TAX, 0);
+    match_emit(p, BPF_LD | BPF_IMM, 1);
+    match_emit(p, BPF_ALU | BPF_LSH | BPF_X, 0);
+    match_emit(p, BPF_ALU | BPF_AND | BPF_K, mask);
+    match_jeq(p, 0, 1);
+}
+
+// Checks on one layout: tci_off < 0 with the tag in the metadata, l3 where
+// the inner EtherType's payload starts
+static void match_layout(match_prog_t *p, const tsn_capture_match_t *m, int tci_off, int l3) {
+    if (m->vlan_id >= 0 && (m->pcp_mask || m->vlan_id > 0)) {
+        if (tci_off < 0) match_emit(p, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_VLAN_TAG);
+        else match_emit(p, BPF_LD | BPF_H | BPF_ABS, tci_off);
+        match_emit(p, BPF_ST, 0);
+        if (m->pcp_mask) {
+            match_emit(p, BPF_ALU | BPF_RSH | BPF_K, 13);
+            match_pcp(p, m->pcp_mask);
+        }
+        if (m->vlan_id > 0) {
+            match_emit(p, BPF_LD | BPF_MEM, 0);
+            match_emit(p, BPF_ALU | BPF_AND | BPF_K, 0x0FFF);
+            match_jeq(p, (uint32_t)m->vlan_id, 0);
+        }
+    }
+
+    if (!m->ethertype) return;
+    match_emit(p, BPF_LD | BPF_H | BPF_ABS, l3 - 2);
+    match_jeq(p, m->ethertype, 0);
+
+    int udp = m->ethertype == 0x0800;
+    int payload = udp ? l3 + 28 : l3;   // UDP: "TC<pcp>", EXP: TC byte
+    if (udp) {
+        match_emit(p, BPF_LD | BPF_B | BPF_ABS, l3);
+        match_jeq(p, 0x45, 0);
+        match_emit(p, BPF_LD | BPF_B | BPF_ABS, l3 + 9);
+        match_jeq(p, 17, 0);
+    }
+
+    // Untagged: the PCP the payload names
+    if (m->vlan_id < 0 && m->pcp_mask) {
+        match_emit(p, BPF_LD | BPF_B | BPF_ABS, udp ? payload + 2 : payload);
+        if (udp) match_emit(p, BPF_ALU | BPF_SUB | BPF_K, '0');
+        match_pcp(p, m->pcp_mask);
+    }
+
+    if (m->test_hdr) {
+        match_emit(p, BPF_LD | BPF_H | BPF_ABS, udp ? payload + 3 : payload + 1);
+        match_jeq(p, TSN_TEST_MAGIC, 0);
+    }
+}
+
+// Generate the program; metadata = 0 for files (no skb to ask). Returns its length
+static int match_build(match_prog_t *p, const tsn_capture_match_t *m, uint32_t snaplen, int metadata) {
+    memset(p, 0, sizeof(*p));
+
+    if (m->src_mac) {
+        const uint8_t *a = m->src_mac;
+        match_emit(p, BPF_LD | BPF_W | BPF_ABS, 6);
+        match_jeq(p, ((uint32_t)a[0] << 24) | (a[1] << 16) | (a[2] << 8) | a[3], 0);
+        match_emit(p, BPF_LD | BPF_H | BPF_ABS, 10);
+        match_jeq(p, (a[4] << 8) | a[5], 0);
+    }
+
+    if (metadata) {
+        match_emit(p, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_VLAN_TAG_PRESENT);
+        if (m->vlan_id < 0) {
+            match_jeq(p, 0, 0);
+        } else {
+            // Tag in the metadata: that layout; no tag: on to the in-band one
+            int j = p->n;
+            p->insn[p->n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 0);
+            match_layout(p, m, -1, 14);
+            match_emit(p, BPF_RET | BPF_K, snaplen);
+            p->insn[j].jt = (uint8_t)(p->n - j - 1);
+        }
+    }
+
+    match_emit(p, BPF_LD | BPF_H | BPF_ABS, 12);
+    match_jeq(p, ETH_P_8021Q, m->vlan_id < 0);
+    if (m->vlan_id >= 0) match_layout(p, m, 14, 18);
+    else match_layout(p, m, -1, 14);
+    match_emit(p, BPF_RET | BPF_K, snaplen);
+
+    int drop = p->n;
+    match_emit(p, BPF_RET | BPF_K, 0);
+    for (int i = 0; i < p->n_true; i++) p->insn[p->drop_true[i]].jt = (uint8_t)(drop - p->drop_true[i] - 1);
+    for (int i = 0; i < p->n_false; i++) p->insn[p->drop_false[i]].jf = (uint8_t)(drop - p->drop_false[i] - 1);
+    return p->n;
+}
+
+int tsn_capture_set_match(tsn_capture_t *cap, const tsn_capture_match_t *m) {
+    match_prog_t p;
+    uint32_t snaplen = cap->snaplen > 0 ? (uint32_t)cap->snaplen : 65535;
+    int n = match_build(&p, m, snaplen, cap->backend != TSN_CAPTURE_FILE);
+
+    if (cap->backend == TSN_CAPTURE_FILE) {
+        // pcap_freecode() frees bf_insns, so a malloc'd copy can stand in
+        struct bpf_insn *insns = malloc(n * sizeof(*insns));
+        if (!insns) return -1;
+        memcpy(insns, p.insn, n * sizeof(*insns));
+        if (cap->has_filter) pcap_freecode(&cap->file_filter);
+        cap->file_filter.bf_len = n;
+        cap->file_filter.bf_insns = insns;
+        cap->has_filter = 1;
+        return 0;
+    }
+
+    if (cap->backend == TSN_CAPTURE_PCAP) {
+        struct bpf_program fp = { .bf_len = n, .bf_insns = (struct bpf_insn *)p.insn };
+        return pcap_setfilter(cap->pcap, &fp);
+    }
+
+    struct sock_fprog prog = { .len = n, .filter = p.insn };
+    return setsockopt(cap->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+// Hand a frame to the tool, timing every TSN_INSTR_SAMPLE-th call
+static inline void deliver(tsn_capture_t *cap, tsn_capture_handler_t handler, void *user,
+                           const tsn_packet_t *pkt) {
+    if (++cap->handler_n % TSN_INSTR_SAMPLE) {
+        handler(user, pkt);
+        return;
+    }
+    uint64_t t0 = tsn_instr_ticks();
+    handler(user, pkt);
+    tsn_stage_add(&cap->stage[TSN_STAGE_HANDLER], t0, tsn_instr_ticks(), 1);
+}
+
+static void pcap_trampoline(u_char *user, const struct pcap_pkthdr *hdr, const u_char *data) {
+    tsn_capture_t *cap = (tsn_capture_t *)user;
+    tsn_packet_t pkt = {
+        .ts_ns = (uint64_t)hdr->ts.tv_sec * 1000000000ULL +
+                 (uint64_t)hdr->ts.tv_usec * (cap->ts_resolution_ns == 1 ? 1ULL : 1000ULL),
+        .data = data,
+        .caplen = hdr->caplen,
+        .len = hdr->len
+    };
+    deliver(cap, cap->handler, cap->user, &pkt);
+}
+
+static inline struct tpacket_block_desc *ring_block(tsn_capture_t *cap, unsigned int idx) {
+    return (struct tpacket_block_desc *)(cap->ring + (size_t)idx * RING_BLOCK_SIZE);
+}
+
+// Walk one retired block and hand it back to the kernel
+static int tpacket_walk_block(tsn_capture_t *cap, struct tpacket_block_desc *bd,
+                              tsn_capture_handler_t handler, void *user) {
+    uint32_t num = bd->hdr.bh1.num_pkts;
+    struct tpacket3_hdr *ppd = (struct tpacket3_hdr *)((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+
+    for (uint32_t i = 0; i < num; i++) {
+        const uint8_t *data = (const uint8_t *)ppd + ppd->tp_mac;
+        tsn_packet_t pkt = {
+            .ts_ns = (uint64_t)ppd->tp_sec * 1000000000ULL + ppd->tp_nsec,
+            .data = data,
+            .caplen = ppd->tp_snaplen,
+            .len = ppd->tp_len
+        };
+
+        // Put back the 802.1Q tag the NIC/driver moved into the metadata
+        if ((ppd->tp_status & TP_STATUS_VLAN_VALID) && ppd->tp_snaplen >= 12 &&
+            ppd->tp_snaplen + 4 <= sizeof(cap->vlan_buf)) {
+            uint16_t tpid = (ppd->tp_status & TP_STATUS_VLAN_TPID_VALID) && ppd->hv1.tp_vlan_tpid ?
+                            ppd->hv1.tp_vlan_tpid : ETH_P_8021Q;
+            uint16_t tci = ppd->hv1.tp_vlan_tci;
+            uint8_t *buf = cap->vlan_buf;
+            memcpy(buf, data, 12);
+            buf[12] = tpid >> 8;
+            buf[13] = tpid & 0xFF;
+            buf[14] = tci >> 8;
+            buf[15] = tci & 0xFF;
+            memcpy(buf + 16, data + 12, ppd->tp_snaplen - 12);
+            pkt.data = buf;
+            pkt.caplen += 4;
+            pkt.len += 4;
+        }
+
+        deliver(cap, handler, user, &pkt);
+        ppd = (struct tpacket3_hdr *)((uint8_t *)ppd + ppd->tp_next_offset);
+    }
+
+    __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    return (int)num;
+}
+
+// --- File backend ---
+
+static inline uint16_t file_u16(const tsn_capture_t *cap, const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return cap->swapped ? __builtin_bswap16(v) : v;
+}
+
+static inline uint32_t file_u32(const tsn_capture_t *cap, const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return cap->swapped ? __builtin_bswap32(v) : v;
+}
+
+// Timestamp resolution in ns of an if_tsresol value (at least 1)
+static uint32_t tsresol_ns(uint8_t tsresol) {
+    uint64_t ns = 1000000000ULL;
+    if (tsresol & 0x80) {
+        int k = tsresol & 0x7F;
+        ns = k < 30 ? ns >> k : 0;
+    } else {
+        for (int i = 0; i < tsresol && ns > 0; i++) ns /= 10;
+    }
+    return ns > 0 ? (uint32_t)ns : 1;
+}
+
+// pcapng timestamp units -> ns since the epoch
+static uint64_t pcapng_ts_ns(const file_iface_t *ifc, uint64_t ts) {
+    uint64_t ns;
+    uint8_t r = ifc->tsresol;
+    if (r & 0x80) {
+        ns = (uint64_t)(((unsigned __int128)ts * 1000000000ULL) >> (r & 0x7F));
+    } else if (r <= 9) {
+        uint64_t mul = 1;
+        for (int i = r; i < 9; i++) mul *= 10;
+        ns = ts * mul;
+    } else {
+        uint64_t div = 1;
+        for (int i = 9; i < r && i < 28; i++) div *= 10;
+        ns = ts / div;
+    }
+    return ns + (uint64_t)(ifc->tsoffset_s * 1000000000LL);
+}
+
+// Section header: byte order; resets the interface list. Returns 0 or -1
+static int pcapng_shb(tsn_capture_t *cap, const uint8_t *b, uint32_t len) {
+    if (len < 28) return -1;
+    uint32_t bom;
+    memcpy(&bom, b + 8, 4);
+    if (bom == PCAPNG_BOM) cap->swapped = 0;
+    else if (bom == __builtin_bswap32(PCAPNG_BOM)) cap->swapped = 1;
+    else return -1;
+    cap->n_ifaces = 0;
+    return 0;
+}
+
+static void pcapng_idb_parse(const tsn_capture_t *cap, const uint8_t *b, uint32_t len,
+                             file_iface_t *ifc) {
+    ifc->linktype = file_u16(cap, b + 8);
+    ifc->tsresol = 6;
+    ifc->tsoffset_s = 0;
+
+    // Options up to the trailing length
+    const uint8_t *o = b + 16, *end = b + len - 4;
+    while (o + 4 <= end) {
+        uint16_t code = file_u16(cap, o), olen = file_u16(cap, o + 2);
+        if (code == 0 || o + 4 + olen > end) break;
+        if (code == 9 && olen >= 1) ifc->tsresol = o[4];
+        if (code == 14 && olen >= 8) {
+            uint64_t v;
+            memcpy(&v, o + 4, 8);
+            ifc->tsoffset_s = (int64_t)(cap->swapped ? __builtin_bswap64(v) : v);
+        }
+        o += 4 + ((olen + 3) & ~3u);
+    }
+}
+
+static void pcapng_idb(tsn_capture_t *cap, const uint8_t *b, uint32_t len) {
+    if (len < 20 || cap->n_ifaces >= FILE_MAX_IFACES) return;
+    pcapng_idb_parse(cap, b, len, &cap->ifaces[cap->n_ifaces++]);
+}
+
+static int file_open(tsn_capture_t *cap, const char *path, char *errbuf) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(errbuf, 256, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 24) {
+        snprintf(errbuf, 256, "%s: not a capture file", path);
+        close(fd);
+        return -1;
+    }
+    cap->map_len = st.st_size;
+    void *m = mmap(NULL, cap->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        snprintf(errbuf, 256, "mmap %s: %s", path, strerror(errno));
+        return -1;
+    }
+    cap->map = m;
+    madvise(m, cap->map_len, MADV_SEQUENTIAL);
+
+    uint32_t magic;
+    memcpy(&magic, cap->map, 4);
+    tsn_rec_hdr_t rh;
+    if (tsn_rec_check_hdr(cap->map, cap->map_len, &rh) == 0) {
+        cap->records = 1;
+        cap->off = TSN_REC_HDR_LEN;
+        cap->ts_resolution_ns = rh.ts_resolution_ns ? rh.ts_resolution_ns : 1;
+        return 0;
+    }
+    if (magic == PCAPNG_SHB) {
+        cap->pcapng = 1;
+        uint32_t len;
+        memcpy(&len, cap->map + 4, 4);
+        if (pcapng_shb(cap, cap->map, cap->swapped ? __builtin_bswap32(len) : len) < 0) {
+            snprintf(errbuf, 256, "%s: bad pcapng section header", path);
+            return -1;
+        }
+
+        // Resolution of the first interface (packets may only follow its IDB)
+        size_t off = 0;
+        cap->ts_resolution_ns = 1000;
+        while (off + 12 <= cap->map_len) {
+            uint32_t type = file_u32(cap, cap->map + off), blen = file_u32(cap, cap->map + off + 4);
+            if (blen < 12 || off + blen > cap->map_len) break;
+            if (type == PCAPNG_IDB && blen >= 20) {
+                file_iface_t ifc;
+                pcapng_idb_parse(cap, cap->map + off, blen, &ifc);
+                if (ifc.linktype != LINKTYPE_ETHERNET) {
+                    snprintf(errbuf, 256, "%s: link type %u is not Ethernet", path, ifc.linktype);
+                    return -1;
+                }
+                cap->ts_resolution_ns = tsresol_ns(ifc.tsresol);
+                break;
+            }
+            off += blen;
+        }
+        return 0;
+    }
+
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+        cap->swapped = 0;
+    } else if (magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS)) {
+        cap->swapped = 1;
+        magic = __builtin_bswap32(magic);
+    } else {
+        snprintf(errbuf, 256, "%s: not a pcap or pcapng file", path);
+        return -1;
+    }
+    cap->nsec = magic == PCAP_MAGIC_NS;
+    uint32_t linktype = file_u32(cap, cap->map + 20) & 0x0FFFFFFF;
+    if (linktype != LINKTYPE_ETHERNET) {
+        snprintf(errbuf, 256, "%s: link type %u is not Ethernet", path, linktype);
+        return -1;
+    }
+    cap->off = 24;
+    cap->ts_resolution_ns = cap->nsec ? 1 : 1000;
+    return 0;
+}
+
+tsn_capture_t *tsn_capture_open_file(const char *path, char *errbuf) {
+    tsn_capture_t *cap = calloc(1, sizeof(*cap));
+    if (!cap) {
+        snprintf(errbuf, 256, "out of memory");
+        return NULL;
+    }
+    cap->backend = TSN_CAPTURE_FILE;
+    cap->fd = -1;
+    if (file_open(cap, path, errbuf) == 0) return cap;
+
+    tsn_capture_close(cap);
+    return NULL;
+}
+
+// PCP used for splitting a file over workers, same rule as the kernel steering
+static inline int frame_pcp(const uint8_t *d, uint32_t caplen) {
+    if (caplen < 15) return 0;
+    uint16_t type = (d[12] << 8) | d[13];
+    if (type == ETH_P_8021Q || type == ETH_P_8021AD) return d[14] >> 5;
+    if (type == TSN_ETHERTYPE_EXP) return d[14] & 0x07;
+    return 0;
+}
+
+// A record replayed as the smallest frame the RX tools parse: 802.1Q tag,
+// experimental EtherType, TC byte and the test header when seq is known
+static void record_frame(tsn_capture_t *cap, const tsn_rec_t *r, tsn_packet_t *pkt) {
+    uint8_t *d = cap->vlan_buf;
+    memset(d, 0, 12);
+    uint16_t tci = (r->pcp << 13) | (r->vid & 0x0FFF);
+    d[12] = 0x81; d[13] = 0x00;
+    d[14] = tci >> 8; d[15] = tci;
+    d[16] = TSN_ETHERTYPE_EXP >> 8; d[17] = TSN_ETHERTYPE_EXP & 0xFF;
+    d[18] = r->pcp;
+    pkt->caplen = 19;
+
+    if (r->flags & TSN_REC_F_SEQ) {
+        uint8_t *h = d + 19;
+        uint64_t tx = r->ts_ns - (int64_t)r->lat_ns;
+        h[0] = TSN_TEST_MAGIC >> 8; h[1] = TSN_TEST_MAGIC & 0xFF;
+        h[2] = 0; h[3] = r->pcp;
+        h[4] = r->seq >> 24; h[5] = r->seq >> 16; h[6] = r->seq >> 8; h[7] = r->seq;
+        for (int i = 0; i < 8; i++) h[8 + i] = tx >> (56 - 8 * i);
+        pkt->caplen += TSN_TEST_HDR_LEN;
+    }
+    pkt->ts_ns = r->ts_ns;
+    pkt->data = d;
+    pkt->len = r->len;
+}
+
+// Next record as a packet, or 0 at the end: -1 on a truncated/corrupt file
+static int file_next(tsn_capture_t *cap, tsn_packet_t *pkt) {
+    if (cap->records) {
+        if (cap->off + sizeof(tsn_rec_t) > cap->map_len) return 0;  // partial tail: writer still running
+        tsn_rec_t r;
+        memcpy(&r, cap->map + cap->off, sizeof(r));
+        cap->off += sizeof(r);
+        record_frame(cap, &r, pkt);
+        return 1;
+    }
+
+    while (cap->off + 16 <= cap->map_len) {
+        const uint8_t *b = cap->map + cap->off;
+
+        if (!cap->pcapng) {
+            uint32_t sec = file_u32(cap, b), frac = file_u32(cap, b + 4);
+            uint32_t caplen = file_u32(cap, b + 8), len = file_u32(cap, b + 12);
+            if (cap->off + 16 + caplen > cap->map_len) return -1;
+            cap->off += 16 + caplen;
+            pkt->ts_ns = (uint64_t)sec * 1000000000ULL + (uint64_t)frac * (cap->nsec ? 1 : 1000);
+            pkt->data = b + 16;
+            pkt->caplen = caplen;
+            pkt->len = len;
+            return 1;
+        }
+
+        uint32_t type, blen;
+        memcpy(&type, b, 4);
+        if (type == PCAPNG_SHB) {
+            // A new section may switch byte order
+            memcpy(&blen, b + 4, 4);
+            uint32_t bom;
+            memcpy(&bom, b + 8, 4);
+            if (bom != PCAPNG_BOM) blen = __builtin_bswap32(blen);
+            if (blen < 28 || cap->off + blen > cap->map_len) return -1;
+            if (pcapng_shb(cap, b, blen) < 0) return -1;
+            cap->off += blen;
+            continue;
+        }
+
+        type = file_u32(cap, b);
+        blen = file_u32(cap, b + 4);
+        if (blen < 12 || cap->off + blen > cap->map_len) return -1;
+        cap->off += blen;
+
+        if (type == PCAPNG_IDB) {
+            pcapng_idb(cap, b, blen);
+            continue;
+        }
+
+        uint32_t iface, caplen, len, hdr;
+        uint64_t ts;
+        if (type == PCAPNG_EPB && blen >= 32) {
+            iface = file_u32(cap, b + 8);
+            ts = ((uint64_t)file_u32(cap, b + 12) << 32) | file_u32(cap, b + 16);
+            caplen = file_u32(cap, b + 20);
+            len = file_u32(cap, b + 24);
+            hdr = 28;
+        } else if (type == PCAPNG_PB && blen >= 32) {
+            iface = file_u16(cap, b + 8);
+            ts = ((uint64_t)file_u32(cap, b + 12) << 32) | file_u32(cap, b + 16);
+            caplen = file_u32(cap, b + 20);
+            len = file_u32(cap, b + 24);
+            hdr = 28;
+        } else {
+            continue;  // statistics, name resolution, simple packets (no timestamp), ...
+        }
+
+        if ((int)iface >= cap->n_ifaces || cap->ifaces[iface].linktype != LINKTYPE_ETHERNET) continue;
+        if (hdr + caplen + 4 > blen) return -1;
+
+        pkt->ts_ns = pcapng_ts_ns(&cap->ifaces[iface], ts);
+        pkt->data = b + hdr;
+        pkt->caplen = caplen;
+        pkt->len = len;
+        return 1;
+    }
+
+    return cap->off == cap->map_len ? 0 : -1;
+}
+
+// File group worker: the frames of the parser's next block
+static int feed_dispatch(tsn_capture_t *cap, tsn_capture_handler_t handler, void *user) {
+    file_feed_t *f = cap->feed;
+    int eof = __atomic_load_n(&f->eof, __ATOMIC_ACQUIRE);
+    if (f->tail == __atomic_load_n(&f->head, __ATOMIC_ACQUIRE)) {
+        if (!eof) {
+            usleep(FILE_FEED_WAIT_US);
+            return 0;
+        }
+        cap->eof = 1;
+        return eof < 0 ? -1 : 0;
+    }
+
+    const file_block_t *b = &f->blocks[f->tail % FILE_FEED_BLOCKS];
+    int delivered = 0;
+    cap->breakloop = 0;
+    while (cap->feed_pos < b->n && !cap->breakloop) {
+        const file_frame_t *fr = &b->frames[cap->feed_pos++];
+        tsn_packet_t pkt;
+        if (cap->records) {
+            tsn_rec_t r;
+            memcpy(&r, cap->map + fr->off, sizeof(r));
+            record_frame(cap, &r, &pkt);
+        } else {
+            pkt.ts_ns = fr->ts_ns;
+            pkt.data = cap->map + fr->off;
+            pkt.caplen = fr->caplen;
+            pkt.len = fr->len;
+        }
+
+        if (cap->has_filter) {
+            struct pcap_pkthdr h = { .caplen = pkt.caplen, .len = pkt.len };
+            if (!pcap_offline_filter(&cap->file_filter, &h, pkt.data)) continue;
+        }
+        deliver(cap, handler, user, &pkt);
+        delivered++;
+    }
+    if (cap->feed_pos == b->n) {
+        cap->feed_pos = 0;
+        __atomic_store_n(&f->tail, f->tail + 1, __ATOMIC_RELEASE);
+    }
+    return delivered;
+}
+
+static int file_dispatch(tsn_capture_t *cap, tsn_capture_handler_t handler, void *user) {
+    if (cap->eof) return 0;
+    if (cap->feed) return feed_dispatch(cap, handler, user);
+
+    int delivered = 0;
+    cap->breakloop = 0;
+    for (int i = 0; i < FILE_BATCH && !cap->breakloop; i++) {
+        tsn_packet_t pkt;
+        int rc = file_next(cap, &pkt);
+        if (rc <= 0) {
+            cap->eof = 1;
+            if (rc < 0) {
+                fprintf(stderr, "capture: truncated capture file at offset %zu\n", cap->off);
+                return -1;
+            }
+            break;
+        }
+
+        if (cap->has_filter) {
+            struct pcap_pkthdr h = { .caplen = pkt.caplen, .len = pkt.len };
+            if (!pcap_offline_filter(&cap->file_filter, &h, pkt.data)) continue;
+        }
+
+        deliver(cap, handler, user, &pkt);
+        delivered++;
+    }
+    return delivered;
+}
+
+static int capture_dispatch(tsn_capture_t *cap, tsn_capture_handler_t handler, void *user) {
+    if (cap->backend == TSN_CAPTURE_FILE) {
+        uint64_t t0 = tsn_instr_ticks();
+        int n = file_dispatch(cap, handler, user);
+        if (n > 0) tsn_stage_add(&cap->stage[TSN_STAGE_RX], t0, tsn_instr_ticks(), n);
+        return n;
+    }
+
+    if (cap->backend == TSN_CAPTURE_PCAP) {
+        cap->handler = handler;
+        cap->user = user;
+        int n = pcap_dispatch(cap->pcap, 100, pcap_trampoline, (u_char *)cap);
+        return n == -2 ? 0 : n;  // -2: broken out of the loop
+    }
+
+    int total = 0;
+    cap->breakloop = 0;
+
+    for (;;) {
+        struct tpacket_block_desc *bd = ring_block(cap, cap->block_idx);
+        uint32_t status = __atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+
+        if (!(status & TP_STATUS_USER)) {
+            if (total > 0 || cap->breakloop || cap->timeout_ms == 0) return total;
+
+            struct pollfd pfd = { .fd = cap->fd, .events = POLLIN | POLLERR };
+            int rc = poll(&pfd, 1, cap->timeout_ms);
+            if (rc < 0 && errno != EINTR) return -1;
+
+            status = __atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+            if (!(status & TP_STATUS_USER)) return 0;
+        }
+
+        uint64_t t0 = tsn_instr_ticks();
+        int n = tpacket_walk_block(cap, bd, handler, user);
+        if (n > 0) tsn_stage_add(&cap->stage[TSN_STAGE_RX], t0, tsn_instr_ticks(), n);
+        total += n;
+        cap->block_idx = (cap->block_idx + 1) % cap->block_nr;
+        if (cap->breakloop) return total;
+    }
+}
+
+// Seqlock write side: the stage costs for tsn_capture_instr() on other threads
+static void stages_publish(tsn_capture_t *cap) {
+    __atomic_store_n(&cap->stage_seq, cap->stage_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(cap->stage_pub, cap->stage, sizeof(cap->stage_pub));
+    __atomic_store_n(&cap->stage_seq, cap->stage_seq + 1, __ATOMIC_RELEASE);
+}
+
+static void stages_snapshot(tsn_capture_t *cap, tsn_stage_t *out) {
+    uint32_t start, end;
+    do {
+        start = __atomic_load_n(&cap->stage_seq, __ATOMIC_ACQUIRE);
+        memcpy(out, cap->stage_pub, sizeof(cap->stage_pub));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&cap->stage_seq, __ATOMIC_RELAXED);
+    } while ((start & 1) || start != end);
+}
+
+int tsn_capture_dispatch(tsn_capture_t *cap, tsn_capture_handler_t handler, void *user) {
+    int n = capture_dispatch(cap, handler, user);
+    if (n > 0) stages_publish(cap);
+    return n;
+}
+
+int tsn_capture_fd(const tsn_capture_t *cap) {
+    if (cap->backend == TSN_CAPTURE_PCAP) return pcap_get_selectable_fd(cap->pcap);
+    return cap->backend == TSN_CAPTURE_TPACKET ? cap->fd : -1;
+}
+
+void tsn_capture_breakloop(tsn_capture_t *cap) {
+    cap->breakloop = 1;
+    if (cap->pcap) pcap_breakloop(cap->pcap);
+}
+
+void tsn_capture_instr(tsn_capture_t *cap, tsn_instr_t *acc) {
+    tsn_instr_t *k = &cap->kernel;
+    if (cap->backend == TSN_CAPTURE_TPACKET) {
+        // Reading resets the kernel's counters; tp_packets includes the drops
+        struct tpacket_stats_v3 st;
+        socklen_t len = sizeof(st);
+        if (getsockopt(cap->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) {
+            __atomic_add_fetch(&k->rx_packets, st.tp_packets, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&k->rx_kernel_drops, st.tp_drops, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&k->rx_ring_freezes, st.tp_freeze_q_cnt, __ATOMIC_RELAXED);
+        }
+    } else if (cap->backend == TSN_CAPTURE_PCAP) {
+        struct pcap_stat st;
+        if (pcap_stats(cap->pcap, &st) == 0) {
+            __atomic_store_n(&k->rx_packets, st.ps_recv, __ATOMIC_RELAXED);
+            __atomic_store_n(&k->rx_kernel_drops, st.ps_drop, __ATOMIC_RELAXED);
+            __atomic_store_n(&k->rx_if_drops, st.ps_ifdrop, __ATOMIC_RELAXED);
+        }
+    }
+
+    tsn_instr_t in = {
+        .rx_packets = __atomic_load_n(&k->rx_packets, __ATOMIC_RELAXED),
+        .rx_kernel_drops = __atomic_load_n(&k->rx_kernel_drops, __ATOMIC_RELAXED),
+        .rx_if_drops = __atomic_load_n(&k->rx_if_drops, __ATOMIC_RELAXED),
+        .rx_ring_freezes = __atomic_load_n(&k->rx_ring_freezes, __ATOMIC_RELAXED),
+    };
+    stages_snapshot(cap, in.stage);
+    tsn_instr_merge(acc, &in);
+}
+
+int tsn_capture_eof(const tsn_capture_t *cap) {
+    return cap->eof;
+}
+
+void tsn_capture_close(tsn_capture_t *cap) {
+    if (!cap) return;
+    if (cap->map && !cap->feed) munmap((void *)cap->map, cap->map_len);
+    free(cap->feed);
+    if (cap->has_filter) pcap_freecode(&cap->file_filter);
+    if (cap->pcap) pcap_close(cap->pcap);
+    if (cap->ring) munmap(cap->ring, cap->ring_len);
+    if (cap->fd >= 0) close(cap->fd);
+    free(cap);
+}
+
+const char *tsn_capture_backend_name(const tsn_capture_t *cap) {
+    if (cap->backend == TSN_CAPTURE_FILE) {
+        return cap->records ? "records" : (cap->pcapng ? "pcapng" : "pcap-file");
+    }
+    return cap->backend == TSN_CAPTURE_TPACKET ? "tpacket" : "pcap";
+}
+
+const char *tsn_capture_ts_source(const tsn_capture_t *cap) {
+    if (cap->backend == TSN_CAPTURE_FILE) return "file";
+    return cap->hw_ts ? "hardware" : "software";
+}
+
+uint32_t tsn_capture_ts_resolution_ns(const tsn_capture_t *cap) {
+    return cap->ts_resolution_ns;
+}
+
+tsn_capture_group_t *tsn_capture_group_open(const char *ifname, const tsn_capture_opts_t *opts,
+                                            int n, char *errbuf) {
+    static int groups = 0;
+
+    if (n < 1 || n > TSN_CAPTURE_MAX_WORKERS) {
+        snprintf(errbuf, 256, "fan-out needs 1..%d workers", TSN_CAPTURE_MAX_WORKERS);
+        return NULL;
+    }
+    if (n > 1 && opts->backend == TSN_CAPTURE_PCAP) {
+        snprintf(errbuf, 256, "fan-out needs the tpacket backend");
+        return NULL;
+    }
+
+    tsn_capture_group_t *g = calloc(1, sizeof(*g));
+    if (!g) {
+        snprintf(errbuf, 256, "out of memory");
+        return NULL;
+    }
+
+    // Group ids are per network namespace, so make them unique per process
+    // (tsn-verify opens one group per port pair from concurrent RX threads)
+    int fanout_id = n > 1 ? (getpid() * 8 + __atomic_fetch_add(&groups, 1, __ATOMIC_RELAXED)) & 0xFFFF : -1;
+    for (int i = 0; i < n; i++) {
+        g->workers[i].cap = capture_open(ifname, opts, fanout_id, errbuf);
+        if (!g->workers[i].cap) {
+            tsn_capture_group_close(g);
+            return NULL;
+        }
+        g->n++;
+    }
+
+    if (n > 1) {
+        for (int i = 0; i < n; i++) accept_all(g->workers[i].cap);
+    }
+    return g;
+}
+
+tsn_capture_group_t *tsn_capture_group_open_file(const char *path, int n, char *errbuf) {
+    if (n < 1 || n > TSN_CAPTURE_MAX_WORKERS) {
+        snprintf(errbuf, 256, "fan-out needs 1..%d workers", TSN_CAPTURE_MAX_WORKERS);
+        return NULL;
+    }
+
+    tsn_capture_group_t *g = calloc(1, sizeof(*g));
+    if (!g) {
+        snprintf(errbuf, 256, "out of memory");
+        return NULL;
+    }
+    tsn_capture_t *src = tsn_capture_open_file(path, errbuf);
+    if (!src) {
+        free(g);
+        return NULL;
+    }
+    if (n == 1) {
+        g->workers[0].cap = src;
+        g->n = 1;
+        return g;
+    }
+
+    // Workers share the parser's mapping and keep their own filter and counters
+    g->src = src;
+    for (int i = 0; i < n; i++) {
+        tsn_capture_t *cap = calloc(1, sizeof(*cap));
+        if (cap) cap->feed = calloc(1, sizeof(*cap->feed));
+        if (!cap || !cap->feed) {
+            free(cap);
+            snprintf(errbuf, 256, "out of memory");
+            tsn_capture_group_close(g);
+            return NULL;
+        }
+        cap->backend = TSN_CAPTURE_FILE;
+        cap->fd = -1;
+        cap->map = src->map;
+        cap->map_len = src->map_len;
+        cap->pcapng = src->pcapng;
+        cap->records = src->records;
+        cap->ts_resolution_ns = src->ts_resolution_ns;
+        g->workers[i].cap = cap;
+        g->n++;
+    }
+    return g;
+}
+
+int tsn_capture_group_set_match(tsn_capture_group_t *g, const tsn_capture_match_t *m) {
+    for (int i = 0; i < g->n; i++) {
+        if (tsn_capture_set_match(g->workers[i].cap, m) < 0) return -1;
+    }
+    return 0;
+}
+
+int tsn_capture_group_set_epoch(tsn_capture_group_t *g, uint64_t frames,
+                                void (*fn)(void *), void *user) {
+    if (!g->src || frames == 0) return -1;
+    g->epoch_frames = frames;
+    g->epoch = fn;
+    g->epoch_user = user;
+    return 0;
+}
+
+int tsn_capture_group_set_filter(tsn_capture_group_t *g, const char *filter) {
+    for (int i = 0; i < g->n; i++) {
+        if (tsn_capture_set_filter(g->workers[i].cap, filter) < 0) return -1;
+    }
+    return 0;
+}
+
+// Wait for room in a worker's queue; 0 once the group is stopped
+static int feed_reserve(tsn_capture_group_t *g, file_feed_t *f) {
+    while (f->head - __atomic_load_n(&f->tail, __ATOMIC_ACQUIRE) >= FILE_FEED_BLOCKS) {
+        if (g->stop) return 0;
+        usleep(FILE_FEED_WAIT_US);
+    }
+    return 1;
+}
+
+// Publish every worker's partial block
+static void feed_flush(tsn_capture_group_t *g, int *fill) {
+    for (int i = 0; i < g->n; i++) {
+        file_feed_t *f = g->workers[i].cap->feed;
+        if (fill[i] == 0) continue;
+        f->blocks[f->head % FILE_FEED_BLOCKS].n = fill[i];
+        fill[i] = 0;
+        __atomic_store_n(&f->head, f->head + 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Wait until every worker has handled every published frame; 0 once the
+// group is stopped. Their handlers' writes are visible after this
+static int feed_drain(tsn_capture_group_t *g) {
+    for (int i = 0; i < g->n; i++) {
+        file_feed_t *f = g->workers[i].cap->feed;
+        while (__atomic_load_n(&f->tail, __ATOMIC_ACQUIRE) != f->head) {
+            if (g->stop) return 0;
+            usleep(FILE_FEED_WAIT_US);
+        }
+    }
+    return 1;
+}
+
+/*
+ * File group parser: walks the file once and deals its frames out by PCP in
+ * blocks, so every TC reaches one worker in file order and the record headers
+ * are parsed once however many workers there are. At each epoch it drains
+ * the workers and runs the epoch callback while they wait for the next block
+ */
+static void *file_parser(void *arg) {
+    tsn_capture_group_t *g = arg;
+    tsn_capture_t *src = g->src;
+    int fill[TSN_CAPTURE_MAX_WORKERS] = { 0 };  // frames in each worker's unpublished block
+    uint64_t parsed = 0;
+    int eof = 1;
+
+    while (!g->stop) {
+        if (g->epoch && parsed > 0 && parsed % g->epoch_frames == 0) {
+            feed_flush(g, fill);
+            if (!feed_drain(g)) break;
+            g->epoch(g->epoch_user);
+        }
+
+
+        size_t off = src->off;
+        tsn_packet_t pkt;
+        int rc = file_next(src, &pkt);
+        if (rc <= 0) {
+            src->eof = 1;
+            if (rc < 0) {
+                fprintf(stderr, "capture: truncated capture file at offset %zu\n", src->off);
+                eof = -1;
+            }
+            break;
+        }
+
+        int w = frame_pcp(pkt.data, pkt.caplen) % g->n;
+        file_feed_t *f = g->workers[w].cap->feed;
+        file_block_t *b = &f->blocks[f->head % FILE_FEED_BLOCKS];
+        if (fill[w] == 0 && !feed_reserve(g, f)) break;
+        b->frames[fill[w]++] = (file_frame_t){
+            .off = src->records ? off : (size_t)(pkt.data - src->map),
+            .ts_ns = pkt.ts_ns,
+            .caplen = pkt.caplen,
+            .len = pkt.len,
+        };
+        parsed++;
+        if (fill[w] == FILE_BATCH) {
+            b->n = fill[w];
+            fill[w] = 0;
+            __atomic_store_n(&f->head, f->head + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    feed_flush(g, fill);
+    for (int i = 0; i < g->n; i++) __atomic_store_n(&g->workers[i].cap->feed->eof, eof, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *group_worker(void *arg) {
+    group_worker_t *w = arg;
+
+    if (w->cpu >= 0 && tsn_pin_cpu(w->cpu) < 0) {
+        fprintf(stderr, "capture: cannot pin RX worker to CPU %d\n", w->cpu);
+    }
+
+    while (!w->group->stop && !tsn_capture_eof(w->cap)) {
+        int n = tsn_capture_dispatch(w->cap, w->handler, w->user);
+        if (n < 0) break;
+        w->packets += n;
+    }
+    __atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int tsn_capture_group_start(tsn_capture_group_t *g, tsn_capture_handler_t handler,
+                            void *const *users, const int *cpus) {
+    g->stop = 0;
+    for (int i = 0; i < g->n; i++) {
+        group_worker_t *w = &g->workers[i];
+        w->group = g;
+        w->done = 0;
+        w->handler = handler;
+        w->user = users ? users[i] : NULL;
+        w->cpu = cpus ? cpus[i] : -1;
+        if (pthread_create(&w->tid, NULL, group_worker, w) != 0) {
+            g->stop = 1;
+            for (int j = 0; j < i; j++) pthread_join(g->workers[j].tid, NULL);
+            return -1;
+        }
+    }
+    if (g->src && pthread_create(&g->parser, NULL, file_parser, g) != 0) {
+        g->stop = 1;
+        for (int i = 0; i < g->n; i++) pthread_join(g->workers[i].tid, NULL);
+        return -1;
+    }
+    g->running = 1;
+    return 0;
+}
+
+int tsn_capture_group_done(const tsn_capture_group_t *g) {
+    for (int i = 0; i < g->n; i++) {
+        if (!__atomic_load_n(&g->workers[i].done, __ATOMIC_ACQUIRE)) return 0;
+    }
+    return 1;
+}
+
+int tsn_capture_group_run(tsn_capture_group_t *g, tsn_capture_handler_t handler,
+                          void *const *users, const int *cpus, const volatile int *running) {
+    if (tsn_capture_group_start(g, handler, users, cpus) < 0) return -1;
+    while ((!running || *running) && !tsn_capture_group_done(g)) usleep(1000);
+    tsn_capture_group_stop(g);
+    return 0;
+}
+
+void tsn_capture_group_breakloop(tsn_capture_group_t *g) {
+    g->stop = 1;
+    for (int i = 0; i < g->n; i++) tsn_capture_breakloop(g->workers[i].cap);
+}
+
+void tsn_capture_group_stop(tsn_capture_group_t *g) {
+    if (!g->running) return;
+    tsn_capture_group_breakloop(g);
+    if (g->src) pthread_join(g->parser, NULL);
+    for (int i = 0; i < g->n; i++) pthread_join(g->workers[i].tid, NULL);
+    g->running = 0;
+}
+
+void tsn_capture_group_close(tsn_capture_group_t *g) {
+    if (!g) return;
+    tsn_capture_group_stop(g);
+    for (int i = 0; i < g->n; i++) tsn_capture_close(g->workers[i].cap);
+    tsn_capture_close(g->src);
+    free(g);
+}
+
+int tsn_capture_group_size(const tsn_capture_group_t *g) {
+    return g->n;
+}
+
+tsn_capture_t *tsn_capture_group_member(const tsn_capture_group_t *g, int i) {
+    return g->workers[i].cap;
+}
+
+void tsn_capture_group_instr(tsn_capture_group_t *g, tsn_instr_t *acc) {
+    for (int i = 0; i < g->n; i++) tsn_capture_instr(g->workers[i].cap, acc);
+}
+
+uint64_t tsn_capture_group_packets(const tsn_capture_group_t *g, int i) {
+    return g->workers[i].packets;
+}
@@ -0,0 +1,185 @@
+/*
+ * tsn-capture.h - Capture backend shared by the TSN RX tools
+ *
+ * Backends:
+ *   tpacket - AF_PACKET TPACKET_V3 block ring (mmap, one poll per block,
+ *             nanosecond timestamps, optional NIC hardware timestamps)
+ *   pcap    - libpcap with nanosecond timestamp precision when available
+ *   file    - offline pcap / pcapng file (tsn_capture_open_file), memory-mapped;
+ *             timestamps keep the file's resolution (pcapng if_tsresol,
+ *             if_tsoffset), Ethernet link type only. tsn-record files are
+ *             accepted too and replayed as minimal tagged test frames
+ *
+ * Selection (for every tool):
+ *   TSN_CAPTURE=auto|tpacket|pcap   (default auto: tpacket, pcap on failure)
+ *   TSN_HWTSTAMP=auto|on|off        (default auto: use NIC timestamps only if
+ *                                    the NIC already stamps all RX frames, e.g.
+ *                                    under ptp4l; "on" enables it via SIOCSHWTSTAMP)
+ *
+ * Fan-out (tsn_capture_group_*): n TPACKET_V3 sockets on one interface in a
+ * PACKET_FANOUT group, each drained by its own pinned thread. A classic BPF
+ * steering program picks the socket by PCP (802.1Q tag, or the first payload
+ * byte of untagged test frames), so every TC lands on exactly one worker in
+ * arrival order: per-TC state keeps one writer and its timestamps need no
+ * merging. Flow hash or CPU fan-out would split a TC across workers.
+ * A file group maps the file once: one parser thread walks the records and
+ * hands each worker blocks of the frames of its PCPs, in file order. An epoch
+ * callback (tsn_capture_group_set_epoch) runs between two records while every
+ * worker is idle, for state that spans the TCs.
+ *
+ * Test traffic filter (tsn_capture_set_match): instead of a pcap expression,
+ * a classic BPF program generated from the frame layout the tool sent: VID
+ * (offloaded or in-band tag), PCP set, EtherType, IPv4 header length / UDP,
+ * the test header magic at its fixed offset and the TX source MAC. Only test
+ * frames leave the kernel, so the handler can decode them at fixed offsets
+ * (tsn_test_rx() in tsn-frame.h).
+ */
+
+#ifndef TSN_CAPTURE_H
+#define TSN_CAPTURE_H
+
+#include <stdint.h>
+
+#include "tsn-instr.h"
+
+typedef enum {
+    TSN_CAPTURE_AUTO,
+    TSN_CAPTURE_TPACKET,
+    TSN_CAPTURE_PCAP,
+    TSN_CAPTURE_FILE   // set by tsn_capture_open_file()
+} tsn_capture_backend_t;
+
+typedef enum {
+    TSN_HWTSTAMP_AUTO,
+    TSN_HWTSTAMP_OFF,
+    TSN_HWTSTAMP_ON
+} tsn_hwtstamp_mode_t;
+
+typedef struct {
+    tsn_capture_backend_t backend;
+    tsn_hwtstamp_mode_t hw_tstamp;
+    int snaplen;
+    int promisc;
+    int timeout_ms;           // 0: dispatch never waits (for event loops on tsn_capture_fd())
+    int ring_blocks;          // tpacket ring size in 256 KiB blocks, 0 = 64 (16 MiB)
+} tsn_capture_opts_t;
+
+// One received frame; data is only valid inside the handler
+typedef struct {
+    uint64_t ts_ns;
+    const uint8_t *data;
+    uint32_t caplen;
+    uint32_t len;
+} tsn_packet_t;
+
+// Frames tsn_capture_set_match() lets through
+typedef struct {
+    int vlan_id;              // > 0: tagged with this VID, 0: tagged, any VID, < 0: untagged
+    uint8_t pcp_mask;         // bit N = PCP N (untagged: the TC the payload names), 0 = any
+    uint16_t ethertype;       // 0x0800 (IPv4 header without options, UDP) or TSN_ETHERTYPE_EXP, 0 = any
+    int test_hdr;             // require the test header magic (needs ethertype)
+    const uint8_t *src_mac;   // NULL = any
+} tsn_capture_match_t;
+
+typedef void (*tsn_capture_handler_t)(void *user, const tsn_packet_t *pkt);
+
+typedef struct tsn_capture tsn_capture_t;
+typedef struct tsn_capture_group tsn_capture_group_t;
+
+// One worker per PCP at most
+#define TSN_CAPTURE_MAX_WORKERS 8
+
+// Defaults (snaplen 128, promisc, 1 ms timeout) plus TSN_CAPTURE/TSN_HWTSTAMP
+void tsn_capture_opts_init(tsn_capture_opts_t *opts);
+
+// Returns NULL and fills errbuf (256 bytes) on failure
+tsn_capture_t *tsn_capture_open(const char *ifname, const tsn_capture_opts_t *opts, char *errbuf);
+
+// Open a pcap, pcapng or tsn-record file. Returns NULL and fills errbuf on failure
+tsn_capture_t *tsn_capture_open_file(const char *path, char *errbuf);
+
+// Install a pcap filter expression in the kernel (file: applied while reading)
+int tsn_capture_set_filter(tsn_capture_t *cap, const char *filter);
+
+// Install a filter generated from m in the kernel (file: applied while
+// reading). Returns 0 or -1
+int tsn_capture_set_match(tsn_capture_t *cap, const tsn_capture_match_t *m);
+
+// Deliver ready packets to handler; waits up to timeout_ms when idle.
+// Returns packets delivered, or -1 on error (also a truncated file)
+int tsn_capture_dispatch(tsn_capture_t *cap, tsn_capture_handler_t handler, void *user);
+
+// Descriptor that turns readable when dispatch has frames to deliver (tpacket:
+// a ring block was retired, within 1 ms of its first frame), for epoll across
+// many captures; -1 for files
+int tsn_capture_fd(const tsn_capture_t *cap);
+
+// Async-signal-safe: makes the current dispatch return early
+void tsn_capture_breakloop(tsn_capture_t *cap);
+
+// File backend: every record has been delivered
+int tsn_capture_eof(const tsn_capture_t *cap);
+
+// Add kernel drop / ring counters and the rx / handler stage costs to acc
+// (tpacket: PACKET_STATISTICS, pcap: pcap_stats). Safe while another thread
+// dispatches: the stages are the copy published at the end of its last
+// dispatch
+void tsn_capture_instr(tsn_capture_t *cap, tsn_instr_t *acc);
+
+void tsn_capture_close(tsn_capture_t *cap);
+
+const char *tsn_capture_backend_name(const tsn_capture_t *cap);
+const char *tsn_capture_ts_source(const tsn_capture_t *cap);  // "hardware" / "software" / "file"
+uint32_t tsn_capture_ts_resolution_ns(const tsn_capture_t *cap);
+
+// n captures in one PCP fan-out group (n > 1 needs the tpacket backend; n = 1
+// is a plain tsn_capture_open()). Returns NULL and fills errbuf on failure
+tsn_capture_group_t *tsn_capture_group_open(const char *ifname, const tsn_capture_opts_t *opts,
+                                            int n, char *errbuf);
+
+// n workers over one pcap / pcapng / tsn-record file, split by PCP like a
+// live group (n > 1 adds a parser thread while running)
+tsn_capture_group_t *tsn_capture_group_open_file(const char *path, int n, char *errbuf);
+
+// Same filter on every member
+int tsn_capture_group_set_filter(tsn_capture_group_t *g, const char *filter);
+int tsn_capture_group_set_match(tsn_capture_group_t *g, const tsn_capture_match_t *m);
+
+// File group with a parser (n > 1): every `frames` records, wait until the
+// workers have handled all records so far and call fn(user) on the parser
+// thread before dealing out the next one. Set before start. Returns -1 when
+// the group has no parser (live, or n = 1: the one worker sees every record)
+int tsn_capture_group_set_epoch(tsn_capture_group_t *g, uint64_t frames,
+                                void (*fn)(void *), void *user);
+
+// Dispatch every member from its own thread until stopped. Worker i calls
+// handler(users ? users[i] : NULL, pkt) and is pinned to cpus[i] (cpus NULL:
+// not pinned). Returns 0 or -1
+int tsn_capture_group_start(tsn_capture_group_t *g, tsn_capture_handler_t handler,
+                            void *const *users, const int *cpus);
+
+// File group: every worker has reached the end of the file
+int tsn_capture_group_done(const tsn_capture_group_t *g);
+
+// Start, wait until every worker reached the end of the file (or *running is
+// cleared), stop. Returns 0 or -1
+int tsn_capture_group_run(tsn_capture_group_t *g, tsn_capture_handler_t handler,
+                          void *const *users, const int *cpus, const volatile int *running);
+
+// Async-signal-safe: make the workers return
+void tsn_capture_group_breakloop(tsn_capture_group_t *g);
+
+// Stop and join the workers
+void tsn_capture_group_stop(tsn_capture_group_t *g);
+
+// Stops the workers if running
+void tsn_capture_group_close(tsn_capture_group_t *g);
+
+int tsn_capture_group_size(const tsn_capture_group_t *g);
+tsn_capture_t *tsn_capture_group_member(const tsn_capture_group_t *g, int i);
+uint64_t tsn_capture_group_packets(const tsn_capture_group_t *g, int i);  // delivered by worker i
+
+// tsn_capture_instr() of every member
+void tsn_capture_group_instr(tsn_capture_group_t *g, tsn_instr_t *acc);
+
+#endif
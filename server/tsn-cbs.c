@@ -0,0 +1,248 @@
+/*
+ * tsn-cbs.c - 802.1Qav credit-based shaper fit to a frame trace (libtsntest)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "tsn-cbs.h"
+
+// Stop when the bracket is this share of the link rate
+#define FIT_PRECISION 1e-6
+
+// A frame is binding when it started within this many tolerances of 0 credit
+#define BINDING_TOLERANCES 2.0
+
+// tight: binding frames at least this share of the trace, and this many
+#define TIGHT_SHARE 0.01
+#define TIGHT_MIN 3
+
+// Chunk slopes this close pin the same shaper when merged
+#define MERGE_SHARE 0.01
+
+void tsn_cbs_trace_init(tsn_cbs_trace_t *t, uint32_t max) {
+    memset(t, 0, sizeof(*t));
+    t->max = max;
+}
+
+void tsn_cbs_trace_free(tsn_cbs_trace_t *t) {
+    free(t->ts_ns);
+    free(t->len);
+    free(t->blocked);
+    memset(t, 0, sizeof(*t));
+}
+
+void tsn_cbs_trace_reset(tsn_cbs_trace_t *t) {
+    free(t->blocked);
+    t->blocked = NULL;
+    t->n = 0;
+}
+
+int tsn_cbs_trace_add(tsn_cbs_trace_t *t, uint64_t ts_ns, uint16_t len) {
+    if (t->n == t->cap) {
+        if (t->cap >= t->max) return -1;
+        uint32_t cap = t->cap ? t->cap * 2 : 4096;
+        if (cap > t->max) cap = t->max;
+        uint64_t *ts = realloc(t->ts_ns, cap * sizeof(*ts));
+        if (!ts) return -1;
+        t->ts_ns = ts;
+        uint16_t *l = realloc(t->len, cap * sizeof(*l));
+        if (!l) return -1;
+        t->len = l;
+        t->cap = cap;
+    }
+    t->ts_ns[t->n] = ts_ns;
+    t->len[t->n] = len;
+    t->n++;
+    return 0;
+}
+
+static uint64_t frame_ns(uint16_t len, double link_bps) {
+    return (uint64_t)((len + TSN_CBS_WIRE_OVERHEAD) * 8.0 * 1e9 / link_bps);
+}
+
+int tsn_cbs_mark_blocked(tsn_cbs_trace_t *const *t, int n, double link_bps, uint32_t tolerance_ns) {
+    for (int a = 0; a < n; a++) {
+        tsn_cbs_trace_t *ta = t[a];
+        free(ta->blocked);
+        ta->blocked = ta->n ? calloc(ta->n, 1) : NULL;
+        if (ta->n && !ta->blocked) return -1;
+
+        // Both traces are in time order: one pointer per other trace
+        for (int b = 0; b < n; b++) {
+            const tsn_cbs_trace_t *tb = t[b];
+            if (b == a || tb->n == 0) continue;
+            uint32_t j = 0;
+            for (uint32_t i = 0; i < ta->n; i++) {
+                uint64_t ts = ta->ts_ns[i];
+                while (j < tb->n && tb->ts_ns[j] + frame_ns(tb->len[j], link_bps) + tolerance_ns < ts) j++;
+                if (j == tb->n) break;
+                uint64_t end = tb->ts_ns[j] + frame_ns(tb->len[j], link_bps);
+                if (tb->ts_ns[j] < ts && end + tolerance_ns >= ts) ta->blocked[i] = 1;
+            }
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    double idle[TSN_CBS_LANES];      // bits per ns
+    uint64_t violations[TSN_CBS_LANES];
+    uint64_t binding[TSN_CBS_LANES];
+    double hi_seen[TSN_CBS_LANES];   // bits
+    double lo_seen[TSN_CBS_LANES];
+} lanes_t;
+
+// Replay the trace for every lane's idle slope. Per frame the gap since the
+// previous one ended is shared; credit, counts and extremes are per lane
+static void replay(const tsn_cbs_trace_t *t, uint32_t from, const tsn_cbs_model_t *m, lanes_t *L) {
+    double link = m->link_bps / 1e9;  // bits per ns
+    double credit[TSN_CBS_LANES], hi[TSN_CBS_LANES], send_frac[TSN_CBS_LANES];
+    double tol[TSN_CBS_LANES], bind[TSN_CBS_LANES];
+    for (int k = 0; k < TSN_CBS_LANES; k++) {
+        credit[k] = 0;
+        hi[k] = m->interference_bytes * 8.0 * L->idle[k] / link;
+        send_frac[k] = 1.0 - L->idle[k] / link;
+        tol[k] = L->idle[k] * m->tolerance_ns;
+        bind[k] = tol[k] * BINDING_TOLERANCES;
+        L->violations[k] = L->binding[k] = 0;
+        L->hi_seen[k] = 0;
+        L->lo_seen[k] = 0;
+    }
+
+    uint64_t prev_end = t->ts_ns[from];
+    for (uint32_t i = from; i < t->n; i++) {
+        uint64_t ts = t->ts_ns[i];
+        double gap = ts > prev_end ? (double)(ts - prev_end) : 0;
+        double bits = (t->len[i] + TSN_CBS_WIRE_OVERHEAD) * 8.0;
+        int in_burst = i > from && gap < m->burst_gap_ns;
+        int blocked = t->blocked && t->blocked[i];
+        prev_end = ts + (uint64_t)(bits / link);
+
+        for (int k = 0; k < TSN_CBS_LANES; k++) {
+            double c = credit[k] + L->idle[k] * gap;
+            L->binding[k] += in_burst && c <= bind[k] && c >= -bind[k];
+            L->violations[k] += c < -tol[k];
+            c = c < 0 ? 0 : c;
+            c = c > (blocked ? hi[k] : 0) ? (blocked ? hi[k] : 0) : c;
+            L->hi_seen[k] = c > L->hi_seen[k] ? c : L->hi_seen[k];
+            c -= bits * send_frac[k];
+            L->lo_seen[k] = c < L->lo_seen[k] ? c : L->lo_seen[k];
+            credit[k] = c;
+        }
+    }
+}
+
+int tsn_cbs_fit(const tsn_cbs_trace_t *t, uint32_t from, const tsn_cbs_model_t *m, tsn_cbs_fit_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (t->n < from + 3 || m->link_bps <= 0) return -1;
+
+    uint64_t frames = t->n - from;
+    uint64_t allowed = (uint64_t)(frames * TSN_CBS_MAX_VIOLATION);
+    double link = m->link_bps / 1e9;
+
+    // Lowest feasible slope in (lo, hi]: the link rate always is
+    double lo = 0, hi = link;
+    lanes_t L;
+    while (hi - lo > link * FIT_PRECISION) {
+        double step = (hi - lo) / (TSN_CBS_LANES + 1);
+        for (int k = 0; k < TSN_CBS_LANES; k++) L.idle[k] = lo + step * (k + 1);
+        replay(t, from, m, &L);
+
+        int k = 0;
+        while (k < TSN_CBS_LANES && L.violations[k] > allowed) k++;
+        if (k < TSN_CBS_LANES) hi = L.idle[k];
+        if (k > 0) lo = L.idle[k - 1];
+    }
+
+    // Counts and credit extremes at the fit
+    for (int k = 0; k < TSN_CBS_LANES; k++) L.idle[k] = hi;
+    replay(t, from, m, &L);
+
+    uint32_t max_len = 0;
+    for (uint32_t i = from; i < t->n; i++) {
+        if (t->len[i] > max_len) max_len = t->len[i];
+    }
+
+    out->idle_slope_bps = hi * 1e9;
+    out->send_slope_bps = out->idle_slope_bps - m->link_bps;
+    out->hi_credit_bytes = m->interference_bytes * hi / link;
+    out->lo_credit_bytes = (max_len + TSN_CBS_WIRE_OVERHEAD) * (hi - link) / link;
+    out->frames = frames;
+    out->binding = L.binding[0];
+    out->violations = L.violations[0];
+    out->tight = out->binding >= TIGHT_MIN && out->binding >= frames * TIGHT_SHARE;
+    return 0;
+}
+
+typedef struct {
+    const tsn_cbs_trace_t *t;
+    const tsn_cbs_model_t *m;
+    tsn_cbs_fit_t *out;
+    int rc;
+} fit_job_t;
+
+static void *fit_thread(void *arg) {
+    fit_job_t *j = arg;
+    j->rc = tsn_cbs_fit(j->t, 0, j->m, j->out);
+    return NULL;
+}
+
+void tsn_cbs_fit_parallel(const tsn_cbs_trace_t *const *t, const tsn_cbs_model_t *m,
+                          tsn_cbs_fit_t *out, int *rc, int n) {
+    if (n <= 0) return;  // no zero-length arrays below
+    fit_job_t jobs[n];
+    pthread_t tids[n];
+    bool started[n];
+    for (int i = 0; i < n; i++) {
+        jobs[i] = (fit_job_t){ .t = t[i], .m = &m[i], .out = &out[i], .rc = -1 };
+        started[i] = pthread_create(&tids[i], NULL, fit_thread, &jobs[i]) == 0;
+        if (!started[i]) fit_thread(&jobs[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+        rc[i] = jobs[i].rc;
+    }
+}
+
+// Wire bytes behind a fit's credits: hiCredit = interference * idle / link,
+// loCredit = frame * send / link, with link = idle - send
+static void fit_credit_bytes(const tsn_cbs_fit_t *f, double *interference, double *frame) {
+    double link = f->idle_slope_bps - f->send_slope_bps;
+    *interference = f->idle_slope_bps > 0 ? f->hi_credit_bytes * link / f->idle_slope_bps : 0;
+    *frame = f->send_slope_bps < 0 ? f->lo_credit_bytes * link / f->send_slope_bps : 0;
+}
+
+void tsn_cbs_fit_merge(tsn_cbs_fit_t *acc, const tsn_cbs_fit_t *f) {
+    if (f->frames == 0) return;
+    if (acc->frames == 0) {
+        *acc = *f;
+        return;
+    }
+
+    double intf_a, frame_a, intf_f, frame_f;
+    fit_credit_bytes(acc, &intf_a, &frame_a);
+    fit_credit_bytes(f, &intf_f, &frame_f);
+    uint64_t frames = acc->frames + f->frames;
+    uint64_t violations = acc->violations + f->violations;
+
+    if (f->idle_slope_bps > acc->idle_slope_bps * (1 + MERGE_SHARE)) {
+        *acc = *f;
+    } else if (f->idle_slope_bps >= acc->idle_slope_bps * (1 - MERGE_SHARE)) {
+        if (f->idle_slope_bps > acc->idle_slope_bps) {
+            acc->idle_slope_bps = f->idle_slope_bps;
+            acc->send_slope_bps = f->send_slope_bps;
+        }
+        acc->binding += f->binding;
+        acc->tight = acc->tight || f->tight;
+    }
+
+    double link = acc->idle_slope_bps - acc->send_slope_bps;
+    double intf = intf_a > intf_f ? intf_a : intf_f;
+    double frame = frame_a > frame_f ? frame_a : frame_f;
+    acc->hi_credit_bytes = intf * acc->idle_slope_bps / link;
+    acc->lo_credit_bytes = frame * acc->send_slope_bps / link;
+    acc->frames = frames;
+    acc->violations = violations;
+}
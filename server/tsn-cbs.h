@@ -0,0 +1,99 @@
+/*
+ * tsn-cbs.h - 802.1Qav credit-based shaper fit to a frame trace (libtsntest)
+ *
+ * The captured frames of one TC (start time, wire length) are replayed through
+ * the shaper's credit: it grows at idleSlope between frames and drops by the
+ * frame's bits * (1 - idleSlope / link) while one is sent. Positive credit
+ * (up to hiCredit) is only kept by a frame that waited behind another TC's,
+ * one that starts as that frame ends (tsn_cbs_mark_blocked()); otherwise the
+ * queue was empty and 802.1Qav resets it to 0. A frame may only start with
+ * credit >= 0, so the fit is the lowest idleSlope at which (all but
+ * TSN_CBS_MAX_VIOLATION of) the frames were allowed to start, with timestamp
+ * jitter of tolerance_ns forgiven. hiCredit follows 802.1Qav
+ * from the largest interfering frame (maxInterferenceSize * idleSlope / link),
+ * loCredit from the TC's largest frame (maxFrameSize * sendSlope / link), and
+ * sendSlope = idleSlope - link.
+ *
+ * Frames that start with credit close to 0, within burst_gap_ns of the one
+ * before, were held back by the shaper ("binding"). Enough of them pin
+ * idleSlope, so a burst sent at any rate above the slope is enough; the link
+ * need not be saturated. Without them the traffic never pushed against the
+ * shaper (an evenly paced stream fits any slope above its rate) and the fit
+ * is only a lower bound (tight = false).
+ *
+ * Search: TSN_CBS_LANES candidate slopes are replayed side by side in one pass
+ * over the trace (plain arrays the compiler vectorizes), and the bracket
+ * around the lowest feasible one shrinks by that factor per pass; each trace
+ * is fitted on its own thread.
+ *
+ * Long runs: the traces hold one chunk of the capture; each chunk is fitted
+ * when it is full and tsn_cbs_fit_merge() folds the chunk fits into one for
+ * the whole run, so memory stays bounded without dropping frames.
+ */
+
+#ifndef TSN_CBS_H
+#define TSN_CBS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TSN_CBS_LANES 8
+#define TSN_CBS_MAX_VIOLATION 0.001   // share of frames the fit may not explain
+#define TSN_CBS_WIRE_OVERHEAD 24      // preamble, SFD, FCS, IFG beyond the captured length
+
+// Frames of one TC in capture order (grows up to max)
+typedef struct {
+    uint64_t *ts_ns;
+    uint16_t *len;
+    uint8_t *blocked;              // tsn_cbs_mark_blocked(), NULL = none
+    uint32_t n;
+    uint32_t cap;
+    uint32_t max;
+} tsn_cbs_trace_t;
+
+typedef struct {
+    double link_bps;
+    uint32_t interference_bytes;   // largest frame that can hold this TC back
+    uint32_t tolerance_ns;         // timestamp jitter forgiven per frame
+    uint64_t burst_gap_ns;         // binding frames must follow closer than this
+} tsn_cbs_model_t;
+
+typedef struct {
+    double idle_slope_bps;
+    double send_slope_bps;
+    double hi_credit_bytes;
+    double lo_credit_bytes;
+    uint64_t frames;
+    uint64_t binding;              // frames held back by the credit
+    uint64_t violations;           // frames started with credit < 0 at the fit
+    bool tight;                    // idle slope pinned, not a lower bound
+} tsn_cbs_fit_t;
+
+void tsn_cbs_trace_init(tsn_cbs_trace_t *t, uint32_t max);
+void tsn_cbs_trace_free(tsn_cbs_trace_t *t);
+
+// Drop the frames (and blocked marks), keep the memory for the next chunk
+void tsn_cbs_trace_reset(tsn_cbs_trace_t *t);
+
+// Append a frame; frames beyond max are not kept. Returns 0 or -1
+int tsn_cbs_trace_add(tsn_cbs_trace_t *t, uint64_t ts_ns, uint16_t len);
+
+// Flag the frames of each trace that start within tolerance_ns of the end of
+// another trace's frame on the same link (link_bps). Returns 0 or -1
+int tsn_cbs_mark_blocked(tsn_cbs_trace_t *const *t, int n, double link_bps, uint32_t tolerance_ns);
+
+// Fit frames [from, t->n) of one trace. Returns 0, or -1 with fewer than 3
+int tsn_cbs_fit(const tsn_cbs_trace_t *t, uint32_t from, const tsn_cbs_model_t *m, tsn_cbs_fit_t *out);
+
+// tsn_cbs_fit() of n traces, one thread each; rc[i] is each fit's result
+// (n <= 0: nothing to do)
+void tsn_cbs_fit_parallel(const tsn_cbs_trace_t *const *t, const tsn_cbs_model_t *m,
+                          tsn_cbs_fit_t *out, int *rc, int n);
+
+// Fold the fit of the next chunk of the same TC into acc (frames = 0: none
+// yet). One shaper has to explain every chunk, so the highest chunk slope
+// wins; credits follow it from the largest frames seen, frames and
+// violations add up, binding and tight come from the chunks that pin it
+void tsn_cbs_fit_merge(tsn_cbs_fit_t *acc, const tsn_cbs_fit_t *f);
+
+#endif
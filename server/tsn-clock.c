@@ -0,0 +1,151 @@
+/*
+ * tsn-clock.c - Time bases for TX scheduling and RX analysis (libtsntest)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/ptp_clock.h>
+
+#include "tsn-clock.h"
+
+// Dynamic POSIX clock of an open PHC character device
+#define FD_TO_CLOCKID(fd) ((~(clockid_t)(fd) << 3) | 3)
+
+#define OFFSET_SAMPLES 10
+
+int tsn_phc_index(const char *ifname) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    struct ethtool_ts_info info = { .cmd = ETHTOOL_GET_TS_INFO };
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    ifr.ifr_data = (char *)&info;
+    int rc = ioctl(fd, SIOCETHTOOL, &ifr);
+    close(fd);
+    return rc < 0 ? -1 : info.phc_index;
+}
+
+int tsn_clock_open(tsn_clock_t *c, const char *name, char *errbuf) {
+    if (!name || !*name) name = getenv("TSN_CLOCK");
+    if (!name || !*name) name = "tai";
+
+    c->fd = -1;
+    c->phc_index = -1;
+    snprintf(c->name, sizeof(c->name), "%s", name);
+
+    if (strcmp(name, "monotonic") == 0) {
+        c->id = CLOCK_MONOTONIC;
+        return 0;
+    }
+    if (strcmp(name, "realtime") == 0) {
+        c->id = CLOCK_REALTIME;
+        return 0;
+    }
+    if (strcmp(name, "tai") == 0) {
+        c->id = CLOCK_TAI;
+        return 0;
+    }
+
+    char path[64];
+    if (strncmp(name, "phc:", 4) == 0) {
+        c->phc_index = tsn_phc_index(name + 4);
+        if (c->phc_index < 0) {
+            snprintf(errbuf, 256, "%s has no PTP hardware clock", name + 4);
+            return -1;
+        }
+        snprintf(path, sizeof(path), "/dev/ptp%d", c->phc_index);
+    } else if (strncmp(name, "/dev/ptp", 8) == 0) {
+        c->phc_index = atoi(name + 8);
+        snprintf(path, sizeof(path), "%s", name);
+    } else {
+        snprintf(errbuf, 256, "unknown clock '%s' (monotonic, realtime, tai, phc:IFACE, /dev/ptpN)", name);
+        return -1;
+    }
+
+    c->fd = open(path, O_RDWR);
+    if (c->fd < 0) c->fd = open(path, O_RDONLY);
+    if (c->fd < 0) {
+        snprintf(errbuf, 256, "open %s: %s", path, strerror(errno));
+        return -1;
+    }
+    c->id = FD_TO_CLOCKID(c->fd);
+    return 0;
+}
+
+void tsn_clock_close(tsn_clock_t *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+}
+
+static inline int64_t ptp_ns(const struct ptp_clock_time *t) {
+    return t->sec * 1000000000LL + t->nsec;
+}
+
+static inline int64_t ts_ns(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// c - CLOCK_REALTIME: the tightest of OFFSET_SAMPLES realtime/c/realtime
+// brackets, taken by the PHC driver when it can
+static int offset_to_realtime(const tsn_clock_t *c, int64_t *offset_ns, uint64_t *err_ns) {
+    int64_t best = INT64_MAX;
+    *offset_ns = 0;
+    *err_ns = 0;
+    if (c->id == CLOCK_REALTIME) return 0;
+
+    if (c->fd >= 0) {
+        struct ptp_sys_offset_extended ext;
+        memset(&ext, 0, sizeof(ext));
+        ext.n_samples = OFFSET_SAMPLES;
+        if (ioctl(c->fd, PTP_SYS_OFFSET_EXTENDED, &ext) == 0) {
+            for (unsigned i = 0; i < ext.n_samples; i++) {
+                int64_t pre = ptp_ns(&ext.ts[i][0]), phc = ptp_ns(&ext.ts[i][1]), post = ptp_ns(&ext.ts[i][2]);
+                if (post - pre < best) {
+                    best = post - pre;
+                    *offset_ns = phc - (pre + (post - pre) / 2);
+                }
+            }
+            *err_ns = best / 2;
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < OFFSET_SAMPLES; i++) {
+        int64_t pre = ts_ns(CLOCK_REALTIME);
+        int64_t t = ts_ns(c->id);
+        int64_t post = ts_ns(CLOCK_REALTIME);
+        if (post - pre < best) {
+            best = post - pre;
+            *offset_ns = t - (pre + (post - pre) / 2);
+        }
+    }
+    *err_ns = best / 2;
+    return best < INT64_MAX && best >= 0 ? 0 : -1;
+}
+
+int tsn_clock_offset(const tsn_clock_t *a, const tsn_clock_t *b, int64_t *offset_ns, uint64_t *err_ns) {
+    int64_t oa, ob;
+    uint64_t ea, eb;
+    if (a->id == b->id || (a->phc_index >= 0 && a->phc_index == b->phc_index)) {
+        *offset_ns = 0;
+        if (err_ns) *err_ns = 0;
+        return 0;
+    }
+    if (offset_to_realtime(a, &oa, &ea) < 0 || offset_to_realtime(b, &ob, &eb) < 0) return -1;
+    *offset_ns = oa - ob;
+    if (err_ns) *err_ns = ea + eb;
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * tsn-clock.h - Time bases for TX scheduling and RX analysis (libtsntest)
+ *
+ * The tools pace on CLOCK_MONOTONIC, hand SO_TXTIME launch times over on
+ * CLOCK_TAI and get RX timestamps on CLOCK_REALTIME (software) or the PTP
+ * hardware clock of the RX NIC (TSN_HWTSTAMP). A GCL base-time is neither:
+ * it is in the network's gPTP time, i.e. the PHC of a port ptp4l keeps
+ * synchronized to the switch. A tsn_clock_t names one of these clocks and
+ * measures its offset to another, so a base-time can be carried into the
+ * launch domain and RX timestamps into the base-time domain.
+ *
+ * Names: monotonic | realtime | tai | phc:IFACE | /dev/ptpN
+ *   phc:IFACE is the PHC that stamps IFACE's frames (ETHTOOL_GET_TS_INFO)
+ *   "" or NULL: TSN_CLOCK from the environment, else tai
+ *
+ * Offsets come from PTP_SYS_OFFSET_EXTENDED when one side is a PHC (the
+ * system time read right around the PHC register read, as phc2sys does),
+ * from bracketed clock_gettime() pairs otherwise. The best of several
+ * samples is kept and half its bracket reported as the uncertainty.
+ */
+
+#ifndef TSN_CLOCK_H
+#define TSN_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+typedef struct {
+    clockid_t id;
+    int fd;              // open PHC, -1 for system clocks
+    int phc_index;       // /dev/ptpN, -1 for system clocks
+    char name[64];
+} tsn_clock_t;
+
+// Open a clock by name; returns 0, or -1 and fills errbuf (256 bytes)
+int tsn_clock_open(tsn_clock_t *c, const char *name, char *errbuf);
+
+void tsn_clock_close(tsn_clock_t *c);
+
+// PHC index of ifname's hardware timestamps, -1 if it has none
+int tsn_phc_index(const char *ifname);
+
+static inline uint64_t tsn_clock_now(const tsn_clock_t *c) {
+    struct timespec ts;
+    clock_gettime(c->id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// a - b in ns at the time of the call; err_ns (may be NULL) gets the
+// measurement uncertainty. Returns 0 or -1
+int tsn_clock_offset(const tsn_clock_t *a, const tsn_clock_t *b, int64_t *offset_ns, uint64_t *err_ns);
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * tsn-common.c - Clocks, argument parsing and socket helpers (libtsntest)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#include "tsn-common.h"
+
+int tsn_parse_mac(const char *str, unsigned char *mac) {
+    return sscanf(str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+                  &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6 ? 0 : -1;
+}
+
+int tsn_parse_tc_list(const char *str, int *tcs) {
+    int count = 0;
+    char *copy = strdup(str);
+    if (!copy) return 0;
+
+    char *save = NULL;
+    char *token = strtok_r(copy, ",", &save);
+    while (token && count < TSN_MAX_TC) {
+        int tc = atoi(token);
+        if (tc >= 0 && tc < TSN_MAX_TC) tcs[count++] = tc;
+        token = strtok_r(NULL, ",", &save);
+    }
+    free(copy);
+    return count;
+}
+
+int tsn_get_iface_mac(const char *ifname, unsigned char *mac) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
+    return 0;
+}
+
+int tsn_raw_socket_open(const char *ifname) {
+    int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
+        perror("ioctl SIOCGIFINDEX");
+        close(sock);
+        return -1;
+    }
+
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = ifr.ifr_ifindex;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    if (bind(sock, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+void tsn_setup_realtime(int prio_offset) {
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - prio_offset;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+        // Not critical (needs root), continue anyway
+    }
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+}
+
+int tsn_pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
@@ -0,0 +1,78 @@
+/*
+ * tsn-common.h - Clocks, argument parsing and socket helpers shared by the
+ * TSN tools (part of libtsntest)
+ */
+
+#ifndef TSN_COMMON_H
+#define TSN_COMMON_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define TSN_MAX_TC 8
+
+// Monotonic time for pacing and test durations
+static inline uint64_t tsn_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// CLOCK_REALTIME, the clock software RX timestamps are taken on; the TX
+// timestamp in the test header uses it so one-way latency needs no conversion
+static inline uint64_t tsn_realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// CLOCK_TAI, the clock SO_TXTIME launch times are expressed in
+static inline uint64_t tsn_tai_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_TAI, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Busy wait until target (CLOCK_MONOTONIC) or until *running is cleared
+static inline void tsn_spin_until(uint64_t target_ns, const volatile int *running) {
+    while (tsn_time_ns() < target_ns) {
+        if (running && !*running) return;
+    }
+}
+
+// 802.1Q fields of a tagged frame
+typedef struct {
+    int pcp;
+    int vid;
+    uint16_t ethertype;  // inner EtherType
+} tsn_vlan_t;
+
+// Returns 0 if the frame carries an 802.1Q tag at offset 12, -1 otherwise
+static inline int tsn_parse_vlan(const uint8_t *pkt, uint32_t caplen, tsn_vlan_t *v) {
+    if (caplen < 18 || pkt[12] != 0x81 || pkt[13] != 0x00) return -1;
+    uint16_t tci = (pkt[14] << 8) | pkt[15];
+    v->pcp = (tci >> 13) & 0x07;
+    v->vid = tci & 0x0FFF;
+    v->ethertype = (pkt[16] << 8) | pkt[17];
+    return 0;
+}
+
+// "aa:bb:cc:dd:ee:ff" -> bytes; returns 0 or -1
+int tsn_parse_mac(const char *str, unsigned char *mac);
+
+// "6,7" -> {6, 7}; stores at most TSN_MAX_TC entries, skips values outside 0..7
+int tsn_parse_tc_list(const char *str, int *tcs);
+
+// Hardware address of an interface; returns 0 or -1
+int tsn_get_iface_mac(const char *ifname, unsigned char *mac);
+
+// AF_PACKET raw socket bound to ifname; returns the fd or -1 (perror printed)
+int tsn_raw_socket_open(const char *ifname);
+
+// SCHED_FIFO at (max priority - prio_offset) plus mlockall; failures are ignored
+void tsn_setup_realtime(int prio_offset);
+
+// Pin the calling thread to one CPU; returns 0 or -1
+int tsn_pin_cpu(int cpu);
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * tsn-cycle.c - TAS cycle time search over arbitrary periods (libtsntest)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "tsn-cycle.h"
+#include "tsn-simd.h"
+
+#define TWO_PI 6.28318530717958647692
+
+#define HARMONICS 8         // harmonics summed per candidate frequency
+#define FFT_MAX (1u << 20)  // spectral bins (8 MB of scratch at most)
+#define FOLD_BINS 64        // phase bins while refining
+#define CONF_BINS 100       // phase bins for the confidence score
+#define MAX_TRIALS 4096     // periods tried per refinement level
+#define FUNDAMENTAL_SHARE 0.8
+#define MAX_CANDIDATES 32
+#define OCCUPANCY_SHARE 0.9
+#define SUPERCYCLE_GAIN 1.1  // fold score a multiple must add to replace the period
+
+// Phase histogram of t[0..n) folded at period (vector kernel, tsn-simd.h)
+static void fold(const uint32_t *t, uint32_t n, double period, int n_bins, uint32_t *bins) {
+    tsn_simd_fold(t, n, period, n_bins, bins);
+}
+
+void tsn_cycle_fold(const tsn_stream_t *s, double cycle_ns, int n_bins, uint32_t *bins) {
+    fold(s->arrivals, s->n_arrivals, cycle_ns, n_bins, bins);
+}
+
+// Number of sorted arrivals before span_ns
+static uint32_t prefix_len(const tsn_stream_t *s, double span_ns) {
+    uint32_t lo = 0, hi = s->n_arrivals;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (s->arrivals[mid] < span_ns) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Variance of the folded profile normalized by mean squared, averaged over
+// the qualifying streams: large when packets cluster at one phase. Periods
+// are only comparable at the same bin width, hence n_bins.
+static double fold_score(const tsn_stream_t *streams, int n_streams, uint64_t min_packets,
+                         double period, double span_ns, int n_bins) {
+    uint32_t bins[HARMONICS * FOLD_BINS];
+    double total = 0;
+    int used = 0;
+
+    for (int i = 0; i < n_streams; i++) {
+        const tsn_stream_t *s = &streams[i];
+        if (s->n_arrivals < min_packets) continue;
+        uint32_t n = prefix_len(s, span_ns);
+        if (n < 2) continue;
+
+        fold(s->arrivals, n, period, n_bins, bins);
+        double mean = (double)n / n_bins;
+        double var = 0;
+        for (int b = 0; b < n_bins; b++) {
+            double d = bins[b] - mean;
+            var += d * d;
+        }
+        total += var / n_bins / (mean * mean);
+        used++;
+    }
+    return used ? total / used : 0;
+}
+
+// Cycles holding at least one arrival over the number expected were the
+// arrivals spread at random, averaged over the streams: about 1 at the cycle
+// or a multiple of it, well below at a fraction of it, where most cycles of
+// a TC's gate pattern come up empty
+static double cycle_occupancy(const tsn_stream_t *streams, int n_streams, uint64_t min_packets,
+                              double period) {
+    const double inv = 1.0 / period;
+    double total = 0;
+    int used = 0;
+
+    for (int i = 0; i < n_streams; i++) {
+        const tsn_stream_t *s = &streams[i];
+        if (s->n_arrivals < min_packets || s->n_arrivals < 2) continue;
+
+        uint64_t occupied = 0, last = UINT64_MAX;
+        for (uint32_t k = 0; k < s->n_arrivals; k++) {
+            uint64_t c = (uint64_t)(s->arrivals[k] * inv);
+            if (c != last) {
+                occupied++;
+                last = c;
+            }
+        }
+        double cycles = floor(s->arrivals[s->n_arrivals - 1] * inv) + 1;
+        double expected = cycles * (1 - pow(1 - 1 / cycles, s->n_arrivals));
+        total += occupied / expected;
+        used++;
+    }
+    return used ? total / used : 0;
+}
+
+// In-place iterative radix-2 FFT, n a power of two. Each stage's twiddles go
+// to wr/wi (n/2 floats each) first, so the butterflies run as a vector kernel
+static void fft(float *re, float *im, uint32_t n, float *wr, float *wi) {
+    for (uint32_t i = 1, j = 0; i < n; i++) {
+        uint32_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        double sr = cos(-TWO_PI / len), si = sin(-TWO_PI / len);
+        uint32_t half = len / 2;
+        double cr = 1, ci = 0;
+        for (uint32_t j = 0; j < half; j++) {
+            wr[j] = (float)cr;
+            wi[j] = (float)ci;
+            double t = cr * sr - ci * si;
+            ci = cr * si + ci * sr;
+            cr = t;
+        }
+        tsn_simd_fft_stage(re, im, n, half, wr, wi);
+    }
+}
+
+static inline double harmonic_sum(const float *power, double k, int harmonics) {
+    double h = 0;
+    for (int m = 1; m <= harmonics; m++) h += power[(uint32_t)lround(m * k)];
+    return h;
+}
+
+// Fundamental period from the summed per-stream power spectra. Each stream is
+// normalized to unit power so a busy TC does not drown the others. Sets the
+// relative uncertainty of the estimate; returns 0 or -1.
+static int spectral_estimate(const tsn_stream_t *streams, int n_streams, uint64_t min_packets,
+                             double min_c, double max_c, double res_ns, double span_ns,
+                             double *period, double *rel_err) {
+    double w = min_c / (2 * HARMONICS);
+    if (w < res_ns) w = res_ns;
+    if (span_ns / w > FFT_MAX) w = span_ns / FFT_MAX;
+    uint32_t n = 4;
+    while (n < span_ns / w && n < FFT_MAX) n <<= 1;
+
+    // The binned signal is real: its even and odd bins go in as the real and
+    // imaginary part of an m = n/2 point FFT, split into the n-point spectrum
+    // after, which halves the work and the scratch
+    uint32_t m = n / 2;
+    float *re = malloc(m * sizeof(float));
+    float *im = malloc(m * sizeof(float));
+    float *power = calloc(m, sizeof(float));
+    float *tw = malloc(m * sizeof(float));  // twiddles (re | im), then the spectrum
+    if (!re || !im || !power || !tw) {
+        free(re); free(im); free(power); free(tw);
+        return -1;
+    }
+    const double sr = cos(-TWO_PI / n), si = sin(-TWO_PI / n);
+
+    for (int i = 0; i < n_streams; i++) {
+        const tsn_stream_t *s = &streams[i];
+        if (s->n_arrivals < min_packets) continue;
+
+        memset(re, 0, m * sizeof(float));
+        memset(im, 0, m * sizeof(float));
+        const double inv_w = 1.0 / w;
+        uint32_t used = 0;
+        for (uint32_t k = 0; k < s->n_arrivals; k++) {
+            uint64_t b = (uint64_t)(s->arrivals[k] * inv_w);
+            if (b >= n) break;
+            (b & 1 ? im : re)[b >> 1] += 1;
+            used++;
+        }
+        float mean = (float)used / n;
+        for (uint32_t b = 0; b < m; b++) {
+            re[b] -= mean;
+            im[b] -= mean;
+        }
+
+        fft(re, im, m, tw, tw + m / 2);
+
+        // X[k] = E + W^k O with E = (Z[k] + conj Z[m-k]) / 2,
+        // O = (Z[k] - conj Z[m-k]) / 2i and W = e^(-2 pi i / n)
+        float *spec = tw;
+        double cr = 1, ci = 0, total = 0;
+        for (uint32_t k = 1; k < m; k++) {
+            double t = cr * sr - ci * si;
+            ci = cr * si + ci * sr;
+            cr = t;
+
+            double er = (re[k] + re[m - k]) / 2, ei = (im[k] - im[m - k]) / 2;
+            double dr = (re[k] - re[m - k]) / 2, di = (im[k] + im[m - k]) / 2;
+            double xr = er + cr * di + ci * dr;
+            double xi = ei - cr * dr + ci * di;
+            spec[k] = (float)(xr * xr + xi * xi);
+            total += spec[k];
+        }
+        if (total <= 0) continue;
+        for (uint32_t k = 1; k < m; k++) power[k] += spec[k] / total;
+    }
+
+    // Harmonic sum over fractional bins k = n*w/period; the same harmonic
+    // count for every k so long cycles are not favored
+    double kmin = n * w / max_c, kmax = n * w / min_c;
+    if (kmin < 1) kmin = 1;
+    int harmonics = HARMONICS;
+    while (harmonics > 1 && harmonics * kmax >= n / 2 - 1) harmonics--;
+    if (kmax * harmonics >= n / 2 - 1) kmax = (n / 2 - 1) / (double)harmonics;
+
+    double best_h = 0;
+    for (double k = kmin; k <= kmax; k += 1.0 / HARMONICS) {
+        double h = harmonic_sum(power, k, harmonics);
+        if (h > best_h) best_h = h;
+    }
+
+    // Sharp gate openings put equal power into every harmonic, so a multiple of
+    // the fundamental can score as high as the fundamental itself, and a
+    // smooth window envelope lets a subharmonic come close. Collect the local
+    // peaks close to the best, then take the highest frequency whose period
+    // keeps the cycles occupied (the lowest if none does).
+    double cand[MAX_CANDIDATES];
+    int n_cand = 0;
+    for (double k = kmin; k <= kmax && best_h > 0 && n_cand < MAX_CANDIDATES; k += 1.0 / HARMONICS) {
+        double h = harmonic_sum(power, k, harmonics);
+        if (h < FUNDAMENTAL_SHARE * best_h) continue;
+        while (k + 1.0 / HARMONICS <= kmax) {
+            double next = harmonic_sum(power, k + 1.0 / HARMONICS, harmonics);
+            if (next <= h) break;
+            h = next;
+            k += 1.0 / HARMONICS;
+        }
+        cand[n_cand++] = k;
+
+        // Skip down the far side of this peak
+        while (k + 1.0 / HARMONICS <= kmax &&
+               harmonic_sum(power, k + 1.0 / HARMONICS, harmonics) >= FUNDAMENTAL_SHARE * best_h) {
+            k += 1.0 / HARMONICS;
+        }
+    }
+
+    double best_k = n_cand ? cand[0] : 0;
+    for (int c = n_cand - 1; c > 0; c--) {
+        if (cycle_occupancy(streams, n_streams, min_packets, n * w / cand[c]) >= OCCUPANCY_SHARE) {
+            best_k = cand[c];
+            break;
+        }
+    }
+
+    free(re);
+    free(im);
+    free(power);
+    free(tw);
+    if (best_k == 0) return -1;
+
+    *period = n * w / best_k;
+    *rel_err = 1.0 / best_k;
+    if (*period / span_ns > *rel_err) *rel_err = *period / span_ns;
+    return 0;
+}
+
+// Coarse-to-fine epoch folding around p0: a prefix of the capture tolerates
+// coarse period steps, each longer span narrows the range and the step
+static double fold_refine(const tsn_stream_t *streams, int n_streams, uint64_t min_packets,
+                          double p0, double rel_err, double span_ns) {
+    double lo = p0 * (1 - 1.5 * rel_err);
+    double hi = p0 * (1 + 1.5 * rel_err);
+    double best = p0;
+
+    for (double frac = 1.0 / 16; ; frac *= 4) {
+        if (frac > 1) frac = 1;
+        double span = span_ns * frac;
+        if (span < 8 * p0 && frac < 1) continue;
+
+        // Period error that drifts half a bin over the span
+        double step = p0 * p0 / (2.0 * FOLD_BINS * span);
+        if ((hi - lo) / step > MAX_TRIALS) step = (hi - lo) / MAX_TRIALS;
+
+        double best_score = -1;
+        for (double p = lo; p <= hi; p += step) {
+            double score = fold_score(streams, n_streams, min_packets, p, span, FOLD_BINS);
+            if (score > best_score) {
+                best_score = score;
+                best = p;
+            }
+        }
+        lo = best - 2 * step;
+        hi = best + 2 * step;
+        if (frac >= 1) break;
+    }
+    return best;
+}
+
+double tsn_cycle_confidence(const tsn_stream_t *streams, int n_streams,
+                            uint64_t cycle_ns, uint64_t min_packets) {
+    uint32_t bins[CONF_BINS];
+    double total = 0;
+    uint64_t weight = 0;
+
+    for (int i = 0; i < n_streams; i++) {
+        const tsn_stream_t *s = &streams[i];
+        if (s->n_arrivals < min_packets || cycle_ns == 0) continue;
+
+        fold(s->arrivals, s->n_arrivals, (double)cycle_ns, CONF_BINS, bins);
+        double mean = (double)s->n_arrivals / CONF_BINS;
+        uint64_t in_busy = 0;
+        int busy = 0;
+        for (int b = 0; b < CONF_BINS; b++) {
+            if (bins[b] >= mean) {
+                in_busy += bins[b];
+                busy++;
+            }
+        }
+        double c = (double)in_busy / s->n_arrivals - (double)busy / CONF_BINS;
+        total += c * s->n_arrivals;
+        weight += s->n_arrivals;
+    }
+    return weight ? total / weight : 0;
+}
+
+int tsn_cycle_search(const tsn_stream_t *streams, int n_streams,
+                     uint64_t min_cycle_ns, uint64_t max_cycle_ns,
+                     uint64_t min_packets, uint32_t ts_resolution_ns,
+                     tsn_cycle_t *out) {
+    double span = 0;
+    for (int i = 0; i < n_streams; i++) {
+        const tsn_stream_t *s = &streams[i];
+        if (s->n_arrivals < min_packets || s->n_arrivals == 0) continue;
+        if (s->arrivals[s->n_arrivals - 1] > span) span = s->arrivals[s->n_arrivals - 1];
+    }
+
+    // At least two cycles must fit in the sample
+    double min_c = min_cycle_ns, max_c = max_cycle_ns;
+    if (max_c > span / 2) max_c = span / 2;
+    if (min_c < 2 * ts_resolution_ns) min_c = 2 * ts_resolution_ns;
+    if (span == 0 || max_c < min_c) return -1;
+
+    double p0, rel_err;
+    if (spectral_estimate(streams, n_streams, min_packets, min_c, max_c, ts_resolution_ns,
+                          span, &p0, &rel_err) < 0) return -1;
+
+    double period = fold_refine(streams, n_streams, min_packets, p0, rel_err, span);
+
+    // A whole multiple folds exactly as sharply unless the gate pattern only
+    // repeats over several base periods (a GCL that alternates), then sharper
+    double score = fold_score(streams, n_streams, min_packets, period, span, FOLD_BINS);
+    for (int m = 2; m <= HARMONICS && period * m <= max_c; m++) {
+        if (fold_score(streams, n_streams, min_packets, period * m, span, m * FOLD_BINS) >
+            SUPERCYCLE_GAIN * score) {
+            period = fold_refine(streams, n_streams, min_packets, period * m, rel_err, span);
+            break;
+        }
+    }
+    out->cycle_ns = (uint64_t)llround(period);
+    out->confidence = tsn_cycle_confidence(streams, n_streams, out->cycle_ns, min_packets);
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * tsn-cycle.h - TAS cycle time search over arbitrary periods (libtsntest)
+ *
+ * Works on the arrival sample kept by tsn_stream_keep_arrivals():
+ *   1. spectral - arrivals are binned, every TC's power spectrum is summed and
+ *                 a harmonic sum picks the fundamental in [min, max] cycle:
+ *                 the highest candidate peak whose cycles all see traffic
+ *   2. folding  - coarse-to-fine epoch folding around that estimate: a short
+ *                 prefix of the capture first, then longer spans with finer
+ *                 period steps, keeping the least uniform phase profile; a
+ *                 multiple that folds clearly sharper (alternating GCL) wins
+ * Cost is a few FFTs plus O(samples) per fold, independent of the candidate
+ * grid, so cycles like 250 us or 1.5 ms are found as easily as 1 ms.
+ */
+
+#ifndef TSN_CYCLE_H
+#define TSN_CYCLE_H
+
+#include <stdint.h>
+
+#include "tsn-analysis.h"
+
+// Arrivals to keep per stream (256 KB each)
+#define TSN_CYCLE_SAMPLES 65536
+
+typedef struct {
+    uint64_t cycle_ns;
+    // 0..1: share of packets inside the busy part of the folded cycle minus
+    // the share of the cycle that part covers (0 = no periodic structure)
+    double confidence;
+} tsn_cycle_t;
+
+// Search streams with at least min_packets sampled arrivals. ts_resolution_ns
+// bounds the spectral bin width. Returns 0, or -1 if no stream qualifies or the
+// capture spans fewer than two max cycles and nothing shorter fits.
+int tsn_cycle_search(const tsn_stream_t *streams, int n_streams,
+                     uint64_t min_cycle_ns, uint64_t max_cycle_ns,
+                     uint64_t min_packets, uint32_t ts_resolution_ns,
+                     tsn_cycle_t *out);
+
+// Confidence of a given cycle (e.g. one passed by the user), same scale
+double tsn_cycle_confidence(const tsn_stream_t *streams, int n_streams,
+                            uint64_t cycle_ns, uint64_t min_packets);
+
+// Phase histogram of the sampled arrivals folded at cycle_ns
+void tsn_cycle_fold(const tsn_stream_t *s, double cycle_ns, int n_bins, uint32_t *bins);
+
+#endif
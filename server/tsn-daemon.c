@@ -0,0 +1,1082 @@
+/*
+ * tsn-daemon.c - Long-lived sender/capture engine behind a Unix control socket
+ *
+ * Runs the traffic-sender and traffic-capture engines without a process per
+ * test: raw sockets, TX rings, capture rings and BPF programs are opened once
+ * and reused while the interface and options stay the same, so back-to-back
+ * runs start in milliseconds.
+ *
+ * Protocol (SOCK_STREAM):
+ *   client -> daemon  one command per line, "word word key=value ..."
+ *   daemon -> client  frames: length (32, little-endian) | type (8) | payload
+ *                     type 'R' reply to the last command, 'E' event; both
+ *                     carry one JSON object (same fields as the tools print)
+ *
+ * Commands:
+ *   ping
+ *   status
+ *   subscribe / unsubscribe      stats events every --interval-ms
+ *   capture start iface=IF [vlan=100] [workers=1] [records=NAME]
+ *   capture stop                 reply: final per-TC analysis
+ *   send start iface=IF dst=MAC [src=MAC] [vlan=100] [tcs=0,1,...] [pps=1000]
+ *              [duration=10] [size=1000] [engine=send|mmsg|ring] [batch=N]
+ *              [prio=N] [per-tc=1] [cpus=LIST] [flows=N] [imix=SPEC|imix]
+ *              [pacing=hybrid|spin|sleep]
+ *   send rate pps=N              reconfigure a running sender (per worker)
+ *   send stop                    replies after the 'send_done' event
+ *   shutdown
+ *
+ * Events: capture_stats, send_stats (to subscribers), send_done (to every
+ * client). Slow subscribers lose stats events rather than stall the daemon.
+ * capture_final and send_done carry the run's "instrumentation" (kernel
+ * drops, send failures, late sends; tsn-instr.h), net of earlier runs on the
+ * same reused socket.
+ * txtime pacing stays with traffic-sender.
+ *
+ * records=NAME writes tsn-record frames to NAME in --records-dir (letters,
+ * digits, '.', '_', '-'; no path): the daemon runs as root, so a client
+ * only ever picks a file name in that directory, which must belong to the
+ * daemon and not be writable by anyone else.
+ *
+ * Compile: make tsn-daemon (links libtsntest.a)
+ * Run: sudo ./tsn-daemon [--socket PATH] [--interval-ms N] [--records-dir DIR]
+ *      echo "capture start iface=enp2s0 vlan=100" | socat - UNIX:/tmp/tsn-daemon.sock
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <net/if.h>
+
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-tx.h"
+#include "tsn-capture.h"
+#include "tsn-analysis.h"
+#include "tsn-record.h"
+#include "tsn-pace.h"
+
+#define MAX_TC TSN_MAX_TC
+#define DEFAULT_SOCKET "/tmp/tsn-daemon.sock"
+#define DEFAULT_INTERVAL_MS 200
+#define DEFAULT_RECORDS_DIR "/var/tmp/tsn-daemon"
+#define MAX_CLIENTS 16
+#define CMD_MAX 1024
+#define MAX_ARGS 24
+#define MAX_TX_SOCKETS 16
+#define MIN_FRAME_SIZE 64
+
+#define FRAME_REPLY 'R'
+#define FRAME_EVENT 'E'
+
+// ---------------------------------------------------------------------------
+// JSON message buffer
+
+typedef struct {
+    char buf[16384];
+    size_t len;
+} msg_t;
+
+static void msg_printf(msg_t *m, const char *fmt, ...) {
+    if (m->len >= sizeof(m->buf)) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(m->buf + m->len, sizeof(m->buf) - m->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) m->len += n;
+    if (m->len > sizeof(m->buf) - 1) m->len = sizeof(m->buf) - 1;
+}
+
+// "instrumentation":{...} member
+static void msg_instr(msg_t *m, const tsn_instr_t *in) {
+    char buf[1024];
+    FILE *f = fmemopen(buf, sizeof(buf), "w");
+    if (!f) return;
+    tsn_instr_print_json(f, in);
+    fclose(f);
+    msg_printf(m, "%s", buf);
+}
+
+// ---------------------------------------------------------------------------
+// Clients
+
+typedef struct {
+    int fd;
+    bool subscribed;
+    char buf[CMD_MAX];
+    size_t len;
+} client_t;
+
+static client_t clients[MAX_CLIENTS];
+static int n_clients = 0;
+static volatile int running = 1;
+static uint64_t dropped_events = 0;
+
+// Reply frames block (the client waits for them); event frames to a full
+// socket are dropped
+static int send_frame(client_t *c, char type, const msg_t *m) {
+    uint8_t hdr[5];
+    uint32_t len = m->len;
+    memcpy(hdr, &len, 4);
+    hdr[4] = type;
+
+    struct iovec iov[2] = { { hdr, sizeof(hdr) }, { (void *)m->buf, m->len } };
+    struct msghdr mh = { .msg_iov = iov, .msg_iovlen = 2 };
+    int flags = MSG_NOSIGNAL | (type == FRAME_EVENT ? MSG_DONTWAIT : 0);
+    ssize_t n = sendmsg(c->fd, &mh, flags);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        dropped_events++;
+        return 0;
+    }
+    if (n < 0) return -1;
+
+    // A short write of a blocking reply: finish it
+    size_t total = sizeof(hdr) + m->len;
+    while ((size_t)n < total) {
+        size_t off = n;
+        const uint8_t *p = off < sizeof(hdr) ? hdr + off : (const uint8_t *)m->buf + (off - sizeof(hdr));
+        size_t rest = off < sizeof(hdr) ? sizeof(hdr) - off : total - off;
+        ssize_t k = send(c->fd, p, rest, MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        n += k;
+    }
+    return 0;
+}
+
+static void broadcast(const msg_t *m, bool subscribers_only) {
+    for (int i = 0; i < n_clients; i++) {
+        if (!subscribers_only || clients[i].subscribed) send_frame(&clients[i], FRAME_EVENT, m);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Command arguments
+
+typedef struct {
+    const char *words[4];
+    int n_words;
+    const char *keys[MAX_ARGS];
+    const char *vals[MAX_ARGS];
+    int n_args;
+} cmd_t;
+
+// Split line in place into words and key=value pairs
+static void cmd_parse(char *line, cmd_t *c) {
+    memset(c, 0, sizeof(*c));
+    for (char *tok = strtok(line, " \t\r"); tok; tok = strtok(NULL, " \t\r")) {
+        char *eq = strchr(tok, '=');
+        if (eq && c->n_args < MAX_ARGS) {
+            *eq = '\0';
+            c->keys[c->n_args] = tok;
+            c->vals[c->n_args++] = eq + 1;
+        } else if (!eq && c->n_words < 4) {
+            c->words[c->n_words++] = tok;
+        }
+    }
+}
+
+static bool cmd_is(const cmd_t *c, const char *w0, const char *w1) {
+    if (c->n_words < 1 || strcmp(c->words[0], w0) != 0) return false;
+    if (!w1) return c->n_words == 1;
+    return c->n_words == 2 && strcmp(c->words[1], w1) == 0;
+}
+
+static const char *arg_str(const cmd_t *c, const char *key, const char *def) {
+    for (int i = 0; i < c->n_args; i++) {
+        if (strcmp(c->keys[i], key) == 0) return c->vals[i];
+    }
+    return def;
+}
+
+static long arg_int(const cmd_t *c, const char *key, long def) {
+    const char *v = arg_str(c, key, NULL);
+    return v ? strtol(v, NULL, 10) : def;
+}
+
+static void reply_error(msg_t *r, const char *fmt, ...) {
+    char text[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    r->len = 0;
+    msg_printf(r, "{\"ok\":false,\"error\":\"");
+    for (const char *p = text; *p; p++) {
+        if (*p == '"' || *p == '\\') msg_printf(r, "\\%c", *p);
+        else if ((unsigned char)*p >= 0x20) msg_printf(r, "%c", *p);
+    }
+    msg_printf(r, "\"}");
+}
+
+// "1,2,3" -> ints; returns the count (at most max)
+static int parse_int_list(const char *str, int *out, int max) {
+    int n = 0;
+    char *end;
+    while (*str && n < max) {
+        long v = strtol(str, &end, 10);
+        if (end == str) break;
+        out[n++] = (int)v;
+        str = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Capture engine
+
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t first_ts_ns;
+    uint64_t last_ts_ns;
+} cap_counters_t;
+
+// Written by the capture worker owning the TC only; the main thread takes
+// seqlock snapshots while running and reads the rest after stop
+typedef struct {
+    uint32_t seq;
+    cap_counters_t live;
+    tsn_seq_t stream_seq;
+    tsn_hist_t interval_hist;
+} __attribute__((aligned(64))) cap_tc_t;
+
+static struct {
+    tsn_capture_group_t *g;   // kept open between runs on the same interface
+    char ifname[IFNAMSIZ];
+    int workers;
+    char filter[64];
+    bool running;
+    int vlan;
+    uint64_t start_ns;
+    tsn_instr_t base_instr;   // group counters at the start of the run
+    cap_tc_t tc[MAX_TC];
+    tsn_rec_out_t *rec_out;
+    tsn_rec_buf_t *rec_bufs;
+} cap;
+
+// Matches no frame: an idle group stops queueing traffic between runs
+#define IDLE_FILTER "less 1"
+
+static void cap_handler(void *user, const tsn_packet_t *p) {
+    tsn_vlan_t vlan;
+    if (tsn_parse_vlan(p->data, p->caplen, &vlan) < 0) return;
+    if (cap.vlan > 0 && vlan.vid != cap.vlan) return;
+
+    cap_tc_t *tc = &cap.tc[vlan.pcp];
+    cap_counters_t *c = &tc->live;
+
+    __atomic_store_n(&tc->seq, tc->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (c->count == 0) c->first_ts_ns = p->ts_ns;
+    else tsn_hist_add(&tc->interval_hist, p->ts_ns - c->last_ts_ns);
+    c->last_ts_ns = p->ts_ns;
+    c->bytes += p->len;
+    c->count++;
+    __atomic_store_n(&tc->seq, tc->seq + 1, __ATOMIC_RELEASE);
+
+    tsn_test_hdr_t th;
+    int has_seq = tsn_test_hdr_parse(p->data, p->caplen, &th) == 0;
+    if (has_seq) tsn_seq_add(&tc->stream_seq, th.seq, (int64_t)(p->ts_ns - th.tx_ns));
+
+    if (user) {
+        tsn_rec_t r;
+        tsn_rec_make(&r, p->ts_ns, vlan.pcp, vlan.vid, p->len, has_seq ? &th : NULL);
+        tsn_rec_put(user, &r, DEFAULT_INTERVAL_MS * 1000000ULL);
+    }
+}
+
+static void cap_snapshot(cap_tc_t *tc, cap_counters_t *out) {
+    uint32_t start, end;
+    do {
+        start = __atomic_load_n(&tc->seq, __ATOMIC_ACQUIRE);
+        memcpy(out, &tc->live, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&tc->seq, __ATOMIC_RELAXED);
+    } while ((start & 1) || start != end);
+}
+
+static void discard(void *user, const tsn_packet_t *p) {
+    (void)user;
+    (void)p;
+}
+
+// Reuse the open group when interface and worker count match
+static int cap_open(const char *ifname, int workers, msg_t *r) {
+    if (cap.g && strcmp(cap.ifname, ifname) == 0 && cap.workers == workers) {
+        // Frames queued before the idle filter went in
+        for (int i = 0; i < workers; i++) {
+            tsn_capture_t *m = tsn_capture_group_member(cap.g, i);
+            while (tsn_capture_dispatch(m, discard, NULL) > 0) {}
+        }
+        return 0;
+    }
+
+    tsn_capture_group_close(cap.g);
+    cap.g = NULL;
+    cap.filter[0] = '\0';
+
+    char errbuf[256];
+    tsn_capture_opts_t opts;
+    tsn_capture_opts_init(&opts);
+    cap.g = tsn_capture_group_open(ifname, &opts, workers, errbuf);
+    if (!cap.g) {
+        reply_error(r, "capture open: %s", errbuf);
+        return -1;
+    }
+    snprintf(cap.ifname, sizeof(cap.ifname), "%s", ifname);
+    cap.workers = workers;
+    return 0;
+}
+
+static const char *records_dir = DEFAULT_RECORDS_DIR;
+
+// Path of records=NAME inside records_dir (created on first use). Returns 0,
+// or -1 after replying with the reason
+static int records_path(const char *name, char *path, size_t size, msg_t *r) {
+    size_t n = strlen(name);
+    bool ok = n > 0 && n < 128 && ((name[0] >= 'A' && name[0] <= 'Z') ||
+                                   (name[0] >= 'a' && name[0] <= 'z') ||
+                                   (name[0] >= '0' && name[0] <= '9'));
+    for (size_t i = 0; ok && i < n; i++) {
+        char ch = name[i];
+        ok = (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') ||
+             ch == '.' || ch == '_' || ch == '-';
+    }
+    if (!ok || strstr(name, "..")) {
+        reply_error(r, "records= is a file name in %s ([A-Za-z0-9._-], no path)", records_dir);
+        return -1;
+    }
+
+    struct stat st;
+    if (mkdir(records_dir, 0755) < 0 && errno != EEXIST) {
+        reply_error(r, "records dir %s: %s", records_dir, strerror(errno));
+        return -1;
+    }
+    if (lstat(records_dir, &st) < 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+        (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        reply_error(r, "records dir %s: not a directory owned by and writable only by the daemon",
+                    records_dir);
+        return -1;
+    }
+    snprintf(path, size, "%s/%s", records_dir, name);
+    return 0;
+}
+
+static int cap_set_filter(const char *filter) {
+    if (strcmp(cap.filter, filter) == 0) return 0;
+    if (tsn_capture_group_set_filter(cap.g, filter) < 0) return -1;
+    snprintf(cap.filter, sizeof(cap.filter), "%s", filter);
+    return 0;
+}
+
+static void cmd_capture_start(const cmd_t *c, msg_t *r) {
+    const char *ifname = arg_str(c, "iface", NULL);
+    int workers = arg_int(c, "workers", 1);
+    const char *records = arg_str(c, "records", NULL);
+    if (!ifname) return reply_error(r, "iface= is required");
+    if (cap.running) return reply_error(r, "capture already running");
+    if (workers < 1 || workers > TSN_CAPTURE_MAX_WORKERS) {
+        return reply_error(r, "workers must be 1..%d", TSN_CAPTURE_MAX_WORKERS);
+    }
+    char rec_path[PATH_MAX];
+    if (records && records_path(records, rec_path, sizeof(rec_path), r) < 0) return;
+
+    uint64_t t0 = tsn_time_ns();
+    bool reused = cap.g && strcmp(cap.ifname, ifname) == 0 && cap.workers == workers;
+    if (cap_open(ifname, workers, r) < 0) return;
+
+    for (int i = 0; i < MAX_TC; i++) {
+        memset(&cap.tc[i], 0, sizeof(cap.tc[i]));
+        tsn_seq_init(&cap.tc[i].stream_seq);
+        tsn_hist_init(&cap.tc[i].interval_hist);
+    }
+    cap.vlan = arg_int(c, "vlan", 100);
+    memset(&cap.base_instr, 0, sizeof(cap.base_instr));
+    tsn_capture_group_instr(cap.g, &cap.base_instr);
+
+    void *users[TSN_CAPTURE_MAX_WORKERS] = { 0 };
+    if (records) {
+        char errbuf[256];
+        tsn_capture_t *m = tsn_capture_group_member(cap.g, 0);
+        uint32_t flags = strcmp(tsn_capture_ts_source(m), "hardware") == 0 ? TSN_REC_F_HWTS : 0;
+        cap.rec_out = tsn_rec_create(rec_path, tsn_capture_ts_resolution_ns(m), flags, errbuf);
+        if (!cap.rec_out) return reply_error(r, "records: %s", errbuf);
+        cap.rec_bufs = calloc(workers, sizeof(tsn_rec_buf_t));
+        if (!cap.rec_bufs) {
+            tsn_rec_close(cap.rec_out);
+            cap.rec_out = NULL;
+            return reply_error(r, "out of memory");
+        }
+        for (int i = 0; i < workers; i++) {
+            tsn_rec_buf_init(&cap.rec_bufs[i], cap.rec_out);
+            users[i] = &cap.rec_bufs[i];
+        }
+    }
+
+    char filter[64];
+    snprintf(filter, sizeof(filter), "vlan %d", cap.vlan);
+    cap_set_filter(filter);
+
+    int cpus[TSN_CAPTURE_MAX_WORKERS];
+    for (int i = 0; i < workers; i++) cpus[i] = i % (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (tsn_capture_group_start(cap.g, cap_handler, users, workers > 1 ? cpus : NULL) < 0) {
+        if (cap.rec_out) {
+            tsn_rec_close(cap.rec_out);
+            free(cap.rec_bufs);
+            cap.rec_out = NULL;
+            cap.rec_bufs = NULL;
+        }
+        return reply_error(r, "cannot start capture workers");
+    }
+    cap.running = true;
+    cap.start_ns = tsn_time_ns();
+
+    tsn_capture_t *m = tsn_capture_group_member(cap.g, 0);
+    msg_printf(r, "{\"ok\":true,\"capture\":\"started\",\"iface\":\"%s\",\"vlan\":%d,"
+               "\"workers\":%d,\"backend\":\"%s\",\"timestamp_source\":\"%s\","
+               "\"reused\":%s,\"setup_us\":%.1f",
+               cap.ifname, cap.vlan, workers, tsn_capture_backend_name(m),
+               tsn_capture_ts_source(m), reused ? "true" : "false", (cap.start_ns - t0) / 1e3);
+    if (cap.rec_out) msg_printf(r, ",\"records_path\":\"%s\"", rec_path);
+    msg_printf(r, "}");
+}
+
+// "<name>_p50_us" ... "<name>_max_us" members
+static void msg_pctl(msg_t *m, const char *name, const tsn_pctl_t *p) {
+    msg_printf(m, ",\"%s_p50_us\":%.1f,\"%s_p90_us\":%.1f,\"%s_p99_us\":%.1f,"
+               "\"%s_p999_us\":%.1f,\"%s_max_us\":%.1f",
+               name, p->p50, name, p->p90, name, p->p99, name, p->p999, name, p->max);
+}
+
+static void cap_stats_json(msg_t *m, bool final) {
+    uint64_t elapsed = tsn_time_ns() - cap.start_ns;
+    cap_counters_t snap[MAX_TC];
+    uint64_t total = 0;
+    for (int i = 0; i < MAX_TC; i++) {
+        cap_snapshot(&cap.tc[i], &snap[i]);
+        total += snap[i].count;
+    }
+
+    msg_printf(m, "{\"type\":\"%s\",\"elapsed_ms\":%.1f,\"total\":%lu,\"tc\":{",
+               final ? "capture_final" : "capture_stats", elapsed / 1e6, total);
+    int first = 1;
+    for (int i = 0; i < MAX_TC; i++) {
+        cap_counters_t *t = &snap[i];
+        if (t->count == 0) continue;
+        uint64_t span = t->last_ts_ns - t->first_ts_ns;
+        msg_printf(m, "%s\"%d\":{\"count\":%lu,\"bytes\":%lu,\"avg_us\":%.1f,\"kbps\":%.1f",
+                   first ? "" : ",", i, t->count, t->bytes,
+                   t->count > 1 ? span / 1e3 / (t->count - 1) : 0.0,
+                   span > 0 ? t->bytes * 8.0 * 1e6 / span : 0.0);
+        first = 0;
+
+        if (final) {
+            tsn_pctl_t ia;
+            tsn_hist_pctl(&cap.tc[i].interval_hist, &ia);
+            msg_pctl(m, "interval", &ia);
+
+            tsn_seq_stats_t q;
+            tsn_seq_stats(&cap.tc[i].stream_seq, &q);
+            if (q.received > 0) {
+                msg_printf(m, ",\"lost\":%lu,\"dup\":%lu,\"reorder\":%lu,"
+                           "\"lat_min_us\":%.1f,\"lat_avg_us\":%.1f",
+                           q.lost, q.duplicates, q.reordered, q.lat_min_us, q.lat_avg_us);
+                msg_pctl(m, "lat", &q.lat);
+            }
+        }
+        msg_printf(m, "}");
+    }
+    msg_printf(m, "}");
+    if (final && cap.workers > 1) {
+        msg_printf(m, ",\"rx_workers\":[");
+        for (int w = 0; w < cap.workers; w++) {
+            msg_printf(m, "%s%lu", w ? "," : "", tsn_capture_group_packets(cap.g, w));
+        }
+        msg_printf(m, "]");
+    }
+    if (final && cap.rec_out) msg_printf(m, ",\"records\":%lu", tsn_rec_written(cap.rec_out));
+    if (final) {
+        // Workers are stopped, so the group counters are ours to read
+        tsn_instr_t now = { 0 }, run;
+        tsn_capture_group_instr(cap.g, &now);
+        tsn_instr_diff(&run, &now, &cap.base_instr);
+        msg_printf(m, ",");
+        msg_instr(m, &run);
+    }
+    msg_printf(m, "}");
+}
+
+static void cmd_capture_stop(msg_t *r) {
+    if (!cap.running) return reply_error(r, "capture not running");
+    tsn_capture_group_stop(cap.g);
+    cap_set_filter(IDLE_FILTER);
+    cap.running = false;
+
+    if (cap.rec_out) {
+        for (int i = 0; i < cap.workers; i++) tsn_rec_flush(&cap.rec_bufs[i]);
+    }
+    cap_stats_json(r, true);
+    if (cap.rec_out) {
+        tsn_rec_close(cap.rec_out);
+        free(cap.rec_bufs);
+        cap.rec_out = NULL;
+        cap.rec_bufs = NULL;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Send engine
+
+// One TX timeline: its TCs are sent round-robin from one socket
+typedef struct {
+    int tcs[MAX_TC];
+    int num_tcs;
+    volatile uint64_t interval_ns;  // "send rate" changes it while running
+    int cpu;  // -1 = not pinned
+    bool realtime;
+    tsn_pacer_t pacer;
+    tsn_tx_t *tx;
+    tsn_tx_stats_t base;  // socket counters at the start of the run
+    tsn_instr_t base_instr;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint64_t end_ns;
+    volatile int done;
+    pthread_t tid;
+} tx_worker_t;
+
+// Open TX sockets, reused by later runs with the same parameters
+typedef struct {
+    char ifname[IFNAMSIZ];
+    tsn_tx_engine_t engine;
+    int batch;
+    int so_priority;
+    bool busy;
+    tsn_tx_t *tx;
+} tx_socket_t;
+
+static struct {
+    bool running;
+    volatile int active;  // cleared to stop the workers
+    int n_workers;
+    tx_worker_t workers[MAX_TC];
+    tsn_frame_t frames[MAX_TC];
+    tsn_frame_mix_t mix;
+    bool vary;
+    tsn_pace_mode_t pace_mode;
+    tx_socket_t sockets[MAX_TX_SOCKETS];
+    int n_sockets;
+    uint64_t start_ns;
+} snd;
+
+static tsn_tx_t *tx_socket_get(const char *ifname, const tsn_tx_opts_t *opts, bool *reused) {
+    for (int i = 0; i < snd.n_sockets; i++) {
+        tx_socket_t *s = &snd.sockets[i];
+        if (!s->busy && strcmp(s->ifname, ifname) == 0 && s->engine == opts->engine &&
+            s->batch == opts->batch && s->so_priority == opts->so_priority) {
+            s->busy = true;
+            *reused = true;
+            return s->tx;
+        }
+    }
+
+    *reused = false;
+    tsn_tx_t *tx = tsn_tx_open(ifname, opts);
+    if (!tx) return NULL;
+
+    // Full cache: replace an idle socket
+    tx_socket_t *s = NULL;
+    if (snd.n_sockets < MAX_TX_SOCKETS) {
+        s = &snd.sockets[snd.n_sockets++];
+    } else {
+        for (int i = 0; i < snd.n_sockets && !s; i++) {
+            if (!snd.sockets[i].busy) s = &snd.sockets[i];
+        }
+        if (!s) return tx;  // all in use: not cached, leaks until exit
+        tsn_tx_close(s->tx);
+    }
+    snprintf(s->ifname, sizeof(s->ifname), "%s", ifname);
+    s->engine = opts->engine;
+    s->batch = opts->batch;
+    s->so_priority = opts->so_priority;
+    s->busy = true;
+    s->tx = tx;
+    return tx;
+}
+
+static void tx_sockets_release(void) {
+    for (int i = 0; i < snd.n_sockets; i++) snd.sockets[i].busy = false;
+}
+
+static void *tx_worker(void *arg) {
+    tx_worker_t *w = arg;
+    tsn_tx_t *tx = w->tx;
+    int batch = tsn_tx_batch(tx);
+
+    if (w->cpu >= 0 && tsn_pin_cpu(w->cpu) < 0) {
+        fprintf(stderr, "Warning: cannot pin TX worker to CPU %d\n", w->cpu);
+    }
+    if (w->realtime) tsn_setup_realtime(0);
+
+    tsn_pacer_wait(&w->pacer, w->start_ns, NULL);
+    uint64_t next_send = w->start_ns;
+    uint64_t tc_idx = 0;
+
+    // As in traffic-sender: one batch per wake-up, plus the slots already due
+    while (snd.active && tsn_time_ns() - w->start_ns < w->duration_ns) {
+        uint64_t now = tsn_pacer_wait(&w->pacer, next_send, &snd.active);
+        int n = batch;
+        int due = tsn_pacer_due(&w->pacer, now, next_send, w->interval_ns, TSN_PACE_MAX_CATCHUP);
+        if (due > n) n = (due + batch - 1) / batch * batch;
+        for (int b = 0; b < n; b++) {
+            int tc = w->tcs[tc_idx % w->num_tcs];
+            if (snd.vary) tsn_frame_vary(&snd.frames[tc], &snd.mix);
+            tsn_tx_queue(tx, &snd.frames[tc], tc, 0);
+            tc_idx++;
+            next_send += w->interval_ns;
+        }
+    }
+
+    tsn_tx_drain(tx);
+    w->end_ns = tsn_time_ns();
+    __atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void cmd_send_start(const cmd_t *c, msg_t *r) {
+    if (snd.running) return reply_error(r, "sender already running");
+
+    const char *ifname = arg_str(c, "iface", NULL);
+    const char *dst = arg_str(c, "dst", NULL);
+    if (!ifname || !dst) return reply_error(r, "iface= and dst= are required");
+
+    unsigned char dst_mac[6], src_mac[6];
+    const char *src = arg_str(c, "src", NULL);
+    if (tsn_parse_mac(dst, dst_mac) < 0) return reply_error(r, "invalid dst MAC");
+    if (src ? tsn_parse_mac(src, src_mac) < 0 : tsn_get_iface_mac(ifname, src_mac) < 0) {
+        return reply_error(r, "invalid src MAC");
+    }
+
+    int tcs[MAX_TC];
+    int num_tcs = tsn_parse_tc_list(arg_str(c, "tcs", "0,1,2,3,4,5,6,7"), tcs);
+    if (num_tcs == 0) return reply_error(r, "no TCs specified");
+
+    int vlan = arg_int(c, "vlan", 100);
+    int pps = arg_int(c, "pps", 1000);
+    int duration = arg_int(c, "duration", 10);
+    int frame_size = arg_int(c, "size", 1000);
+    bool per_tc = arg_int(c, "per-tc", 0) != 0;
+    if (frame_size < MIN_FRAME_SIZE) frame_size = MIN_FRAME_SIZE;
+    if (frame_size > TSN_MAX_FRAME_SIZE) frame_size = TSN_MAX_FRAME_SIZE;
+
+    tsn_tx_opts_t opts;
+    tsn_tx_opts_init(&opts);
+    const char *engine = arg_str(c, "engine", "send");
+    if (strcmp(engine, "send") == 0) opts.engine = TSN_TX_SEND;
+    else if (strcmp(engine, "mmsg") == 0) opts.engine = TSN_TX_MMSG;
+    else if (strcmp(engine, "ring") == 0) opts.engine = TSN_TX_RING;
+    else return reply_error(r, "unknown engine: %s", engine);
+    opts.batch = arg_int(c, "batch", opts.batch);
+    opts.so_priority = arg_int(c, "prio", -1);
+
+    int cpus[MAX_TC];
+    int n_cpus = parse_int_list(arg_str(c, "cpus", ""), cpus, MAX_TC);
+
+    int flows = arg_int(c, "flows", 1);
+    if (flows < 1 || flows > TSN_FRAME_MAX_FLOWS) return reply_error(r, "flows must be 1..%d", TSN_FRAME_MAX_FLOWS);
+    memset(&snd.mix, 0, sizeof(snd.mix));
+    snd.mix.flows = flows;
+    const char *imix = arg_str(c, "imix", NULL);
+    if (imix && tsn_frame_mix_parse_sizes(&snd.mix, imix) < 0) return reply_error(r, "invalid imix: %s", imix);
+    snd.vary = snd.mix.flows > 1 || snd.mix.n_sizes > 0;
+
+    const char *pacing = arg_str(c, "pacing", "hybrid");
+    if (tsn_pace_mode_parse(pacing, &snd.pace_mode) < 0) return reply_error(r, "unknown pacing: %s", pacing);
+
+    uint64_t t0 = tsn_time_ns();
+    for (int i = 0; i < num_tcs; i++) {
+        tsn_frame_spec_t spec = {
+            .dst_mac = dst_mac, .src_mac = src_mac,
+            .vlan_id = vlan, .pcp = tcs[i],
+            .frame_size = frame_size, .proto = TSN_FRAME_UDP,
+            .stream_id = (uint16_t)tcs[i]
+        };
+        tsn_frame_build(&snd.frames[tcs[i]], &spec);
+    }
+
+    int num_workers = per_tc ? num_tcs : 1;
+    int reused_sockets = 0;
+    for (int k = 0; k < num_workers; k++) {
+        tx_worker_t *w = &snd.workers[k];
+        memset(w, 0, sizeof(*w));
+        int worker_pps = pps;
+        if (per_tc) {
+            w->tcs[0] = tcs[k];
+            w->num_tcs = 1;
+            worker_pps = pps / num_tcs;
+        } else {
+            memcpy(w->tcs, tcs, sizeof(tcs));
+            w->num_tcs = num_tcs;
+        }
+        if (worker_pps < 1) worker_pps = 1;
+        w->interval_ns = 1000000000ULL / worker_pps;
+        w->cpu = k < n_cpus ? cpus[k] : (per_tc ? k % (int)sysconf(_SC_NPROCESSORS_ONLN) : -1);
+        w->duration_ns = (uint64_t)duration * 1000000000ULL;
+        tsn_pacer_init(&w->pacer, snd.pace_mode);
+
+        // SCHED_FIFO spinners sharing a CPU would starve each other (the
+        // unpinned single worker shares with the control loop)
+        w->realtime = w->cpu >= 0;
+        for (int j = 0; j < k; j++) {
+            if (w->cpu >= 0 && snd.workers[j].cpu == w->cpu) w->realtime = snd.workers[j].realtime = false;
+        }
+
+        tsn_tx_opts_t wopts = opts;
+        if (per_tc && wopts.so_priority < 0) wopts.so_priority = tcs[k];
+        bool reused;
+        w->tx = tx_socket_get(ifname, &wopts, &reused);
+        if (!w->tx) {
+            tx_sockets_release();
+            return reply_error(r, "cannot open TX socket on %s", ifname);
+        }
+        reused_sockets += reused;
+        w->base = *tsn_tx_stats(w->tx);
+        tsn_tx_instr(w->tx, &w->base_instr);
+    }
+
+    snd.active = 1;
+    snd.n_workers = num_workers;
+    snd.start_ns = tsn_time_ns() + (per_tc ? 10000000ULL : 1000000ULL);
+    for (int k = 0; k < num_workers; k++) {
+        snd.workers[k].start_ns = snd.start_ns;
+        if (pthread_create(&snd.workers[k].tid, NULL, tx_worker, &snd.workers[k]) != 0) {
+            snd.active = 0;
+            for (int j = 0; j < k; j++) pthread_join(snd.workers[j].tid, NULL);
+            tx_sockets_release();
+            return reply_error(r, "pthread_create: %s", strerror(errno));
+        }
+    }
+    snd.running = true;
+
+    msg_printf(r, "{\"ok\":true,\"send\":\"started\",\"iface\":\"%s\",\"workers\":%d,"
+               "\"engine\":\"%s\",\"reused_sockets\":%d,\"setup_us\":%.1f}",
+               ifname, num_workers, tsn_tx_engine_name(tsn_tx_engine(snd.workers[0].tx)),
+               reused_sockets, (tsn_time_ns() - t0) / 1e3);
+}
+
+// Per-run counters of worker w
+static void tx_worker_stats(const tx_worker_t *w, tsn_tx_stats_t *out) {
+    const tsn_tx_stats_t *s = tsn_tx_stats(w->tx);
+    for (int i = 0; i < MAX_TC; i++) {
+        out->packets[i] += s->packets[i] - w->base.packets[i];
+        out->bytes[i] += s->bytes[i] - w->base.bytes[i];
+    }
+    out->total += s->total - w->base.total;
+}
+
+// While running the counters are read without the workers' cooperation, so
+// they may lag by a frame; the send_done totals are exact
+static void send_stats_json(msg_t *m, bool done) {
+    tsn_tx_stats_t st;
+    memset(&st, 0, sizeof(st));
+    uint64_t end = done ? snd.start_ns : tsn_time_ns();
+    for (int k = 0; k < snd.n_workers; k++) {
+        tx_worker_stats(&snd.workers[k], &st);
+        if (done && snd.workers[k].end_ns > end) end = snd.workers[k].end_ns;
+    }
+    double secs = end > snd.start_ns ? (end - snd.start_ns) / 1e9 : 0;
+
+    if (done) {
+        msg_printf(m, "{\"type\":\"send_done\",\"success\":true,\"duration\":%.2f,\"total\":%lu,"
+                   "\"pps\":%.1f,\"sent\":{", secs, st.total, secs > 0 ? st.total / secs : 0.0);
+    } else {
+        msg_printf(m, "{\"type\":\"send_stats\",\"elapsed_ms\":%.1f,\"total\":%lu,\"sent\":{",
+                   secs * 1e3, st.total);
+    }
+    int first = 1;
+    for (int i = 0; i < MAX_TC; i++) {
+        if (st.packets[i] == 0) continue;
+        msg_printf(m, "%s\"%d\":{\"packets\":%lu,\"bytes\":%lu,\"mbps\":%.2f}", first ? "" : ",",
+                   i, st.packets[i], st.bytes[i], secs > 0 ? st.bytes[i] * 8.0 / (secs * 1e6) : 0.0);
+        first = 0;
+    }
+    msg_printf(m, "},\"workers\":%d", snd.n_workers);
+
+    if (done) {
+        tsn_pacer_t all = snd.workers[0].pacer;
+        for (int k = 1; k < snd.n_workers; k++) tsn_pacer_merge(&all, &snd.workers[k].pacer);
+        tsn_pctl_t e;
+        tsn_hist_pctl(&all.error, &e);
+        msg_printf(m, ",\"pacing\":\"%s\",\"send_error_us\":{\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f},"
+                   "\"catchup_frames\":%lu", tsn_pace_mode_name(all.mode), e.p50, e.p99, e.max, all.catchup);
+
+        // Workers are joined: their sockets' counters are settled
+        tsn_instr_t in = { 0 };
+        for (int k = 0; k < snd.n_workers; k++) {
+            tsn_instr_t now = { 0 }, run;
+            tsn_tx_instr(snd.workers[k].tx, &now);
+            tsn_instr_diff(&run, &now, &snd.workers[k].base_instr);
+            tsn_instr_merge(&in, &run);
+        }
+        in.tx_late = all.late;
+        msg_printf(m, ",");
+        msg_instr(m, &in);
+    }
+    msg_printf(m, "}");
+}
+
+// Join the workers once all are done (or wait for them); returns true once
+// the run is over
+static bool send_reap(bool wait) {
+    if (!snd.running) return false;
+    for (int k = 0; k < snd.n_workers && !wait; k++) {
+        if (!__atomic_load_n(&snd.workers[k].done, __ATOMIC_ACQUIRE)) return false;
+    }
+    for (int k = 0; k < snd.n_workers; k++) pthread_join(snd.workers[k].tid, NULL);
+    snd.running = false;
+
+    msg_t m = { .len = 0 };
+    send_stats_json(&m, true);
+    broadcast(&m, false);
+    tx_sockets_release();
+    return true;
+}
+
+static void cmd_send_rate(const cmd_t *c, msg_t *r) {
+    if (!snd.running) return reply_error(r, "sender not running");
+    int pps = arg_int(c, "pps", 0);
+    if (pps < 1) return reply_error(r, "pps= must be positive");
+    int per_worker = snd.n_workers > 1 ? pps / snd.n_workers : pps;
+    if (per_worker < 1) per_worker = 1;
+    for (int k = 0; k < snd.n_workers; k++) snd.workers[k].interval_ns = 1000000000ULL / per_worker;
+    msg_printf(r, "{\"ok\":true,\"pps\":%d,\"workers\":%d}", pps, snd.n_workers);
+}
+
+static void cmd_send_stop(msg_t *r) {
+    if (!snd.running) return reply_error(r, "sender not running");
+    // Workers notice within one send; the ring engine may take up to a
+    // second to drain
+    snd.active = 0;
+    send_reap(true);
+    msg_printf(r, "{\"ok\":true,\"send\":\"stopped\"}");
+}
+
+// ---------------------------------------------------------------------------
+// Control loop
+
+static void cmd_status(msg_t *r) {
+    msg_printf(r, "{\"ok\":true,\"clients\":%d,\"dropped_events\":%lu,"
+               "\"capture\":{\"running\":%s,\"iface\":\"%s\",\"workers\":%d},"
+               "\"send\":{\"running\":%s,\"workers\":%d,\"open_sockets\":%d}}",
+               n_clients, dropped_events, cap.running ? "true" : "false",
+               cap.g ? cap.ifname : "", cap.g ? cap.workers : 0,
+               snd.running ? "true" : "false", snd.running ? snd.n_workers : 0, snd.n_sockets);
+}
+
+static void handle_command(client_t *cl, char *line) {
+    cmd_t c;
+    cmd_parse(line, &c);
+    if (c.n_words == 0) return;
+
+    msg_t r = { .len = 0 };
+    if (cmd_is(&c, "ping", NULL)) {
+        msg_printf(&r, "{\"ok\":true,\"pong\":true}");
+    } else if (cmd_is(&c, "status", NULL)) {
+        cmd_status(&r);
+    } else if (cmd_is(&c, "subscribe", NULL) || cmd_is(&c, "unsubscribe", NULL)) {
+        cl->subscribed = strcmp(c.words[0], "subscribe") == 0;
+        msg_printf(&r, "{\"ok\":true,\"subscribed\":%s}", cl->subscribed ? "true" : "false");
+    } else if (cmd_is(&c, "capture", "start")) {
+        cmd_capture_start(&c, &r);
+    } else if (cmd_is(&c, "capture", "stop")) {
+        cmd_capture_stop(&r);
+    } else if (cmd_is(&c, "send", "start")) {
+        cmd_send_start(&c, &r);
+    } else if (cmd_is(&c, "send", "rate")) {
+        cmd_send_rate(&c, &r);
+    } else if (cmd_is(&c, "send", "stop")) {
+        cmd_send_stop(&r);
+    } else if (cmd_is(&c, "shutdown", NULL)) {
+        running = 0;
+        msg_printf(&r, "{\"ok\":true,\"shutdown\":true}");
+    } else {
+        reply_error(&r, "unknown command: %s", c.words[0]);
+    }
+    send_frame(cl, FRAME_REPLY, &r);
+}
+
+static void client_close(int i) {
+    close(clients[i].fd);
+    clients[i] = clients[--n_clients];
+}
+
+// Read what is there and run every complete line; returns -1 on EOF/error
+static int client_read(client_t *cl) {
+    ssize_t n = recv(cl->fd, cl->buf + cl->len, sizeof(cl->buf) - 1 - cl->len, 0);
+    if (n <= 0) return n < 0 && errno == EINTR ? 0 : -1;
+    cl->len += n;
+
+    char *start = cl->buf;
+    char *nl;
+    while ((nl = memchr(start, '\n', cl->buf + cl->len - start))) {
+        *nl = '\0';
+        handle_command(cl, start);
+        start = nl + 1;
+    }
+    cl->len -= start - cl->buf;
+    memmove(cl->buf, start, cl->len);
+
+    if (cl->len == sizeof(cl->buf) - 1) return -1;  // line too long
+    return 0;
+}
+
+static int listen_on(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        close(fd);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    // Group access for the web server user; raw traffic is not for everyone
+    chmod(path, 0660);
+    return fd;
+}
+
+static void signal_handler(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--socket PATH] [--interval-ms N] [--records-dir DIR]\n", prog);
+    fprintf(stderr, "  --socket: control socket (default: %s)\n", DEFAULT_SOCKET);
+    fprintf(stderr, "  --records-dir: where capture records=NAME files go (default: %s)\n", DEFAULT_RECORDS_DIR);
+    fprintf(stderr, "  --interval-ms: stats events to subscribers (default: %d)\n", DEFAULT_INTERVAL_MS);
+    fprintf(stderr, "Example: echo status | socat - UNIX:%s\n", DEFAULT_SOCKET);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = DEFAULT_SOCKET;
+    int interval_ms = DEFAULT_INTERVAL_MS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--interval-ms") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--records-dir") == 0 && i + 1 < argc) {
+            records_dir = argv[++i];
+        } else {
+            usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if (interval_ms < 10) interval_ms = 10;
+
+    struct sigaction sa = { .sa_handler = signal_handler };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Pages locked once for the daemon's lifetime (the workers add SCHED_FIFO)
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+
+    int lfd = listen_on(path);
+    if (lfd < 0) return 1;
+    fprintf(stderr, "tsn-daemon: listening on %s (stats every %d ms)\n", path, interval_ms);
+
+    uint64_t next_stats = tsn_time_ns() + interval_ms * 1000000ULL;
+    while (running) {
+        struct pollfd pfd[MAX_CLIENTS + 1];
+        pfd[0] = (struct pollfd){ .fd = lfd, .events = POLLIN };
+        for (int i = 0; i < n_clients; i++) pfd[i + 1] = (struct pollfd){ .fd = clients[i].fd, .events = POLLIN };
+
+        // Wake at least every 10 ms to notice a finished sender
+        int64_t wait_ms = ((int64_t)next_stats - (int64_t)tsn_time_ns()) / 1000000;
+        if (wait_ms < 0) wait_ms = 0;
+        if (snd.running && wait_ms > 10) wait_ms = 10;
+        int nready = poll(pfd, n_clients + 1, (int)wait_ms);
+        if (nready < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        if (nready > 0) {
+            for (int i = n_clients - 1; i >= 0; i--) {
+                if (pfd[i + 1].revents && client_read(&clients[i]) < 0) client_close(i);
+            }
+            if (pfd[0].revents & POLLIN) {
+                int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+                if (fd >= 0 && n_clients < MAX_CLIENTS) {
+                    clients[n_clients++] = (client_t){ .fd = fd };
+                } else if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+
+        send_reap(false);
+
+        uint64_t now = tsn_time_ns();
+        if (now >= next_stats) {
+            next_stats += interval_ms * 1000000ULL;
+            if (next_stats < now) next_stats = now + interval_ms * 1000000ULL;
+            if (cap.running) {
+                msg_t m = { .len = 0 };
+                cap_stats_json(&m, false);
+                broadcast(&m, true);
+            }
+            if (snd.running) {
+                msg_t m = { .len = 0 };
+                send_stats_json(&m, false);
+                broadcast(&m, true);
+            }
+        }
+    }
+
+    fprintf(stderr, "tsn-daemon: shutting down\n");
+    if (snd.running) {
+        snd.active = 0;
+        send_reap(true);
+    }
+    if (cap.running) tsn_capture_group_stop(cap.g);
+    if (cap.rec_out) {
+        for (int i = 0; i < cap.workers; i++) tsn_rec_flush(&cap.rec_bufs[i]);
+        tsn_rec_close(cap.rec_out);
+        free(cap.rec_bufs);
+    }
+    tsn_capture_group_close(cap.g);
+    for (int i = 0; i < snd.n_sockets; i++) tsn_tx_close(snd.sockets[i].tx);
+    for (int i = 0; i < n_clients; i++) close(clients[i].fd);
+    close(lfd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * tsn-frame.c - Test frame builder (libtsntest)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "tsn-frame.h"
+
+uint16_t tsn_ip_checksum(const void *buf, int len) {
+    const uint8_t *p = buf;
+    uint32_t sum = 0;
+    while (len > 1) {
+        sum += (p[0] << 8) | p[1];
+        p += 2;
+        len -= 2;
+    }
+    if (len == 1) sum += p[0] << 8;
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum += (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static inline void put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+static inline uint16_t get16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+// RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m')
+static inline uint16_t csum_update(uint16_t hc, uint16_t old, uint16_t new) {
+    uint32_t sum = (uint16_t)~hc + (uint16_t)~old + new;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// Rewrite one 16-bit IP header word and patch the header checksum
+static inline void ip_put16(uint8_t *ip, int off, uint16_t v) {
+    uint16_t old = get16(ip + off);
+    if (old == v) return;
+    put16(ip + off, v);
+    put16(ip + 10, csum_update(get16(ip + 10), old, v));
+}
+
+// Magic and stream ID; sequence and timestamp are filled by tsn_frame_stamp()
+static void test_hdr_init(tsn_frame_t *f, uint16_t stream_id) {
+    put16(f->data + f->hdr_off, TSN_TEST_MAGIC);
+    put16(f->data + f->hdr_off + 2, stream_id);
+    f->seq = 0;
+    f->flow = 0;
+    f->size_idx = 0;
+    f->size_shift = 0;
+}
+
+int tsn_frame_build(tsn_frame_t *f, const tsn_frame_spec_t *spec) {
+    uint8_t *frame = f->data;
+    int pcp = spec->pcp & 0x7;
+    int size = spec->frame_size;
+    if (size < TSN_MIN_FRAME_SIZE) size = TSN_MIN_FRAME_SIZE;
+    if (size > TSN_MAX_FRAME_SIZE) size = TSN_MAX_FRAME_SIZE;
+
+    // The whole buffer is filled, so tsn_frame_vary() can grow the frame
+    // without touching the payload
+    memset(frame, 0, sizeof(f->data));
+    int offset = 0;
+
+    // Ethernet header
+    memcpy(frame + offset, spec->dst_mac, 6); offset += 6;
+    memcpy(frame + offset, spec->src_mac, 6); offset += 6;
+
+    // 802.1Q VLAN tag
+    if (spec->vlan_id >= 0) {
+        put16(frame + offset, 0x8100); offset += 2;
+        put16(frame + offset, (pcp << 13) | (spec->vlan_id & 0xFFF)); offset += 2;
+    }
+
+    if (spec->proto == TSN_FRAME_EXP) {
+        put16(frame + offset, TSN_ETHERTYPE_EXP); offset += 2;
+        frame[offset++] = (uint8_t)pcp;   // TC identifier
+        f->hdr_off = offset;
+        f->ip_off = -1;
+        f->sport = 0;
+        f->min_len = offset + TSN_TEST_HDR_LEN;
+        if (f->min_len < TSN_MIN_FRAME_SIZE) f->min_len = TSN_MIN_FRAME_SIZE;
+        offset += TSN_TEST_HDR_LEN;
+        for (int i = offset; i < TSN_MAX_FRAME_SIZE; i++) frame[i] = 0xAA;
+        f->len = offset > size ? offset : size;
+        test_hdr_init(f, spec->stream_id);
+        return f->len;
+    }
+
+    put16(frame + offset, 0x0800); offset += 2;
+
+    // Payload size to reach the target frame size
+    int payload_size = size - offset - 20 - 8;
+    if (payload_size < 3 + TSN_TEST_HDR_LEN) payload_size = 3 + TSN_TEST_HDR_LEN;
+    if (payload_size > 1472) payload_size = 1472;  // MTU limit
+
+    // IP header (20 bytes)
+    uint8_t *ip = frame + offset;
+    f->ip_off = offset;
+    ip[0] = 0x45;                          // Version + IHL
+    ip[1] = pcp << 5;                      // DSCP = PCP, ECN = 0
+    put16(ip + 2, 20 + 8 + payload_size);  // Total length
+    ip[8] = 64;                            // TTL
+    ip[9] = 17;                            // UDP
+    ip[12] = 192; ip[13] = 168; ip[14] = 100; ip[15] = 1;
+    ip[16] = 192; ip[17] = 168; ip[18] = 100; ip[19] = 2;
+    put16(ip + 10, tsn_ip_checksum(ip, 20));
+    offset += 20;
+
+    // UDP header (8 bytes, checksum left 0)
+    uint8_t *udp = frame + offset;
+    f->sport = 10000 + pcp;
+    put16(udp + 0, f->sport);
+    put16(udp + 2, 20000 + pcp);
+    put16(udp + 4, 8 + payload_size);
+    offset += 8;
+
+    // Payload: TC marker, test header, pattern
+    uint8_t *payload = frame + offset;
+    payload[0] = 'T';
+    payload[1] = 'C';
+    payload[2] = '0' + pcp;
+    f->hdr_off = offset + 3;
+    for (int i = 3 + TSN_TEST_HDR_LEN; offset + i < TSN_MAX_FRAME_SIZE; i++) payload[i] = (i + pcp) & 0xFF;
+    f->min_len = offset + 3 + TSN_TEST_HDR_LEN;
+    offset += payload_size;
+
+    f->len = offset;
+    test_hdr_init(f, spec->stream_id);
+    return f->len;
+}
+
+int tsn_frame_mix_parse_sizes(tsn_frame_mix_t *m, const char *spec) {
+    uint16_t size[TSN_MIX_MAX_SIZES];
+    int weight[TSN_MIX_MAX_SIZES], n = 0, total = 0;
+
+    if (strcmp(spec, "imix") == 0) spec = "64:7,594:4,1518:1";
+    const char *p = spec;
+    while (*p) {
+        char *end;
+        long sz = strtol(p, &end, 10), w = 1;
+        if (end == p || sz < 1 || sz > TSN_MAX_FRAME_SIZE) return -1;
+        p = end;
+        if (*p == ':') {
+            w = strtol(p + 1, &end, 10);
+            if (end == p + 1 || w < 1) return -1;
+            p = end;
+        }
+        if (n == TSN_MIX_MAX_SIZES || (total += w) > TSN_MIX_MAX_SIZES) return -1;
+        size[n] = sz;
+        weight[n++] = w;
+        if (*p == ',') p++;
+        else if (*p) return -1;
+    }
+    if (n == 0) return -1;
+
+    // Smooth weighted round-robin: 7/4/1 becomes a 64-594-64-1518-... mix
+    // rather than seven 64s in a row
+    int current[TSN_MIX_MAX_SIZES] = {0};
+    for (int k = 0; k < total; k++) {
+        int best = 0;
+        for (int i = 0; i < n; i++) {
+            current[i] += weight[i];
+            if (current[i] > current[best]) best = i;
+        }
+        current[best] -= total;
+        m->sizes[k] = size[best];
+    }
+    m->n_sizes = total;
+    return 0;
+}
+
+double tsn_frame_mix_avg_size(const tsn_frame_mix_t *m) {
+    double sum = 0;
+    for (int i = 0; i < m->n_sizes; i++) sum += m->sizes[i];
+    return m->n_sizes ? sum / m->n_sizes : 0;
+}
+
+static void frame_set_len(tsn_frame_t *f, int len) {
+    int max_len = f->ip_off >= 0 ? f->ip_off + 1500 : TSN_MAX_FRAME_SIZE;
+    if (max_len > TSN_MAX_FRAME_SIZE) max_len = TSN_MAX_FRAME_SIZE;
+    if (len < f->min_len) len = f->min_len;
+    if (len > max_len) len = max_len;
+    if (len == f->len) return;
+
+    f->len = len;
+    if (f->ip_off < 0) return;
+    uint8_t *ip = f->data + f->ip_off;
+    ip_put16(ip, 2, len - f->ip_off);          // IP total length
+    put16(ip + 24, len - f->ip_off - 20);      // UDP length (no checksum)
+}
+
+static void frame_set_flow(tsn_frame_t *f, uint32_t flow) {
+    if (f->ip_off < 0) return;
+    uint8_t *ip = f->data + f->ip_off;
+    ip_put16(ip, 14, ((100 + (flow & 127)) << 8) | 1);   // 192.168.x.1
+    put16(ip + 20, f->sport + 8 * (flow >> 7));         // UDP source port
+}
+
+void tsn_frame_vary(tsn_frame_t *f, const tsn_frame_mix_t *m) {
+    uint32_t n_sizes = m->n_sizes;
+    if (n_sizes) {
+        frame_set_len(f, m->sizes[f->size_idx]);
+        if (++f->size_idx == n_sizes) f->size_idx = 0;
+    }
+    if (m->flows > 1) {
+        frame_set_flow(f, f->flow);
+        if (++f->flow == m->flows) f->flow = 0;
+    }
+
+    // Flow and size cursors are back where they started: when the counts
+    // share a factor, not every flow has seen every size yet, so start the
+    // next round one size later
+    if (f->flow == 0 && f->size_idx == f->size_shift && n_sizes > 1 && m->flows > 1) {
+        if (++f->size_shift == n_sizes) f->size_shift = 0;
+        f->size_idx = f->size_shift;
+    }
+}
+
+int tsn_test_hdr_parse(const uint8_t *pkt, uint32_t caplen, tsn_test_hdr_t *h) {
+    uint32_t off = 12;
+    if (caplen < off + 2) return -1;
+    uint16_t ethertype = get16(pkt + off);
+    if (ethertype == 0x8100) {
+        off += 4;
+        if (caplen < off + 2) return -1;
+        ethertype = get16(pkt + off);
+    }
+    off += 2;
+
+    if (ethertype == TSN_ETHERTYPE_EXP) {
+        off += 1;                                 // TC byte
+    } else if (ethertype == 0x0800) {
+        if (caplen < off + 20) return -1;
+        if (pkt[off + 9] != 17) return -1;        // UDP only
+        off += (pkt[off] & 0x0F) * 4 + 8 + 3;     // IP, UDP, "TC<pcp>"
+    } else {
+        return -1;
+    }
+
+    if (caplen < off + TSN_TEST_HDR_LEN) return -1;
+    const uint8_t *p = pkt + off;
+    if (get16(p) != TSN_TEST_MAGIC) return -1;
+
+    h->stream_id = get16(p + 2);
+    h->seq = ((uint32_t)p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+    h->tx_ns = 0;
+    for (int i = 0; i < 8; i++) h->tx_ns = (h->tx_ns << 8) | p[8 + i];
+    return 0;
+}
+
+// Test header offsets per layout: L2 (+ tag), IPv4 without options + UDP +
+// "TC<pcp>" or the EXP TC byte
+#define RX_HDR_UDP(l3) ((l3) + 20 + 8 + 3)
+#define RX_HDR_EXP(l3) ((l3) + 1)
+
+static inline void rx_fields(const uint8_t *p, tsn_test_hdr_t *h) {
+    uint32_t seq;
+    uint64_t tx;
+    memcpy(&seq, p + 4, 4);
+    memcpy(&tx, p + 8, 8);
+    h->stream_id = get16(p + 2);
+    h->seq = __builtin_bswap32(seq);
+    h->tx_ns = __builtin_bswap64(tx);
+}
+
+#define TEST_RX(name, off, pcp_expr)                                            \
+    static int name(const uint8_t *pkt, uint32_t caplen, tsn_test_rx_t *out) { \
+        if (caplen < (off) + TSN_TEST_HDR_LEN) return -1;                      \
+        out->pcp = (pcp_expr);                                                 \
+        rx_fields(pkt + (off), &out->hdr);                                     \
+        return 0;                                                              \
+    }
+
+TEST_RX(rx_tagged_udp, RX_HDR_UDP(18), pkt[14] >> 5)
+TEST_RX(rx_tagged_exp, RX_HDR_EXP(18), pkt[14] >> 5)
+TEST_RX(rx_untagged_udp, RX_HDR_UDP(14), (pkt[RX_HDR_UDP(14) - 1] - '0') & 7)
+TEST_RX(rx_untagged_exp, RX_HDR_EXP(14), pkt[14] & 7)
+
+tsn_test_rx_fn tsn_test_rx(int tagged, tsn_frame_proto_t proto) {
+    if (proto == TSN_FRAME_EXP) return tagged ? rx_tagged_exp : rx_untagged_exp;
+    return tagged ? rx_tagged_udp : rx_untagged_udp;
+}
@@ -0,0 +1,128 @@
+/*
+ * tsn-frame.h - Test frame builder shared by the TSN TX paths (libtsntest)
+ *
+ * Frame formats:
+ *   TSN_FRAME_UDP - [802.1Q] IPv4/UDP 192.168.100.1:10000+pcp -> .2:20000+pcp,
+ *                   payload "TC<pcp>" + test header + pattern
+ *   TSN_FRAME_EXP - [802.1Q] EtherType 0x88B5 (local experimental),
+ *                   payload TC byte + test header + 0xAA padding
+ *
+ * Test header (16 bytes, big-endian):
+ *   magic "TS" | stream ID (16) | sequence (32) | TX timestamp ns (64)
+ *
+ * Sequence and TX timestamp are written in place by tsn_frame_stamp() right
+ * before each send, so a prebuilt frame is never rebuilt. The UDP checksum is
+ * left 0, so nothing else has to be updated.
+ *
+ * A built frame is also the template for a stream mix (tsn_frame_vary()):
+ * flow f moves the source to 192.168.(100 + f % 128).1 and the UDP source
+ * port up by 8 per 128 flows (flow 0 is the built frame), and the frame size
+ * steps through a weighted size list such as IMIX. Only the changed 16-bit
+ * words are rewritten and the IP checksum is patched per RFC 1624, so a
+ * varied send costs a handful of stores, not a rebuild.
+ */
+
+#ifndef TSN_FRAME_H
+#define TSN_FRAME_H
+
+#include <stdint.h>
+
+#define TSN_MAX_FRAME_SIZE 1518
+#define TSN_MIN_FRAME_SIZE 60
+#define TSN_ETHERTYPE_EXP 0x88B5
+#define TSN_TEST_MAGIC 0x5453    // "TS"
+#define TSN_TEST_HDR_LEN 16
+#define TSN_MIX_MAX_SIZES 64     // size schedule slots (sum of weights)
+#define TSN_FRAME_MAX_FLOWS 65536
+
+typedef enum {
+    TSN_FRAME_UDP,
+    TSN_FRAME_EXP
+} tsn_frame_proto_t;
+
+typedef struct {
+    const unsigned char *dst_mac;
+    const unsigned char *src_mac;
+    int vlan_id;             // < 0 = untagged
+    int pcp;
+    int frame_size;          // clamped to TSN_MIN/MAX_FRAME_SIZE
+    tsn_frame_proto_t proto;
+    uint16_t stream_id;      // carried in the test header
+} tsn_frame_spec_t;
+
+typedef struct {
+    uint8_t data[TSN_MAX_FRAME_SIZE];
+    int len;
+    int hdr_off;             // offset of the test header
+    uint32_t seq;            // sequence number of the next stamp
+    int ip_off;              // offset of the IPv4 header, -1 for EXP
+    int min_len;             // smallest length that still holds the test header
+    uint16_t sport;          // UDP source port of flow 0
+    uint32_t flow;           // tsn_frame_vary() cursors
+    uint32_t size_idx;
+    uint32_t size_shift;
+} tsn_frame_t;
+
+// Stream mix applied by tsn_frame_vary()
+typedef struct {
+    uint32_t flows;                      // distinct flows, 1 = template only
+    uint16_t sizes[TSN_MIX_MAX_SIZES];   // size schedule, 0 entries = keep size
+    int n_sizes;
+} tsn_frame_mix_t;
+
+// Test header fields in host order
+typedef struct {
+    uint16_t stream_id;
+    uint32_t seq;
+    uint64_t tx_ns;
+} tsn_test_hdr_t;
+
+// Build a frame from spec; returns its length
+int tsn_frame_build(tsn_frame_t *f, const tsn_frame_spec_t *spec);
+
+// Fill m->sizes from "SIZE:WEIGHT,..." (weight defaults to 1) or "imix"
+// (64:7,594:4,1518:1); weights are interleaved, not run in blocks. Returns 0,
+// or -1 if the spec is malformed or the weights add up to more than
+// TSN_MIX_MAX_SIZES. m->flows is left alone.
+int tsn_frame_mix_parse_sizes(tsn_frame_mix_t *m, const char *spec);
+
+// Mean frame size of the schedule (0 if empty)
+double tsn_frame_mix_avg_size(const tsn_frame_mix_t *m);
+
+// Turn a built frame into the next flow/size of the mix in place. Every flow
+// goes through the whole size schedule. Sizes are clamped to what the frame
+// can carry.
+void tsn_frame_vary(tsn_frame_t *f, const tsn_frame_mix_t *m);
+
+// RFC 1071 checksum over len bytes
+uint16_t tsn_ip_checksum(const void *buf, int len);
+
+// Find the test header in a received frame (tagged or untagged, UDP or EXP);
+// returns 0 and fills h, or -1 if the frame carries none
+int tsn_test_hdr_parse(const uint8_t *pkt, uint32_t caplen, tsn_test_hdr_t *h);
+
+// A test frame decoded by a tsn_test_rx_fn
+typedef struct {
+    int pcp;
+    tsn_test_hdr_t hdr;
+} tsn_test_rx_t;
+
+// Returns 0, or -1 if caplen is too short for the layout
+typedef int (*tsn_test_rx_fn)(const uint8_t *pkt, uint32_t caplen, tsn_test_rx_t *out);
+
+// Decoder for one layout (802.1Q tag in the data or none, UDP or EXP), picked
+// once at startup: fixed offsets, no branches. Only for frames that passed a
+// tsn_capture_match_t of the same layout with test_hdr set, which already
+// checked EtherType, IP header and magic; anything else needs
+// tsn_test_hdr_parse()
+tsn_test_rx_fn tsn_test_rx(int tagged, tsn_frame_proto_t proto);
+
+// Write the next sequence number and the TX timestamp into the frame in place
+static inline void tsn_frame_stamp(tsn_frame_t *f, uint64_t ts_ns) {
+    uint8_t *p = f->data + f->hdr_off + 4;
+    uint32_t seq = f->seq++;
+    p[0] = seq >> 24; p[1] = seq >> 16; p[2] = seq >> 8; p[3] = seq;
+    for (int i = 0; i < 8; i++) p[4 + i] = ts_ns >> (56 - 8 * i);
+}
+
+#endif
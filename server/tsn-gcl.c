@@ -0,0 +1,131 @@
+/*
+ * tsn-gcl.c - Configured 802.1Qbv gate control list as a lookup table (libtsntest)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tsn-gcl.h"
+
+static int parse_spec(tsn_gcl_t *g, const char *spec, char *errbuf) {
+    const char *p = spec;
+    while (*p) {
+        if (g->n_entries == TSN_GCL_MAX_ENTRIES) {
+            snprintf(errbuf, 256, "more than %d GCL entries", TSN_GCL_MAX_ENTRIES);
+            return -1;
+        }
+        char *end;
+        unsigned long mask = strtoul(p, &end, 0);
+        if (end == p || *end != ':' || mask > 0xff) {
+            snprintf(errbuf, 256, "GCL entry %d: expected MASK:NS", g->n_entries);
+            return -1;
+        }
+        p = end + 1;
+        unsigned long long ns = strtoull(p, &end, 10);
+        if (end == p || ns == 0 || ns > UINT32_MAX) {
+            snprintf(errbuf, 256, "GCL entry %d: bad time interval", g->n_entries);
+            return -1;
+        }
+        g->gate_states[g->n_entries] = (uint8_t)mask;
+        g->interval_ns[g->n_entries] = (uint32_t)ns;
+        g->n_entries++;
+        p = end;
+        if (*p == ',') p++;
+        else if (*p) {
+            snprintf(errbuf, 256, "GCL entry %d: unexpected '%c'", g->n_entries - 1, *p);
+            return -1;
+        }
+    }
+    if (g->n_entries == 0) {
+        snprintf(errbuf, 256, "empty GCL");
+        return -1;
+    }
+    return 0;
+}
+
+// Gate open over [from, to) of the cycle: extend the TC's last window or add one
+static void open_span(tsn_gcl_tc_t *t, uint64_t from, uint64_t to) {
+    if (t->n_windows > 0 && t->windows[t->n_windows - 1].end_ns == from) {
+        t->windows[t->n_windows - 1].end_ns = to;
+        return;
+    }
+    t->windows[t->n_windows].start_ns = from;
+    t->windows[t->n_windows].end_ns = to;
+    t->n_windows++;
+}
+
+int tsn_gcl_compile(tsn_gcl_t *g, const char *spec, uint64_t cycle_ns, char *errbuf) {
+    memset(g, 0, sizeof(*g));
+    if (parse_spec(g, spec, errbuf) < 0) return -1;
+
+    uint64_t sum = 0;
+    for (int e = 0; e < g->n_entries; e++) sum += g->interval_ns[e];
+    g->cycle_ns = cycle_ns ? cycle_ns : sum;
+    g->bin_ns = (g->cycle_ns + TSN_GCL_LUT_BINS - 1) / TSN_GCL_LUT_BINS;
+
+    // Entries in order; the last one's states hold to the end of a longer cycle.
+    // Windows only grow at the end, so one entry adds at most one per TC
+    uint64_t t = 0;
+    for (int e = 0; e < g->n_entries && t < g->cycle_ns; e++) {
+        uint64_t end = t + g->interval_ns[e];
+        if (end > g->cycle_ns || e == g->n_entries - 1) end = g->cycle_ns;
+        for (int tc = 0; tc < TSN_MAX_TC; tc++) {
+            if (g->gate_states[e] & (1 << tc)) open_span(&g->tc[tc], t, end);
+        }
+        t = end;
+    }
+
+    for (int tc = 0; tc < TSN_MAX_TC; tc++) {
+        tsn_gcl_tc_t *c = &g->tc[tc];
+        int w = 0;
+        for (int b = 0; b < TSN_GCL_LUT_BINS; b++) {
+            uint64_t start = (uint64_t)b * g->bin_ns;
+            while (w < c->n_windows && c->windows[w].end_ns <= start) w++;
+            c->lut[b] = (uint8_t)w;
+        }
+    }
+    return 0;
+}
+
+tsn_gcl_class_t tsn_gcl_classify(const tsn_gcl_t *g, int tc, uint64_t ts_ns, int64_t *offset_ns) {
+    const tsn_gcl_tc_t *c = &g->tc[tc];
+    int n = c->n_windows;
+    if (n == 0) {
+        *offset_ns = 0;
+        return TSN_GCL_VIOLATION;
+    }
+
+    uint64_t cycle = g->cycle_ns;
+    uint64_t phase = ts_ns >= g->base_ns ? (ts_ns - g->base_ns) % cycle
+                                         : (cycle - (g->base_ns - ts_ns) % cycle) % cycle;
+
+    int w = c->lut[phase / g->bin_ns];
+    while (w < n && c->windows[w].end_ns <= phase) w++;
+
+    const tsn_gcl_window_t *last = &c->windows[n - 1];
+    if (w < n && c->windows[w].start_ns <= phase) {
+        // A window open across the cycle end opened in the previous cycle
+        uint64_t since = phase - c->windows[w].start_ns;
+        if (w == 0 && n > 1 && c->windows[0].start_ns == 0 && last->end_ns == cycle) {
+            since += cycle - last->start_ns;
+        }
+        *offset_ns = (int64_t)since;
+        return TSN_GCL_IN_WINDOW;
+    }
+
+    // Between the previous close and the next opening, across the cycle end
+    uint64_t early = w < n ? c->windows[w].start_ns - phase : cycle - phase + c->windows[0].start_ns;
+    uint64_t late = w > 0 ? phase - c->windows[w - 1].end_ns : phase + cycle - last->end_ns;
+    uint64_t dist = late <= early ? late : early;
+    *offset_ns = late <= early ? (int64_t)late : -(int64_t)early;
+    return dist <= g->guard_ns ? TSN_GCL_GUARD : TSN_GCL_VIOLATION;
+}
+
+const char *tsn_gcl_class_name(tsn_gcl_class_t c) {
+    switch (c) {
+    case TSN_GCL_IN_WINDOW: return "in_window";
+    case TSN_GCL_GUARD: return "guard";
+    default: return "violation";
+    }
+}
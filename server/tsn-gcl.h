@@ -0,0 +1,73 @@
+/*
+ * tsn-gcl.h - Configured 802.1Qbv gate control list as a lookup table (libtsntest)
+ *
+ * The GCL that was pushed to the switch (gate-states / time-interval entries,
+ * cycle time, base-time) is compiled into each TC's open windows plus a table
+ * of TSN_GCL_LUT_BINS bins over the cycle. A bin holds the first window that
+ * has not closed by the bin's start, so classifying a frame is one modulo, one
+ * division and a look at that window and the one before it:
+ *
+ *   in window - the TC's gate is open at the frame's timestamp
+ *   guard     - closed, but within guard_ns of an edge (timestamp resolution,
+ *               frame time on the wire, residual clock offset)
+ *   violation - closed, further than guard_ns from any window
+ *
+ * 802.1Qbv semantics: entries run in order from base-time; a cycle longer than
+ * the entries keeps the last gate states until it ends, a shorter one cuts the
+ * list off.
+ *
+ * Spec: "MASK:NS,MASK:NS,..." with MASK the gate-states value (bit N = TC N,
+ * decimal or 0x hex) and NS the time-interval value, as in routes/tas.js.
+ */
+
+#ifndef TSN_GCL_H
+#define TSN_GCL_H
+
+#include <stdint.h>
+
+#include "tsn-common.h"
+
+#define TSN_GCL_MAX_ENTRIES 64
+#define TSN_GCL_LUT_BINS 4096
+
+typedef enum {
+    TSN_GCL_IN_WINDOW,
+    TSN_GCL_GUARD,
+    TSN_GCL_VIOLATION,
+    TSN_GCL_CLASSES
+} tsn_gcl_class_t;
+
+typedef struct {
+    uint64_t start_ns;   // offset in the cycle
+    uint64_t end_ns;     // exclusive, <= cycle_ns
+} tsn_gcl_window_t;
+
+typedef struct {
+    int n_windows;       // closed throughout: 0, open throughout: one window
+    tsn_gcl_window_t windows[TSN_GCL_MAX_ENTRIES];
+    uint8_t lut[TSN_GCL_LUT_BINS];
+} tsn_gcl_tc_t;
+
+typedef struct {
+    int n_entries;
+    uint8_t gate_states[TSN_GCL_MAX_ENTRIES];
+    uint32_t interval_ns[TSN_GCL_MAX_ENTRIES];
+    uint64_t cycle_ns;
+    uint64_t bin_ns;
+    uint64_t base_ns;    // cycle start, in the timestamps' clock
+    uint64_t guard_ns;
+    tsn_gcl_tc_t tc[TSN_MAX_TC];
+} tsn_gcl_t;
+
+// Parse spec and compile the tables. cycle_ns = 0 takes the sum of the
+// intervals. Returns 0, or -1 with errbuf (256 bytes) filled
+int tsn_gcl_compile(tsn_gcl_t *g, const char *spec, uint64_t cycle_ns, char *errbuf);
+
+// Class of a frame of tc stamped ts_ns. *offset_ns: in a window, ns since it
+// opened; otherwise the signed distance to the nearest edge (< 0: before a
+// window opens, > 0: after one closed; 0 when the gate never opens)
+tsn_gcl_class_t tsn_gcl_classify(const tsn_gcl_t *g, int tc, uint64_t ts_ns, int64_t *offset_ns);
+
+const char *tsn_gcl_class_name(tsn_gcl_class_t c);
+
+#endif
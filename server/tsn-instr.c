@@ -0,0 +1,135 @@
+/*
+ * tsn-instr.c - Drop, overflow and per-stage cost counters (libtsntest)
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "tsn-instr.h"
+
+#define CALIB_NS 5000000ULL
+
+static const char *stage_names[TSN_STAGES] = { "rx", "handler", "tx", "analysis" };
+
+static pthread_once_t calib_once = PTHREAD_ONCE_INIT;
+static double tick_ns = 1.0;
+
+static void calibrate(void) {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    uint64_t n0 = tsn_time_ns();
+    uint64_t t0 = tsn_instr_ticks();
+    usleep(CALIB_NS / 1000);
+    uint64_t n1 = tsn_time_ns();
+    uint64_t t1 = tsn_instr_ticks();
+    if (t1 > t0) tick_ns = (double)(n1 - n0) / (double)(t1 - t0);
+#endif
+}
+
+double tsn_instr_tick_ns(void) {
+    pthread_once(&calib_once, calibrate);
+    return tick_ns;
+}
+
+void tsn_stage_merge(tsn_stage_t *a, const tsn_stage_t *b) {
+    a->samples += b->samples;
+    a->items += b->items;
+    a->ticks += b->ticks;
+    if (b->max_ticks > a->max_ticks) a->max_ticks = b->max_ticks;
+}
+
+void tsn_instr_merge(tsn_instr_t *a, const tsn_instr_t *b) {
+    a->rx_packets += b->rx_packets;
+    a->rx_kernel_drops += b->rx_kernel_drops;
+    a->rx_if_drops += b->rx_if_drops;
+    a->rx_ring_freezes += b->rx_ring_freezes;
+    a->truncated += b->truncated;
+    a->tx_eagain += b->tx_eagain;
+    a->tx_enobufs += b->tx_enobufs;
+    a->tx_errors += b->tx_errors;
+    a->tx_dropped += b->tx_dropped;
+    a->tx_late += b->tx_late;
+    a->txtime_dropped += b->txtime_dropped;
+    for (int s = 0; s < TSN_STAGES; s++) tsn_stage_merge(&a->stage[s], &b->stage[s]);
+}
+
+void tsn_instr_diff(tsn_instr_t *out, const tsn_instr_t *now, const tsn_instr_t *base) {
+    out->rx_packets = now->rx_packets - base->rx_packets;
+    out->rx_kernel_drops = now->rx_kernel_drops - base->rx_kernel_drops;
+    out->rx_if_drops = now->rx_if_drops - base->rx_if_drops;
+    out->rx_ring_freezes = now->rx_ring_freezes - base->rx_ring_freezes;
+    out->truncated = now->truncated - base->truncated;
+    out->tx_eagain = now->tx_eagain - base->tx_eagain;
+    out->tx_enobufs = now->tx_enobufs - base->tx_enobufs;
+    out->tx_errors = now->tx_errors - base->tx_errors;
+    out->tx_dropped = now->tx_dropped - base->tx_dropped;
+    out->tx_late = now->tx_late - base->tx_late;
+    out->txtime_dropped = now->txtime_dropped - base->txtime_dropped;
+    for (int s = 0; s < TSN_STAGES; s++) {
+        out->stage[s].samples = now->stage[s].samples - base->stage[s].samples;
+        out->stage[s].items = now->stage[s].items - base->stage[s].items;
+        out->stage[s].ticks = now->stage[s].ticks - base->stage[s].ticks;
+        out->stage[s].max_ticks = now->stage[s].max_ticks;
+    }
+}
+
+double tsn_stage_ns(const tsn_stage_t *s) {
+    return s->items ? s->ticks * tsn_instr_tick_ns() / s->items : 0;
+}
+
+int tsn_instr_degraded(const tsn_instr_t *in) {
+    return in->rx_kernel_drops || in->rx_if_drops || in->rx_ring_freezes || in->truncated ||
+           in->tx_dropped || in->tx_late || in->txtime_dropped;
+}
+
+void tsn_instr_print_json(FILE *out, const tsn_instr_t *in) {
+    fprintf(out, "\"instrumentation\":{\"degraded\":%s,"
+            "\"rx\":{\"packets\":%lu,\"kernel_drops\":%lu,\"if_drops\":%lu,\"ring_freezes\":%lu},"
+            "\"truncated\":%lu,"
+            "\"tx\":{\"eagain\":%lu,\"enobufs\":%lu,\"errors\":%lu,\"dropped\":%lu,\"late\":%lu,"
+            "\"txtime_dropped\":%lu},\"stages\":{",
+            tsn_instr_degraded(in) ? "true" : "false",
+            in->rx_packets, in->rx_kernel_drops, in->rx_if_drops, in->rx_ring_freezes,
+            in->truncated,
+            in->tx_eagain, in->tx_enobufs, in->tx_errors, in->tx_dropped, in->tx_late,
+            in->txtime_dropped);
+
+    double tns = tsn_instr_tick_ns();
+    int first = 1;
+    for (int s = 0; s < TSN_STAGES; s++) {
+        const tsn_stage_t *st = &in->stage[s];
+        if (st->samples == 0) continue;
+        fprintf(out, "%s\"%s\":{\"samples\":%lu,\"frames\":%lu,\"ns_per_frame\":%.1f,"
+                "\"ticks_per_frame\":%.1f,\"max_ns\":%.0f}",
+                first ? "" : ",", stage_names[s], st->samples, st->items, tsn_stage_ns(st),
+                st->items ? (double)st->ticks / st->items : 0, st->max_ticks * tns);
+        first = 0;
+    }
+    fprintf(out, "}}");
+}
+
+void tsn_instr_print_human(FILE *out, const tsn_instr_t *in) {
+    if (in->rx_packets || in->rx_kernel_drops || in->rx_if_drops || in->truncated) {
+        fprintf(out, "RX: %lu accepted, %lu kernel drops, %lu interface drops, %lu ring freezes, "
+                "%lu truncated\n", in->rx_packets, in->rx_kernel_drops, in->rx_if_drops,
+                in->rx_ring_freezes, in->truncated);
+    }
+    if (in->tx_eagain || in->tx_enobufs || in->tx_errors || in->tx_late || in->txtime_dropped ||
+        in->stage[TSN_STAGE_TX].samples) {
+        fprintf(out, "TX: %lu EAGAIN, %lu ENOBUFS, %lu other errors, %lu frames dropped, "
+                "%lu late, %lu missed launch time\n", in->tx_eagain, in->tx_enobufs,
+                in->tx_errors, in->tx_dropped, in->tx_late, in->txtime_dropped);
+    }
+
+    int any = 0;
+    for (int s = 0; s < TSN_STAGES; s++) {
+        if (in->stage[s].samples == 0) continue;
+        fprintf(out, "%s%s %.0f ns/frame", any ? ", " : "Cost: ", stage_names[s],
+                tsn_stage_ns(&in->stage[s]));
+        any = 1;
+    }
+    if (any) fprintf(out, "\n");
+    if (tsn_instr_degraded(in)) {
+        fprintf(out, "WARNING: frames were dropped or sent late by the test setup itself; "
+                "loss and shaping figures are not trustworthy\n");
+    }
+}
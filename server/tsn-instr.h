@@ -0,0 +1,127 @@
+/*
+ * tsn-instr.h - Drop, overflow and per-stage cost counters (libtsntest)
+ *
+ * Everything that can make a result lie without the tool noticing, in one
+ * block every tool fills and reports:
+ *
+ *   RX  - frames the kernel dropped because the ring / pcap buffer was full
+ *         (PACKET_STATISTICS tp_drops, pcap_stats ps_drop), dropped by the
+ *         driver (ps_ifdrop), and how often the TPACKET_V3 ring froze because
+ *         user space fell behind (tp_freeze_q_cnt)
+ *   cap - frames an analysis saw but could not keep (a trace at its length
+ *         limit, a frame cut by the snaplen below what the tool needs)
+ *   TX  - send() / sendmmsg() failures by errno (EAGAIN, ENOBUFS, other),
+ *         frames that never left because of them or a malformed ring slot,
+ *         frames SO_TXTIME/ETF reported as missed, and slots the pacer handed
+ *         out after the next one was already due
+ *
+ * A "shaped" verdict or a loss figure with kernel drops or late sends behind
+ * it is a measurement problem, not a switch property.
+ *
+ * Stage cost: tsn_instr_ticks() is the CPU timestamp counter where there is
+ * one (x86 TSC, arm64 CNTVCT) and CLOCK_MONOTONIC otherwise; a stage adds
+ * begin/end tick pairs and the frames they covered, and is reported as ns per
+ * frame plus the worst single sample. Stages:
+ *
+ *   rx       - tsn_capture_dispatch() on the tpacket and file backends: ring
+ *              walk, copies and the handler (pcap's includes its wait, so it
+ *              is not timed)
+ *   handler  - the tool's per-frame handler (every TSN_INSTR_SAMPLE-th frame)
+ *   tx       - send syscall, batch push or ring kick
+ *   analysis - post-processing at report time (cycle search, fits, sorting)
+ *
+ * The rx minus handler difference is the capture backend's own cost.
+ */
+
+#ifndef TSN_INSTR_H
+#define TSN_INSTR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "tsn-common.h"
+
+#define TSN_INSTR_SAMPLE 16   // handler frames per timed one
+
+typedef enum {
+    TSN_STAGE_RX,
+    TSN_STAGE_HANDLER,
+    TSN_STAGE_TX,
+    TSN_STAGE_ANALYSIS,
+    TSN_STAGES
+} tsn_stage_id_t;
+
+typedef struct {
+    uint64_t samples;         // begin/end pairs
+    uint64_t items;           // frames they covered
+    uint64_t ticks;
+    uint64_t max_ticks;       // worst sample
+} tsn_stage_t;
+
+typedef struct {
+    // RX
+    uint64_t rx_packets;      // frames the socket accepted (after its filter)
+    uint64_t rx_kernel_drops;
+    uint64_t rx_if_drops;
+    uint64_t rx_ring_freezes;
+    // Capacity
+    uint64_t truncated;
+    // TX
+    uint64_t tx_eagain;
+    uint64_t tx_enobufs;
+    uint64_t tx_errors;       // any other errno
+    uint64_t tx_dropped;      // frames not sent because of the above
+    uint64_t tx_late;
+    uint64_t txtime_dropped;
+    tsn_stage_t stage[TSN_STAGES];
+} tsn_instr_t;
+
+static inline uint64_t tsn_instr_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return tsn_time_ns();
+#endif
+}
+
+static inline void tsn_stage_add(tsn_stage_t *s, uint64_t t0, uint64_t t1, uint64_t items) {
+    uint64_t d = t1 - t0;
+    s->samples++;
+    s->items += items;
+    s->ticks += d;
+    if (d > s->max_ticks) s->max_ticks = d;
+}
+
+// Calibrated tick length (a few ms against CLOCK_MONOTONIC on first use)
+double tsn_instr_tick_ns(void);
+
+// Add b's counters and stages to a
+void tsn_instr_merge(tsn_instr_t *a, const tsn_instr_t *b);
+
+void tsn_stage_merge(tsn_stage_t *a, const tsn_stage_t *b);
+
+// now - base for a long-lived socket reused across runs (max_ticks stays
+// now's: the worst sample is not per run)
+void tsn_instr_diff(tsn_instr_t *out, const tsn_instr_t *now, const tsn_instr_t *base);
+
+// ns per frame of a stage, 0 without samples
+double tsn_stage_ns(const tsn_stage_t *s);
+
+// Any drop, overflow or failed/late send
+int tsn_instr_degraded(const tsn_instr_t *in);
+
+// "\"instrumentation\":{...}" JSON member (no separators around it)
+void tsn_instr_print_json(FILE *out, const tsn_instr_t *in);
+
+// One summary line per side that has counts, with a warning when degraded
+void tsn_instr_print_human(FILE *out, const tsn_instr_t *in);
+
+#endif
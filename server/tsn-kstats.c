@@ -0,0 +1,452 @@
+/*
+ * tsn-kstats.c - Per-TC receive counters kept in the kernel (libtsntest)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-kstats.h"
+
+#ifndef SO_ATTACH_BPF
+#define SO_ATTACH_BPF 50
+#endif
+
+// Map value, one per PCP and CPU. min_iv is valid once count >= 2, the
+// sequence range once seq_seen > 0
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t first_ns;
+    uint64_t last_ns;
+    uint64_t total_iv;
+    uint64_t min_iv;
+    uint64_t max_iv;
+    uint64_t burst;
+    uint64_t seq_seen;
+    uint32_t seq_min;
+    uint32_t seq_max;
+    uint32_t buckets[TSN_HIST_BUCKETS];
+} kval_t;
+
+struct tsn_kstats {
+    int fd;          // AF_PACKET socket carrying the filter
+    int map_fd;
+    int prog_fd;
+    int n_cpus;      // possible CPUs: per-CPU lookups return one value each
+    kval_t *vals;
+};
+
+static long sys_bpf(int cmd, union bpf_attr *attr) {
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+// ---------------------------------------------------------------------------
+// Assembler: instructions plus forward jumps to labels, patched at the end
+
+#define MAX_INSNS 160
+#define MAX_FIXUPS 48
+
+enum {
+    L_TAG_INLINE, L_HAVE_TAG, L_NOT_FIRST, L_SET_MIN, L_MIN_DONE, L_MAX_DONE,
+    L_BURST_DONE, L_MSB16, L_MSB8, L_MSB4, L_MSB2, L_MSB1, L_MSB_DONE, L_IN_RANGE, L_BUCKET,
+    L_COUNT, L_SEQ_FIRST, L_SEQ_MIN_OK, L_SEQ_COUNT, L_DROP, N_LABELS
+};
+
+typedef struct {
+    struct bpf_insn insn[MAX_INSNS];
+    int n;
+    int label[N_LABELS];
+    int fix_at[MAX_FIXUPS];
+    int fix_label[MAX_FIXUPS];
+    int n_fix;
+} prog_t;
+
+#define INSN(c, d, s, o, i) ((struct bpf_insn){ .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+#define ALU_IMM(op, d, i)    INSN(BPF_ALU64 | (op) | BPF_K, d, 0, 0, i)
+#define ALU_REG(op, d, s)    INSN(BPF_ALU64 | (op) | BPF_X, d, s, 0, 0)
+#define MOV_IMM(d, i)        ALU_IMM(BPF_MOV, d, i)
+#define MOV_REG(d, s)        ALU_REG(BPF_MOV, d, s)
+#define LDX(sz, d, s, o)     INSN(BPF_LDX | BPF_MEM | (sz), d, s, o, 0)
+#define STX(sz, d, s, o)     INSN(BPF_STX | BPF_MEM | (sz), d, s, o, 0)
+#define LD_ABS(sz, i)        INSN(BPF_LD | BPF_ABS | (sz), 0, 0, 0, i)
+#define LD_IND(sz, s, i)     INSN(BPF_LD | BPF_IND | (sz), 0, s, 0, i)
+#define JMP_IMM(op, d, i)    INSN(BPF_JMP | (op) | BPF_K, d, 0, 0, i)
+#define JMP_REG(op, d, s)    INSN(BPF_JMP | (op) | BPF_X, d, s, 0, 0)
+#define JA                   INSN(BPF_JMP | BPF_JA, 0, 0, 0, 0)
+#define CALL(fn)             INSN(BPF_JMP | BPF_CALL, 0, 0, 0, fn)
+#define EXIT                 INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+#define V(field) ((short)offsetof(kval_t, field))
+#define SKB(field) ((short)offsetof(struct __sk_buff, field))
+
+static void emit(prog_t *p, struct bpf_insn i) {
+    if (p->n < MAX_INSNS) p->insn[p->n] = i;
+    p->n++;
+}
+
+static void emit_jmp(prog_t *p, struct bpf_insn i, int label) {
+    if (p->n_fix < MAX_FIXUPS) {
+        p->fix_at[p->n_fix] = p->n;
+        p->fix_label[p->n_fix] = label;
+    }
+    p->n_fix++;
+    emit(p, i);
+}
+
+static void label(prog_t *p, int l) {
+    p->label[l] = p->n;
+}
+
+static int link_prog(prog_t *p) {
+    if (p->n > MAX_INSNS || p->n_fix > MAX_FIXUPS) return -1;
+    for (int i = 0; i < p->n_fix; i++) {
+        p->insn[p->fix_at[i]].off = (short)(p->label[p->fix_label[i]] - p->fix_at[i] - 1);
+    }
+    return 0;
+}
+
+/*
+ * The filter. r6 = skb (LD_ABS / LD_IND need it there), r7 = TCI then seq,
+ * r8 = L3 offset, r9 = map value; r10 - 4 the key, r10 - 16 the arrival time.
+ * LD_ABS / LD_IND past the end of the frame end the program with 0 too, so
+ * the counters are updated before the test header is looked at.
+ */
+static void build_prog(prog_t *p, int map_fd, int vlan_id, uint64_t burst_ns) {
+    memset(p, 0, sizeof(*p));
+    emit(p, MOV_REG(6, 1));
+
+    // 802.1Q tag: offloaded into the skb, or still in the frame
+    emit(p, LDX(BPF_W, 1, 6, SKB(vlan_present)));
+    emit_jmp(p, JMP_IMM(BPF_JEQ, 1, 0), L_TAG_INLINE);
+    emit(p, LDX(BPF_W, 7, 6, SKB(vlan_tci)));
+    emit(p, MOV_IMM(8, 14));
+    emit_jmp(p, JA, L_HAVE_TAG);
+    label(p, L_TAG_INLINE);
+    emit(p, LD_ABS(BPF_H, 12));
+    emit_jmp(p, JMP_IMM(BPF_JNE, 0, 0x8100), L_DROP);
+    emit(p, LD_ABS(BPF_H, 14));
+    emit(p, MOV_REG(7, 0));
+    emit(p, MOV_IMM(8, 18));
+    label(p, L_HAVE_TAG);
+
+    if (vlan_id > 0) {
+        emit(p, MOV_REG(1, 7));
+        emit(p, ALU_IMM(BPF_AND, 1, 0xFFF));
+        emit_jmp(p, JMP_IMM(BPF_JNE, 1, vlan_id), L_DROP);
+    }
+    emit(p, LD_IND(BPF_H, 8, -2));
+    emit_jmp(p, JMP_IMM(BPF_JNE, 0, 0x0800), L_DROP);
+
+    // Key = PCP, value of this CPU
+    emit(p, ALU_IMM(BPF_RSH, 7, 13));
+    emit(p, ALU_IMM(BPF_AND, 7, 7));
+    emit(p, STX(BPF_W, 10, 7, -4));
+    emit(p, CALL(BPF_FUNC_ktime_get_ns));
+    emit(p, STX(BPF_DW, 10, 0, -16));
+    emit(p, INSN(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map_fd));
+    emit(p, INSN(0, 0, 0, 0, 0));
+    emit(p, MOV_REG(2, 10));
+    emit(p, ALU_IMM(BPF_ADD, 2, -4));
+    emit(p, CALL(BPF_FUNC_map_lookup_elem));
+    emit_jmp(p, JMP_IMM(BPF_JEQ, 0, 0), L_DROP);
+    emit(p, MOV_REG(9, 0));
+
+    emit(p, LDX(BPF_DW, 1, 9, V(count)));
+    emit(p, LDX(BPF_DW, 2, 10, -16));
+    emit_jmp(p, JMP_IMM(BPF_JNE, 1, 0), L_NOT_FIRST);
+    emit(p, STX(BPF_DW, 9, 2, V(first_ns)));
+    emit_jmp(p, JA, L_COUNT);
+
+    // r2 = interval
+    label(p, L_NOT_FIRST);
+    emit(p, LDX(BPF_DW, 3, 9, V(last_ns)));
+    emit(p, ALU_REG(BPF_SUB, 2, 3));
+    emit(p, LDX(BPF_DW, 3, 9, V(total_iv)));
+    emit(p, ALU_REG(BPF_ADD, 3, 2));
+    emit(p, STX(BPF_DW, 9, 3, V(total_iv)));
+    emit_jmp(p, JMP_IMM(BPF_JEQ, 1, 1), L_SET_MIN);
+    emit(p, LDX(BPF_DW, 3, 9, V(min_iv)));
+    emit_jmp(p, JMP_REG(BPF_JGE, 2, 3), L_MIN_DONE);
+    label(p, L_SET_MIN);
+    emit(p, STX(BPF_DW, 9, 2, V(min_iv)));
+    label(p, L_MIN_DONE);
+    emit(p, LDX(BPF_DW, 3, 9, V(max_iv)));
+    emit_jmp(p, JMP_REG(BPF_JLE, 2, 3), L_MAX_DONE);
+    emit(p, STX(BPF_DW, 9, 2, V(max_iv)));
+    label(p, L_MAX_DONE);
+    // 64-bit threshold: a JGE immediate is a sign-extended 32-bit value
+    emit(p, INSN(BPF_LD | BPF_DW | BPF_IMM, 3, 0, 0, (int)(uint32_t)burst_ns));
+    emit(p, INSN(0, 0, 0, 0, (int)(uint32_t)(burst_ns >> 32)));
+    emit_jmp(p, JMP_REG(BPF_JGE, 2, 3), L_BURST_DONE);
+    emit(p, LDX(BPF_DW, 3, 9, V(burst)));
+    emit(p, ALU_IMM(BPF_ADD, 3, 1));
+    emit(p, STX(BPF_DW, 9, 3, V(burst)));
+    label(p, L_BURST_DONE);
+
+    // r4 = tsn_hist_index(r2): r4 = msb by halving, then the log-linear bucket
+    emit(p, MOV_REG(4, 2));
+    emit_jmp(p, JMP_IMM(BPF_JLT, 2, 1 << TSN_HIST_SUB_BITS), L_BUCKET);
+    emit(p, MOV_REG(5, 2));
+    emit(p, MOV_IMM(4, 0));
+    static const int steps[] = { 32, 16, 8, 4, 2, 1 };
+    static const int next[] = { L_MSB16, L_MSB8, L_MSB4, L_MSB2, L_MSB1, L_MSB_DONE };
+    for (int i = 0; i < 6; i++) {
+        emit(p, MOV_REG(3, 5));
+        emit(p, ALU_IMM(BPF_RSH, 3, steps[i]));
+        emit_jmp(p, JMP_IMM(BPF_JEQ, 3, 0), next[i]);
+        emit(p, ALU_IMM(BPF_ADD, 4, steps[i]));
+        emit(p, MOV_REG(5, 3));
+        label(p, next[i]);
+    }
+    emit_jmp(p, JMP_IMM(BPF_JLE, 4, TSN_HIST_MAX_BITS), L_IN_RANGE);
+    emit(p, MOV_IMM(4, TSN_HIST_BUCKETS - 1));
+    emit_jmp(p, JA, L_BUCKET);
+    label(p, L_IN_RANGE);
+    emit(p, ALU_IMM(BPF_SUB, 4, TSN_HIST_SUB_BITS));
+    emit(p, MOV_REG(5, 2));
+    emit(p, ALU_REG(BPF_RSH, 5, 4));
+    emit(p, ALU_IMM(BPF_ADD, 4, 1));
+    emit(p, ALU_IMM(BPF_LSH, 4, TSN_HIST_SUB_BITS));
+    emit(p, ALU_REG(BPF_ADD, 4, 5));
+    emit(p, ALU_IMM(BPF_SUB, 4, 1 << TSN_HIST_SUB_BITS));
+    label(p, L_BUCKET);
+    emit_jmp(p, JMP_IMM(BPF_JGT, 4, TSN_HIST_BUCKETS - 1), L_COUNT);
+    emit(p, ALU_IMM(BPF_LSH, 4, 2));
+    emit(p, MOV_REG(1, 9));
+    emit(p, ALU_REG(BPF_ADD, 1, 4));
+    emit(p, LDX(BPF_W, 3, 1, V(buckets)));
+    emit(p, ALU_IMM(BPF_ADD, 3, 1));
+    emit(p, STX(BPF_W, 1, 3, V(buckets)));
+
+    label(p, L_COUNT);
+    emit(p, LDX(BPF_DW, 2, 10, -16));
+    emit(p, STX(BPF_DW, 9, 2, V(last_ns)));
+    emit(p, LDX(BPF_W, 3, 6, SKB(len)));
+    emit(p, LDX(BPF_DW, 2, 9, V(bytes)));
+    emit(p, ALU_REG(BPF_ADD, 2, 3));
+    emit(p, STX(BPF_DW, 9, 2, V(bytes)));
+    emit(p, LDX(BPF_DW, 2, 9, V(count)));
+    emit(p, ALU_IMM(BPF_ADD, 2, 1));
+    emit(p, STX(BPF_DW, 9, 2, V(count)));
+
+    // Test header after IPv4 / UDP / "TC<pcp>" (tsn-frame.h)
+    emit(p, LD_IND(BPF_B, 8, 9));
+    emit_jmp(p, JMP_IMM(BPF_JNE, 0, 17), L_DROP);
+    emit(p, LD_IND(BPF_B, 8, 0));
+    emit(p, ALU_IMM(BPF_AND, 0, 0x0F));
+    emit(p, ALU_IMM(BPF_LSH, 0, 2));
+    emit(p, ALU_REG(BPF_ADD, 8, 0));
+    emit(p, LD_IND(BPF_H, 8, 8 + 3));
+    emit_jmp(p, JMP_IMM(BPF_JNE, 0, TSN_TEST_MAGIC), L_DROP);
+    emit(p, LD_IND(BPF_W, 8, 8 + 3 + 4));
+    emit(p, MOV_REG(7, 0));
+    emit(p, LDX(BPF_DW, 1, 9, V(seq_seen)));
+    emit_jmp(p, JMP_IMM(BPF_JEQ, 1, 0), L_SEQ_FIRST);
+    emit(p, LDX(BPF_W, 2, 9, V(seq_min)));
+    emit_jmp(p, JMP_REG(BPF_JGE, 7, 2), L_SEQ_MIN_OK);
+    emit(p, STX(BPF_W, 9, 7, V(seq_min)));
+    label(p, L_SEQ_MIN_OK);
+    emit(p, LDX(BPF_W, 2, 9, V(seq_max)));
+    emit_jmp(p, JMP_REG(BPF_JLE, 7, 2), L_SEQ_COUNT);
+    emit(p, STX(BPF_W, 9, 7, V(seq_max)));
+    emit_jmp(p, JA, L_SEQ_COUNT);
+    label(p, L_SEQ_FIRST);
+    emit(p, STX(BPF_W, 9, 7, V(seq_min)));
+    emit(p, STX(BPF_W, 9, 7, V(seq_max)));
+    label(p, L_SEQ_COUNT);
+    emit(p, ALU_IMM(BPF_ADD, 1, 1));
+    emit(p, STX(BPF_DW, 9, 1, V(seq_seen)));
+
+    // Never queue the frame
+    label(p, L_DROP);
+    emit(p, MOV_IMM(0, 0));
+    emit(p, EXIT);
+}
+
+// ---------------------------------------------------------------------------
+
+// Per-CPU map lookups return one value per possible CPU ("0-N" or "0")
+static int possible_cpus(void) {
+    int n = 0;
+    FILE *f = fopen("/sys/devices/system/cpu/possible", "r");
+    if (f) {
+        int lo, hi;
+        char sep;
+        while (fscanf(f, "%d", &lo) == 1) {
+            hi = lo;
+            if (fscanf(f, "%c", &sep) == 1 && sep == '-' && fscanf(f, "%d", &hi) == 1) {
+                if (fscanf(f, "%c", &sep) != 1) sep = '\n';
+            }
+            n = hi + 1;
+            if (sep != ',') break;
+        }
+        fclose(f);
+    }
+    return n > 0 ? n : (int)sysconf(_SC_NPROCESSORS_CONF);
+}
+
+tsn_kstats_t *tsn_kstats_open(const char *ifname, int vlan_id, uint64_t burst_ns, char *errbuf) {
+    tsn_kstats_t *k = calloc(1, sizeof(*k));
+    if (!k) {
+        snprintf(errbuf, 256, "out of memory");
+        return NULL;
+    }
+    k->fd = k->map_fd = k->prog_fd = -1;
+    k->n_cpus = possible_cpus();
+    k->vals = calloc(k->n_cpus, sizeof(kval_t));
+    if (!k->vals) {
+        snprintf(errbuf, 256, "out of memory");
+        goto fail;
+    }
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_PERCPU_ARRAY;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(kval_t);
+    attr.max_entries = TSN_MAX_TC;
+    k->map_fd = (int)sys_bpf(BPF_MAP_CREATE, &attr);
+    if (k->map_fd < 0) {
+        snprintf(errbuf, 256, "BPF_MAP_CREATE: %s", strerror(errno));
+        goto fail;
+    }
+
+    static prog_t prog;
+    build_prog(&prog, k->map_fd, vlan_id, burst_ns);
+    if (link_prog(&prog) < 0) {
+        snprintf(errbuf, 256, "filter program too long");
+        goto fail;
+    }
+
+    static char log[65536];
+    log[0] = '\0';
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+    attr.insns = (uint64_t)(uintptr_t)prog.insn;
+    attr.insn_cnt = prog.n;
+    attr.license = (uint64_t)(uintptr_t)"GPL";
+    attr.log_buf = (uint64_t)(uintptr_t)log;
+    attr.log_size = sizeof(log);
+    attr.log_level = 1;
+    k->prog_fd = (int)sys_bpf(BPF_PROG_LOAD, &attr);
+    if (k->prog_fd < 0) {
+        // The verifier's verdict is the last line of its log
+        int err = errno;
+        size_t len = strlen(log);
+        while (len > 0 && log[len - 1] == '\n') log[--len] = '\0';
+        char *last = strrchr(log, '\n');
+        snprintf(errbuf, 256, "BPF_PROG_LOAD: %s%s%s", strerror(err),
+                 len ? ": " : "", last ? last + 1 : log);
+        goto fail;
+    }
+
+    // Protocol 0 until the filter is attached, as in tsn-capture
+    k->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (k->fd < 0) {
+        snprintf(errbuf, 256, "socket: %s", strerror(errno));
+        goto fail;
+    }
+    if (setsockopt(k->fd, SOL_SOCKET, SO_ATTACH_BPF, &k->prog_fd, sizeof(k->prog_fd)) < 0) {
+        snprintf(errbuf, 256, "SO_ATTACH_BPF: %s", strerror(errno));
+        goto fail;
+    }
+
+    unsigned int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) {
+        snprintf(errbuf, 256, "%s: no such interface", ifname);
+        goto fail;
+    }
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ifindex;
+    if (bind(k->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        snprintf(errbuf, 256, "bind: %s", strerror(errno));
+        goto fail;
+    }
+
+    struct packet_mreq mr;
+    memset(&mr, 0, sizeof(mr));
+    mr.mr_ifindex = ifindex;
+    mr.mr_type = PACKET_MR_PROMISC;
+    setsockopt(k->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr));
+    return k;
+
+fail:
+    tsn_kstats_close(k);
+    return NULL;
+}
+
+int tsn_kstats_read(tsn_kstats_t *k, tsn_kstats_tc_t *tc) {
+    for (uint32_t key = 0; key < TSN_MAX_TC; key++) {
+        union bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = k->map_fd;
+        attr.key = (uint64_t)(uintptr_t)&key;
+        attr.value = (uint64_t)(uintptr_t)k->vals;
+        if (sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr) < 0) return -1;
+
+        tsn_kstats_tc_t *t = &tc[key];
+        memset(t, 0, sizeof(*t));
+        t->min_interval_ns = UINT64_MAX;
+        tsn_hist_init(&t->interval_hist);
+
+        for (int c = 0; c < k->n_cpus; c++) {
+            const kval_t *v = &k->vals[c];
+            if (v->count == 0) continue;
+
+            if (t->count == 0 || v->first_ns < t->first_ts_ns) t->first_ts_ns = v->first_ns;
+            if (v->last_ns > t->last_ts_ns) t->last_ts_ns = v->last_ns;
+            t->count += v->count;
+            t->bytes += v->bytes;
+            t->total_interval_ns += v->total_iv;
+            t->burst_intervals += v->burst;
+            if (v->count > 1) {
+                if (v->min_iv < t->min_interval_ns) t->min_interval_ns = v->min_iv;
+                if (v->max_iv > t->max_interval_ns) t->max_interval_ns = v->max_iv;
+                t->interval_hist.count += v->count - 1;
+            }
+            if (v->seq_seen) {
+                if (t->seq_seen == 0 || v->seq_min < t->seq_min) t->seq_min = v->seq_min;
+                if (t->seq_seen == 0 || v->seq_max > t->seq_max) t->seq_max = v->seq_max;
+                t->seq_seen += v->seq_seen;
+            }
+            for (int i = 0; i < TSN_HIST_BUCKETS; i++) t->interval_hist.buckets[i] += v->buckets[i];
+        }
+        if (t->interval_hist.count) {
+            t->interval_hist.min = t->min_interval_ns;
+            t->interval_hist.max = t->max_interval_ns;
+        }
+    }
+    return 0;
+}
+
+uint64_t tsn_kstats_lost(const tsn_kstats_tc_t *tc) {
+    if (tc->seq_seen == 0) return 0;
+    uint64_t range = (uint64_t)(tc->seq_max - tc->seq_min) + 1;
+    return range > tc->seq_seen ? range - tc->seq_seen : 0;
+}
+
+void tsn_kstats_close(tsn_kstats_t *k) {
+    if (!k) return;
+    if (k->fd >= 0) close(k->fd);
+    if (k->prog_fd >= 0) close(k->prog_fd);
+    if (k->map_fd >= 0) close(k->map_fd);
+    free(k->vals);
+    free(k);
+}
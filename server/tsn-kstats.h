@@ -0,0 +1,62 @@
+/*
+ * tsn-kstats.h - Per-TC receive counters kept in the kernel (libtsntest)
+ *
+ * An eBPF socket filter on an AF_PACKET socket does the per-packet work of
+ * traffic-capture's stats path in the RX softirq: 802.1Q PCP / VID (offloaded
+ * or in-band tag), IPv4 only, then count, bytes, first / last arrival,
+ * inter-arrival sum / min / max, burst intervals, the tsn_hist_t interval
+ * histogram and the test header sequence range. The counters live in a
+ * per-CPU array map keyed by PCP, so the program needs no atomics, and the
+ * filter returns 0: no frame is ever queued on the socket or copied to user
+ * space. tsn_kstats_read() sums the CPUs.
+ *
+ * Arrival times are bpf_ktime_get_ns() (CLOCK_MONOTONIC) when the filter
+ * runs. Intervals are taken per CPU, so a TC spread over several RX queues
+ * gets the intervals between frames of the same queue; RSS keeps one flow on
+ * one queue, and a TC is one flow unless the sender varies them (--flows).
+ *
+ * Sequence: lowest / highest sequence and the number of test headers seen,
+ * so loss is the range minus what arrived. Duplicates, reordering and
+ * latency need the frame and stay with the copying path.
+ *
+ * The program is assembled here and loaded with bpf(2); no compiler, libbpf
+ * or BTF needed. Needs root (CAP_BPF and CAP_NET_RAW).
+ */
+
+#ifndef TSN_KSTATS_H
+#define TSN_KSTATS_H
+
+#include <stdint.h>
+
+#include "tsn-analysis.h"
+
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t first_ts_ns;
+    uint64_t last_ts_ns;
+    uint64_t total_interval_ns;
+    uint64_t min_interval_ns;    // UINT64_MAX until a TC has two frames
+    uint64_t max_interval_ns;
+    uint64_t burst_intervals;    // intervals below burst_ns
+    uint64_t seq_seen;           // frames with a test header
+    uint32_t seq_min;
+    uint32_t seq_max;
+    tsn_hist_t interval_hist;
+} tsn_kstats_tc_t;
+
+typedef struct tsn_kstats tsn_kstats_t;
+
+// Attach to ifname, counting frames of vlan_id (0: any VLAN). Returns NULL
+// and fills errbuf (256 bytes) if the kernel refuses the program
+tsn_kstats_t *tsn_kstats_open(const char *ifname, int vlan_id, uint64_t burst_ns, char *errbuf);
+
+// Current totals of every TC into tc[TSN_MAX_TC]; returns 0 or -1
+int tsn_kstats_read(tsn_kstats_t *k, tsn_kstats_tc_t *tc);
+
+// Frames lost by the sequence range, 0 without test headers
+uint64_t tsn_kstats_lost(const tsn_kstats_tc_t *tc);
+
+void tsn_kstats_close(tsn_kstats_t *k);
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * tsn-pace.c - Send-time pacer for the TX loops (libtsntest)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "tsn-common.h"
+#include "tsn-pace.h"
+
+// Calibration: p95 wake-up overshoot of CALIB_SLEEPS short absolute sleeps,
+// plus a margin for the odd slow wake-up
+#define CALIB_SLEEPS 64
+#define CALIB_SLEEP_NS 50000ULL
+#define SLACK_MARGIN_NS 10000ULL
+#define SLACK_MIN_NS 20000ULL
+#define SLACK_MAX_NS 1000000ULL
+
+// Single sleeps are capped so a cleared *running is seen within this
+#define SLEEP_CHUNK_NS 10000000ULL
+
+static pthread_once_t calib_once = PTHREAD_ONCE_INIT;
+static uint64_t calib_slack_ns = SLACK_MAX_NS;
+
+static void sleep_until_ns(uint64_t target_ns) {
+    struct timespec ts = { .tv_sec = target_ns / 1000000000ULL, .tv_nsec = target_ns % 1000000000ULL };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void calibrate(void) {
+    const char *env = getenv("TSN_PACE_SLACK_US");
+    if (env && *env) {
+        calib_slack_ns = strtoull(env, NULL, 10) * 1000ULL;
+        return;
+    }
+
+    uint64_t over[CALIB_SLEEPS];
+    for (int i = 0; i < CALIB_SLEEPS; i++) {
+        uint64_t target = tsn_time_ns() + CALIB_SLEEP_NS;
+        sleep_until_ns(target);
+        over[i] = tsn_time_ns() - target;
+    }
+    qsort(over, CALIB_SLEEPS, sizeof(over[0]), cmp_u64);
+
+    uint64_t slack = over[CALIB_SLEEPS * 95 / 100] + SLACK_MARGIN_NS;
+    if (slack < SLACK_MIN_NS) slack = SLACK_MIN_NS;
+    if (slack > SLACK_MAX_NS) slack = SLACK_MAX_NS;
+    calib_slack_ns = slack;
+}
+
+void tsn_pacer_init(tsn_pacer_t *p, tsn_pace_mode_t mode) {
+    memset(p, 0, sizeof(*p));
+    tsn_hist_init(&p->error);
+    p->mode = mode;
+    if (mode == TSN_PACE_HYBRID) {
+        pthread_once(&calib_once, calibrate);
+        p->slack_ns = calib_slack_ns;
+    }
+}
+
+int tsn_pace_mode_parse(const char *name, tsn_pace_mode_t *mode) {
+    if (strcmp(name, "hybrid") == 0) *mode = TSN_PACE_HYBRID;
+    else if (strcmp(name, "spin") == 0) *mode = TSN_PACE_SPIN;
+    else if (strcmp(name, "sleep") == 0) *mode = TSN_PACE_SLEEP;
+    else return -1;
+    return 0;
+}
+
+const char *tsn_pace_mode_name(tsn_pace_mode_t mode) {
+    switch (mode) {
+    case TSN_PACE_SPIN: return "spin";
+    case TSN_PACE_SLEEP: return "sleep";
+    default: return "hybrid";
+    }
+}
+
+uint64_t tsn_pacer_wait(tsn_pacer_t *p, uint64_t target_ns, const volatile int *running) {
+    uint64_t now = tsn_time_ns();
+
+    // Sleep (spin and short waits skip this) to slack before the target
+    if (p->mode != TSN_PACE_SPIN) {
+        while (now + p->slack_ns < target_ns && (!running || *running)) {
+            uint64_t wake = target_ns - p->slack_ns;
+            if (wake - now > SLEEP_CHUNK_NS) wake = now + SLEEP_CHUNK_NS;
+            sleep_until_ns(wake);
+            now = tsn_time_ns();
+        }
+        if (p->mode == TSN_PACE_SLEEP) return now;
+    }
+
+    while (now < target_ns) {
+        if (running && !*running) break;
+        now = tsn_time_ns();
+    }
+    return now;
+}
+
+uint32_t tsn_pacer_due(tsn_pacer_t *p, uint64_t now, uint64_t next_ns, uint64_t interval_ns, uint32_t max) {
+    uint32_t n = 1;
+    if (now > next_ns && interval_ns > 0) {
+        uint64_t due = (now - next_ns) / interval_ns + 1;
+        n = due < max ? (uint32_t)due : max;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t slot = next_ns + i * interval_ns;
+        tsn_hist_add(&p->error, now > slot ? now - slot : 0);
+        p->late += now >= slot + interval_ns && interval_ns > 0;
+    }
+    p->slots += n;
+    p->catchup += n - 1;
+    return n;
+}
+
+void tsn_pacer_merge(tsn_pacer_t *a, const tsn_pacer_t *b) {
+    if (b->error.count == 0) return;
+    if (a->error.count == 0 || b->error.min < a->error.min) a->error.min = b->error.min;
+    if (b->error.max > a->error.max) a->error.max = b->error.max;
+    a->error.count += b->error.count;
+    for (int i = 0; i < TSN_HIST_BUCKETS; i++) a->error.buckets[i] += b->error.buckets[i];
+    a->slots += b->slots;
+    a->catchup += b->catchup;
+    a->late += b->late;
+}
@@ -0,0 +1,69 @@
+/*
+ * tsn-pace.h - Send-time pacer for the TX loops (libtsntest)
+ *
+ * Modes:
+ *   hybrid - clock_nanosleep(TIMER_ABSTIME) to slack_ns before the send time,
+ *            then busy-wait the rest (default). The slack is calibrated once
+ *            per process from this host's wake-up latency, so the core is
+ *            free for RX threads and the web server between frames while the
+ *            send times stay close to spin precision
+ *   spin   - busy-wait the whole interval: lowest jitter, a full core per TX
+ *            thread (with SCHED_FIFO, nothing else runs there)
+ *   sleep  - clock_nanosleep only: cheapest, the wake-up latency ends up in
+ *            the send-time error
+ *
+ * Behind schedule (preempted, slow send), tsn_pacer_due() hands out every
+ * slot that is already due, up to TSN_PACE_MAX_CATCHUP, so the loop can send
+ * them as one burst and the average rate holds.
+ *
+ * Each slot's send-time error (time handed out - slot time, in ns) goes into
+ * a histogram for the tool's summary; a slot a whole interval or more behind
+ * counts as late (tsn-instr.h tx_late).
+ *
+ * Selection: --pacing in each tool; TSN_PACE_SLACK_US overrides the
+ * calibrated slack
+ */
+
+#ifndef TSN_PACE_H
+#define TSN_PACE_H
+
+#include <stdint.h>
+
+#include "tsn-analysis.h"
+
+#define TSN_PACE_MAX_CATCHUP 64
+
+typedef enum {
+    TSN_PACE_HYBRID,
+    TSN_PACE_SPIN,
+    TSN_PACE_SLEEP
+} tsn_pace_mode_t;
+
+typedef struct {
+    tsn_pace_mode_t mode;
+    uint64_t slack_ns;      // hybrid: spin this long before each send time
+    tsn_hist_t error;       // send-time error per slot (ns)
+    uint64_t slots;
+    uint64_t catchup;       // slots sent in a burst behind an earlier one
+    uint64_t late;          // slots handed out once the next one was due
+} tsn_pacer_t;
+
+// Calibrates the hybrid slack on first use (a few ms)
+void tsn_pacer_init(tsn_pacer_t *p, tsn_pace_mode_t mode);
+
+// "hybrid", "spin" or "sleep"; returns -1 for anything else
+int tsn_pace_mode_parse(const char *name, tsn_pace_mode_t *mode);
+const char *tsn_pace_mode_name(tsn_pace_mode_t mode);
+
+// Wait until target_ns (CLOCK_MONOTONIC) or until *running (may be NULL) is
+// cleared; returns the time it stopped waiting
+uint64_t tsn_pacer_wait(tsn_pacer_t *p, uint64_t target_ns, const volatile int *running);
+
+// Slots of interval_ns from next_ns on that are due at now: at least 1, at
+// most max. Records the send-time error of each
+uint32_t tsn_pacer_due(tsn_pacer_t *p, uint64_t now, uint64_t next_ns, uint64_t interval_ns, uint32_t max);
+
+// Add b's slots and errors to a (per-worker pacers into one summary)
+void tsn_pacer_merge(tsn_pacer_t *a, const tsn_pacer_t *b);
+
+#endif
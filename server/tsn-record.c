@@ -0,0 +1,154 @@
+/*
+ * tsn-record.c - Fixed-width binary capture records (libtsntest)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tsn-record.h"
+
+_Static_assert(sizeof(tsn_rec_t) == 24, "tsn_rec_t is part of the file format");
+_Static_assert(sizeof(tsn_rec_hdr_t) == TSN_REC_HDR_LEN, "tsn_rec_hdr_t is part of the file format");
+
+struct tsn_rec_out {
+    int fd;
+    int own_fd;
+    pthread_mutex_t lock;
+    uint64_t written;
+    int error;
+};
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+tsn_rec_out_t *tsn_rec_create(const char *path, uint32_t ts_resolution_ns, uint32_t flags,
+                              char *errbuf) {
+    tsn_rec_out_t *out = calloc(1, sizeof(*out));
+    if (!out) {
+        snprintf(errbuf, 256, "out of memory");
+        return NULL;
+    }
+
+    if (strcmp(path, "-") == 0) {
+        out->fd = STDOUT_FILENO;
+    } else {
+        out->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out->fd < 0) {
+            snprintf(errbuf, 256, "%s: %s", path, strerror(errno));
+            free(out);
+            return NULL;
+        }
+        out->own_fd = 1;
+    }
+    pthread_mutex_init(&out->lock, NULL);
+
+    tsn_rec_hdr_t hdr = {
+        .magic = TSN_REC_MAGIC,
+        .version = TSN_REC_VERSION,
+        .rec_size = sizeof(tsn_rec_t),
+        .ts_resolution_ns = ts_resolution_ns,
+        .flags = flags
+    };
+    if (write_all(out->fd, &hdr, sizeof(hdr)) < 0) {
+        snprintf(errbuf, 256, "%s: %s", path, strerror(errno));
+        tsn_rec_close(out);
+        return NULL;
+    }
+    return out;
+}
+
+int tsn_rec_flush(tsn_rec_buf_t *b) {
+    if (b->n == 0) return 0;
+    tsn_rec_out_t *out = b->out;
+
+    pthread_mutex_lock(&out->lock);
+    int rc = out->error ? -1 : write_all(out->fd, b->recs, b->n * sizeof(tsn_rec_t));
+    if (rc < 0 && !out->error) {
+        out->error = errno;
+        fprintf(stderr, "record: write failed: %s\n", strerror(errno));
+    }
+    if (rc == 0) out->written += b->n;
+    pthread_mutex_unlock(&out->lock);
+
+    b->n = 0;
+    return rc;
+}
+
+uint64_t tsn_rec_written(const tsn_rec_out_t *out) {
+    return out->written;
+}
+
+int tsn_rec_close(tsn_rec_out_t *out) {
+    if (!out) return 0;
+    int rc = out->error ? -1 : 0;
+    if (out->own_fd && close(out->fd) < 0) rc = -1;
+    pthread_mutex_destroy(&out->lock);
+    free(out);
+    return rc;
+}
+
+int tsn_rec_check_hdr(const void *buf, size_t len, tsn_rec_hdr_t *hdr) {
+    if (len < TSN_REC_HDR_LEN) return -1;
+    memcpy(hdr, buf, sizeof(*hdr));
+    if (hdr->magic != TSN_REC_MAGIC) return -1;
+    if (hdr->version != TSN_REC_VERSION || hdr->rec_size != sizeof(tsn_rec_t)) return -1;
+    return 0;
+}
+
+int tsn_rec_open(tsn_rec_file_t *f, const char *path, char *errbuf) {
+    memset(f, 0, sizeof(*f));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(errbuf, 256, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < TSN_REC_HDR_LEN) {
+        snprintf(errbuf, 256, "%s: not a record file", path);
+        close(fd);
+        return -1;
+    }
+    f->map_len = st.st_size;
+    f->map = mmap(NULL, f->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (f->map == MAP_FAILED) {
+        f->map = NULL;
+        snprintf(errbuf, 256, "mmap %s: %s", path, strerror(errno));
+        return -1;
+    }
+    madvise(f->map, f->map_len, MADV_SEQUENTIAL);
+
+    if (tsn_rec_check_hdr(f->map, f->map_len, &f->hdr) < 0) {
+        snprintf(errbuf, 256, "%s: not a version %d record file", path, TSN_REC_VERSION);
+        tsn_rec_close_file(f);
+        return -1;
+    }
+    f->recs = (const tsn_rec_t *)((const uint8_t *)f->map + TSN_REC_HDR_LEN);
+    f->n = (f->map_len - TSN_REC_HDR_LEN) / sizeof(tsn_rec_t);
+    return 0;
+}
+
+void tsn_rec_close_file(tsn_rec_file_t *f) {
+    if (f->map) munmap(f->map, f->map_len);
+    f->map = NULL;
+    f->recs = NULL;
+    f->n = 0;
+}
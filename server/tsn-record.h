@@ -0,0 +1,127 @@
+/*
+ * tsn-record.h - Fixed-width binary capture records (libtsntest)
+ *
+ * File layout (host byte order, little-endian on every target we build for):
+ *   header  16 bytes: magic "TSNR" | version (16) | record size (16) |
+ *                     timestamp resolution ns (32) | flags (32)
+ *   records 24 bytes each, see tsn_rec_t
+ *
+ * Writers buffer TSN_REC_BUF records per thread and append whole buffers
+ * under a lock, so several capture workers can share one file or pipe. Records
+ * of one TC come from one worker and stay in arrival order; records of
+ * different TCs are interleaved in buffer-sized runs, not sorted by time.
+ *
+ * The capture file backend reads record files too (tsn_capture_open_file),
+ * replaying each record as a minimal tagged test frame.
+ */
+
+#ifndef TSN_RECORD_H
+#define TSN_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tsn-frame.h"
+
+#define TSN_REC_MAGIC 0x524E5354   // "TSNR"
+#define TSN_REC_VERSION 1
+#define TSN_REC_HDR_LEN 16
+#define TSN_REC_BUF 4096           // records per writer buffer (96 KB)
+
+#define TSN_REC_F_HWTS 0x1         // header: hardware RX timestamps
+#define TSN_REC_F_SEQ 0x1          // record: seq and lat_ns are valid
+
+typedef struct {
+    uint64_t ts_ns;     // RX timestamp
+    uint32_t seq;       // test header sequence
+    int32_t lat_ns;     // RX - TX timestamp, saturated to +-2.1 s
+    uint16_t len;       // wire length
+    uint16_t vid;
+    uint8_t pcp;
+    uint8_t flags;      // TSN_REC_F_*
+    uint16_t reserved;
+} tsn_rec_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t rec_size;
+    uint32_t ts_resolution_ns;
+    uint32_t flags;
+} tsn_rec_hdr_t;
+
+// Record for a received frame; th is its test header or NULL
+static inline void tsn_rec_make(tsn_rec_t *r, uint64_t ts_ns, int pcp, int vid, uint32_t len,
+                                const tsn_test_hdr_t *th) {
+    int64_t lat = th ? (int64_t)(ts_ns - th->tx_ns) : 0;
+    if (lat > INT32_MAX) lat = INT32_MAX;
+    if (lat < INT32_MIN) lat = INT32_MIN;
+    *r = (tsn_rec_t){
+        .ts_ns = ts_ns,
+        .seq = th ? th->seq : 0,
+        .lat_ns = (int32_t)lat,
+        .len = len > UINT16_MAX ? UINT16_MAX : len,
+        .vid = vid,
+        .pcp = pcp,
+        .flags = th ? TSN_REC_F_SEQ : 0
+    };
+}
+
+typedef struct tsn_rec_out tsn_rec_out_t;
+
+// Per-thread staging buffer
+typedef struct {
+    tsn_rec_out_t *out;
+    uint32_t n;
+    uint64_t first_ts_ns;  // oldest buffered record
+    tsn_rec_t recs[TSN_REC_BUF];
+} tsn_rec_buf_t;
+
+// Create path ("-" = stdout) and write the header. Returns NULL and fills
+// errbuf (256 bytes) on failure
+tsn_rec_out_t *tsn_rec_create(const char *path, uint32_t ts_resolution_ns, uint32_t flags,
+                              char *errbuf);
+
+// Append the buffered records; returns 0 or -1
+int tsn_rec_flush(tsn_rec_buf_t *b);
+
+// Records written so far (across all buffers)
+uint64_t tsn_rec_written(const tsn_rec_out_t *out);
+
+// Flushes nothing; flush every buffer first. Returns 0 or -1 (write error)
+int tsn_rec_close(tsn_rec_out_t *out);
+
+static inline void tsn_rec_buf_init(tsn_rec_buf_t *b, tsn_rec_out_t *out) {
+    b->out = out;
+    b->n = 0;
+}
+
+// Stage a record; a full buffer, or one holding records older than
+// max_age_ns (0 = no limit), is written out
+static inline void tsn_rec_put(tsn_rec_buf_t *b, const tsn_rec_t *r, uint64_t max_age_ns) {
+    if (b->n == 0) b->first_ts_ns = r->ts_ns;
+    b->recs[b->n++] = *r;
+    if (b->n == TSN_REC_BUF || (max_age_ns && r->ts_ns - b->first_ts_ns >= max_age_ns)) {
+        tsn_rec_flush(b);
+    }
+}
+
+// Read side: the whole file mapped read-only
+typedef struct {
+    tsn_rec_hdr_t hdr;
+    const tsn_rec_t *recs;
+    size_t n;
+    void *map;
+    size_t map_len;
+} tsn_rec_file_t;
+
+// Check a header; returns 0 or -1
+int tsn_rec_check_hdr(const void *buf, size_t len, tsn_rec_hdr_t *hdr);
+
+// Map a record file. Returns 0, or -1 and fills errbuf. A partial trailing
+// record (writer still running or killed) is ignored
+int tsn_rec_open(tsn_rec_file_t *f, const char *path, char *errbuf);
+
+void tsn_rec_close_file(tsn_rec_file_t *f);
+
+#endif
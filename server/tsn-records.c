@@ -0,0 +1,190 @@
+/*
+ * tsn-records.c - Dump and convert tsn-record capture files
+ *
+ * Modes:
+ *   text (default)  one line per record, the traffic-capture raw format plus
+ *                   sequence and latency
+ *   --csv           ts_ns,pcp,vid,len,seq,lat_ns (seq/lat empty if unknown)
+ *   --summary       per-TC packets, bytes, span and rate as one JSON object
+ *   --from CAPTURE  convert a pcap / pcapng file (VLAN-tagged frames only)
+ *
+ * Compile: make tsn-records (links libtsntest.a)
+ * Run: ./tsn-records [--csv|--summary] <file.tsnr>
+ *      ./tsn-records --from <capture.pcapng> [--vlan N] <out.tsnr>
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-capture.h"
+#include "tsn-record.h"
+
+#define MAX_TC TSN_MAX_TC
+
+typedef enum {
+    OUT_TEXT,
+    OUT_CSV,
+    OUT_SUMMARY
+} out_mode_t;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--csv|--summary] <file.tsnr>\n", prog);
+    fprintf(stderr, "       %s --from <capture.pcap|.pcapng> [--vlan N] <out.tsnr>\n", prog);
+    fprintf(stderr, "Example: %s --summary run.tsnr\n", prog);
+}
+
+static void print_summary(const tsn_rec_file_t *f) {
+    uint64_t count[MAX_TC] = { 0 }, bytes[MAX_TC] = { 0 };
+    uint64_t first[MAX_TC], last[MAX_TC] = { 0 };
+    for (int t = 0; t < MAX_TC; t++) first[t] = UINT64_MAX;
+
+    for (size_t i = 0; i < f->n; i++) {
+        const tsn_rec_t *r = &f->recs[i];
+        int t = r->pcp & 0x07;
+        count[t]++;
+        bytes[t] += r->len;
+        if (r->ts_ns < first[t]) first[t] = r->ts_ns;
+        if (r->ts_ns > last[t]) last[t] = r->ts_ns;
+    }
+
+    printf("{\"records\":%zu,\"ts_resolution_ns\":%u,\"hw_timestamps\":%s,\"tc\":{",
+           f->n, f->hdr.ts_resolution_ns, f->hdr.flags & TSN_REC_F_HWTS ? "true" : "false");
+    int first_tc = 1;
+    for (int t = 0; t < MAX_TC; t++) {
+        if (count[t] == 0) continue;
+        double span_ms = (last[t] - first[t]) / 1e6;
+        double kbps = last[t] > first[t] ? bytes[t] * 8.0 * 1e6 / (last[t] - first[t]) : 0;
+        printf("%s\"%d\":{\"packets\":%lu,\"bytes\":%lu,\"span_ms\":%.3f,\"kbps\":%.1f}",
+               first_tc ? "" : ",", t, count[t], bytes[t], span_ms, kbps);
+        first_tc = 0;
+    }
+    printf("}}\n");
+}
+
+static int dump(const char *path, out_mode_t mode) {
+    char errbuf[256];
+    tsn_rec_file_t f;
+    if (tsn_rec_open(&f, path, errbuf) < 0) {
+        fprintf(stderr, "Error: %s\n", errbuf);
+        return 1;
+    }
+
+    if (mode == OUT_SUMMARY) {
+        print_summary(&f);
+        tsn_rec_close_file(&f);
+        return 0;
+    }
+
+    if (mode == OUT_CSV) printf("ts_ns,pcp,vid,len,seq,lat_ns\n");
+    for (size_t i = 0; i < f.n; i++) {
+        const tsn_rec_t *r = &f.recs[i];
+        int has_seq = r->flags & TSN_REC_F_SEQ;
+        if (mode == OUT_CSV) {
+            if (has_seq) {
+                printf("%lu,%u,%u,%u,%u,%d\n", r->ts_ns, r->pcp, r->vid, r->len, r->seq, r->lat_ns);
+            } else {
+                printf("%lu,%u,%u,%u,,\n", r->ts_ns, r->pcp, r->vid, r->len);
+            }
+        } else {
+            printf("%lu.%09lu TC%u VID%u len=%u",
+                   r->ts_ns / 1000000000, r->ts_ns % 1000000000, r->pcp, r->vid, r->len);
+            if (has_seq) printf(" seq=%u lat_us=%.3f", r->seq, r->lat_ns / 1000.0);
+            printf("\n");
+        }
+    }
+    tsn_rec_close_file(&f);
+    return 0;
+}
+
+// Handler state for --from
+typedef struct {
+    tsn_rec_buf_t buf;
+    int vlan;
+    uint64_t skipped;  // untagged or other VLAN
+} convert_t;
+
+static void convert_handler(void *user, const tsn_packet_t *p) {
+    convert_t *c = user;
+    tsn_vlan_t vlan;
+    if (tsn_parse_vlan(p->data, p->caplen, &vlan) < 0 || (c->vlan > 0 && vlan.vid != c->vlan)) {
+        c->skipped++;
+        return;
+    }
+
+    tsn_test_hdr_t th;
+    int has_seq = tsn_test_hdr_parse(p->data, p->caplen, &th) == 0;
+    tsn_rec_t r;
+    tsn_rec_make(&r, p->ts_ns, vlan.pcp, vlan.vid, p->len, has_seq ? &th : NULL);
+    tsn_rec_put(&c->buf, &r, 0);
+}
+
+static int convert(const char *in, const char *out, int vlan) {
+    char errbuf[256];
+    tsn_capture_t *cap = tsn_capture_open_file(in, errbuf);
+    if (!cap) {
+        fprintf(stderr, "Error: %s\n", errbuf);
+        return 1;
+    }
+    tsn_rec_out_t *rec = tsn_rec_create(out, tsn_capture_ts_resolution_ns(cap), 0, errbuf);
+    convert_t *c = calloc(1, sizeof(*c));
+    if (!rec || !c) {
+        fprintf(stderr, "Error: %s\n", rec ? "out of memory" : errbuf);
+        tsn_rec_close(rec);
+        tsn_capture_close(cap);
+        free(c);
+        return 1;
+    }
+    tsn_rec_buf_init(&c->buf, rec);
+    c->vlan = vlan;
+
+    int rc = 0;
+    while (!tsn_capture_eof(cap)) {
+        if (tsn_capture_dispatch(cap, convert_handler, c) < 0) {
+            rc = 1;
+            break;
+        }
+    }
+    tsn_rec_flush(&c->buf);
+
+    fprintf(stderr, "%s (%s): %lu records, %lu frames skipped\n",
+            in, tsn_capture_backend_name(cap), tsn_rec_written(rec), c->skipped);
+    if (tsn_rec_close(rec) < 0) rc = 1;
+    tsn_capture_close(cap);
+    free(c);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    out_mode_t mode = OUT_TEXT;
+    const char *from = NULL;
+    const char *path = NULL;
+    int vlan = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            mode = OUT_CSV;
+        } else if (strcmp(argv[i], "--summary") == 0) {
+            mode = OUT_SUMMARY;
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            from = argv[++i];
+        } else if (strcmp(argv[i], "--vlan") == 0 && i + 1 < argc) {
+            vlan = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+    return from ? convert(from, path, vlan) : dump(path, mode);
+}
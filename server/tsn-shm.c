@@ -0,0 +1,98 @@
+/*
+ * tsn-shm.c - Live stats block in POSIX shared memory (libtsntest)
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "tsn-shm.h"
+
+_Static_assert(sizeof(tsn_shm_tc_t) == 27 * 8, "tsn_shm_tc_t is read by offset");
+_Static_assert(sizeof(tsn_shm_stats_t) == 192 + TSN_MAX_TC * 27 * 8 + 8,
+               "tsn_shm_stats_t is read by offset");
+
+tsn_shm_stats_t *tsn_shm_create(const char *name, const char *source, char *errbuf) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    // Readable by the (unprivileged) web server, written by the root tool
+    int fd = shm_open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        snprintf(errbuf, 256, "shm_open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(tsn_shm_stats_t)) < 0) {
+        snprintf(errbuf, 256, "ftruncate %s: %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    tsn_shm_stats_t *s = mmap(NULL, sizeof(*s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s == MAP_FAILED) {
+        snprintf(errbuf, 256, "mmap %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    // A previous writer's block keeps its sequence going, so a reader
+    // polling across the restart sees the reset as one more update
+    tsn_shm_begin(s);
+    memset(&s->flags, 0, offsetof(tsn_shm_stats_t, seq_end) - offsetof(tsn_shm_stats_t, flags));
+    s->magic = TSN_SHM_MAGIC;
+    s->version = TSN_SHM_VERSION;
+    s->tc_size = sizeof(tsn_shm_tc_t);
+    s->pid = getpid();
+    snprintf(s->source, sizeof(s->source), "%s", source);
+    __atomic_store_n(&s->seq, s->seq_end, __ATOMIC_RELEASE);
+    return s;
+}
+
+void tsn_shm_close(tsn_shm_stats_t *s) {
+    if (!s) return;
+    tsn_shm_begin(s);
+    s->flags |= TSN_SHM_F_FINAL;
+    tsn_shm_end(s);
+    munmap(s, sizeof(*s));
+}
+
+void tsn_shm_put_stream(tsn_shm_tc_t *t, const tsn_stream_t *s) {
+    t->count = s->count;
+    t->bytes = s->total_bytes;
+    t->first_ts_ns = s->first_ts;
+    t->last_ts_ns = s->last_ts;
+    t->kbps = s->last_ts > s->first_ts ? s->total_bytes * 8.0 * 1e6 / (s->last_ts - s->first_ts) : 0;
+    t->avg_interval_us = s->interval.mean / 1000.0;
+    t->min_interval_us = s->interval_hist.count ? s->interval_hist.min / 1000.0 : 0;
+    t->max_interval_us = s->interval_hist.max / 1000.0;
+    tsn_hist_pctl(&s->interval_hist, &t->interval);
+}
+
+void tsn_shm_put_seq(tsn_shm_tc_t *t, const tsn_seq_t *q) {
+    tsn_seq_stats_t st;
+    tsn_seq_stats(q, &st);
+    t->lost = st.lost;
+    t->dup = st.duplicates;
+    t->reorder = st.reordered;
+    t->lat_avg_us = st.lat_avg_us;
+    t->lat = st.lat;
+}
+
+void tsn_shm_put_instr(tsn_shm_stats_t *s, const tsn_instr_t *in) {
+    s->rx_kernel_drops = in->rx_kernel_drops;
+    s->rx_if_drops = in->rx_if_drops;
+    s->rx_ring_freezes = in->rx_ring_freezes;
+    s->truncated = in->truncated;
+    s->tx_eagain = in->tx_eagain;
+    s->tx_enobufs = in->tx_enobufs;
+    s->tx_errors = in->tx_errors;
+    s->tx_dropped = in->tx_dropped;
+    s->tx_late = in->tx_late;
+    s->txtime_dropped = in->txtime_dropped;
+    s->rx_ns_per_frame = tsn_stage_ns(&in->stage[TSN_STAGE_RX]);
+    s->handler_ns_per_frame = tsn_stage_ns(&in->stage[TSN_STAGE_HANDLER]);
+    s->tx_ns_per_frame = tsn_stage_ns(&in->stage[TSN_STAGE_TX]);
+}
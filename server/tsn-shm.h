@@ -0,0 +1,120 @@
+/*
+ * tsn-shm.h - Live stats block in POSIX shared memory (libtsntest)
+ *
+ * A tool started with --shm NAME keeps /dev/shm/NAME up to date with its
+ * per-TC counters, histogram percentiles and estimates, so a dashboard can
+ * poll it at 50-100 Hz without a pipe, JSON or any work in the capture path.
+ *
+ * Layout: fixed, little-endian, every field 8 bytes wide from offset 40 on
+ * (see tsn_shm_stats_t); lib/tsn-stats-shm.js decodes it by offset. Fields a
+ * tool does not measure stay 0.
+ *
+ * Consistency: one writer; seq at the start of the block and seq_end at the
+ * very end. The writer bumps seq_end, updates the data, then sets seq to the
+ * same value, so a reader that loads seq first and seq_end last (a single
+ * front-to-back copy or read(2) of the block does) has a consistent snapshot
+ * iff both are equal; otherwise it retries.
+ */
+
+#ifndef TSN_SHM_H
+#define TSN_SHM_H
+
+#include <stdint.h>
+
+#include "tsn-common.h"
+#include "tsn-analysis.h"
+#include "tsn-instr.h"
+
+#define TSN_SHM_MAGIC 0x534E5354   // "TSNS"
+#define TSN_SHM_VERSION 2
+
+#define TSN_SHM_F_FINAL 0x1        // writer finished, values are final
+
+typedef struct {
+    // Counters
+    uint64_t count;
+    uint64_t bytes;            // wire length
+    uint64_t first_ts_ns;
+    uint64_t last_ts_ns;
+    double kbps;               // bytes over first..last timestamp
+    double avg_interval_us;
+    double min_interval_us;
+    double max_interval_us;
+    tsn_pctl_t interval;       // inter-arrival percentiles
+    // Test header sequence / one-way latency
+    uint64_t lost;
+    uint64_t dup;
+    uint64_t reorder;
+    double lat_avg_us;
+    tsn_pctl_t lat;
+    // Estimates
+    double idle_slope_kbps;    // cbs-estimator
+    double hi_credit_bytes;
+    uint64_t shaped;           // 1 = CBS shaping detected
+    double window_start_us;    // tas-estimator: first gate window in the cycle
+    double window_us;
+} tsn_shm_tc_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t tc_size;          // sizeof(tsn_shm_tc_t)
+    uint32_t seq;
+    uint32_t flags;            // TSN_SHM_F_*
+    uint32_t pid;              // writer
+    uint32_t reserved;
+    char source[16];           // writing tool, NUL-terminated
+    uint64_t update_ns;        // CLOCK_REALTIME of the last update
+    uint64_t updates;
+    double elapsed_ms;
+    uint64_t total;            // packets, all TCs
+    double cycle_us;           // tas-estimator: estimated GCL cycle
+    double cycle_confidence;
+    // Instrumentation (tsn-instr.h)
+    uint64_t rx_kernel_drops;
+    uint64_t rx_if_drops;
+    uint64_t rx_ring_freezes;
+    uint64_t truncated;
+    uint64_t tx_eagain;
+    uint64_t tx_enobufs;
+    uint64_t tx_errors;
+    uint64_t tx_dropped;
+    uint64_t tx_late;
+    uint64_t txtime_dropped;
+    double rx_ns_per_frame;
+    double handler_ns_per_frame;
+    double tx_ns_per_frame;
+    tsn_shm_tc_t tc[TSN_MAX_TC];
+    uint32_t seq_end;
+    uint32_t reserved2;
+} tsn_shm_stats_t;
+
+// Create (or take over) /dev/shm/<name> ("/" prefix optional) and map it.
+// Returns NULL and fills errbuf (256 bytes) on failure
+tsn_shm_stats_t *tsn_shm_create(const char *name, const char *source, char *errbuf);
+
+// Unmap; the block stays behind (marked final) for readers to pick up
+void tsn_shm_close(tsn_shm_stats_t *s);
+
+// Counters and inter-arrival percentiles of a stream
+void tsn_shm_put_stream(tsn_shm_tc_t *t, const tsn_stream_t *s);
+
+// Loss and latency
+void tsn_shm_put_seq(tsn_shm_tc_t *t, const tsn_seq_t *q);
+
+// Drop / overflow counters and stage costs
+void tsn_shm_put_instr(tsn_shm_stats_t *s, const tsn_instr_t *in);
+
+// Write side, single writer: begin, fill the fields, end
+static inline void tsn_shm_begin(tsn_shm_stats_t *s) {
+    __atomic_store_n(&s->seq_end, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void tsn_shm_end(tsn_shm_stats_t *s) {
+    s->update_ns = tsn_realtime_ns();
+    s->updates++;
+    __atomic_store_n(&s->seq, s->seq_end, __ATOMIC_RELEASE);
+}
+
+#endif
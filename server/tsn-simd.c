@@ -0,0 +1,241 @@
+/*
+ * tsn-simd.c - Vector kernels for the post-capture analysis (libtsntest)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNELS 1
+#endif
+
+#include "tsn-simd.h"
+
+#define FOLD_CHUNK 256
+#define FOLD_COPIES 4       // interleaved histograms for the scatter
+#define FOLD_COPY_BINS 1024 // larger histograms are counted in one copy
+
+// Count idx[0..m) into bins. A gated TC puts most arrivals into a few bins,
+// so consecutive increments would wait on each other's store; FOLD_COPIES
+// copies (summed at the end) keep them independent.
+static void fold_scatter(const int32_t *idx, uint32_t m, uint32_t (*copies)[FOLD_COPY_BINS],
+                         uint32_t *bins, int n_bins) {
+    if (n_bins > FOLD_COPY_BINS) {
+        for (uint32_t j = 0; j < m; j++) bins[idx[j]]++;
+        return;
+    }
+    uint32_t j = 0;
+    for (; j + FOLD_COPIES <= m; j += FOLD_COPIES) {
+        copies[0][idx[j]]++;
+        copies[1][idx[j + 1]]++;
+        copies[2][idx[j + 2]]++;
+        copies[3][idx[j + 3]]++;
+    }
+    for (; j < m; j++) copies[0][idx[j]]++;
+}
+
+static void fold_sum(uint32_t (*copies)[FOLD_COPY_BINS], uint32_t *bins, int n_bins) {
+    if (n_bins > FOLD_COPY_BINS) return;
+    for (int b = 0; b < n_bins; b++) {
+        bins[b] = copies[0][b] + copies[1][b] + copies[2][b] + copies[3][b];
+    }
+}
+
+// Phase and bin of one arrival, the reference for the vector versions
+static inline int32_t fold_bin(uint32_t t, double inv, int n_bins, int32_t top) {
+    double x = t * inv;
+    x -= (double)(int32_t)x;  // < 2^31 cycles: t < 2^32 ns, period > 2 ns
+    int32_t b = (int32_t)(x * n_bins);
+    return b < top ? b : top;
+}
+
+static void fold_scalar(const uint32_t *t, uint32_t n, double period, int n_bins, uint32_t *bins) {
+    static __thread uint32_t copies[FOLD_COPIES][FOLD_COPY_BINS];
+    const double inv = 1.0 / period;
+    const int32_t top = n_bins - 1;
+    int32_t idx[FOLD_CHUNK];
+
+    memset(bins, 0, n_bins * sizeof(uint32_t));
+    if (n_bins <= FOLD_COPY_BINS) memset(copies, 0, sizeof(copies));
+    for (uint32_t i = 0; i < n; i += FOLD_CHUNK) {
+        uint32_t m = n - i < FOLD_CHUNK ? n - i : FOLD_CHUNK;
+        for (uint32_t j = 0; j < m; j++) idx[j] = fold_bin(t[i + j], inv, n_bins, top);
+        fold_scatter(idx, m, copies, bins, n_bins);
+    }
+    fold_sum(copies, bins, n_bins);
+}
+
+static void fft_stage_scalar(float *re, float *im, uint32_t n, uint32_t half,
+                             const float *wr, const float *wi) {
+    for (uint32_t i = 0; i < n; i += 2 * half) {
+        for (uint32_t j = 0; j < half; j++) {
+            uint32_t u = i + j, v = u + half;
+            float tr = re[v] * wr[j] - im[v] * wi[j];
+            float ti = re[v] * wi[j] + im[v] * wr[j];
+            re[v] = re[u] - tr;
+            im[v] = im[u] - ti;
+            re[u] += tr;
+            im[u] += ti;
+        }
+    }
+}
+
+#ifdef HAVE_AVX2_KERNELS
+// Four arrivals per step in double precision, as in fold_bin
+__attribute__((target("avx2")))
+static void fold_avx2(const uint32_t *t, uint32_t n, double period, int n_bins, uint32_t *bins) {
+    static __thread uint32_t copies[FOLD_COPIES][FOLD_COPY_BINS];
+    const double inv_s = 1.0 / period;
+    const __m256d inv = _mm256_set1_pd(inv_s);
+    const __m256d nb = _mm256_set1_pd((double)n_bins);
+    const __m256d two31 = _mm256_set1_pd(2147483648.0);
+    const __m128i sign = _mm_set1_epi32(INT32_MIN);
+    const __m128i top = _mm_set1_epi32(n_bins - 1);
+    int32_t idx[FOLD_CHUNK];
+
+    memset(bins, 0, n_bins * sizeof(uint32_t));
+    if (n_bins <= FOLD_COPY_BINS) memset(copies, 0, sizeof(copies));
+    for (uint32_t i = 0; i < n; i += FOLD_CHUNK) {
+        uint32_t m = n - i < FOLD_CHUNK ? n - i : FOLD_CHUNK;
+        const uint32_t *c = t + i;
+        uint32_t j = 0;
+        for (; j + 4 <= m; j += 4) {
+            // uint32 to double: flip the sign bit, convert as int32, add 2^31
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(c + j)), sign);
+            __m256d x = _mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(v), two31), inv);
+            x = _mm256_sub_pd(x, _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+            __m128i b = _mm256_cvttpd_epi32(_mm256_mul_pd(x, nb));
+            _mm_storeu_si128((__m128i *)(idx + j), _mm_min_epi32(b, top));
+        }
+        for (; j < m; j++) idx[j] = fold_bin(c[j], inv_s, n_bins, n_bins - 1);
+        fold_scatter(idx, m, copies, bins, n_bins);
+    }
+    fold_sum(copies, bins, n_bins);
+}
+
+__attribute__((target("avx2")))
+static void fft_stage_avx2(float *re, float *im, uint32_t n, uint32_t half,
+                           const float *wr, const float *wi) {
+    if (half < 8) {
+        fft_stage_scalar(re, im, n, half, wr, wi);
+        return;
+    }
+    for (uint32_t i = 0; i < n; i += 2 * half) {
+        float *ur = re + i, *ui = im + i, *vr = ur + half, *vi = ui + half;
+        for (uint32_t j = 0; j < half; j += 8) {
+            __m256 w_r = _mm256_loadu_ps(wr + j), w_i = _mm256_loadu_ps(wi + j);
+            __m256 x_r = _mm256_loadu_ps(vr + j), x_i = _mm256_loadu_ps(vi + j);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(x_r, w_r), _mm256_mul_ps(x_i, w_i));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(x_r, w_i), _mm256_mul_ps(x_i, w_r));
+            __m256 a_r = _mm256_loadu_ps(ur + j), a_i = _mm256_loadu_ps(ui + j);
+            _mm256_storeu_ps(vr + j, _mm256_sub_ps(a_r, tr));
+            _mm256_storeu_ps(vi + j, _mm256_sub_ps(a_i, ti));
+            _mm256_storeu_ps(ur + j, _mm256_add_ps(a_r, tr));
+            _mm256_storeu_ps(ui + j, _mm256_add_ps(a_i, ti));
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+static void fold_neon(const uint32_t *t, uint32_t n, double period, int n_bins, uint32_t *bins) {
+    static __thread uint32_t copies[FOLD_COPIES][FOLD_COPY_BINS];
+    const double inv_s = 1.0 / period;
+    const float64x2_t inv = vdupq_n_f64(inv_s);
+    const float64x2_t nb = vdupq_n_f64((double)n_bins);
+    const int32x4_t top = vdupq_n_s32(n_bins - 1);
+    int32_t idx[FOLD_CHUNK];
+
+    memset(bins, 0, n_bins * sizeof(uint32_t));
+    if (n_bins <= FOLD_COPY_BINS) memset(copies, 0, sizeof(copies));
+    for (uint32_t i = 0; i < n; i += FOLD_CHUNK) {
+        uint32_t m = n - i < FOLD_CHUNK ? n - i : FOLD_CHUNK;
+        const uint32_t *c = t + i;
+        uint32_t j = 0;
+        for (; j + 4 <= m; j += 4) {
+            uint32x4_t v = vld1q_u32(c + j);
+            float64x2_t lo = vmulq_f64(vcvtq_f64_u64(vmovl_u32(vget_low_u32(v))), inv);
+            float64x2_t hi = vmulq_f64(vcvtq_f64_u64(vmovl_u32(vget_high_u32(v))), inv);
+            lo = vmulq_f64(vsubq_f64(lo, vrndq_f64(lo)), nb);
+            hi = vmulq_f64(vsubq_f64(hi, vrndq_f64(hi)), nb);
+            int32x4_t b = vcombine_s32(vmovn_s64(vcvtq_s64_f64(lo)), vmovn_s64(vcvtq_s64_f64(hi)));
+            vst1q_s32(idx + j, vminq_s32(b, top));
+        }
+        for (; j < m; j++) idx[j] = fold_bin(c[j], inv_s, n_bins, n_bins - 1);
+        fold_scatter(idx, m, copies, bins, n_bins);
+    }
+    fold_sum(copies, bins, n_bins);
+}
+
+static void fft_stage_neon(float *re, float *im, uint32_t n, uint32_t half,
+                           const float *wr, const float *wi) {
+    if (half < 4) {
+        fft_stage_scalar(re, im, n, half, wr, wi);
+        return;
+    }
+    for (uint32_t i = 0; i < n; i += 2 * half) {
+        float *ur = re + i, *ui = im + i, *vr = ur + half, *vi = ui + half;
+        for (uint32_t j = 0; j < half; j += 4) {
+            float32x4_t w_r = vld1q_f32(wr + j), w_i = vld1q_f32(wi + j);
+            float32x4_t x_r = vld1q_f32(vr + j), x_i = vld1q_f32(vi + j);
+            float32x4_t tr = vsubq_f32(vmulq_f32(x_r, w_r), vmulq_f32(x_i, w_i));
+            float32x4_t ti = vaddq_f32(vmulq_f32(x_r, w_i), vmulq_f32(x_i, w_r));
+            float32x4_t a_r = vld1q_f32(ur + j), a_i = vld1q_f32(ui + j);
+            vst1q_f32(vr + j, vsubq_f32(a_r, tr));
+            vst1q_f32(vi + j, vsubq_f32(a_i, ti));
+            vst1q_f32(ur + j, vaddq_f32(a_r, tr));
+            vst1q_f32(ui + j, vaddq_f32(a_i, ti));
+        }
+    }
+}
+#endif
+
+static struct {
+    const char *name;
+    void (*fold)(const uint32_t *, uint32_t, double, int, uint32_t *);
+    void (*fft_stage)(float *, float *, uint32_t, uint32_t, const float *, const float *);
+} impl = { "scalar", fold_scalar, fft_stage_scalar };
+
+static pthread_once_t impl_once = PTHREAD_ONCE_INIT;
+
+static void impl_select(void) {
+    const char *want = getenv("TSN_SIMD");
+    if (want && strcmp(want, "auto") != 0 && strcmp(want, "avx2") != 0 &&
+        strcmp(want, "neon") != 0) return;
+
+#ifdef HAVE_AVX2_KERNELS
+    if ((!want || strcmp(want, "neon") != 0) && __builtin_cpu_supports("avx2")) {
+        impl.name = "avx2";
+        impl.fold = fold_avx2;
+        impl.fft_stage = fft_stage_avx2;
+    }
+#endif
+#ifdef HAVE_NEON_KERNELS
+    if (!want || strcmp(want, "avx2") != 0) {
+        impl.name = "neon";
+        impl.fold = fold_neon;
+        impl.fft_stage = fft_stage_neon;
+    }
+#endif
+}
+
+const char *tsn_simd_name(void) {
+    pthread_once(&impl_once, impl_select);
+    return impl.name;
+}
+
+void tsn_simd_fold(const uint32_t *t, uint32_t n, double period, int n_bins, uint32_t *bins) {
+    pthread_once(&impl_once, impl_select);
+    impl.fold(t, n, period, n_bins, bins);
+}
+
+void tsn_simd_fft_stage(float *re, float *im, uint32_t n, uint32_t half,
+                        const float *wr, const float *wi) {
+    pthread_once(&impl_once, impl_select);
+    impl.fft_stage(re, im, n, half, wr, wi);
+}
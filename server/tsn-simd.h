@@ -0,0 +1,36 @@
+/*
+ * tsn-simd.h - Vector kernels for the post-capture analysis (libtsntest)
+ *
+ * What is left after a multi-million-packet run is the TAS cycle search
+ * (tsn-cycle.h) over the arrival samples, which are already kept as plain
+ * uint32 arrays: a few large FFTs over split re/im arrays and hundreds of
+ * epoch folds. Both inner loops live here in three versions:
+ *   avx2   - x86-64, picked at run time when the CPU has it
+ *   neon   - aarch64
+ *   scalar - everything else, and the reference
+ * No FMA is used, so the vector folds give the same bins as the scalar one.
+ *
+ * Selection: TSN_SIMD=auto|avx2|neon|scalar (default auto: best available;
+ * an unavailable choice falls back to scalar)
+ */
+
+#ifndef TSN_SIMD_H
+#define TSN_SIMD_H
+
+#include <stdint.h>
+
+// "avx2", "neon" or "scalar"
+const char *tsn_simd_name(void);
+
+// Phase histogram of t[0..n) folded at period (> 2 ns, t < 2^32): bin of t is
+// (int)(frac(t * (1 / period)) * n_bins), clamped to n_bins - 1. bins is
+// cleared first.
+void tsn_simd_fold(const uint32_t *t, uint32_t n, double period, int n_bins, uint32_t *bins);
+
+// One radix-2 FFT stage over re/im[0..n): for every block of 2*half and
+// j < half, with u = block + j, v = u + half and w = (wr[j], wi[j]):
+//   t = w * x[v];  x[v] = x[u] - t;  x[u] = x[u] + t
+void tsn_simd_fft_stage(float *re, float *im, uint32_t n, uint32_t half,
+                        const float *wr, const float *wi);
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ * tsn-tx.c - send / sendmmsg / PACKET_TX_RING TX engines with SO_TXTIME (libtsntest)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+
+#include "tsn-tx.h"
+
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
+
+// PACKET_TX_RING geometry (TPACKET_V2): 64 KB blocks of 2 KB frames
+#define RING_FRAME_SIZE 2048
+#define RING_BLOCK_SIZE (1 << 16)
+#define RING_BLOCK_NR 32
+#define RING_FRAME_NR ((RING_BLOCK_SIZE / RING_FRAME_SIZE) * RING_BLOCK_NR)
+
+// Drain the ETF error queue this often (frames)
+#define TXTIME_ERR_POLL 1024
+
+static const char *engine_names[] = { "send", "mmsg", "ring" };
+
+struct tsn_tx {
+    int fd;
+    tsn_tx_engine_t engine;
+    int batch;
+    bool txtime;
+    tsn_txtime_t sched;
+    tsn_tx_stats_t stats;
+    tsn_instr_t instr;       // send failures and the tx stage
+    uint64_t queued;
+    uint64_t tai_offset_ns;  // CLOCK_TAI - CLOCK_REALTIME, for launch-time stamps
+
+    // sendmmsg batch; frames are copied so each keeps its own timestamp
+    int pending;
+    struct mmsghdr hdrs[TSN_TX_MAX_BATCH];
+    struct iovec iovs[TSN_TX_MAX_BATCH];
+    int tcs[TSN_TX_MAX_BATCH];
+    unsigned char ctrl[TSN_TX_MAX_BATCH][CMSG_SPACE(sizeof(uint64_t))];
+    uint8_t bufs[TSN_TX_MAX_BATCH][TSN_MAX_FRAME_SIZE];
+
+    // PACKET_TX_RING
+    uint8_t *ring;
+    size_t ring_len;
+    unsigned int ring_head;
+    int ring_slot_tc[RING_FRAME_NR];  // TC queued in slot, -1 = free/accounted
+};
+
+void tsn_tx_opts_init(tsn_tx_opts_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->engine = TSN_TX_SEND;
+    opts->batch = TSN_TX_DEFAULT_BATCH;
+    opts->so_priority = -1;
+    opts->txtime = false;
+    opts->schedule.lead_ns = 500000;
+}
+
+// Account one frame that has left the socket
+static inline void account_tx(tsn_tx_t *tx, int tc, uint64_t bytes) {
+    tx->stats.packets[tc]++;
+    tx->stats.bytes[tc] += bytes;
+    tx->stats.total++;
+}
+
+// Count a failed send by errno; frames are lost with it
+static void send_failed(tsn_tx_t *tx, uint64_t frames) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) tx->instr.tx_eagain++;
+    else if (errno == ENOBUFS) tx->instr.tx_enobufs++;
+    else tx->instr.tx_errors++;
+    tx->instr.tx_dropped += frames;
+}
+
+// Enable SO_TXTIME and place base-time at the first cycle start far enough ahead
+static int txtime_setup(tsn_tx_t *tx) {
+    struct sock_txtime cfg = {
+        .clockid = CLOCK_TAI,
+        .flags = SOF_TXTIME_REPORT_ERRORS
+    };
+    if (setsockopt(tx->fd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) < 0) {
+        perror("setsockopt SO_TXTIME");
+        return -1;
+    }
+
+    tsn_txtime_t *t = &tx->sched;
+    if (t->interval_ns == 0) t->interval_ns = 1;
+    uint64_t earliest = tsn_tai_ns() + 2 * t->lead_ns;
+    t->per_cycle = 1;
+
+    if (t->cycle_ns > 0) {
+        t->offset_ns %= t->cycle_ns;
+        if (t->window_ns == 0 || t->offset_ns + t->window_ns > t->cycle_ns) {
+            t->window_ns = t->cycle_ns - t->offset_ns;
+        }
+        t->per_cycle = t->window_ns / t->interval_ns;
+        if (t->per_cycle == 0) t->per_cycle = 1;
+
+        if (t->base_ns < earliest) {
+            uint64_t cycles = (earliest - t->base_ns + t->cycle_ns - 1) / t->cycle_ns;
+            t->base_ns += cycles * t->cycle_ns;
+        }
+    } else if (t->base_ns < earliest) {
+        t->base_ns = earliest;
+    }
+
+    tx->tai_offset_ns = tsn_tai_ns() - tsn_realtime_ns();
+
+    for (int i = 0; i < TSN_TX_MAX_BATCH; i++) {
+        struct msghdr *msg = &tx->hdrs[i].msg_hdr;
+        msg->msg_control = tx->ctrl[i];
+        msg->msg_controllen = sizeof(tx->ctrl[i]);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_TXTIME;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+    }
+    return 0;
+}
+
+static inline void txtime_tag(tsn_tx_t *tx, int slot, uint64_t launch_ns) {
+    memcpy(CMSG_DATA(CMSG_FIRSTHDR(&tx->hdrs[slot].msg_hdr)), &launch_ns, sizeof(launch_ns));
+}
+
+// Count frames the ETF qdisc dropped for a missed or invalid launch time
+static void txtime_drain_errors(tsn_tx_t *tx) {
+    unsigned char ctrl[256];
+    unsigned char data[TSN_MAX_FRAME_SIZE];
+    struct iovec iov = { .iov_base = data, .iov_len = sizeof(data) };
+
+    for (;;) {
+        struct msghdr msg = {
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = ctrl, .msg_controllen = sizeof(ctrl)
+        };
+        if (recvmsg(tx->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err *ee = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (ee->ee_origin == SO_EE_ORIGIN_TXTIME) tx->stats.txtime_dropped++;
+        }
+    }
+}
+
+static inline struct tpacket2_hdr *ring_slot(tsn_tx_t *tx, unsigned int idx) {
+    return (struct tpacket2_hdr *)(tx->ring + (size_t)idx * RING_FRAME_SIZE);
+}
+
+// Map a TPACKET_V2 TX ring on the socket
+static int ring_setup(tsn_tx_t *tx) {
+    int version = TPACKET_V2;
+    if (setsockopt(tx->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        perror("setsockopt PACKET_VERSION");
+        return -1;
+    }
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = RING_BLOCK_SIZE;
+    req.tp_block_nr = RING_BLOCK_NR;
+    req.tp_frame_size = RING_FRAME_SIZE;
+    req.tp_frame_nr = RING_FRAME_NR;
+    if (setsockopt(tx->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+        perror("setsockopt PACKET_TX_RING");
+        return -1;
+    }
+
+    tx->ring_len = (size_t)req.tp_block_size * req.tp_block_nr;
+    tx->ring = mmap(NULL, tx->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, tx->fd, 0);
+    if (tx->ring == MAP_FAILED) {
+        perror("mmap PACKET_TX_RING");
+        tx->ring = NULL;
+        return -1;
+    }
+
+    for (int i = 0; i < RING_FRAME_NR; i++) tx->ring_slot_tc[i] = -1;
+    tx->ring_head = 0;
+    return 0;
+}
+
+// Credit a slot the kernel has finished with; returns 0 if the slot is still in flight
+static int ring_reclaim(tsn_tx_t *tx, unsigned int idx) {
+    struct tpacket2_hdr *hdr = ring_slot(tx, idx);
+    unsigned int status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+
+    if (status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)) return 0;
+
+    if (tx->ring_slot_tc[idx] >= 0) {
+        if (status == TP_STATUS_AVAILABLE) account_tx(tx, tx->ring_slot_tc[idx], hdr->tp_len);
+        else tx->instr.tx_dropped++;
+        tx->ring_slot_tc[idx] = -1;
+    }
+    if (status != TP_STATUS_AVAILABLE) {
+        // TP_STATUS_WRONG_FORMAT: drop the frame and give the slot back
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_AVAILABLE, __ATOMIC_RELEASE);
+    }
+    return 1;
+}
+
+// Copy a frame into the next free ring slot (kicks the kernel if the ring is full)
+static void ring_queue(tsn_tx_t *tx, const tsn_frame_t *f, int tc) {
+    unsigned int idx = tx->ring_head;
+
+    while (!ring_reclaim(tx, idx)) {
+        send(tx->fd, NULL, 0, MSG_DONTWAIT);
+        struct pollfd pfd = { .fd = tx->fd, .events = POLLOUT };
+        poll(&pfd, 1, 1);
+    }
+
+    struct tpacket2_hdr *hdr = ring_slot(tx, idx);
+    uint8_t *data = (uint8_t *)hdr + TPACKET_ALIGN(sizeof(struct tpacket2_hdr));
+    memcpy(data, f->data, f->len);
+    hdr->tp_len = f->len;
+    tx->ring_slot_tc[idx] = tc;
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+    tx->ring_head = (idx + 1) % RING_FRAME_NR;
+}
+
+// Ask the kernel to send the queued slots of a batch
+static void ring_kick(tsn_tx_t *tx) {
+    uint64_t t0 = tsn_instr_ticks();
+    if (send(tx->fd, NULL, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        send_failed(tx, 0);
+    }
+    tsn_stage_add(&tx->instr.stage[TSN_STAGE_TX], t0, tsn_instr_ticks(), tx->pending);
+    tx->pending = 0;
+}
+
+// Wait for every queued slot to complete and credit it
+static void ring_drain(tsn_tx_t *tx) {
+    send(tx->fd, NULL, 0, 0);
+    uint64_t deadline = tsn_time_ns() + 1000000000ULL;
+    for (unsigned int i = 0; i < RING_FRAME_NR; i++) {
+        while (!ring_reclaim(tx, i) && tsn_time_ns() < deadline) {
+            send(tx->fd, NULL, 0, MSG_DONTWAIT);
+        }
+    }
+}
+
+// Push the queued sendmmsg batch, retrying the tail after partial sends
+static void mmsg_flush(tsn_tx_t *tx) {
+    int off = 0;
+    while (off < tx->pending) {
+        uint64_t t0 = tsn_instr_ticks();
+        int sent = sendmmsg(tx->fd, tx->hdrs + off, tx->pending - off, 0);
+        if (sent <= 0) {
+            if (sent < 0) send_failed(tx, tx->pending - off);
+            break;
+        }
+        tsn_stage_add(&tx->instr.stage[TSN_STAGE_TX], t0, tsn_instr_ticks(), sent);
+        for (int i = 0; i < sent; i++) {
+            account_tx(tx, tx->tcs[off + i], tx->hdrs[off + i].msg_len);
+        }
+        off += sent;
+    }
+    tx->pending = 0;
+}
+
+tsn_tx_t *tsn_tx_open(const char *ifname, const tsn_tx_opts_t *opts) {
+    tsn_tx_t *tx = calloc(1, sizeof(*tx));
+    if (!tx) {
+        perror("calloc");
+        return NULL;
+    }
+
+    tx->engine = opts->engine;
+    tx->batch = opts->batch;
+    if (tx->batch < 1) tx->batch = 1;
+    if (tx->batch > TSN_TX_MAX_BATCH) tx->batch = TSN_TX_MAX_BATCH;
+    tx->txtime = opts->txtime;
+    tx->sched = opts->schedule;
+
+    tx->fd = tsn_raw_socket_open(ifname);
+    if (tx->fd < 0) {
+        free(tx);
+        return NULL;
+    }
+
+    if (opts->so_priority >= 0 &&
+        setsockopt(tx->fd, SOL_SOCKET, SO_PRIORITY, &opts->so_priority, sizeof(opts->so_priority)) < 0) {
+        perror("setsockopt SO_PRIORITY");
+    }
+
+    for (int i = 0; i < TSN_TX_MAX_BATCH; i++) {
+        tx->hdrs[i].msg_hdr.msg_iov = &tx->iovs[i];
+        tx->hdrs[i].msg_hdr.msg_iovlen = 1;
+        tx->iovs[i].iov_base = tx->bufs[i];
+    }
+
+    // A socket with a TX ring sends everything through it, launch times are lost
+    if (tx->txtime && tx->engine == TSN_TX_RING) {
+        fprintf(stderr, "PACKET_TX_RING cannot carry launch times, using sendmmsg\n");
+        tx->engine = TSN_TX_MMSG;
+    }
+    if (tx->txtime && txtime_setup(tx) < 0) {
+        close(tx->fd);
+        free(tx);
+        return NULL;
+    }
+    if (tx->engine == TSN_TX_RING && ring_setup(tx) < 0) {
+        fprintf(stderr, "PACKET_TX_RING unavailable, falling back to sendmmsg\n");
+        tx->engine = TSN_TX_MMSG;
+    }
+    if (tx->engine == TSN_TX_SEND) tx->batch = 1;
+
+    return tx;
+}
+
+void tsn_tx_queue(tsn_tx_t *tx, tsn_frame_t *f, int tc, uint64_t launch_ns) {
+    if (tx->txtime && (tx->queued++ % TXTIME_ERR_POLL) == 0) txtime_drain_errors(tx);
+
+    // With txtime the frame leaves at its launch time, so that is what latency
+    // is measured from
+    tsn_frame_stamp(f, tx->txtime ? launch_ns - tx->tai_offset_ns : tsn_realtime_ns());
+
+    switch (tx->engine) {
+    case TSN_TX_SEND: {
+        ssize_t sent;
+        uint64_t t0 = tsn_instr_ticks();
+        if (tx->txtime) {
+            struct msghdr *msg = &tx->hdrs[0].msg_hdr;
+            struct iovec iov = { .iov_base = f->data, .iov_len = f->len };
+            msg->msg_iov = &iov;
+            txtime_tag(tx, 0, launch_ns);
+            sent = sendmsg(tx->fd, msg, 0);
+            msg->msg_iov = &tx->iovs[0];
+        } else {
+            sent = send(tx->fd, f->data, f->len, 0);
+        }
+        if (sent > 0) {
+            tsn_stage_add(&tx->instr.stage[TSN_STAGE_TX], t0, tsn_instr_ticks(), 1);
+            account_tx(tx, tc, sent);
+        } else {
+            send_failed(tx, 1);
+        }
+        break;
+    }
+    case TSN_TX_MMSG: {
+        int slot = tx->pending++;
+        memcpy(tx->bufs[slot], f->data, f->len);
+        tx->iovs[slot].iov_len = f->len;
+        tx->tcs[slot] = tc;
+        if (tx->txtime) txtime_tag(tx, slot, launch_ns);
+        if (tx->pending == tx->batch) mmsg_flush(tx);
+        break;
+    }
+    case TSN_TX_RING:
+        ring_queue(tx, f, tc);
+        if (++tx->pending == tx->batch) ring_kick(tx);
+        break;
+    }
+}
+
+void tsn_tx_flush(tsn_tx_t *tx) {
+    if (tx->pending == 0) return;
+    if (tx->engine == TSN_TX_MMSG) {
+        mmsg_flush(tx);
+    } else if (tx->engine == TSN_TX_RING) {
+        ring_kick(tx);
+    }
+}
+
+uint64_t tsn_tx_launch(const tsn_tx_t *tx, uint64_t n) {
+    const tsn_txtime_t *t = &tx->sched;
+    if (t->cycle_ns == 0) {
+        return t->base_ns + t->offset_ns + n * t->interval_ns;
+    }
+    return t->base_ns + (n / t->per_cycle) * t->cycle_ns +
+           t->offset_ns + (n % t->per_cycle) * t->interval_ns;
+}
+
+void tsn_tx_sleep_until(const tsn_tx_t *tx, uint64_t launch_ns) {
+    uint64_t wake_ns = launch_ns - tx->sched.lead_ns;
+    struct timespec ts = { .tv_sec = wake_ns / 1000000000ULL, .tv_nsec = wake_ns % 1000000000ULL };
+    while (clock_nanosleep(CLOCK_TAI, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+void tsn_tx_drain(tsn_tx_t *tx) {
+    if (tx->fd < 0) return;
+    tsn_tx_flush(tx);
+    if (tx->ring) ring_drain(tx);
+    if (tx->txtime) {
+        // Let the last launches happen before collecting ETF drop reports
+        usleep(tx->sched.lead_ns / 1000 + 10000);
+        txtime_drain_errors(tx);
+    }
+}
+
+void tsn_tx_finish(tsn_tx_t *tx) {
+    tsn_tx_drain(tx);
+    if (tx->ring) {
+        munmap(tx->ring, tx->ring_len);
+        tx->ring = NULL;
+    }
+}
+
+void tsn_tx_close(tsn_tx_t *tx) {
+    if (!tx) return;
+    if (tx->ring) munmap(tx->ring, tx->ring_len);
+    if (tx->fd >= 0) close(tx->fd);
+    free(tx);
+}
+
+const tsn_tx_stats_t *tsn_tx_stats(const tsn_tx_t *tx) {
+    return &tx->stats;
+}
+
+void tsn_tx_instr(const tsn_tx_t *tx, tsn_instr_t *acc) {
+    tsn_instr_merge(acc, &tx->instr);
+    acc->txtime_dropped += tx->stats.txtime_dropped;
+}
+
+const tsn_txtime_t *tsn_tx_schedule(const tsn_tx_t *tx) {
+    return &tx->sched;
+}
+
+tsn_tx_engine_t tsn_tx_engine(const tsn_tx_t *tx) {
+    return tx->engine;
+}
+
+const char *tsn_tx_engine_name(tsn_tx_engine_t engine) {
+    return engine_names[engine];
+}
+
+int tsn_tx_batch(const tsn_tx_t *tx) {
+    return tx->batch;
+}
+
+bool tsn_tx_txtime(const tsn_tx_t *tx) {
+    return tx->txtime;
+}
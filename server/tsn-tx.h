@@ -0,0 +1,104 @@
+/*
+ * tsn-tx.h - Raw-socket TX engines shared by the TSN senders (libtsntest)
+ *
+ * Engines:
+ *   send - one send() syscall per frame (most precise pacing)
+ *   mmsg - frames queued in batches and pushed with one sendmmsg() call
+ *   ring - frames written into an mmap'd PACKET_TX_RING and kicked once per batch
+ *          (falls back to mmsg if the ring cannot be set up)
+ *
+ * With txtime set every frame carries an SO_TXTIME launch time on CLOCK_TAI and
+ * the ETF qdisc / NIC releases it. Launch times follow the GCL grid
+ * base + k*cycle + offset (+ n*interval inside window); base is advanced by whole
+ * cycles into the future like 802.1Qbv does. The ring cannot carry launch times,
+ * so txtime turns a ring request into mmsg.
+ */
+
+#ifndef TSN_TX_H
+#define TSN_TX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-instr.h"
+
+#define TSN_TX_DEFAULT_BATCH 32
+#define TSN_TX_MAX_BATCH 256
+
+typedef enum {
+    TSN_TX_SEND,
+    TSN_TX_MMSG,
+    TSN_TX_RING
+} tsn_tx_engine_t;
+
+// SO_TXTIME launch schedule, all times on CLOCK_TAI
+typedef struct {
+    uint64_t base_ns;      // GCL base time (cycle start)
+    uint64_t cycle_ns;     // 0 = continuous timeline
+    uint64_t offset_ns;    // first launch offset inside each cycle
+    uint64_t window_ns;    // span inside each cycle used for launches (0 = rest of cycle)
+    uint64_t interval_ns;  // spacing between launches
+    uint64_t per_cycle;    // launches per cycle (derived)
+    uint64_t lead_ns;      // hand-off to the qdisc this long before launch
+} tsn_txtime_t;
+
+typedef struct {
+    tsn_tx_engine_t engine;
+    int batch;             // frames per syscall for mmsg/ring
+    int so_priority;       // SO_PRIORITY for the socket, -1 = leave default
+    bool txtime;
+    tsn_txtime_t schedule; // used with txtime; interval_ns must be set
+} tsn_tx_opts_t;
+
+typedef struct {
+    uint64_t packets[TSN_MAX_TC];
+    uint64_t bytes[TSN_MAX_TC];
+    uint64_t total;
+    uint64_t txtime_dropped;  // frames reported missed/invalid by ETF
+} tsn_tx_stats_t;
+
+typedef struct tsn_tx tsn_tx_t;
+
+// Defaults: send engine, batch 32, no SO_PRIORITY, spin pacing, 500 us lead
+void tsn_tx_opts_init(tsn_tx_opts_t *opts);
+
+// Returns NULL on failure (perror printed)
+tsn_tx_t *tsn_tx_open(const char *ifname, const tsn_tx_opts_t *opts);
+
+// Queue one frame for TC tc. Its sequence number and TX timestamp (CLOCK_REALTIME;
+// the launch time with txtime) are stamped in place; launch_ns is only used with
+// txtime. The batch goes out when full (send: immediately).
+void tsn_tx_queue(tsn_tx_t *tx, tsn_frame_t *f, int tc, uint64_t launch_ns);
+
+// Push whatever is queued
+void tsn_tx_flush(tsn_tx_t *tx);
+
+// Launch time of the n-th frame on the schedule
+uint64_t tsn_tx_launch(const tsn_tx_t *tx, uint64_t n);
+
+// Sleep (not spin) until the frame launching at launch_ns must be handed over
+void tsn_tx_sleep_until(const tsn_tx_t *tx, uint64_t launch_ns);
+
+// Flush and wait for in-flight frames and ETF error reports; call before
+// reading the final stats
+void tsn_tx_finish(tsn_tx_t *tx);
+
+// Same wait, but the TX ring stays mapped so the socket can send again
+void tsn_tx_drain(tsn_tx_t *tx);
+
+void tsn_tx_close(tsn_tx_t *tx);
+
+const tsn_tx_stats_t *tsn_tx_stats(const tsn_tx_t *tx);
+
+// Add send failures by errno, frames lost to them, ETF drops and the tx stage
+// cost to acc
+void tsn_tx_instr(const tsn_tx_t *tx, tsn_instr_t *acc);
+const tsn_txtime_t *tsn_tx_schedule(const tsn_tx_t *tx);
+tsn_tx_engine_t tsn_tx_engine(const tsn_tx_t *tx);
+const char *tsn_tx_engine_name(tsn_tx_engine_t engine);
+int tsn_tx_batch(const tsn_tx_t *tx);
+bool tsn_tx_txtime(const tsn_tx_t *tx);
+
+#endif
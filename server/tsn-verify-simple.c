@@ -2,7 +2,14 @@
  * Simple TSN Verification - works without VLAN for initial testing
  * Sends traffic with PCP values and measures patterns
  *
- * Compile: gcc -O2 -o tsn-verify-simple tsn-verify-simple.c -lpcap -lpthread -lrt -lm
+ * RX: a kernel filter generated from the frames sent (source MAC, tag / VID,
+ * EtherType, test header magic; tsn_capture_set_match) lets only test frames
+ * through, and they are decoded at the fixed offsets of that layout
+ *
+ * Kernel drops, send failures and late sends are printed under the table;
+ * loss figures with any of them behind it say nothing about the switch
+ *
+ * Compile: make tsn-verify-simple (links libtsntest.a)
  */
 
 #define _GNU_SOURCE
@@ -14,40 +21,28 @@
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
-#include <math.h>
 #include <pthread.h>
-#include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <sys/mman.h>
-#include <sched.h>
-#include <net/if.h>
-#include <linux/if_packet.h>
-#include <linux/if_ether.h>
-#include <arpa/inet.h>
-#include <pcap/pcap.h>
-
-#define MAX_TC 8
-#define MAX_PACKETS 50000
 
-typedef struct {
-    uint64_t ts_ns;
-    uint16_t len;
-} packet_t;
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-tx.h"
+#include "tsn-capture.h"
+#include "tsn-analysis.h"
+#include "tsn-pace.h"
+
+#define MAX_TC TSN_MAX_TC
 
 typedef struct {
-    packet_t packets[MAX_PACKETS];
-    int packet_count;
+    tsn_stream_t stream;
+    tsn_seq_t seq;
     uint64_t tx_count;
-    uint64_t total_bytes;
-    uint64_t first_ts;
-    uint64_t last_ts;
     double measured_bps;
-} tc_data_t;
+} __attribute__((aligned(64))) tc_data_t;
 
 static volatile int running = 1;
 static tc_data_t tc_data[MAX_TC];
-static pthread_mutex_t data_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pcap_t *rx_handle = NULL;
+static tsn_capture_group_t *rx_group = NULL;
+static tsn_instr_t tx_instr, rx_instr;   // each thread's own, read after the join
 
 static const char *tx_if = NULL;
 static const char *rx_if = NULL;
@@ -55,230 +50,171 @@ static int use_vlan = 0;
 static int vlan_id = 100;
 static int duration = 5;
 static int pps = 500;
+static int rx_workers = 1;
 
 static unsigned char tx_mac[6];
 static unsigned char rx_mac[6];
 
-static uint64_t get_time_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
-}
+// Layout decoder, or NULL when the kernel filter could not be installed
+static tsn_test_rx_fn rx_decode = NULL;
 
 static void signal_handler(int sig) {
     (void)sig;
     running = 0;
-    if (rx_handle) pcap_breakloop(rx_handle);
-}
-
-static int get_mac(const char *ifname, unsigned char *mac) {
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) return -1;
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
-    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
-        close(fd);
-        return -1;
-    }
-    close(fd);
-    memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
-    return 0;
+    if (rx_group) tsn_capture_group_breakloop(rx_group);
 }
 
-// Build frame with or without VLAN tag
-// Uses custom EtherType 0x88B5 (local experimental) with TC in first byte of payload
-static int build_frame(unsigned char *frame, int tc) {
-    int offset = 0;
-
-    memcpy(frame + offset, rx_mac, 6); offset += 6;
-    memcpy(frame + offset, tx_mac, 6); offset += 6;
-
-    if (use_vlan) {
-        // 802.1Q VLAN
-        frame[offset++] = 0x81;
-        frame[offset++] = 0x00;
-        uint16_t tci = ((tc & 0x7) << 13) | (vlan_id & 0xFFF);
-        frame[offset++] = (tci >> 8) & 0xFF;
-        frame[offset++] = tci & 0xFF;
-    }
-
-    // Custom EtherType for test traffic
-    frame[offset++] = 0x88;
-    frame[offset++] = 0xB5;
-
-    // Payload: TC identifier + timestamp + sequence
-    frame[offset++] = (uint8_t)tc;  // TC identifier in first byte
-
-    uint64_t ts = get_time_ns();
-    memcpy(&frame[offset], &ts, 8); offset += 8;
-
-    static uint32_t seq[MAX_TC] = {0};
-    uint32_t s = seq[tc]++;
-    memcpy(&frame[offset], &s, 4); offset += 4;
-
-    // Pad to 60 bytes
-    while (offset < 60) frame[offset++] = 0xAA;
-
-    return offset;
-}
-
-// Parse received frame to extract TC
-static int parse_frame(const u_char *pkt, int len) {
+// Fallback without the test frame filter: parse received frame to extract TC
+static int parse_frame(const uint8_t *pkt, int len) {
     if (len < 20) return -1;
 
     // Check source MAC is our TX
     if (memcmp(pkt + 6, tx_mac, 6) != 0) return -1;
 
-    int offset = 12;
-    uint16_t ethertype = (pkt[offset] << 8) | pkt[offset + 1];
-    offset += 2;
-
-    // Skip VLAN tag if present
-    if (ethertype == 0x8100) {
-        // Get PCP from VLAN tag
-        uint16_t tci = (pkt[offset] << 8) | pkt[offset + 1];
-        int pcp = (tci >> 13) & 0x07;
-        offset += 2;
-        ethertype = (pkt[offset] << 8) | pkt[offset + 1];
-        offset += 2;
-
-        // Return PCP as TC
-        if (ethertype == 0x88B5) {
-            return pcp;
-        }
+    // Tagged: PCP is the TC
+    tsn_vlan_t vlan;
+    if (tsn_parse_vlan(pkt, len, &vlan) == 0) {
+        return vlan.ethertype == TSN_ETHERTYPE_EXP ? vlan.pcp : -1;
     }
 
-    // Check our test EtherType
-    if (ethertype == 0x88B5) {
-        // TC is in first byte of payload
-        return pkt[offset] & 0x07;
+    // Untagged: TC is in first byte of payload
+    uint16_t ethertype = (pkt[12] << 8) | pkt[13];
+    if (ethertype == TSN_ETHERTYPE_EXP) {
+        return pkt[14] & 0x07;
     }
 
     return -1;
 }
 
-static void rx_callback(u_char *user, const struct pcap_pkthdr *hdr, const u_char *pkt) {
+// Only the RX worker owning a TC writes its data (fan-out is by TC) and main
+// reads it after join, so no lock
+static void rx_callback(void *user, const tsn_packet_t *hdr) {
     (void)user;
+    const uint8_t *pkt = hdr->data;
+
+    tsn_test_rx_t rx;
+    if (rx_decode) {
+        if (rx_decode(pkt, hdr->caplen, &rx) < 0) return;
+        tsn_stream_add(&tc_data[rx.pcp].stream, hdr->ts_ns, hdr->len);
+        tsn_seq_add(&tc_data[rx.pcp].seq, rx.hdr.seq, (int64_t)(hdr->ts_ns - rx.hdr.tx_ns));
+        return;
+    }
 
     int tc = parse_frame(pkt, hdr->caplen);
     if (tc < 0) return;
 
-    uint64_t ts_ns = (uint64_t)hdr->ts.tv_sec * 1000000000ULL +
-                     (uint64_t)hdr->ts.tv_usec * 1000ULL;
-
-    pthread_mutex_lock(&data_mutex);
+    tsn_stream_add(&tc_data[tc].stream, hdr->ts_ns, hdr->len);
 
-    tc_data_t *td = &tc_data[tc];
-    if (td->packet_count < MAX_PACKETS) {
-        packet_t *p = &td->packets[td->packet_count];
-        p->ts_ns = ts_ns;
-        p->len = hdr->len;
-        td->packet_count++;
-        td->total_bytes += hdr->len;
-
-        if (td->first_ts == 0) td->first_ts = ts_ns;
-        td->last_ts = ts_ns;
+    tsn_test_hdr_t th;
+    if (tsn_test_hdr_parse(pkt, hdr->caplen, &th) == 0) {
+        tsn_seq_add(&tc_data[tc].seq, th.seq, (int64_t)(hdr->ts_ns - th.tx_ns));
     }
-
-    pthread_mutex_unlock(&data_mutex);
 }
 
 static void *rx_thread(void *arg) {
     (void)arg;
 
-    char errbuf[PCAP_ERRBUF_SIZE];
-    rx_handle = pcap_open_live(rx_if, 128, 1, 1, errbuf);
-    if (!rx_handle) {
+    char errbuf[256];
+    tsn_capture_opts_t opts;
+    tsn_capture_opts_init(&opts);
+    tsn_capture_group_t *g = tsn_capture_group_open(rx_if, &opts, rx_workers, errbuf);
+    if (!g) {
         fprintf(stderr, "RX error: %s\n", errbuf);
         return NULL;
     }
-
-    // Filter for packets from our TX MAC
-    char filter[128];
-    snprintf(filter, sizeof(filter), "ether src %02x:%02x:%02x:%02x:%02x:%02x",
-             tx_mac[0], tx_mac[1], tx_mac[2], tx_mac[3], tx_mac[4], tx_mac[5]);
-    struct bpf_program fp;
-    if (pcap_compile(rx_handle, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) == 0) {
-        pcap_setfilter(rx_handle, &fp);
-        pcap_freecode(&fp);
+    tsn_capture_t *cap = tsn_capture_group_member(g, 0);
+
+    // Only our test frames; failing that, everything from our TX MAC
+    tsn_capture_match_t match = {
+        .vlan_id = use_vlan ? vlan_id : -1, .ethertype = TSN_ETHERTYPE_EXP,
+        .test_hdr = 1, .src_mac = tx_mac
+    };
+    if (tsn_capture_group_set_match(g, &match) == 0) {
+        rx_decode = tsn_test_rx(use_vlan, TSN_FRAME_EXP);
+    } else {
+        char filter[128];
+        snprintf(filter, sizeof(filter), "ether src %02x:%02x:%02x:%02x:%02x:%02x",
+                 tx_mac[0], tx_mac[1], tx_mac[2], tx_mac[3], tx_mac[4], tx_mac[5]);
+        tsn_capture_group_set_filter(g, filter);
     }
 
-    fprintf(stderr, "RX: Capturing on %s\n", rx_if);
+    fprintf(stderr, "RX: Capturing on %s (%s, %s timestamps, %d worker%s)\n", rx_if,
+            tsn_capture_backend_name(cap), tsn_capture_ts_source(cap),
+            rx_workers, rx_workers > 1 ? "s" : "");
 
-    while (running) {
-        pcap_dispatch(rx_handle, 100, rx_callback, NULL);
+    int cpus[TSN_CAPTURE_MAX_WORKERS];
+    for (int i = 0; i < rx_workers; i++) cpus[i] = i % (int)sysconf(_SC_NPROCESSORS_ONLN);
+    rx_group = g;
+    if (tsn_capture_group_start(g, rx_callback, NULL, rx_workers > 1 ? cpus : NULL) == 0) {
+        while (running) usleep(1000);
+        tsn_capture_group_stop(g);
     }
 
-    pcap_close(rx_handle);
+    tsn_capture_group_instr(g, &rx_instr);
+    rx_group = NULL;
+    tsn_capture_group_close(g);
     return NULL;
 }
 
 static void *tx_thread(void *arg) {
     (void)arg;
 
-    int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
-    if (sock < 0) {
-        perror("socket");
-        return NULL;
-    }
+    tsn_tx_opts_t opts;
+    tsn_tx_opts_init(&opts);
+    tsn_tx_t *tx = tsn_tx_open(tx_if, &opts);
+    if (!tx) return NULL;
 
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, tx_if, IFNAMSIZ - 1);
-    if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
-        perror("ioctl");
-        close(sock);
-        return NULL;
-    }
-
-    struct sockaddr_ll sll;
-    memset(&sll, 0, sizeof(sll));
-    sll.sll_family = AF_PACKET;
-    sll.sll_ifindex = ifr.ifr_ifindex;
-    sll.sll_protocol = htons(ETH_P_ALL);
-    bind(sock, (struct sockaddr *)&sll, sizeof(sll));
-
-    // Pre-build frames
-    unsigned char frames[MAX_TC][64];
-    int frame_lens[MAX_TC];
+    // Pre-build frames; sequence and TX timestamp are stamped on every send
+    static tsn_frame_t frames[MAX_TC];
     for (int tc = 0; tc < MAX_TC; tc++) {
-        frame_lens[tc] = build_frame(frames[tc], tc);
+        tsn_frame_spec_t spec = {
+            .dst_mac = rx_mac, .src_mac = tx_mac,
+            .vlan_id = use_vlan ? vlan_id : -1, .pcp = tc,
+            .frame_size = 60, .proto = TSN_FRAME_EXP,
+            .stream_id = (uint16_t)tc
+        };
+        tsn_frame_build(&frames[tc], &spec);
     }
 
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    sched_setscheduler(0, SCHED_FIFO, &param);
-    mlockall(MCL_CURRENT | MCL_FUTURE);
+    // Hybrid pacing: sleep until just before each frame, spin the rest
+    tsn_pacer_t pacer;
+    tsn_pacer_init(&pacer, TSN_PACE_HYBRID);
+    tsn_setup_realtime(0);
 
     uint64_t interval_ns = 1000000000ULL / pps;
-    uint64_t next_send = get_time_ns();
+    uint64_t next_send = tsn_time_ns();
     int tc_idx = 0;
 
     fprintf(stderr, "TX: Sending all TCs at %d pps (interval=%lu ns)\n", pps, interval_ns);
 
     while (running) {
-        while (get_time_ns() < next_send && running) {}
+        uint64_t now = tsn_pacer_wait(&pacer, next_send, &running);
         if (!running) break;
 
-        int tc = tc_idx % MAX_TC;
-
-        // Update timestamp in frame
-        uint64_t ts = get_time_ns();
-        memcpy(&frames[tc][use_vlan ? 17 : 15], &ts, 8);
-
-        ssize_t sent = send(sock, frames[tc], frame_lens[tc], 0);
-        if (sent > 0) {
-            pthread_mutex_lock(&data_mutex);
-            tc_data[tc].tx_count++;
-            pthread_mutex_unlock(&data_mutex);
+        // Slots missed while preempted go out back to back
+        uint32_t n = tsn_pacer_due(&pacer, now, next_send, interval_ns, TSN_PACE_MAX_CATCHUP);
+        for (uint32_t i = 0; i < n; i++) {
+            int tc = tc_idx % MAX_TC;
+            tsn_tx_queue(tx, &frames[tc], tc, 0);
+            tc_idx++;
         }
-
-        tc_idx++;
-        next_send += interval_ns;
+        next_send += n * interval_ns;
     }
 
-    close(sock);
+    tsn_pctl_t err;
+    tsn_hist_pctl(&pacer.error, &err);
+    fprintf(stderr, "TX: send-time error p50/p99/max=%.1f/%.1f/%.1f us (%lu catch-up)\n",
+            err.p50, err.p99, err.max, pacer.catchup);
+
+    // TX-owned counters; published to tc_data after the loop so the TX and
+    // RX threads never write the same cache lines
+    tsn_tx_finish(tx);
+    const tsn_tx_stats_t *st = tsn_tx_stats(tx);
+    for (int t = 0; t < MAX_TC; t++) tc_data[t].tx_count = st->packets[t];
+    tsn_tx_instr(tx, &tx_instr);
+    tx_instr.tx_late = pacer.late;
+
+    tsn_tx_close(tx);
     return NULL;
 }
 
@@ -299,24 +235,24 @@ static void print_results(void) {
     for (int tc = 0; tc < MAX_TC; tc++) {
         tc_data_t *td = &tc_data[tc];
 
-        if (td->tx_count == 0 && td->packet_count == 0) continue;
+        if (td->tx_count == 0 && td->stream.count == 0) continue;
 
         total_tx += td->tx_count;
-        total_rx += td->packet_count;
+        total_rx += td->stream.count;
 
         double loss = td->tx_count > 0 ?
-            100.0 * (1 - (double)td->packet_count / td->tx_count) : 0;
+            100.0 * (1 - (double)td->stream.count / td->tx_count) : 0;
 
-        double duration_s = td->packet_count > 1 ?
-            (td->last_ts - td->first_ts) / 1e9 : 0;
+        double duration_s = td->stream.count > 1 ?
+            (td->stream.last_ts - td->stream.first_ts) / 1e9 : 0;
 
-        double kbps = duration_s > 0 ? (td->total_bytes * 8.0 / 1000.0) / duration_s : 0;
+        double kbps = duration_s > 0 ? (td->stream.total_bytes * 8.0 / 1000.0) / duration_s : 0;
 
-        double avg_interval_ms = td->packet_count > 1 ?
-            (td->last_ts - td->first_ts) / 1e6 / (td->packet_count - 1) : 0;
+        double avg_interval_ms = td->stream.count > 1 ?
+            (td->stream.last_ts - td->stream.first_ts) / 1e6 / (td->stream.count - 1) : 0;
 
-        printf("│ %2d │ %7lu │ %7d │ %7.1f%% │ %9.1f │ %11.2f │\n",
-               tc, td->tx_count, td->packet_count, loss, kbps, avg_interval_ms);
+        printf("│ %2d │ %7lu │ %7lu │ %7.1f%% │ %9.1f │ %11.2f │\n",
+               tc, td->tx_count, td->stream.count, loss, kbps, avg_interval_ms);
     }
 
     printf("├────┼─────────┼─────────┼──────────┼───────────┼─────────────┤\n");
@@ -324,6 +260,11 @@ static void print_results(void) {
            total_tx, total_rx, total_tx > 0 ? 100.0 * (1 - (double)total_rx / total_tx) : 0);
     printf("└────┴─────────┴─────────┴──────────┴───────────┴─────────────┘\n\n");
 
+    tsn_instr_t in = tx_instr;
+    tsn_instr_merge(&in, &rx_instr);
+    tsn_instr_print_human(stdout, &in);
+    printf("\n");
+
     // Analysis
     if (total_rx > 0) {
         // Check for shaping
@@ -332,29 +273,32 @@ static void print_results(void) {
         // Calculate interval variance per TC
         for (int tc = 0; tc < MAX_TC; tc++) {
             tc_data_t *td = &tc_data[tc];
-            if (td->packet_count < 10) continue;
+            if (td->stream.count < 10) continue;
 
             // Calculate interval statistics
-            double sum = 0, sum_sq = 0;
-            int count = 0;
-            for (int i = 1; i < td->packet_count; i++) {
-                double interval = (td->packets[i].ts_ns - td->packets[i-1].ts_ns) / 1e6;
-                sum += interval;
-                sum_sq += interval * interval;
-                count++;
-            }
-
-            if (count > 0) {
-                double avg = sum / count;
-                double var = (sum_sq / count) - (avg * avg);
-                double stddev = var > 0 ? sqrt(var) : 0;
+            double avg_us, stddev_us;
+            if (tsn_interval_stats(&td->stream, &avg_us, &stddev_us) > 0) {
+                double avg = avg_us / 1000.0;
+                double stddev = stddev_us / 1000.0;
                 double cv = avg > 0 ? stddev / avg : 0;  // Coefficient of variation
 
                 // High CV suggests shaping/queuing
                 const char *status = cv > 0.5 ? "SHAPED/QUEUED" : "REGULAR";
 
-                printf("  TC%d: avg=%.2fms stddev=%.2fms CV=%.2f [%s]\n",
-                       tc, avg, stddev, cv, status);
+                tsn_pctl_t ia;
+                tsn_hist_pctl(&td->stream.interval_hist, &ia);
+
+                printf("  TC%d: avg=%.2fms stddev=%.2fms CV=%.2f p99=%.2fms max=%.2fms [%s]\n",
+                       tc, avg, stddev, cv, ia.p99 / 1000.0, ia.max / 1000.0, status);
+            }
+
+            tsn_seq_stats_t q;
+            tsn_seq_stats(&td->seq, &q);
+            if (q.received > 0) {
+                printf("       latency min/avg/p50/p99/p99.9/max=%.1f/%.1f/%.1f/%.1f/%.1f/%.1f us "
+                       "lost=%lu dup=%lu reorder=%lu\n",
+                       q.lat_min_us, q.lat_avg_us, q.lat.p50, q.lat.p99, q.lat.p999,
+                       q.lat_max_us, q.lost, q.duplicates, q.reordered);
             }
         }
         printf("\n");
@@ -368,7 +312,7 @@ static void print_results(void) {
 
 int main(int argc, char *argv[]) {
     if (argc < 3) {
-        fprintf(stderr, "Usage: %s <tx_if> <rx_if> [duration] [pps] [--vlan <id>]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <tx_if> <rx_if> [duration] [pps] [--vlan <id>] [--rx-workers <n>]\n", argv[0]);
         fprintf(stderr, "Example: %s enxc84d44263ba6 enx00e04c6812d1 5 500\n", argv[0]);
         fprintf(stderr, "         %s enxc84d44263ba6 enx00e04c6812d1 5 500 --vlan 100\n", argv[0]);
         return 1;
@@ -381,6 +325,8 @@ int main(int argc, char *argv[]) {
         if (strcmp(argv[i], "--vlan") == 0 && i + 1 < argc) {
             use_vlan = 1;
             vlan_id = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rx-workers") == 0 && i + 1 < argc) {
+            rx_workers = atoi(argv[++i]);
         } else if (duration == 5 && atoi(argv[i]) > 0) {
             duration = atoi(argv[i]);
         } else if (pps == 500 && atoi(argv[i]) > 0) {
@@ -389,11 +335,15 @@ int main(int argc, char *argv[]) {
     }
 
     memset(tc_data, 0, sizeof(tc_data));
+    for (int t = 0; t < MAX_TC; t++) {
+        tsn_stream_init(&tc_data[t].stream, 0, 0);
+        tsn_seq_init(&tc_data[t].seq);
+    }
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
-    get_mac(tx_if, tx_mac);
-    get_mac(rx_if, rx_mac);
+    tsn_get_iface_mac(tx_if, tx_mac);
+    tsn_get_iface_mac(rx_if, rx_mac);
 
     printf("TX MAC: %02x:%02x:%02x:%02x:%02x:%02x\n",
            tx_mac[0], tx_mac[1], tx_mac[2], tx_mac[3], tx_mac[4], tx_mac[5]);
@@ -405,8 +355,8 @@ int main(int argc, char *argv[]) {
     usleep(100000);
     pthread_create(&tx_tid, NULL, tx_thread, NULL);
 
-    uint64_t end_time = get_time_ns() + (uint64_t)duration * 1000000000ULL;
-    while (running && get_time_ns() < end_time) {
+    uint64_t end_time = tsn_time_ns() + (uint64_t)duration * 1000000000ULL;
+    while (running && tsn_time_ns() < end_time) {
         usleep(100000);
     }
 
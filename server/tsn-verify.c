@@ -8,8 +8,33 @@
  * 3. Analyzes patterns to estimate actual switch configuration
  * 4. Compares with expected configuration
  *
- * Compile: gcc -O2 -o tsn-verify tsn-verify.c -lpcap -lpthread -lrt -lm
+ * Compile: make tsn-verify (links libtsntest.a)
  * Run: sudo ./tsn-verify --mode cbs --tx-if enx1 --rx-if enx2 --duration 10
+ *
+ * TX is paced by tsn-pace.h: --pacing hybrid (default) sleeps to a calibrated
+ * slack before each send time and spins the rest, so the RX thread keeps its
+ * CPU; spin and sleep are the two extremes. The send-time error is reported
+ * with the results. --pacing txtime hands each frame to the ETF qdisc with an
+ * SO_TXTIME launch time (CLOCK_TAI) instead. With --cycle the launches
+ * are laid on the GCL grid base-time + k*cycle + tx-offset, spread over
+ * --tx-window, so a chosen TAS window can be probed directly.
+ *
+ * --read FILE skips TX and verifies a pcap / pcapng capture taken elsewhere
+ * (tcpdump, hardware tap); loss then comes from the sequence numbers only.
+ *
+ * --mode sweep closes the loop on CBS: every TC's offered load is stepped from
+ * below to above its configured idle slope (--sweep-range, as a factor) while
+ * RX measures what comes through. A step ends as soon as the rate has settled
+ * (--converge-pct over the last few 50 ms windows) or after --step-ms, and a
+ * TC stops once it is clearly saturated. The result is a bandwidth curve and
+ * the measured plateau per TC, to compare with the configured idle slope.
+ *
+ * --pair "TX RX [key=value ...]" (repeatable) verifies several port pairs at
+ * once, each with its own TCs, rate, VLAN and cbs/tas mode and its own TX and
+ * RX thread pinned to a CPU of its own. Every RX only analyzes frames from its
+ * own pair's source MAC; frames in its VLAN from other pairs are counted per
+ * sending pair, which is how flooding and cross-port leaks show up. One report
+ * covers all pairs (JSON: {"mode":"matrix","pairs":[...]}).
  */
 
 #define _GNU_SOURCE
@@ -24,28 +49,31 @@
 #include <math.h>
 #include <getopt.h>
 #include <pthread.h>
-#include <errno.h>
-#include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <sys/mman.h>
-#include <sched.h>
-#include <net/if.h>
-#include <linux/if_packet.h>
-#include <linux/if_ether.h>
-#include <arpa/inet.h>
-#include <pcap/pcap.h>
-
-#define MAX_TC 8
-#define MAX_PACKETS 100000
-#define MAX_BURSTS 5000
+
+#include "tsn-common.h"
+#include "tsn-frame.h"
+#include "tsn-tx.h"
+#include "tsn-capture.h"
+#include "tsn-analysis.h"
+#include "tsn-cycle.h"
+#include "tsn-pace.h"
+
+#define MAX_TC TSN_MAX_TC
 #define MAX_GCL 64
+#define TAS_BINS 100
 
 typedef enum {
     MODE_CBS,
     MODE_TAS,
-    MODE_BOTH
+    MODE_BOTH,
+    MODE_SWEEP
 } test_mode_t;
 
+typedef enum {
+    PACING_PACER,   // tsn-pace.h, config.pace_mode
+    PACING_TXTIME
+} pacing_t;
+
 // Configuration
 static struct {
     test_mode_t mode;
@@ -61,6 +89,23 @@ static struct {
     char src_mac[32];
     bool json_output;
     bool verbose;
+    pacing_t pacing;
+    tsn_pace_mode_t pace_mode;
+    uint64_t base_time_ns;
+    double tx_offset_us;
+    double tx_window_us;
+    double lead_us;
+    int so_priority;
+    int rx_workers;
+    const char *read_file;
+    int frame_size;
+    // Sweep
+    char idle_slope[128];
+    double sweep_lo;
+    double sweep_hi;
+    int sweep_steps;
+    int step_ms;
+    double converge_pct;
 } config = {
     .mode = MODE_CBS,
     .tx_iface = NULL,
@@ -74,35 +119,32 @@ static struct {
     .dst_mac = "",
     .src_mac = "",
     .json_output = false,
-    .verbose = false
+    .verbose = false,
+    .pacing = PACING_PACER,
+    .pace_mode = TSN_PACE_HYBRID,
+    .base_time_ns = 0,
+    .tx_offset_us = 0,
+    .tx_window_us = 0,
+    .lead_us = 500,
+    .so_priority = -1,
+    .rx_workers = 0,  // 1 live, one per CPU for a file
+    .read_file = NULL,
+    .frame_size = 64,
+    .idle_slope = "",
+    .sweep_lo = 0.5,
+    .sweep_hi = 1.5,
+    .sweep_steps = 11,
+    .step_ms = 1000,
+    .converge_pct = 2.0
 };
 
-// Packet record
-typedef struct {
-    uint64_t ts_ns;
-    uint16_t len;
-} packet_t;
-
-// Burst
-typedef struct {
-    uint64_t start_ns;
-    uint64_t end_ns;
-    uint32_t bytes;
-    uint32_t packets;
-} burst_t;
-
 // Per-TC data
 typedef struct {
-    packet_t packets[MAX_PACKETS];
-    int packet_count;
-
-    burst_t bursts[MAX_BURSTS];
-    int burst_count;
+    tsn_stream_t stream;
+    tsn_seq_t seq;
 
     uint64_t tx_count;
-    uint64_t total_bytes;
-    uint64_t first_ts;
-    uint64_t last_ts;
+    uint64_t rx_bytes;          // sweep: read live by the controller
 
     // CBS estimation
     double measured_bps;
@@ -111,533 +153,980 @@ typedef struct {
     bool is_shaped;
 
     // TAS estimation
-    int histogram[1000];
-    int histogram_size;
     double window_start_us;
     double window_duration_us;
-} tc_data_t;
+} __attribute__((aligned(64))) tc_data_t;
+
+// One TX -> RX port pair: its traffic and everything measured on it. A plain
+// run is pair 0 built from the options; --pair adds pairs that run at once
+// (matrix), each with its own TX and RX threads
+#define MAX_PAIRS 16
+
+typedef struct {
+    const char *tx_iface;
+    const char *rx_iface;
+    test_mode_t mode;           // cbs, tas or both (sweep: single pair only)
+    char tc_list[32];
+    int pps;
+    int vlan_id;
+    int frame_size;
+    double expected_cycle_ms;
+    char dst_mac[32];
+    char src_mac[32];
+    int tx_cpu;                 // -1 = not pinned
+    int rx_cpu;
+
+    unsigned char tx_mac[6];    // source MAC of this pair's frames
+    tsn_frame_t frames[MAX_TC];
+    tsn_pacer_t pacer;          // TX thread's; read by main after the join
+    tsn_instr_t tx_instr;       // same, send failures and cost
+    tsn_instr_t rx_instr;       // RX thread's, kernel drops and capture cost
+    tsn_stage_t analysis;       // main's
+    tc_data_t tc_data[MAX_TC];
+
+    // Matrix: frames in this pair's VLAN from another pair's TX ([n_pairs]:
+    // from no pair at all), from all of its RX workers. Kept out of tc_data
+    uint64_t foreign[MAX_PAIRS + 1];
+
+    tsn_capture_group_t *rx_group;
+    uint32_t rx_ts_resolution_ns;
+    uint64_t estimated_cycle_ns;
+    double cycle_confidence;
+} pair_t;
 
 // Global state
 static volatile int running = 1;
-static tc_data_t tc_data[MAX_TC];
-static pthread_mutex_t data_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pcap_t *rx_handle = NULL;
+static pair_t pairs[MAX_PAIRS];
+static int n_pairs = 1;
+static bool matrix = false;
+
+// TAS estimation, cycle search range 1 ms .. 200 ms
+#define MIN_CYCLE_NS 1000000ULL
+#define MAX_CYCLE_NS 200000000ULL
+
+// Sweep: steps settle, then are measured in windows until the last
+// SWEEP_CONVERGE windows agree; SWEEP_SAT_STEPS steps delivering SWEEP_SAT_PCT
+// less than offered end a TC
+#define MAX_SWEEP_STEPS 64
+#define SWEEP_SETTLE_MS 30
+#define SWEEP_WINDOW_MS 50
+#define SWEEP_CONVERGE 3
+#define SWEEP_SAT_PCT 5.0
+#define SWEEP_SAT_STEPS 2
+#define SWEEP_POLL_NS 1000000ULL   // the TX thread sees a new step within this
 
-// TAS estimation
-static uint64_t estimated_cycle_ns = 0;
+typedef struct {
+    double offered_kbps;
+    double measured_kbps;
+    double ms;
+    bool converged;
+} sweep_point_t;
+
+// Offered load per TC, 0 = not sending. The controller stores the intervals
+// and then bumps gen; the TX thread restarts its schedule on a new gen
+static struct {
+    uint64_t interval_ns[MAX_TC];
+    uint32_t gen;
+} sweep_tx;
 
-static uint64_t get_time_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
-}
+static struct {
+    double nominal_kbps;        // configured idle slope
+    sweep_point_t curve[MAX_SWEEP_STEPS];
+    int n_points;
+    int sat_steps;
+    int sat_point;              // first saturated step, -1 = none
+} sweep[MAX_TC];
 
 static void signal_handler(int sig) {
     (void)sig;
     running = 0;
-    if (rx_handle) pcap_breakloop(rx_handle);
-}
-
-// Parse MAC
-static int parse_mac(const char *str, unsigned char *mac) {
-    return sscanf(str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
-                  &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6 ? 0 : -1;
-}
-
-// Parse TC list
-static int parse_tc_list(const char *str, int *tcs) {
-    int count = 0;
-    char *copy = strdup(str);
-    char *token = strtok(copy, ",");
-    while (token && count < MAX_TC) {
-        tcs[count++] = atoi(token);
-        token = strtok(NULL, ",");
+    for (int i = 0; i < n_pairs; i++) {
+        if (pairs[i].rx_group) tsn_capture_group_breakloop(pairs[i].rx_group);
     }
-    free(copy);
-    return count;
 }
 
-// Get interface MAC
-static int get_iface_mac(const char *ifname, unsigned char *mac) {
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) return -1;
+// Fixed rate: round-robin over the TCs, one frame every interval; frames
+// that fell behind go out back-to-back
+static void send_fixed_rate(pair_t *p, tsn_tx_t *tx, const int *tcs, int num_tcs, uint64_t interval_ns) {
+    uint64_t next_send = tsn_time_ns();
+    uint64_t tc_idx = 0;
+
+    while (running) {
+        uint64_t launch = 0;
+        uint32_t n = 1;
 
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+        if (config.pacing == PACING_TXTIME) {
+            // Sleep until the hand-off point; ETF releases the frame at launch time
+            launch = tsn_tx_launch(tx, tc_idx);
+            tsn_tx_sleep_until(tx, launch);
+        } else {
+            uint64_t now = tsn_pacer_wait(&p->pacer, next_send, &running);
+            n = tsn_pacer_due(&p->pacer, now, next_send, interval_ns, TSN_PACE_MAX_CATCHUP);
+        }
+        if (!running) break;
 
-    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
-        close(fd);
-        return -1;
+        for (uint32_t i = 0; i < n; i++) {
+            int tc = tcs[tc_idx % num_tcs];
+            tsn_tx_queue(tx, &p->frames[tc], tc, launch);
+            tc_idx++;
+            next_send += interval_ns;
+        }
     }
-    close(fd);
-
-    memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
-    return 0;
 }
 
-// Build VLAN-tagged UDP frame
-static int build_frame(unsigned char *frame, unsigned char *dst, unsigned char *src,
-                       int vlan_id, int pcp) {
-    int offset = 0;
-
-    memcpy(frame + offset, dst, 6); offset += 6;
-    memcpy(frame + offset, src, 6); offset += 6;
-
-    // 802.1Q VLAN
-    frame[offset++] = 0x81;
-    frame[offset++] = 0x00;
-    uint16_t tci = ((pcp & 0x7) << 13) | (vlan_id & 0xFFF);
-    frame[offset++] = (tci >> 8) & 0xFF;
-    frame[offset++] = tci & 0xFF;
+// Sweep: every TC on its own interval as set by the controller; the next
+// frame is the TC due first
+static void send_sweep(pair_t *p, tsn_tx_t *tx) {
+    uint64_t interval[MAX_TC] = {0}, next[MAX_TC] = {0};
+    uint32_t gen = 0;
 
-    // IPv4
-    frame[offset++] = 0x08;
-    frame[offset++] = 0x00;
-
-    // IP header
-    int ip_start = offset;
-    frame[offset++] = 0x45;
-    frame[offset++] = pcp << 5;
-
-    int ip_len = 20 + 8 + 18;  // IP + UDP + payload
-    frame[offset++] = (ip_len >> 8) & 0xFF;
-    frame[offset++] = ip_len & 0xFF;
+    while (running) {
+        uint32_t g = __atomic_load_n(&sweep_tx.gen, __ATOMIC_ACQUIRE);
+        if (g != gen) {
+            gen = g;
+            uint64_t now = tsn_time_ns();
+            for (int t = 0; t < MAX_TC; t++) {
+                interval[t] = __atomic_load_n(&sweep_tx.interval_ns[t], __ATOMIC_RELAXED);
+                next[t] = now;
+            }
+        }
 
-    frame[offset++] = 0; frame[offset++] = 0;  // ID
-    frame[offset++] = 0; frame[offset++] = 0;  // Flags
-    frame[offset++] = 64;  // TTL
-    frame[offset++] = 17;  // UDP
-    frame[offset++] = 0; frame[offset++] = 0;  // Checksum placeholder
+        int tc = -1;
+        for (int t = 0; t < MAX_TC; t++) {
+            if (interval[t] && (tc < 0 || next[t] < next[tc])) tc = t;
+        }
+        if (tc < 0) {
+            usleep(100);
+            continue;
+        }
 
-    // IPs
-    frame[offset++] = 192; frame[offset++] = 168; frame[offset++] = 100; frame[offset++] = 1;
-    frame[offset++] = 192; frame[offset++] = 168; frame[offset++] = 100; frame[offset++] = 2;
+        // Wait for the send time in slices, so a new step is picked up right away
+        uint64_t now = tsn_time_ns();
+        while (running && now < next[tc] && __atomic_load_n(&sweep_tx.gen, __ATOMIC_RELAXED) == gen) {
+            uint64_t until = next[tc] - now > SWEEP_POLL_NS ? now + SWEEP_POLL_NS : next[tc];
+            now = tsn_pacer_wait(&p->pacer, until, &running);
+        }
+        if (!running) break;
+        if (__atomic_load_n(&sweep_tx.gen, __ATOMIC_RELAXED) != gen) continue;
 
-    // IP checksum
-    unsigned long sum = 0;
-    for (int i = 0; i < 10; i++) {
-        sum += ((unsigned short *)&frame[ip_start])[i];
+        // A TC behind schedule stays the one due first, so it catches up by itself
+        tsn_pacer_due(&p->pacer, now, next[tc], interval[tc], 1);
+        tsn_tx_queue(tx, &p->frames[tc], tc, 0);
+        next[tc] += interval[tc];
     }
-    sum = (sum >> 16) + (sum & 0xFFFF);
-    sum += (sum >> 16);
-    frame[ip_start + 10] = (~sum >> 8) & 0xFF;
-    frame[ip_start + 11] = (~sum) & 0xFF;
-
-    // UDP header
-    int sport = 10000 + pcp;
-    int dport = 20000 + pcp;
-    frame[offset++] = (sport >> 8) & 0xFF;
-    frame[offset++] = sport & 0xFF;
-    frame[offset++] = (dport >> 8) & 0xFF;
-    frame[offset++] = dport & 0xFF;
-
-    int udp_len = 8 + 18;
-    frame[offset++] = (udp_len >> 8) & 0xFF;
-    frame[offset++] = udp_len & 0xFF;
-    frame[offset++] = 0; frame[offset++] = 0;
-
-    // Payload with timestamp
-    uint64_t ts = get_time_ns();
-    memcpy(&frame[offset], &ts, 8); offset += 8;
-    frame[offset++] = pcp;  // TC identifier
-    for (int i = 0; i < 9; i++) frame[offset++] = i;
-
-    while (offset < 60) frame[offset++] = 0;
-
-    return offset;
 }
 
 // TX thread
 static void *tx_thread(void *arg) {
-    (void)arg;
+    pair_t *p = arg;
 
     int tcs[MAX_TC];
-    int num_tcs = parse_tc_list(config.tc_list, tcs);
+    int num_tcs = tsn_parse_tc_list(p->tc_list, tcs);
+    if (num_tcs == 0) {
+        fprintf(stderr, "TX: no valid TCs in '%s'\n", p->tc_list);
+        return NULL;
+    }
 
-    unsigned char dst_mac[6], src_mac[6];
+    unsigned char dst_mac[6];
 
     // Get MACs
-    if (config.dst_mac[0]) {
-        parse_mac(config.dst_mac, dst_mac);
+    if (p->dst_mac[0]) {
+        tsn_parse_mac(p->dst_mac, dst_mac);
     } else {
         // Use broadcast if not specified
         memset(dst_mac, 0xFF, 6);
     }
 
-    if (config.src_mac[0]) {
-        parse_mac(config.src_mac, src_mac);
-    } else {
-        get_iface_mac(config.tx_iface, src_mac);
-    }
-
-    // Create raw socket
-    int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
-    if (sock < 0) {
-        perror("tx socket");
-        return NULL;
+    uint64_t interval_ns = 1000000000ULL / p->pps;
+
+    tsn_tx_opts_t opts;
+    tsn_tx_opts_init(&opts);
+    opts.so_priority = config.so_priority;
+    if (config.pacing == PACING_TXTIME) {
+        opts.txtime = true;
+        opts.schedule.base_ns = config.base_time_ns;
+        opts.schedule.cycle_ns = (uint64_t)(p->expected_cycle_ms * 1e6);
+        opts.schedule.offset_ns = (uint64_t)(config.tx_offset_us * 1000);
+        opts.schedule.window_ns = (uint64_t)(config.tx_window_us * 1000);
+        opts.schedule.lead_ns = (uint64_t)(config.lead_us * 1000);
+        opts.schedule.interval_ns = interval_ns;
     }
 
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, config.tx_iface, IFNAMSIZ - 1);
-    if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
-        perror("ioctl");
-        close(sock);
-        return NULL;
-    }
+    tsn_tx_t *tx = tsn_tx_open(p->tx_iface, &opts);
+    if (!tx) return NULL;
 
-    struct sockaddr_ll sll;
-    memset(&sll, 0, sizeof(sll));
-    sll.sll_family = AF_PACKET;
-    sll.sll_ifindex = ifr.ifr_ifindex;
-    sll.sll_protocol = htons(ETH_P_ALL);
-    if (bind(sock, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
-        perror("bind");
-        close(sock);
-        return NULL;
-    }
-
-    // Pre-build frames
-    unsigned char frames[MAX_TC][64];
-    int frame_lens[MAX_TC];
+    // Pre-build frames; sequence and TX timestamp are stamped on every send
     for (int i = 0; i < num_tcs; i++) {
-        frame_lens[tcs[i]] = build_frame(frames[tcs[i]], dst_mac, src_mac,
-                                         config.vlan_id, tcs[i]);
+        tsn_frame_spec_t spec = {
+            .dst_mac = dst_mac, .src_mac = p->tx_mac,
+            .vlan_id = p->vlan_id, .pcp = tcs[i],
+            .frame_size = p->frame_size, .proto = TSN_FRAME_UDP,
+            .stream_id = (uint16_t)tcs[i]
+        };
+        tsn_frame_build(&p->frames[tcs[i]], &spec);
     }
 
-    // Set real-time
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    sched_setscheduler(0, SCHED_FIFO, &param);
-    mlockall(MCL_CURRENT | MCL_FUTURE);
-
-    uint64_t interval_ns = 1000000000ULL / config.pps;
-    uint64_t start = get_time_ns();
-    uint64_t next_send = start;
-    int tc_idx = 0;
-
-    if (config.verbose) {
-        fprintf(stderr, "TX: Sending %d TCs at %d pps, interval=%lu ns\n",
-                num_tcs, config.pps, interval_ns);
+    if (p->tx_cpu >= 0 && tsn_pin_cpu(p->tx_cpu) < 0) {
+        fprintf(stderr, "Warning: cannot pin TX for %s to CPU %d\n", p->tx_iface, p->tx_cpu);
     }
 
-    while (running) {
-        // Wait
-        while (get_time_ns() < next_send && running) {}
-        if (!running) break;
-
-        int tc = tcs[tc_idx % num_tcs];
-        ssize_t sent = send(sock, frames[tc], frame_lens[tc], 0);
-        if (sent > 0) {
-            pthread_mutex_lock(&data_mutex);
-            tc_data[tc].tx_count++;
-            pthread_mutex_unlock(&data_mutex);
+    // Calibrate the pacer before SCHED_FIFO, then set real-time
+    tsn_pacer_init(&p->pacer, config.pace_mode);
+    tsn_setup_realtime(0);
+
+    if (config.verbose && p->mode == MODE_SWEEP) {
+        fprintf(stderr, "TX: Sweeping %d TCs, %d-byte frames\n", num_tcs, p->frames[tcs[0]].len);
+    } else if (config.verbose) {
+        fprintf(stderr, "TX %s: Sending %d TCs at %d pps, interval=%lu ns\n",
+                p->tx_iface, num_tcs, p->pps, interval_ns);
+        if (config.pacing == PACING_TXTIME) {
+            const tsn_txtime_t *t = tsn_tx_schedule(tx);
+            fprintf(stderr, "TX: txtime pacing, base %lu ns TAI, cycle %lu ns, offset %lu ns, %lu/cycle\n",
+                    t->base_ns, t->cycle_ns, t->offset_ns, t->per_cycle);
         }
+    }
 
-        tc_idx++;
-        next_send += interval_ns;
+    if (p->mode == MODE_SWEEP) send_sweep(p, tx);
+    else send_fixed_rate(p, tx, tcs, num_tcs, interval_ns);
+
+    tsn_tx_finish(tx);
+
+    // The TX thread owns its counters; publish them once the loop is done so
+    // the TX and RX threads never write the same cache lines
+    const tsn_tx_stats_t *st = tsn_tx_stats(tx);
+    for (int t = 0; t < MAX_TC; t++) p->tc_data[t].tx_count = st->packets[t];
+    tsn_tx_instr(tx, &p->tx_instr);
+    p->tx_instr.tx_late = p->pacer.late;
+
+    if (config.pacing == PACING_TXTIME && config.verbose) {
+        fprintf(stderr, "TX %s: %lu frames dropped by ETF (missed/invalid launch time)\n",
+                p->tx_iface, st->txtime_dropped);
+    } else if (config.verbose) {
+        tsn_pctl_t e;
+        tsn_hist_pctl(&p->pacer.error, &e);
+        fprintf(stderr, "TX %s: %s pacing, send-time error p50 %.1f us, p99 %.1f us, max %.1f us, "
+                "%lu frames caught up\n", p->tx_iface, tsn_pace_mode_name(config.pace_mode),
+                e.p50, e.p99, e.max, p->pacer.catchup);
     }
 
-    close(sock);
+    tsn_tx_close(tx);
     return NULL;
 }
 
-// RX callback
-static void rx_callback(u_char *user, const struct pcap_pkthdr *hdr, const u_char *pkt) {
-    (void)user;
-
-    if (hdr->caplen < 18) return;
-
-    uint16_t ethertype = (pkt[12] << 8) | pkt[13];
-    if (ethertype != 0x8100) return;
-
-    uint16_t tci = (pkt[14] << 8) | pkt[15];
-    int pcp = (tci >> 13) & 0x07;
-    int vid = tci & 0x0FFF;
-
-    if (config.vlan_id > 0 && vid != config.vlan_id) return;
-
-    uint64_t ts_ns = (uint64_t)hdr->ts.tv_sec * 1000000000ULL +
-                     (uint64_t)hdr->ts.tv_usec * 1000ULL;
+// Matrix: index of the pair whose TX uses src, n_pairs for none
+static int pair_of_mac(const uint8_t *src) {
+    for (int i = 0; i < n_pairs; i++) {
+        if (memcmp(pairs[i].tx_mac, src, 6) == 0) return i;
+    }
+    return n_pairs;
+}
 
-    pthread_mutex_lock(&data_mutex);
+// RX callback
+// Only the RX thread writes packet data and main reads it after join, so no lock
+static void rx_callback(void *user, const tsn_packet_t *hdr) {
+    pair_t *p = user;
+
+    tsn_vlan_t vlan;
+    if (tsn_parse_vlan(hdr->data, hdr->caplen, &vlan) < 0) return;
+    if (p->vlan_id > 0 && vlan.vid != p->vlan_id) return;
+
+    // Matrix: other pairs' frames (flooded, misforwarded) are counted, not analyzed
+    if (matrix && memcmp(hdr->data + 6, p->tx_mac, 6) != 0) {
+        // Every fan-out worker of the pair counts here
+        __atomic_fetch_add(&p->foreign[pair_of_mac(hdr->data + 6)], 1, __ATOMIC_RELAXED);
+        return;
+    }
 
-    tc_data_t *tc = &tc_data[pcp];
-    if (tc->packet_count < MAX_PACKETS) {
-        packet_t *p = &tc->packets[tc->packet_count];
-        p->ts_ns = ts_ns;
-        p->len = hdr->len;
-        tc->packet_count++;
-        tc->total_bytes += hdr->len;
+    tc_data_t *tc = &p->tc_data[vlan.pcp];
+    tsn_stream_add(&tc->stream, hdr->ts_ns, hdr->len);
+    __atomic_store_n(&tc->rx_bytes, tc->rx_bytes + hdr->len, __ATOMIC_RELAXED);
 
-        if (tc->first_ts == 0) tc->first_ts = ts_ns;
-        tc->last_ts = ts_ns;
+    tsn_test_hdr_t th;
+    if (tsn_test_hdr_parse(hdr->data, hdr->caplen, &th) == 0) {
+        tsn_seq_add(&tc->seq, th.seq, (int64_t)(hdr->ts_ns - th.tx_ns));
     }
-
-    pthread_mutex_unlock(&data_mutex);
 }
 
 // RX thread
+// With --rx-workers N the frames fan out by PCP over N pinned workers; each
+// TC still has a single writer, so rx_callback needs no lock either way
+// (the matrix foreign counts, shared by the workers, are atomic).
+// A file group splits the same way and ends at the end of the file.
 static void *rx_thread(void *arg) {
-    (void)arg;
+    pair_t *p = arg;
 
-    char errbuf[PCAP_ERRBUF_SIZE];
-    rx_handle = pcap_open_live(config.rx_iface, 128, 1, 1, errbuf);
-    if (!rx_handle) {
+    char errbuf[256];
+    tsn_capture_group_t *g;
+    if (config.read_file) {
+        g = tsn_capture_group_open_file(config.read_file, config.rx_workers, errbuf);
+    } else {
+        tsn_capture_opts_t opts;
+        tsn_capture_opts_init(&opts);
+        g = tsn_capture_group_open(p->rx_iface, &opts, config.rx_workers, errbuf);
+    }
+    if (!g) {
         fprintf(stderr, "RX error: %s\n", errbuf);
         return NULL;
     }
+    tsn_capture_t *cap = tsn_capture_group_member(g, 0);
+    p->rx_ts_resolution_ns = tsn_capture_ts_resolution_ns(cap);
 
-    struct bpf_program fp;
     char filter[64];
-    snprintf(filter, sizeof(filter), "vlan %d", config.vlan_id);
-    if (pcap_compile(rx_handle, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) == 0) {
-        pcap_setfilter(rx_handle, &fp);
-        pcap_freecode(&fp);
-    }
+    snprintf(filter, sizeof(filter), "vlan %d", p->vlan_id);
+    tsn_capture_group_set_filter(g, filter);
 
     if (config.verbose) {
-        fprintf(stderr, "RX: Capturing on %s (VLAN %d)\n", config.rx_iface, config.vlan_id);
+        fprintf(stderr, "RX: %s %s (VLAN %d, %s, %s timestamps, %d worker%s)\n",
+                config.read_file ? "Reading" : "Capturing on",
+                config.read_file ? config.read_file : p->rx_iface, p->vlan_id, tsn_capture_backend_name(cap),
+                tsn_capture_ts_source(cap), config.rx_workers, config.rx_workers > 1 ? "s" : "");
     }
 
-    while (running) {
-        pcap_dispatch(rx_handle, 100, rx_callback, NULL);
+    // Workers go one per CPU from the pair's RX CPU, or from CPU 0 when fanned out
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int cpus[TSN_CAPTURE_MAX_WORKERS];
+    void *users[TSN_CAPTURE_MAX_WORKERS];
+    bool pin = p->rx_cpu >= 0 || config.rx_workers > 1;
+    for (int i = 0; i < config.rx_workers; i++) {
+        cpus[i] = ((p->rx_cpu >= 0 ? p->rx_cpu : 0) + i) % ncpu;
+        users[i] = p;
+    }
+    p->rx_group = g;
+    if (config.read_file) {
+        tsn_capture_group_run(g, rx_callback, users, pin ? cpus : NULL, &running);
+    } else if (tsn_capture_group_start(g, rx_callback, users, pin ? cpus : NULL) < 0) {
+        fprintf(stderr, "RX error: cannot start workers\n");
+    } else {
+        while (running) usleep(1000);
+        tsn_capture_group_stop(g);
+    }
+
+    if (config.verbose && config.rx_workers > 1) {
+        for (int i = 0; i < config.rx_workers; i++) {
+            fprintf(stderr, "RX: worker %d (CPU %d): %lu packets\n",
+                    i, cpus[i], tsn_capture_group_packets(g, i));
+        }
     }
 
-    pcap_close(rx_handle);
+    tsn_capture_group_instr(g, &p->rx_instr);
+    p->rx_group = NULL;
+    tsn_capture_group_close(g);
     return NULL;
 }
 
-// Detect bursts for CBS
-static void detect_bursts(tc_data_t *tc) {
-    if (tc->packet_count < 2) return;
+// Analyze CBS
+static void analyze_cbs(tc_data_t *tc) {
+    if (tc->stream.count < 10) return;
 
-    uint64_t gap_threshold = 500000;  // 500us
+    tsn_burst_stats_t bs;
+    tsn_burst_stats(&tc->stream, &bs);
+    if (bs.measured_bps <= 0) return;
 
-    burst_t *b = &tc->bursts[0];
-    b->start_ns = tc->packets[0].ts_ns;
-    b->bytes = tc->packets[0].len;
-    b->packets = 1;
-    tc->burst_count = 1;
+    tc->measured_bps = bs.measured_bps;
+    tc->burst_ratio = bs.burst_ratio;
+    tc->is_shaped = (tc->burst_ratio < 0.85) && (tc->stream.burst_count > 3);
+    tc->estimated_idle_slope = tc->measured_bps;
+}
 
-    for (int i = 1; i < tc->packet_count && tc->burst_count < MAX_BURSTS; i++) {
-        uint64_t gap = tc->packets[i].ts_ns - tc->packets[i-1].ts_ns;
+// Streams split bursts at 500us gaps. For TAS they keep an arrival sample for
+// the cycle search, and an expected cycle gets a running phase histogram.
+static int init_stream(const pair_t *p, tc_data_t *tc) {
+    tsn_stream_init(&tc->stream, 500000, 0);
+    if (p->mode == MODE_CBS || p->mode == MODE_SWEEP) return 0;
+    if (tsn_stream_keep_arrivals(&tc->stream, TSN_CYCLE_SAMPLES) < 0) return -1;
+    if (p->expected_cycle_ms > 0) {
+        return tsn_stream_add_phase(&tc->stream, (uint64_t)(p->expected_cycle_ms * 1e6),
+                                    TAS_BINS, 0);
+    }
+    return 0;
+}
 
-        if (gap > gap_threshold) {
-            b->end_ns = tc->packets[i-1].ts_ns;
-            tc->burst_count++;
-            b = &tc->bursts[tc->burst_count - 1];
-            b->start_ns = tc->packets[i].ts_ns;
-            b->bytes = tc->packets[i].len;
-            b->packets = 1;
-        } else {
-            b->bytes += tc->packets[i].len;
-            b->packets++;
-        }
+// Detect TAS cycle
+static uint64_t detect_cycle(pair_t *p) {
+    tsn_stream_t streams[MAX_TC];
+    for (int t = 0; t < MAX_TC; t++) streams[t] = p->tc_data[t].stream;
+
+    if (p->expected_cycle_ms > 0) {
+        uint64_t cycle_ns = (uint64_t)(p->expected_cycle_ms * 1e6);
+        p->cycle_confidence = tsn_cycle_confidence(streams, MAX_TC, cycle_ns, 50);
+        return cycle_ns;
     }
-    b->end_ns = tc->packets[tc->packet_count - 1].ts_ns;
+
+    tsn_cycle_t c;
+    if (tsn_cycle_search(streams, MAX_TC, MIN_CYCLE_NS, MAX_CYCLE_NS, 50,
+                         p->rx_ts_resolution_ns, &c) < 0) return 0;
+    p->cycle_confidence = c.confidence;
+    return c.cycle_ns;
 }
 
-// Analyze CBS
-static void analyze_cbs(tc_data_t *tc) {
-    if (tc->packet_count < 10) return;
+// Analyze TAS: the window spans the first to the last busy phase bin
+static void analyze_tas(tc_data_t *tc, uint64_t cycle_ns) {
+    if (tc->stream.count < 10 || cycle_ns == 0) return;
+
+    // Running histogram for an expected cycle, folded arrival sample otherwise
+    uint32_t folded[TAS_BINS];
+    const uint32_t *bins = folded;
+    int n_bins = TAS_BINS;
+    uint64_t count = tc->stream.n_arrivals;
+    const tsn_phase_hist_t *hist = tsn_stream_phase(&tc->stream, cycle_ns);
+    if (hist) {
+        bins = hist->bins;
+        n_bins = hist->n_bins;
+        count = hist->count;
+    } else {
+        tsn_cycle_fold(&tc->stream, (double)cycle_ns, n_bins, folded);
+    }
 
-    double duration_s = (tc->last_ts - tc->first_ts) / 1e9;
-    if (duration_s <= 0) return;
+    // Find window
+    double mean = (double)count / n_bins;
+    uint32_t threshold = (uint32_t)(mean * 0.3);
+    if (threshold < 1) threshold = 1;
 
-    tc->measured_bps = (tc->total_bytes * 8.0) / duration_s;
+    int start = -1, end = -1;
+    for (int i = 0; i < n_bins; i++) {
+        if (bins[i] >= threshold) {
+            if (start < 0) start = i;
+            end = i;
+        }
+    }
 
-    double total_burst = 0;
-    for (int i = 0; i < tc->burst_count; i++) {
-        total_burst += (tc->bursts[i].end_ns - tc->bursts[i].start_ns) / 1e3;
+    if (start >= 0) {
+        double bin_us = cycle_ns / 1000.0 / n_bins;
+        tc->window_start_us = start * bin_us;
+        tc->window_duration_us = (end - start + 1) * bin_us;
     }
+}
 
-    double total_time = duration_s * 1e6;
-    tc->burst_ratio = total_burst / total_time;
+// Sweep controller, on the main thread while TX and RX run
 
-    tc->is_shaped = (tc->burst_ratio < 0.85) && (tc->burst_count > 3);
-    tc->estimated_idle_slope = tc->measured_bps;
+static void sweep_set_rates(const double *offered_kbps, int frame_len) {
+    for (int t = 0; t < MAX_TC; t++) {
+        uint64_t interval = offered_kbps[t] > 0 ? (uint64_t)(frame_len * 8.0 * 1e6 / offered_kbps[t]) : 0;
+        __atomic_store_n(&sweep_tx.interval_ns[t], interval, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&sweep_tx.gen, 1, __ATOMIC_RELEASE);
 }
 
-// Detect TAS cycle
-static uint64_t detect_cycle(void) {
-    uint64_t candidates[] = {
-        1000000, 2000000, 5000000, 10000000,
-        20000000, 50000000, 100000000, 200000000
-    };
-    int n = sizeof(candidates) / sizeof(candidates[0]);
-
-    if (config.expected_cycle_ms > 0) {
-        return (uint64_t)(config.expected_cycle_ms * 1e6);
+// Idle slopes in --tc order, or one value for all TCs; link share if unset
+static int sweep_init(const int *tcs, int num_tcs) {
+    double v[MAX_TC];
+    int n = 0;
+    const char *p = config.idle_slope;
+    while (*p && n < MAX_TC) {
+        char *end;
+        v[n] = strtod(p, &end);
+        if (end == p || v[n] <= 0) return -1;
+        n++;
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return -1;
     }
+    if (n > 1 && n != num_tcs) return -1;
 
-    double best_score = 0;
-    uint64_t best = 0;
+    for (int i = 0; i < num_tcs; i++) {
+        int t = tcs[i];
+        sweep[t].nominal_kbps = n == 0 ? config.link_speed_mbps * 1000 / num_tcs : v[n == 1 ? 0 : i];
+        sweep[t].sat_point = -1;
+    }
+    if (n == 0) {
+        fprintf(stderr, "Sweep: no --idle-slope, centring on the link share (%.0f kbps/TC)\n",
+                config.link_speed_mbps * 1000 / num_tcs);
+    }
+    return 0;
+}
 
-    for (int c = 0; c < n; c++) {
-        uint64_t cycle = candidates[c];
-        double score = 0;
-        int tc_count = 0;
+static void run_sweep(const int *tcs, int num_tcs, int frame_len) {
+    tc_data_t *tc_data = pairs[0].tc_data;
+
+    for (int step = 0; step < config.sweep_steps && running; step++) {
+        double factor = config.sweep_steps > 1
+            ? config.sweep_lo + (config.sweep_hi - config.sweep_lo) * step / (config.sweep_steps - 1)
+            : config.sweep_lo;
+
+        // TCs that saturated for good sit the rest of the sweep out
+        double offered[MAX_TC] = {0};
+        int active = 0;
+        for (int i = 0; i < num_tcs; i++) {
+            int t = tcs[i];
+            if (sweep[t].sat_steps >= SWEEP_SAT_STEPS) continue;
+            offered[t] = sweep[t].nominal_kbps * factor;
+            active++;
+        }
+        if (!active) break;
+
+        sweep_set_rates(offered, frame_len);
+        uint64_t start = tsn_time_ns();
+        usleep(SWEEP_SETTLE_MS * 1000);
+
+        // The last SWEEP_CONVERGE window rates per TC, in a ring
+        double win[MAX_TC][SWEEP_CONVERGE];
+        uint64_t prev_bytes[MAX_TC];
+        for (int t = 0; t < MAX_TC; t++) prev_bytes[t] = __atomic_load_n(&tc_data[t].rx_bytes, __ATOMIC_RELAXED);
+        uint64_t prev_ns = tsn_time_ns();
+        int n_win = 0;
+        bool converged = false;
+
+        while (running) {
+            usleep(SWEEP_WINDOW_MS * 1000);
+            uint64_t now = tsn_time_ns();
+            for (int t = 0; t < MAX_TC; t++) {
+                uint64_t b = __atomic_load_n(&tc_data[t].rx_bytes, __ATOMIC_RELAXED);
+                win[t][n_win % SWEEP_CONVERGE] = (b - prev_bytes[t]) * 8.0 * 1e6 / (now - prev_ns);
+                prev_bytes[t] = b;
+            }
+            prev_ns = now;
+            n_win++;
+
+            if (n_win >= SWEEP_CONVERGE) {
+                converged = true;
+                for (int t = 0; t < MAX_TC && converged; t++) {
+                    if (offered[t] <= 0) continue;
+                    double lo = win[t][0], hi = win[t][0], sum = 0;
+                    for (int k = 0; k < SWEEP_CONVERGE; k++) {
+                        if (win[t][k] < lo) lo = win[t][k];
+                        if (win[t][k] > hi) hi = win[t][k];
+                        sum += win[t][k];
+                    }
+                    if (hi - lo > sum / SWEEP_CONVERGE * config.converge_pct / 100) converged = false;
+                }
+            }
+            if (converged || (now - start) / 1e6 >= config.step_ms) break;
+        }
+        if (n_win == 0) break;
 
+        double ms = (tsn_time_ns() - start) / 1e6;
+        int k_n = n_win < SWEEP_CONVERGE ? n_win : SWEEP_CONVERGE;
         for (int t = 0; t < MAX_TC; t++) {
-            tc_data_t *tc = &tc_data[t];
-            if (tc->packet_count < 50) continue;
-            tc_count++;
-
-            int bins[50] = {0};
-            uint64_t bin_size = cycle / 50;
-
-            for (int i = 0; i < tc->packet_count; i++) {
-                int bin = ((tc->packets[i].ts_ns - tc->first_ts) % cycle) / bin_size;
-                if (bin < 50) bins[bin]++;
+            if (offered[t] <= 0) continue;
+            double sum = 0;
+            for (int k = 0; k < k_n; k++) sum += win[t][k];
+
+            sweep_point_t *pt = &sweep[t].curve[sweep[t].n_points];
+            pt->offered_kbps = offered[t];
+            pt->measured_kbps = sum / k_n;
+            pt->ms = ms;
+            pt->converged = converged;
+
+            // Saturated only if it holds for consecutive steps
+            if (pt->measured_kbps < pt->offered_kbps * (1 - SWEEP_SAT_PCT / 100)) {
+                if (sweep[t].sat_steps++ == 0) sweep[t].sat_point = sweep[t].n_points;
+            } else {
+                sweep[t].sat_steps = 0;
+                sweep[t].sat_point = -1;
             }
+            sweep[t].n_points++;
 
-            double mean = (double)tc->packet_count / 50;
-            double var = 0;
-            for (int b = 0; b < 50; b++) {
-                double d = bins[b] - mean;
-                var += d * d;
+            if (config.verbose) {
+                fprintf(stderr, "Sweep: TC%d offered %.1f kbps, measured %.1f kbps (%.0f ms%s)\n",
+                        t, pt->offered_kbps, pt->measured_kbps, ms, converged ? "" : ", not converged");
             }
-            score += var / (mean * mean + 0.001);
         }
+    }
+
+    double off[MAX_TC] = {0};
+    sweep_set_rates(off, frame_len);
+}
 
-        if (tc_count > 0 && score / tc_count > best_score) {
-            best_score = score / tc_count;
-            best = cycle;
+// Plateau: mean delivered rate over the saturated steps, peak if none
+static double sweep_plateau(int t) {
+    double sum = 0, peak = 0;
+    int n = 0;
+    for (int i = 0; i < sweep[t].n_points; i++) {
+        double m = sweep[t].curve[i].measured_kbps;
+        if (m > peak) peak = m;
+        if (sweep[t].sat_point >= 0 && i >= sweep[t].sat_point) {
+            sum += m;
+            n++;
         }
     }
+    return n ? sum / n : peak;
+}
+
+// Print results
+
+// "<name>_p50_us" ... "<name>_max_us" members
+static void print_pctl_json(const char *name, const tsn_pctl_t *p) {
+    printf(",\"%s_p50_us\":%.1f,\"%s_p90_us\":%.1f,\"%s_p99_us\":%.1f,"
+           "\"%s_p999_us\":%.1f,\"%s_max_us\":%.1f",
+           name, p->p50, name, p->p90, name, p->p99, name, p->p999, name, p->max);
+}
 
-    return best;
+// Loss / duplicate / reorder / latency / jitter members of a TC's JSON object
+static void print_seq_json(const tc_data_t *tc) {
+    tsn_seq_stats_t q;
+    tsn_seq_stats(&tc->seq, &q);
+    printf(",\"lost\":%lu,\"dup\":%lu,\"reorder\":%lu,"
+           "\"lat_min_us\":%.1f,\"lat_avg_us\":%.1f",
+           q.lost, q.duplicates, q.reordered, q.lat_min_us, q.lat_avg_us);
+    print_pctl_json("lat", &q.lat);
+
+    tsn_pctl_t ia;
+    tsn_hist_pctl(&tc->stream.interval_hist, &ia);
+    print_pctl_json("interval", &ia);
 }
 
-// Analyze TAS
-static void analyze_tas(tc_data_t *tc, uint64_t cycle_ns, int tc_idx) {
-    if (tc->packet_count < 10 || cycle_ns == 0) return;
+static void print_seq_table(const pair_t *p) {
+    printf("┌────┬────────┬───────┬─────────┬──────────┬──────────┬──────────┬──────────┬──────────┐\n");
+    printf("│ TC │  Lost  │  Dup  │ Reorder │ Lat min  │ Lat p50  │ Lat p99  │ Lat p99.9│ Lat max  │\n");
+    printf("│    │        │       │         │   (us)   │   (us)   │   (us)   │   (us)   │   (us)   │\n");
+    printf("├────┼────────┼───────┼─────────┼──────────┼──────────┼──────────┼──────────┼──────────┤\n");
 
-    int n_bins = 100;
-    uint64_t bin_size = cycle_ns / n_bins;
-    memset(tc->histogram, 0, sizeof(tc->histogram));
-    tc->histogram_size = n_bins;
+    for (int t = 0; t < MAX_TC; t++) {
+        tsn_seq_stats_t q;
+        tsn_seq_stats(&p->tc_data[t].seq, &q);
+        if (q.received == 0) continue;
 
-    for (int i = 0; i < tc->packet_count; i++) {
-        int bin = ((tc->packets[i].ts_ns - tc->first_ts) % cycle_ns) / bin_size;
-        if (bin < n_bins) tc->histogram[bin]++;
+        printf("│ %2d │ %6lu │ %5lu │ %7lu │ %8.1f │ %8.1f │ %8.1f │ %8.1f │ %8.1f │\n",
+               t, q.lost, q.duplicates, q.reordered,
+               q.lat_min_us, q.lat.p50, q.lat.p99, q.lat.p999, q.lat_max_us);
     }
+    printf("└────┴────────┴───────┴─────────┴──────────┴──────────┴──────────┴──────────┴──────────┘\n\n");
+}
 
-    // Find window
-    double mean = (double)tc->packet_count / n_bins;
-    int threshold = (int)(mean * 0.3);
-    if (threshold < 1) threshold = 1;
+// ,"tx_pacing":{...} for the JSON results (nothing if the pacer did not run)
+static void print_tx_pacing_json(const pair_t *p) {
+    const tsn_pacer_t *tx_pacer = &p->pacer;
+    if (tx_pacer->slots == 0) return;
+    tsn_pctl_t e;
+    tsn_hist_pctl(&tx_pacer->error, &e);
+    printf(",\"tx_pacing\":{\"mode\":\"%s\",\"slack_us\":%.1f,\"send_error_us\":{\"p50\":%.3f,"
+           "\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f},\"catchup_frames\":%lu}",
+           tsn_pace_mode_name(tx_pacer->mode), tx_pacer->slack_ns / 1000.0, e.p50, e.p90, e.p99, e.p999,
+           e.max, tx_pacer->catchup);
+}
 
-    int start = -1, end = -1;
-    for (int i = 0; i < n_bins; i++) {
-        if (tc->histogram[i] >= threshold) {
-            if (start < 0) start = i;
-            end = i;
-        }
-    }
+static void pair_instr(const pair_t *p, tsn_instr_t *in) {
+    *in = p->tx_instr;
+    tsn_instr_merge(in, &p->rx_instr);
+    tsn_stage_merge(&in->stage[TSN_STAGE_ANALYSIS], &p->analysis);
+}
 
-    if (start >= 0) {
-        tc->window_start_us = start * (bin_size / 1000.0);
-        tc->window_duration_us = (end - start + 1) * (bin_size / 1000.0);
+// ,"instrumentation":{...}: drops and late sends on both sides of the pair
+static void print_instr_json(const pair_t *p) {
+    tsn_instr_t in;
+    pair_instr(p, &in);
+    printf(",");
+    tsn_instr_print_json(stdout, &in);
+}
+
+static void print_instr_human(const pair_t *p) {
+    tsn_instr_t in;
+    pair_instr(p, &in);
+    tsn_instr_print_human(stdout, &in);
+    printf("\n");
+}
+
+// CBS results of one pair as a JSON object (no newline)
+static void print_cbs_json(const pair_t *p) {
+    double link_bps = config.link_speed_mbps * 1e6;
+
+    printf("{\"mode\":\"cbs\",\"vlan\":%d,\"link_mbps\":%.0f,\"tc\":{",
+           p->vlan_id, config.link_speed_mbps);
+
+    int first = 1;
+    for (int t = 0; t < MAX_TC; t++) {
+        const tc_data_t *tc = &p->tc_data[t];
+        if (tc->stream.count < 10) continue;
+        if (!first) printf(",");
+        first = 0;
+
+        printf("\"%d\":{\"tx\":%lu,\"rx\":%lu,\"kbps\":%.1f,\"shaped\":%s,"
+               "\"idle_slope_kbps\":%.1f,\"bw_pct\":%.2f",
+               t, tc->tx_count, tc->stream.count, tc->measured_bps/1000,
+               tc->is_shaped ? "true" : "false",
+               tc->estimated_idle_slope/1000,
+               tc->estimated_idle_slope/link_bps*100);
+        print_seq_json(tc);
+        printf("}");
     }
+    printf("}");
+    print_tx_pacing_json(p);
+    print_instr_json(p);
+    printf("}");
 }
 
-// Print results
-static void print_cbs_results(void) {
+static void print_cbs_results(const pair_t *p) {
     double link_bps = config.link_speed_mbps * 1e6;
 
     if (config.json_output) {
-        printf("{\"mode\":\"cbs\",\"vlan\":%d,\"link_mbps\":%.0f,\"tc\":{",
-               config.vlan_id, config.link_speed_mbps);
+        print_cbs_json(p);
+        printf("\n");
+        return;
+    }
 
-        int first = 1;
-        for (int t = 0; t < MAX_TC; t++) {
-            tc_data_t *tc = &tc_data[t];
-            if (tc->packet_count < 10) continue;
-            if (!first) printf(",");
-            first = 0;
-
-            printf("\"%d\":{\"tx\":%lu,\"rx\":%d,\"kbps\":%.1f,\"shaped\":%s,"
-                   "\"idle_slope_kbps\":%.1f,\"bw_pct\":%.2f}",
-                   t, tc->tx_count, tc->packet_count, tc->measured_bps/1000,
-                   tc->is_shaped ? "true" : "false",
-                   tc->estimated_idle_slope/1000,
-                   tc->estimated_idle_slope/link_bps*100);
-        }
-        printf("}}\n");
-    } else {
+    printf("\n");
+    printf("══════════════════════════════════════════════════════════════\n");
+    printf("          CBS Configuration Verification Results              \n");
+    printf("══════════════════════════════════════════════════════════════\n");
+    printf("Link: %.0f Mbps  VLAN: %d  Duration: %d sec\n\n", config.link_speed_mbps, p->vlan_id, config.duration);
+
+    printf("┌────┬────────┬────────┬──────────┬─────────┬─────────────┬─────────┐\n");
+    printf("│ TC │   TX   │   RX   │   Kbps   │ Shaped  │ IdleSlope   │   BW    │\n");
+    printf("├────┼────────┼────────┼──────────┼─────────┼─────────────┼─────────┤\n");
+
+    for (int t = 0; t < MAX_TC; t++) {
+        const tc_data_t *tc = &p->tc_data[t];
+        if (tc->stream.count < 10 && tc->tx_count == 0) continue;
+
+        double loss = tc->tx_count > 0 ? 100.0 * (1 - (double)tc->stream.count / tc->tx_count) : 0;
+
+        printf("│ %2d │ %6lu │ %6lu │ %8.1f │   %s   │ %9.1f K │ %5.2f%% │\n",
+               t, tc->tx_count, tc->stream.count, tc->measured_bps/1000,
+               tc->is_shaped ? "YES" : " NO",
+               tc->estimated_idle_slope/1000,
+               tc->estimated_idle_slope/link_bps*100);
+    }
+    printf("└────┴────────┴────────┴──────────┴─────────┴─────────────┴─────────┘\n\n");
+}
+
+// TAS results of one pair as a JSON object (no newline)
+static void print_tas_json(const pair_t *p) {
+    printf("{\"mode\":\"tas\",\"vlan\":%d,\"cycle_ms\":%.3f,\"cycle_confidence\":%.3f,\"tc\":{",
+           p->vlan_id, p->estimated_cycle_ns/1e6, p->cycle_confidence);
+
+    int first = 1;
+    for (int t = 0; t < MAX_TC; t++) {
+        const tc_data_t *tc = &p->tc_data[t];
+        if (tc->stream.count < 10) continue;
+        if (!first) printf(",");
+        first = 0;
+
+        printf("\"%d\":{\"tx\":%lu,\"rx\":%lu,\"window_start_us\":%.1f,\"window_dur_us\":%.1f",
+               t, tc->tx_count, tc->stream.count, tc->window_start_us, tc->window_duration_us);
+        print_seq_json(tc);
+        printf("}");
+    }
+    printf("}");
+    print_tx_pacing_json(p);
+    print_instr_json(p);
+    printf("}");
+}
+
+static void print_tas_results(const pair_t *p) {
+    if (config.json_output) {
+        print_tas_json(p);
         printf("\n");
-        printf("══════════════════════════════════════════════════════════════\n");
-        printf("          CBS Configuration Verification Results              \n");
-        printf("══════════════════════════════════════════════════════════════\n");
-        printf("Link: %.0f Mbps  VLAN: %d  Duration: %d sec\n\n", config.link_speed_mbps, config.vlan_id, config.duration);
+        return;
+    }
 
-        printf("┌────┬────────┬────────┬──────────┬─────────┬─────────────┬─────────┐\n");
-        printf("│ TC │   TX   │   RX   │   Kbps   │ Shaped  │ IdleSlope   │   BW    │\n");
-        printf("├────┼────────┼────────┼──────────┼─────────┼─────────────┼─────────┤\n");
+    printf("\n");
+    printf("══════════════════════════════════════════════════════════════\n");
+    printf("           TAS Configuration Verification Results             \n");
+    printf("══════════════════════════════════════════════════════════════\n");
+    printf("VLAN: %d  Detected Cycle: %.3f ms  Confidence: %.2f\n\n",
+           p->vlan_id, p->estimated_cycle_ns/1e6, p->cycle_confidence);
 
-        for (int t = 0; t < MAX_TC; t++) {
-            tc_data_t *tc = &tc_data[t];
-            if (tc->packet_count < 10 && tc->tx_count == 0) continue;
+    printf("┌────┬────────┬────────┬─────────────┬─────────────┐\n");
+    printf("│ TC │   TX   │   RX   │ Window Start│ Window Dur  │\n");
+    printf("│    │        │        │     (us)    │    (us)     │\n");
+    printf("├────┼────────┼────────┼─────────────┼─────────────┤\n");
+
+    for (int t = 0; t < MAX_TC; t++) {
+        const tc_data_t *tc = &p->tc_data[t];
+        if (tc->stream.count < 10 && tc->tx_count == 0) continue;
 
-            double loss = tc->tx_count > 0 ? 100.0 * (1 - (double)tc->packet_count / tc->tx_count) : 0;
+        printf("│ %2d │ %6lu │ %6lu │ %11.1f │ %11.1f │\n",
+               t, tc->tx_count, tc->stream.count, tc->window_start_us, tc->window_duration_us);
+    }
+    printf("└────┴────────┴────────┴─────────────┴─────────────┘\n\n");
+}
 
-            printf("│ %2d │ %6lu │ %6d │ %8.1f │   %s   │ %9.1f K │ %5.2f%% │\n",
-                   t, tc->tx_count, tc->packet_count, tc->measured_bps/1000,
-                   tc->is_shaped ? "YES" : " NO",
-                   tc->estimated_idle_slope/1000,
-                   tc->estimated_idle_slope/link_bps*100);
+// Sweep results as a JSON object (no newline)
+static void print_sweep_json(const pair_t *p) {
+    printf("{\"mode\":\"sweep\",\"vlan\":%d,\"link_mbps\":%.0f,\"frame_size\":%d,\"tc\":{",
+           p->vlan_id, config.link_speed_mbps, p->frame_size);
+
+    int first = 1;
+    for (int t = 0; t < MAX_TC; t++) {
+        const tc_data_t *tc = &p->tc_data[t];
+        if (sweep[t].n_points == 0) continue;
+        if (!first) printf(",");
+        first = 0;
+
+        bool sat = sweep[t].sat_point >= 0;
+        double plateau = sweep_plateau(t);
+        printf("\"%d\":{\"tx\":%lu,\"rx\":%lu,\"configured_kbps\":%.1f,\"saturated\":%s,"
+               "\"saturation_offered_kbps\":%.1f,\"plateau_kbps\":%.1f,\"error_pct\":%.2f",
+               t, tc->tx_count, tc->stream.count, sweep[t].nominal_kbps, sat ? "true" : "false",
+               sat ? sweep[t].curve[sweep[t].sat_point].offered_kbps : 0, plateau,
+               sat ? (plateau - sweep[t].nominal_kbps) / sweep[t].nominal_kbps * 100 : 0);
+        print_seq_json(tc);
+
+        printf(",\"curve\":[");
+        for (int i = 0; i < sweep[t].n_points; i++) {
+            const sweep_point_t *pt = &sweep[t].curve[i];
+            printf("%s{\"offered_kbps\":%.1f,\"measured_kbps\":%.1f,\"ms\":%.0f,\"converged\":%s}",
+                   i ? "," : "", pt->offered_kbps, pt->measured_kbps, pt->ms,
+                   pt->converged ? "true" : "false");
         }
-        printf("└────┴────────┴────────┴──────────┴─────────┴─────────────┴─────────┘\n\n");
+        printf("]}");
     }
+    printf("}");
+    print_tx_pacing_json(p);
+    print_instr_json(p);
+    printf("}");
 }
 
-static void print_tas_results(void) {
+static void print_sweep_results(const pair_t *p) {
     if (config.json_output) {
-        printf("{\"mode\":\"tas\",\"vlan\":%d,\"cycle_ms\":%.3f,\"tc\":{",
-               config.vlan_id, estimated_cycle_ns/1e6);
+        print_sweep_json(p);
+        printf("\n");
+        return;
+    }
 
-        int first = 1;
-        for (int t = 0; t < MAX_TC; t++) {
-            tc_data_t *tc = &tc_data[t];
-            if (tc->packet_count < 10) continue;
-            if (!first) printf(",");
-            first = 0;
+    printf("\n");
+    printf("══════════════════════════════════════════════════════════════\n");
+    printf("            CBS Idle-Slope Sweep Results                      \n");
+    printf("══════════════════════════════════════════════════════════════\n");
+    printf("Link: %.0f Mbps  VLAN: %d  Frame: %d bytes\n\n",
+           config.link_speed_mbps, p->vlan_id, p->frame_size);
+
+    printf("┌────┬─────────────┬─────────────┬─────────┬──────┐\n");
+    printf("│ TC │   Offered   │  Measured   │  Step   │ Conv │\n");
+    printf("│    │   (Kbps)    │   (Kbps)    │  (ms)   │      │\n");
+    printf("├────┼─────────────┼─────────────┼─────────┼──────┤\n");
+    for (int t = 0; t < MAX_TC; t++) {
+        for (int i = 0; i < sweep[t].n_points; i++) {
+            const sweep_point_t *pt = &sweep[t].curve[i];
+            printf("│ %2d │ %11.1f │ %11.1f │ %7.0f │ %s  │\n",
+                   t, pt->offered_kbps, pt->measured_kbps, pt->ms, pt->converged ? "YES" : " NO");
+        }
+    }
+    printf("└────┴─────────────┴─────────────┴─────────┴──────┘\n\n");
 
-            printf("\"%d\":{\"tx\":%lu,\"rx\":%d,\"window_start_us\":%.1f,\"window_dur_us\":%.1f}",
-                   t, tc->tx_count, tc->packet_count, tc->window_start_us, tc->window_duration_us);
+    printf("┌────┬─────────────┬─────────────┬─────────────┬─────────┐\n");
+    printf("│ TC │ Configured  │   Plateau   │ Saturates at│  Error  │\n");
+    printf("│    │   (Kbps)    │   (Kbps)    │   (Kbps)    │         │\n");
+    printf("├────┼─────────────┼─────────────┼─────────────┼─────────┤\n");
+    for (int t = 0; t < MAX_TC; t++) {
+        if (sweep[t].n_points == 0) continue;
+        double plateau = sweep_plateau(t);
+        if (sweep[t].sat_point >= 0) {
+            printf("│ %2d │ %11.1f │ %11.1f │ %11.1f │ %6.2f%% │\n",
+                   t, sweep[t].nominal_kbps, plateau,
+                   sweep[t].curve[sweep[t].sat_point].offered_kbps,
+                   (plateau - sweep[t].nominal_kbps) / sweep[t].nominal_kbps * 100);
+        } else {
+            printf("│ %2d │ %11.1f │ %11.1f │   not seen  │    -    │\n",
+                   t, sweep[t].nominal_kbps, plateau);
         }
-        printf("}}\n");
-    } else {
-        printf("\n");
-        printf("══════════════════════════════════════════════════════════════\n");
-        printf("           TAS Configuration Verification Results             \n");
-        printf("══════════════════════════════════════════════════════════════\n");
-        printf("VLAN: %d  Detected Cycle: %.3f ms\n\n", config.vlan_id, estimated_cycle_ns/1e6);
+    }
+    printf("└────┴─────────────┴─────────────┴─────────────┴─────────┘\n\n");
+}
 
-        printf("┌────┬────────┬────────┬─────────────┬─────────────┐\n");
-        printf("│ TC │   TX   │   RX   │ Window Start│ Window Dur  │\n");
-        printf("│    │        │        │     (us)    │    (us)     │\n");
-        printf("├────┼────────┼────────┼─────────────┼─────────────┤\n");
+// Matrix: every pair's tables, then the frames each RX saw from other pairs
+static void print_matrix_results(void) {
+    if (config.json_output) {
+        printf("{\"mode\":\"matrix\",\"pairs\":[");
+        for (int i = 0; i < n_pairs; i++) {
+            const pair_t *p = &pairs[i];
+            printf("%s{\"pair\":%d,\"tx_if\":\"%s\",\"rx_if\":\"%s\",\"tx_cpu\":%d,\"rx_cpu\":%d",
+                   i ? "," : "", i, p->tx_iface, p->rx_iface, p->tx_cpu, p->rx_cpu);
+            if (p->mode == MODE_CBS || p->mode == MODE_BOTH) {
+                printf(",\"cbs\":");
+                print_cbs_json(p);
+            }
+            if (p->mode == MODE_TAS || p->mode == MODE_BOTH) {
+                printf(",\"tas\":");
+                print_tas_json(p);
+            }
+            printf(",\"foreign_rx\":{");
+            int first = 1;
+            for (int j = 0; j < n_pairs; j++) {
+                if (p->foreign[j] == 0) continue;
+                printf("%s\"%d\":%lu", first ? "" : ",", j, p->foreign[j]);
+                first = 0;
+            }
+            printf("%s\"unknown\":%lu}}", first ? "" : ",", p->foreign[n_pairs]);
+        }
+        printf("]}\n");
+        return;
+    }
 
-        for (int t = 0; t < MAX_TC; t++) {
-            tc_data_t *tc = &tc_data[t];
-            if (tc->packet_count < 10 && tc->tx_count == 0) continue;
+    for (int i = 0; i < n_pairs; i++) {
+        const pair_t *p = &pairs[i];
+        printf("\n── Pair %d: %s -> %s (TX CPU %d, RX CPU %d) ──\n",
+               i, p->tx_iface, p->rx_iface, p->tx_cpu, p->rx_cpu);
+        if (p->mode == MODE_CBS || p->mode == MODE_BOTH) print_cbs_results(p);
+        if (p->mode == MODE_TAS || p->mode == MODE_BOTH) print_tas_results(p);
+        print_seq_table(p);
+        print_instr_human(p);
+
+        uint64_t total = 0;
+        for (int j = 0; j <= n_pairs; j++) total += p->foreign[j];
+        if (total == 0) continue;
+        printf("Frames from other pairs on %s:", p->rx_iface);
+        for (int j = 0; j < n_pairs; j++) {
+            if (p->foreign[j]) printf(" pair %d: %lu", j, p->foreign[j]);
+        }
+        if (p->foreign[n_pairs]) printf(" unknown source: %lu", p->foreign[n_pairs]);
+        printf("\n\n");
+    }
+}
+
+// Pair defaults: the global options
+static void pair_init(pair_t *p) {
+    memset(p, 0, sizeof(*p));
+    p->tx_iface = config.tx_iface;
+    p->rx_iface = config.rx_iface;
+    p->mode = config.mode;
+    snprintf(p->tc_list, sizeof(p->tc_list), "%s", config.tc_list);
+    p->pps = config.pps;
+    p->vlan_id = config.vlan_id;
+    p->frame_size = config.frame_size;
+    p->expected_cycle_ms = config.expected_cycle_ms;
+    snprintf(p->dst_mac, sizeof(p->dst_mac), "%s", config.dst_mac);
+    snprintf(p->src_mac, sizeof(p->src_mac), "%s", config.src_mac);
+    p->tx_cpu = -1;
+    p->rx_cpu = -1;
+}
 
-            printf("│ %2d │ %6lu │ %6d │ %11.1f │ %11.1f │\n",
-                   t, tc->tx_count, tc->packet_count, tc->window_start_us, tc->window_duration_us);
+// --pair "TX RX [key=value ...]" over pair_init() defaults; returns 0 or -1
+static int parse_pair(char *spec, pair_t *p) {
+    int n_ifaces = 0;
+    char *save;
+    for (char *w = strtok_r(spec, " ", &save); w; w = strtok_r(NULL, " ", &save)) {
+        char *v = strchr(w, '=');
+        if (!v) {
+            if (n_ifaces == 0) p->tx_iface = w;
+            else if (n_ifaces == 1) p->rx_iface = w;
+            else return -1;
+            n_ifaces++;
+            continue;
+        }
+        *v++ = '\0';
+        if (strcmp(w, "mode") == 0) {
+            if (strcmp(v, "cbs") == 0) p->mode = MODE_CBS;
+            else if (strcmp(v, "tas") == 0) p->mode = MODE_TAS;
+            else if (strcmp(v, "both") == 0) p->mode = MODE_BOTH;
+            else return -1;
+        } else if (strcmp(w, "tc") == 0) {
+            snprintf(p->tc_list, sizeof(p->tc_list), "%s", v);
+        } else if (strcmp(w, "pps") == 0) {
+            p->pps = atoi(v);
+        } else if (strcmp(w, "vlan") == 0) {
+            p->vlan_id = atoi(v);
+        } else if (strcmp(w, "size") == 0) {
+            p->frame_size = atoi(v);
+        } else if (strcmp(w, "cycle") == 0) {
+            p->expected_cycle_ms = atof(v);
+        } else if (strcmp(w, "dst") == 0) {
+            snprintf(p->dst_mac, sizeof(p->dst_mac), "%s", v);
+        } else if (strcmp(w, "src") == 0) {
+            snprintf(p->src_mac, sizeof(p->src_mac), "%s", v);
+        } else if (strcmp(w, "cpus") == 0) {
+            if (sscanf(v, "%d,%d", &p->tx_cpu, &p->rx_cpu) != 2) return -1;
+        } else {
+            return -1;
         }
-        printf("└────┴────────┴────────┴─────────────┴─────────────┘\n\n");
     }
+    return n_ifaces == 2 ? 0 : -1;
 }
 
 static void usage(const char *prog) {
     fprintf(stderr, "TSN Configuration Verification Tool\n\n");
     fprintf(stderr, "Usage: %s [options]\n\n", prog);
     fprintf(stderr, "Options:\n");
-    fprintf(stderr, "  --mode <cbs|tas|both>   Test mode (default: cbs)\n");
+    fprintf(stderr, "  --mode <cbs|tas|both|sweep>  Test mode (default: cbs)\n");
     fprintf(stderr, "  --tx-if <interface>     Transmit interface\n");
     fprintf(stderr, "  --rx-if <interface>     Receive interface\n");
     fprintf(stderr, "  --vlan <id>             VLAN ID (default: 100)\n");
@@ -648,10 +1137,40 @@ static void usage(const char *prog) {
     fprintf(stderr, "  --tc <list>             TC list (default: 0,1,2,3,4,5,6,7)\n");
     fprintf(stderr, "  --dst-mac <mac>         Destination MAC\n");
     fprintf(stderr, "  --src-mac <mac>         Source MAC (auto-detect if not set)\n");
+    fprintf(stderr, "  --pacing <mode>         TX pacing: hybrid, spin, sleep or txtime (default: hybrid)\n");
+    fprintf(stderr, "  --base-time <ns>        GCL base time for txtime pacing (CLOCK_TAI ns)\n");
+    fprintf(stderr, "  --tx-offset <us>        Launch offset inside each cycle (txtime)\n");
+    fprintf(stderr, "  --tx-window <us>        Span inside each cycle used for launches (txtime)\n");
+    fprintf(stderr, "  --lead <us>             Hand frames to ETF this early (default: 500)\n");
+    fprintf(stderr, "  --prio <n>              SO_PRIORITY for the TX socket (ETF queue)\n");
+    fprintf(stderr, "  --rx-workers <n>        Fan RX out by PCP over n pinned workers\n");
+    fprintf(stderr, "                          (default: 1, one per CPU with --read)\n");
+    fprintf(stderr, "  --read <file>           Verify a pcap/pcapng capture instead (no TX)\n");
+    fprintf(stderr, "  --frame-size <bytes>    Test frame size (default: 64)\n");
     fprintf(stderr, "  --json                  JSON output\n");
+    fprintf(stderr, "\nSweep (--mode sweep, spin pacing; --duration and --pps are not used):\n");
+    fprintf(stderr, "  --idle-slope <kbps,..>  Configured idle slope per TC in --tc order, or one\n");
+    fprintf(stderr, "                          for all (default: link speed / number of TCs)\n");
+    fprintf(stderr, "  --sweep-range <lo:hi>   Offered load as a factor of it (default: 0.5:1.5)\n");
+    fprintf(stderr, "  --sweep-steps <n>       Steps over the range (default: 11, max %d)\n", MAX_SWEEP_STEPS);
+    fprintf(stderr, "  --step-ms <ms>          Longest step; settled steps end early (default: 1000)\n");
+    fprintf(stderr, "  --converge-pct <pct>    Settled when the last %d %d ms windows agree this\n",
+            SWEEP_CONVERGE, SWEEP_WINDOW_MS);
+    fprintf(stderr, "                          closely (default: 2)\n");
+    fprintf(stderr, "\nMatrix (port pairs verified at once, each with its own TX and RX thread):\n");
+    fprintf(stderr, "  --pair \"<tx> <rx> [key=value ...]\"\n");
+    fprintf(stderr, "                          Add a pair; repeat for more (max %d). Keys: mode=cbs|tas|both\n", MAX_PAIRS);
+    fprintf(stderr, "                          tc=LIST pps=N vlan=ID size=N cycle=MS dst=MAC src=MAC\n");
+    fprintf(stderr, "                          cpus=TX,RX (default: pair i gets CPUs from (1 + RX\n");
+    fprintf(stderr, "                          workers) * i, TX first; RX workers go from RX on);\n");
+    fprintf(stderr, "                          unset keys take the options above. --tx-if/--rx-if,\n");
+    fprintf(stderr, "                          if given, are pair 0\n");
     fprintf(stderr, "  --verbose               Verbose output\n");
     fprintf(stderr, "\nExample:\n");
     fprintf(stderr, "  %s --mode cbs --tx-if enxc84d44263ba6 --rx-if enx00e04c6812d1 --duration 10\n", prog);
+    fprintf(stderr, "  %s --mode tas --read tap.pcapng --cycle 1\n", prog);
+    fprintf(stderr, "  %s --mode sweep --tx-if enx1 --rx-if enx2 --tc 2,3 --idle-slope 20000,40000\n", prog);
+    fprintf(stderr, "  %s --pair \"enp1s0 enp2s0 tc=1,2\" --pair \"enp3s0 enp4s0 mode=tas tc=5 cycle=1\"\n", prog);
 }
 
 int main(int argc, char *argv[]) {
@@ -667,19 +1186,39 @@ int main(int argc, char *argv[]) {
         {"tc", required_argument, 0, 'T'},
         {"dst-mac", required_argument, 0, 'D'},
         {"src-mac", required_argument, 0, 'S'},
+        {"pacing", required_argument, 0, 'P'},
+        {"base-time", required_argument, 0, 'B'},
+        {"tx-offset", required_argument, 0, 'O'},
+        {"tx-window", required_argument, 0, 'W'},
+        {"lead", required_argument, 0, 'L'},
+        {"prio", required_argument, 0, 'R'},
+        {"rx-workers", required_argument, 0, 'X'},
+        {"read", required_argument, 0, 'F'},
+        {"frame-size", required_argument, 0, 'z'},
+        {"idle-slope", required_argument, 0, 'I'},
+        {"sweep-range", required_argument, 0, 'G'},
+        {"sweep-steps", required_argument, 0, 'N'},
+        {"step-ms", required_argument, 0, 'M'},
+        {"converge-pct", required_argument, 0, 'C'},
+        {"pair", required_argument, 0, 'A'},
         {"json", no_argument, 0, 'j'},
         {"verbose", no_argument, 0, 'V'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
+    // --pair specs are parsed after the options they default to
+    char *pair_specs[MAX_PAIRS];
+    int n_specs = 0;
+
     int c;
-    while ((c = getopt_long(argc, argv, "m:t:r:v:d:p:l:c:T:D:S:jVh", long_opts, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "m:t:r:v:d:p:l:c:T:D:S:P:B:O:W:L:R:X:F:z:I:G:N:M:C:A:jVh", long_opts, NULL)) != -1) {
         switch (c) {
             case 'm':
                 if (strcmp(optarg, "cbs") == 0) config.mode = MODE_CBS;
                 else if (strcmp(optarg, "tas") == 0) config.mode = MODE_TAS;
                 else if (strcmp(optarg, "both") == 0) config.mode = MODE_BOTH;
+                else if (strcmp(optarg, "sweep") == 0) config.mode = MODE_SWEEP;
                 break;
             case 't': config.tx_iface = optarg; break;
             case 'r': config.rx_iface = optarg; break;
@@ -691,69 +1230,238 @@ int main(int argc, char *argv[]) {
             case 'T': strncpy(config.tc_list, optarg, sizeof(config.tc_list)-1); break;
             case 'D': strncpy(config.dst_mac, optarg, sizeof(config.dst_mac)-1); break;
             case 'S': strncpy(config.src_mac, optarg, sizeof(config.src_mac)-1); break;
+            case 'P':
+                if (strcmp(optarg, "txtime") == 0) {
+                    config.pacing = PACING_TXTIME;
+                } else if (tsn_pace_mode_parse(optarg, &config.pace_mode) == 0) {
+                    config.pacing = PACING_PACER;
+                } else {
+                    fprintf(stderr, "Error: unknown pacing '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'B': config.base_time_ns = strtoull(optarg, NULL, 10); break;
+            case 'O': config.tx_offset_us = atof(optarg); break;
+            case 'W': config.tx_window_us = atof(optarg); break;
+            case 'L': config.lead_us = atof(optarg); break;
+            case 'R': config.so_priority = atoi(optarg); break;
+            case 'X': config.rx_workers = atoi(optarg); break;
+            case 'F': config.read_file = optarg; break;
+            case 'z': config.frame_size = atoi(optarg); break;
+            case 'I': strncpy(config.idle_slope, optarg, sizeof(config.idle_slope)-1); break;
+            case 'G':
+                if (sscanf(optarg, "%lf:%lf", &config.sweep_lo, &config.sweep_hi) != 2) {
+                    fprintf(stderr, "Error: --sweep-range wants LO:HI\n");
+                    return 1;
+                }
+                break;
+            case 'N': config.sweep_steps = atoi(optarg); break;
+            case 'M': config.step_ms = atoi(optarg); break;
+            case 'C': config.converge_pct = atof(optarg); break;
+            case 'A':
+                if (n_specs == MAX_PAIRS) {
+                    fprintf(stderr, "Error: at most %d --pair\n", MAX_PAIRS);
+                    return 1;
+                }
+                pair_specs[n_specs++] = optarg;
+                break;
             case 'j': config.json_output = true; break;
             case 'V': config.verbose = true; break;
             case 'h': usage(argv[0]); return 0;
         }
     }
 
-    if (!config.tx_iface || !config.rx_iface) {
-        fprintf(stderr, "Error: Both --tx-if and --rx-if are required\n\n");
+    matrix = n_specs > 0;
+    if (!config.read_file && !matrix && (!config.tx_iface || !config.rx_iface)) {
+        fprintf(stderr, "Error: Both --tx-if and --rx-if are required (or --read, --pair)\n\n");
         usage(argv[0]);
         return 1;
     }
+    if (matrix && (config.read_file || config.mode == MODE_SWEEP)) {
+        fprintf(stderr, "Error: --pair runs live cbs/tas tests (no --read, no --mode sweep)\n");
+        return 1;
+    }
+
+    // Pair 0 from --tx-if/--rx-if (or --read), then one per --pair
+    n_pairs = 0;
+    if (!matrix || (config.tx_iface && config.rx_iface)) pair_init(&pairs[n_pairs++]);
+    for (int i = 0; i < n_specs; i++) {
+        if (n_pairs == MAX_PAIRS) {
+            fprintf(stderr, "Error: at most %d pairs\n", MAX_PAIRS);
+            return 1;
+        }
+        pair_t *p = &pairs[n_pairs++];
+        pair_init(p);
+        p->tx_iface = p->rx_iface = NULL;
+        if (parse_pair(pair_specs[i], p) < 0) {
+            fprintf(stderr, "Error: invalid --pair (\"TX RX [key=value ...]\", see --help)\n");
+            return 1;
+        }
+    }
 
-    memset(tc_data, 0, sizeof(tc_data));
+    if (config.rx_workers <= 0) {
+        config.rx_workers = config.read_file ? (int)sysconf(_SC_NPROCESSORS_ONLN) : 1;
+        if (config.rx_workers > TSN_CAPTURE_MAX_WORKERS) config.rx_workers = TSN_CAPTURE_MAX_WORKERS;
+    }
+
+    // Matrix defaults: pair i gets its own range, the TX CPU then one per RX worker
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int pair_cpus = 1 + config.rx_workers;
+    if (matrix && n_pairs * pair_cpus > ncpu) {
+        fprintf(stderr, "Warning: %d pairs with %d RX worker%s need %d CPUs, %d online; "
+                "pairs will share CPUs\n", n_pairs, config.rx_workers, config.rx_workers > 1 ? "s" : "",
+                n_pairs * pair_cpus, ncpu);
+    }
+    for (int i = 0; i < n_pairs; i++) {
+        pair_t *p = &pairs[i];
+        if (p->frame_size < TSN_MIN_FRAME_SIZE) p->frame_size = TSN_MIN_FRAME_SIZE;
+        if (p->frame_size > TSN_MAX_FRAME_SIZE) p->frame_size = TSN_MAX_FRAME_SIZE;
+        if (p->pps < 1) {
+            fprintf(stderr, "Error: pps must be positive\n");
+            return 1;
+        }
+        if (matrix && p->tx_cpu < 0) {
+            p->tx_cpu = (pair_cpus * i) % ncpu;
+            p->rx_cpu = (pair_cpus * i + 1) % ncpu;
+        }
+        if (config.read_file) continue;
+
+        if (p->src_mac[0]) tsn_parse_mac(p->src_mac, p->tx_mac);
+        else tsn_get_iface_mac(p->tx_iface, p->tx_mac);
+        for (int j = 0; j < i; j++) {
+            if (memcmp(pairs[j].tx_mac, p->tx_mac, 6) == 0) {
+                fprintf(stderr, "Warning: pairs %d and %d send from the same MAC; "
+                        "their frames cannot be told apart\n", j, i);
+            }
+        }
+    }
+
+    int sweep_tcs[MAX_TC];
+    int sweep_num_tcs = 0;
+    if (config.mode == MODE_SWEEP) {
+        if (config.read_file || config.pacing != PACING_PACER) {
+            fprintf(stderr, "Error: --mode sweep drives live traffic (hybrid, spin or sleep pacing)\n");
+            return 1;
+        }
+        if (config.sweep_steps < 1 || config.sweep_steps > MAX_SWEEP_STEPS ||
+            config.sweep_lo <= 0 || config.sweep_hi < config.sweep_lo || config.step_ms <= 0) {
+            fprintf(stderr, "Error: invalid sweep range/steps\n");
+            return 1;
+        }
+        sweep_num_tcs = tsn_parse_tc_list(config.tc_list, sweep_tcs);
+        if (sweep_num_tcs == 0 || sweep_init(sweep_tcs, sweep_num_tcs) < 0) {
+            fprintf(stderr, "Error: --idle-slope needs one value or one per TC in --tc\n");
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < n_pairs; i++) {
+        for (int t = 0; t < MAX_TC; t++) {
+            if (init_stream(&pairs[i], &pairs[i].tc_data[t]) < 0) {
+                fprintf(stderr, "Error: cannot allocate phase histograms\n");
+                return 1;
+            }
+            tsn_seq_init(&pairs[i].tc_data[t].seq);
+        }
+    }
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
-    fprintf(stderr, "TSN Verification: mode=%s, tx=%s, rx=%s, duration=%ds\n",
-            config.mode == MODE_CBS ? "CBS" : (config.mode == MODE_TAS ? "TAS" : "BOTH"),
-            config.tx_iface, config.rx_iface, config.duration);
+    const char *mode_names[] = { "CBS", "TAS", "BOTH", "SWEEP" };
+    const char *mode_name = mode_names[config.mode];
+    pthread_t tx_tid[MAX_PAIRS], rx_tid[MAX_PAIRS];
+
+    if (config.read_file) {
+        // The RX thread returns at the end of the file
+        fprintf(stderr, "TSN Verification: mode=%s, file=%s\n", mode_name, config.read_file);
+        pthread_create(&rx_tid[0], NULL, rx_thread, &pairs[0]);
+        pthread_join(rx_tid[0], NULL);
+    } else if (config.mode == MODE_SWEEP) {
+        fprintf(stderr, "TSN Verification: mode=%s, tx=%s, rx=%s, %d steps x%.2f..x%.2f\n",
+                mode_name, config.tx_iface, config.rx_iface, config.sweep_steps,
+                config.sweep_lo, config.sweep_hi);
+
+        pthread_create(&rx_tid[0], NULL, rx_thread, &pairs[0]);
+        usleep(100000);  // Let RX settle
+        pthread_create(&tx_tid[0], NULL, tx_thread, &pairs[0]);
+
+        run_sweep(sweep_tcs, sweep_num_tcs, pairs[0].frame_size);
+
+        running = 0;
+        pthread_join(tx_tid[0], NULL);
+        pthread_join(rx_tid[0], NULL);
+
+        print_sweep_results(&pairs[0]);
+        if (!config.json_output) {
+            print_seq_table(&pairs[0]);
+            print_instr_human(&pairs[0]);
+        }
+        return 0;
+    } else {
+        if (matrix) {
+            fprintf(stderr, "TSN Verification: matrix of %d pairs, duration=%ds\n", n_pairs, config.duration);
+            for (int i = 0; i < n_pairs; i++) {
+                fprintf(stderr, "  pair %d: tx=%s rx=%s mode=%s tc=%s pps=%d vlan=%d (CPUs %d/%d)\n",
+                        i, pairs[i].tx_iface, pairs[i].rx_iface, mode_names[pairs[i].mode],
+                        pairs[i].tc_list, pairs[i].pps, pairs[i].vlan_id, pairs[i].tx_cpu, pairs[i].rx_cpu);
+            }
+        } else {
+            fprintf(stderr, "TSN Verification: mode=%s, tx=%s, rx=%s, duration=%ds\n",
+                    mode_name, config.tx_iface, config.rx_iface, config.duration);
+        }
 
-    // Start threads
-    pthread_t tx_tid, rx_tid;
-    pthread_create(&rx_tid, NULL, rx_thread, NULL);
-    usleep(100000);  // Let RX settle
-    pthread_create(&tx_tid, NULL, tx_thread, NULL);
+        // Start threads: every pair's RX, then every pair's TX
+        for (int i = 0; i < n_pairs; i++) pthread_create(&rx_tid[i], NULL, rx_thread, &pairs[i]);
+        usleep(100000);  // Let RX settle
+        for (int i = 0; i < n_pairs; i++) pthread_create(&tx_tid[i], NULL, tx_thread, &pairs[i]);
 
-    // Wait for duration
-    uint64_t end_time = get_time_ns() + (uint64_t)config.duration * 1000000000ULL;
-    while (running && get_time_ns() < end_time) {
-        usleep(100000);
-    }
+        // Wait for duration
+        uint64_t end_time = tsn_time_ns() + (uint64_t)config.duration * 1000000000ULL;
+        while (running && tsn_time_ns() < end_time) {
+            usleep(100000);
+        }
 
-    running = 0;
-    pthread_join(tx_tid, NULL);
-    pthread_join(rx_tid, NULL);
+        running = 0;
+        for (int i = 0; i < n_pairs; i++) pthread_join(tx_tid[i], NULL);
+        for (int i = 0; i < n_pairs; i++) pthread_join(rx_tid[i], NULL);
+    }
 
     fprintf(stderr, "Analyzing results...\n");
 
     // Analyze
-    for (int t = 0; t < MAX_TC; t++) {
-        if (tc_data[t].packet_count > 0) {
-            if (config.mode == MODE_CBS || config.mode == MODE_BOTH) {
-                detect_bursts(&tc_data[t]);
-                analyze_cbs(&tc_data[t]);
+    for (int i = 0; i < n_pairs; i++) {
+        pair_t *p = &pairs[i];
+        uint64_t t0 = tsn_instr_ticks(), frames = 0;
+        for (int t = 0; t < MAX_TC; t++) frames += p->tc_data[t].stream.count;
+        if (p->mode == MODE_CBS || p->mode == MODE_BOTH) {
+            for (int t = 0; t < MAX_TC; t++) {
+                analyze_cbs(&p->tc_data[t]);
             }
         }
-    }
 
-    if (config.mode == MODE_TAS || config.mode == MODE_BOTH) {
-        estimated_cycle_ns = detect_cycle();
-        for (int t = 0; t < MAX_TC; t++) {
-            if (tc_data[t].packet_count > 0) {
-                analyze_tas(&tc_data[t], estimated_cycle_ns, t);
+        if (p->mode == MODE_TAS || p->mode == MODE_BOTH) {
+            p->estimated_cycle_ns = detect_cycle(p);
+            for (int t = 0; t < MAX_TC; t++) {
+                analyze_tas(&p->tc_data[t], p->estimated_cycle_ns);
             }
         }
+        tsn_stage_add(&p->analysis, t0, tsn_instr_ticks(), frames);
     }
 
     // Output
+    if (matrix) {
+        print_matrix_results();
+        return 0;
+    }
     if (config.mode == MODE_CBS || config.mode == MODE_BOTH) {
-        print_cbs_results();
+        print_cbs_results(&pairs[0]);
     }
     if (config.mode == MODE_TAS || config.mode == MODE_BOTH) {
-        print_tas_results();
+        print_tas_results(&pairs[0]);
+    }
+    if (!config.json_output) {
+        print_seq_table(&pairs[0]);
+        print_instr_human(&pairs[0]);
     }
 
     return 0;